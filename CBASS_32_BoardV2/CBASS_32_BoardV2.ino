@@ -58,6 +58,7 @@ WARNING: do not upgrade the Arduino ESP32 board definition past 2.0.13.
  ********************************************************/
 // C++ standard library
 #include <vector>               // Supports having vector of PIDs and another of data points.
+#include <memory>               // shared_ptr for state kept across the pieces of a web response.
 // Third-party libraries
 #include <SdFat.h>              // SD card library (do NOT use SD.h!)
 #include <Adafruit_ILI9341.h>   // Adafruit TFT LCD Display
@@ -85,10 +86,25 @@ WARNING: do not upgrade the Arduino ESP32 board definition past 2.0.13.
   To be safe, put every function used in this file into this list.
  */
 #include "Definitions.h"  // Prototypes and some class and constant definitions.
+#include "RampPlan.h"     // The ramp plan as a table of linear segments.
+#include "RampStream.h"   // Long ramp plans read from their own file a window at a time.
+#include "SettingsParser.h" // Settings.ini in one pass, with line and column for errors.
+#include "SectorFile.h"   // New files on SD written a whole sector at a time.
+#include "SettingsFile.h" // Settings.ini rewritten in one step, with a numbered backup.
+#include "PlanJSON.h"     // Ramp plans posted from the web page, parsed as they arrive.
+#include "RingBuffer.h"   // Fixed-size history storage for graph points.
+#include "GraphTiers.h"   // Minute and ten minute summaries of the graph points.
+#include "GraphJournal.h" // The graph history on SD, restored at boot.
+#include "LogWriter.h"    // Buffered writes to LOG.txt.
+#include "LogIndex.h"     // Where each ten minutes of the log starts, for /LogRange.
+#include "LogRecord.h"    // The binary log format and its CSV equivalent.
+#include "StaticFiles.h"  // /htdocs from SPIFFS, gzipped when the browser accepts it.
+#include "PageTemplate.h" // Web page templates compiled into text and fill functions.
 
 // ===== Global variables are defined below. =====
 const int port = 80;
 AsyncWebServer server(port);
+AsyncEventSource events("/events");  // New graph points, as they are stored.
 IPAddress myIP;
 
 // The TFT display uses SPI communication, but now on a separate hardware channel
@@ -105,8 +121,21 @@ DateTime  t;
 
 // A file for logging the data.
 File32 logFile;
+// LOG.txt is kept open and written a sector at a time.  This is the longest unwritten log
+// data may wait in memory.  Rollover, downloads and reboots always flush it first.
+const unsigned long LOGsyncMs = 60000;
+LogWriter logWriter(SDF, "/LOG.txt", LOGsyncMs);
+LogIndex logIndex(SDF, LOGindexPath);
+uint32_t logHeaderAt = 0;          // File position of the latest header in the log.
 boolean logPaused = false;
 unsigned long startPause = 0;
+// Automatic rollover, set by LOGROLLKB and LOGROLLTIME in Settings.ini.
+unsigned long logRollKB = 0;       // Roll over once the log reaches this size.  0 for no limit.
+int logRollMinutes = -1;           // Roll over daily at this time of day.  -1 for never.
+uint32_t nextLogRoll = 0;          // RTC seconds of the next daily rollover, 0 until worked out.
+uint32_t logRollRetry = 0;         // After a failed rollover, RTC seconds before LOGROLLKB tries again.
+const uint32_t LOGrollRetrySeconds = 600;
+SemaphoreHandle_t rollMutex;       // One rollover at a time, from the web or logTask.
 
 // Storage for the characters of keywords while reading Settings.ini.
 // Now expanded from 16 bytes to 128 so it can be used for longer 
@@ -122,17 +151,20 @@ DeviceAddress thermometer[NT];
 
 //Define Variables we'll Need
 // Ramp plan
-unsigned int rampMinutes[MAX_RAMP_STEPS];  // Time for each ramp step.
-int rampHundredths[NT][MAX_RAMP_STEPS];  // Temperatures in 1/100 degree, because is half the storage of a float.
-short rampSteps = 0;  // Actual defined steps, <= MAX_RAMP_STEPS
+RampPlan rampPlan;           // One segment per step, with temperatures in 1/100 degree.
+SemaphoreHandle_t rampMutex; // The web server replaces rampPlan while controlTask reads it.
+RampStream rampStream(SDF);  // Used instead of rampPlan when Settings.ini has PLANFILE.
 boolean interpolateT = true; // If true, interpolate between ramp points, otherwise step.
 boolean relativeStart = false;  // Start from midnight (default) or a specified time.
 unsigned int relativeStartTime;  // Start time in minutes from midnight
+uint32_t relativeStartEpoch = 0; // RTC seconds of START when it has a date.  The plan then runs once rather than daily.
 
 // Time in minutes after midnight for lights on and off.  -1 means to do nothing.
 // If lights are used the preferred ways is with the LIGHTON and LIGHTOFF keywords
 // in Settings.ini
 bool switchLights = false;   // If LIGHTON and LIGHTOFF are in Settings.ini, this will be set true.
+bool logFormatBinary = false; // LOGFORMAT BINARY in Settings.ini.
+bool binaryLog = false;       // Log to LOG.bin rather than LOG.txt.  Set from logFormatBinary at boot only.
 int lightOnMinutes = -1, lightOffMinutes = -1;
 char LightStateStr[NT][4]; // [number of entries][characters + null terminator]
 
@@ -154,6 +186,8 @@ const unsigned int serialHeaderPeriod = 10000; // Print header after this many l
 unsigned int SerialOutCount = serialHeaderPeriod + 1;  // Print at the top of any new log.
 
 unsigned long rebootMillis = 0; // if set > 0 the system will reboot when millis() > this number
+const __FlashStringHelper *fatalMessage = NULL;  // From taskFatalError(), for displayTask to show.
+const unsigned long FATALrestartMs = 10000;      // How long it is shown before the restart.
 
 // Display Conversion Strings
 char setPointStr[5];  // Was an array of [NT][5], but we only need one at a time.
@@ -167,28 +201,72 @@ char RelayStateStr[NT][4]; // [number of entries][characters + null terminator]
 
 // A vector of PID Controllers which will be instantiated in setup().
 std::vector<PID> pids;
-// A vector of DataPoints for graphing.
+// A ring buffer of DataPoints for graphing.  Once full, each new point replaces the oldest.
 // Selection of graphHours:
-// Each additional hour of data takes up to 131,072 B of memory, with a 
-// long-term average of about 104 kB.
-//
-// 6 hours is a reasonable compromise for fast loading of the graphs on an external device.
-// 12 hours is safe.  Up to 72 hours can be loaded, but this leaves minimal
-// extra memory on the system and could be unstable.
-// This is based on NT = 8 and GRAPHwindow = 5000.  Memory use should decease linearly with increasing
-// GRAPHwindow.  Use drops less than linearly with decreasing NT since timestamps consume 
-// constant memory per point.
-// Your primary science data should still be based on the log files.  Live graph data does not survive reboots.
+// Each hour of data takes 720 points of 8 + 4*NT bytes: 28,800 B with NT = 8, or 17,280 B with NT = 4.
+// graphPoints is the finest of the three tiers below, and the other two reach further back
+// in less memory, so there is no need to make it longer.  Leave plenty of memory for the web server.
+// This is based on GRAPHwindow = 5000.  Memory use should decease linearly with increasing
+// GRAPHwindow.
+// Your primary science data should still be based on the log files.  Live graph data is kept on the SD
+// card as well (see GraphJournal.h) and restored after a restart, but only as far as the tiers below reach.
 const int GRAPHwindow = 5000;  // 5000 (5 seconds) gives good graph resolution without excessive resource use.
 const float graphHours = 12;               // Hours of data to store.
 const int maxGraphPoints = (int)(graphHours*3600/((float)GRAPHwindow/1000)); 
-std::vector<DataPoint> graphPoints;
+RingBuffer<DataPoint> graphPoints;
+// Older history is kept in coarser tiers, built as points arrive (see GraphTiers.h).
+// With NT = 4 the three tiers below take about 357 kB and span 14 days, where 36 hours
+// of 5 second points took 622 kB.  /runT answers from the finest tier reaching back far enough.
+const float minuteHours = 48;              // 1 minute means, 24 bytes each with NT = 4.
+const float tenMinuteDays = 14;            // 10 minute low/mean/high, 40 bytes each with NT = 4.
+RingBuffer<DataPoint> graphMinutes;
+RingBuffer<GraphRollup> graphTenMinutes;
+GraphAccumulator minuteSums(60000), tenMinuteSums(600000);
+// Added to millis() for graph timestamps, so points after a restart follow the restored ones.
+uint32_t graphMsOffset = 0;
+// Restored graph timestamps are moved back toward 0 before the next would reach this.
+const uint32_t GRAPHtimestampLimit = 0x7F000000;
+LogWriter graphJournal(SDF, GRAPHjournalPath, GRAPHsyncMs);
+bool journalNeedsHeader = true;    // The journal is new or was just restarted.
+uint32_t lastJournaled = 0;       // Timestamp of the newest graph point on the card, or 0 for none.
+unsigned long journalDrops = 0;    // Graph points not journaled because logTask fell behind.
+unsigned long graphRestoreMs = 0, graphRestored = 0;  // Time and points for restoreGraphHistory().
+unsigned long checkpointMs = 0;    // Time for the last checkpointGraph().
 
 // Formerly "printDate". No spaces or commas.  This becomes the first item on each log line.
 String logLabel = "CBASS-32";
 
 //TimeKeepers
 unsigned long now_ms = millis(),SERIALt, LCDt, GRAPHt;
+
+// Non-blocking temperature acquisition.  See getTemperatures().
+enum SensorPhase { SENSORS_START, SENSORS_CONVERTING, SENSORS_READING };
+SensorPhase sensorPhase = SENSORS_START;
+unsigned long conversionStart;  // millis() when the current conversion was requested.
+unsigned long conversionMs;     // Conversion time at the resolution in use, set in sensorsInit().
+unsigned int sensorToRead;      // Next thermometer[] to read.
+
+// Control pass timing.  If loopTimingPasses > 0 the average and worst time in microseconds
+// of each part of controlPass() is printed every loopTimingPasses passes.
+unsigned int loopTimingPasses = 0;
+const char *loopPhaseNames[LOOP_PHASES] = {"sensors", "targets", "control", "handoff"};
+unsigned long phaseMark;  // micros() at the end of the previous phase.
+unsigned long phaseTotal[LOOP_PHASES], phaseMax[LOOP_PHASES];
+unsigned int timedPasses = 0;
+
+// ***** Tasks *****
+// Thermal control runs in controlTask at a fixed period, pinned to one core at high priority.
+// Everything slow - writing LOG.txt, drawing the display, storing graph points - runs in its
+// own task on the other core.  The control task hands each of them a ControlSnapshot through
+// a queue and never waits, so a slow SD card or screen refresh cannot delay a relay decision.
+const unsigned int CONTROLperiod = 100;  // ms between control passes.  The PIDs' default SampleTime.
+const BaseType_t CONTROLcore = 1;        // Arduino's loop() also runs here, at priority 1.
+const BaseType_t IOcore = 0;             // The WiFi stack runs here.
+const UBaseType_t CONTROLpriority = 10;  // Above loop() and the web server, below WiFi.
+const UBaseType_t IOpriority = 2;
+QueueHandle_t logQueue, displayQueue, graphQueue;
+SemaphoreHandle_t graphMutex;      // graphTask adds to graphPoints while web requests read it.
+unsigned long snapshotDrops = 0;   // Snapshots not queued because the log or graph task fell behind.
 String bootTime;
 
 /////////////////////////////////////////////
@@ -201,9 +279,15 @@ void setup()
     pids.emplace_back(PID(&tempInput[i], &controlOutput[i], &setPoint[i], KP, KI, KD, DIRECT));
   }
 
-  // Reserve all the memory for the graph data used in the web interface.  This prevents wasted time and 
-  // memory later.  In one case this prevented the sketch from loading, so try commenting this if there is a problem.
+  // Reserve all the memory for the graph data used in the web interface.  This also sets
+  // how many points are kept, so it is required.
   graphPoints.reserve(maxGraphPoints);
+  graphMinutes.reserve((size_t)(minuteHours * 60));
+  graphTenMinutes.reserve((size_t)(tenMinuteDays * 24 * 6));
+  graphMutex = xSemaphoreCreateMutex();
+  rollMutex = xSemaphoreCreateMutex();
+  rampMutex = xSemaphoreCreateMutex();
+  rampStream.begin(rampMutex);
 
   // Start "reset if hung" watchdog timer.
   esp_task_wdt_init(WDT_TIMEOUT, true);
@@ -227,6 +311,10 @@ void setup()
   // Start the filesystem for SD card access.
   tftMessage("Starting file systems.", true);
   SDinit();                   // SD card
+  logWriter.begin();
+  logIndex.begin();
+  graphJournal.begin();
+  restoreGraphHistory();      // Before the web server, so the chart has it from the start.
 
 
   // This starts the in-memory filesystem used for web files.
@@ -249,6 +337,11 @@ void setup()
   esp_task_wdt_reset();
 
   readRampPlan();
+  binaryLog = logFormatBinary;
+  if (binaryLog) logWriter.setPath("/LOG.bin");
+  File32 log = SDF.open(logWriter.getPath(), O_RDONLY);
+  logIndex.trim(log.isOpen() ? log.fileSize() : 0);
+  log.close();
 
   esp_task_wdt_reset();
   rampOffsets();  // This does not need repeating in the main loop.
@@ -263,7 +356,9 @@ void setup()
   PIDinit();
 
   sensorsInit();
-  getTemperatures(); // Not needed for control until the loop() starts, but the web server is already active.
+  // Not needed for control until the loop() starts, but the web server is already active.
+  // This waits for one conversion; after this getTemperatures() never waits.
+  while (!getTemperatures()) delay(10);
 
   esp_task_wdt_reset();
 
@@ -284,6 +379,8 @@ void setup()
   LCDt = millis() - LCDwindow;
   GRAPHt = millis() - GRAPHwindow;
 
+  startTasks();
+
   // For debugging memory use only.
   // Serial.println("Heap info at end of setup:");
   // Serial.print("heap_caps_get_largest_free_block(MALLOC_CAP_32BIT) = "); Serial.print(heap_caps_get_largest_free_block(MALLOC_CAP_32BIT));
@@ -291,11 +388,14 @@ void setup()
 }
 
 /**
- * This loop checks temperatures and updates the heater and chiller states.  
- * With the ESP32 processor the fastest loops take only about 7 ms!  With temperature checks 294 ms and with logging, 304 ms.
+ * All the work is done by the tasks started in startTasks().  controlTask checks temperatures and
+ * updates the heater and chiller states every CONTROLperiod ms; logging, the display and graph
+ * data are handled by lower priority tasks on the other core.
+ * With the ESP32 processor a control pass takes only a few ms, since getTemperatures() does not wait
+ * for the sensors.  Set loopTimingPasses to see where the time goes.
  *
- * Loop times of around one second are known to be  effective for thermal control.  Changes to the code
- * which increase the loop time much beyond that should be followed by physical testing of temperature histories.
+ * Control periods of around one second are known to be effective for thermal control.  Changes to the code
+ * which increase the period much beyond that should be followed by physical testing of temperature histories.
  */
 /////////////////////////////////////////////
 //     LOOP                                //
@@ -303,122 +403,279 @@ void setup()
 unsigned long timer24h = 0;
 void loop()
 {
+  esp_task_wdt_reset();  // Reboot if hung for WDT_TIMEOUT seconds
+  if (rebootMillis && millis() > rebootMillis) {  // Support web reboots.
+    logWriter.close();
+    graphJournal.close();
+    ESP.restart();
+  }
+  delay(100);
+}
+
+/**
+ * Create the queues and start the control and I/O tasks.  Logging and the graph get a few
+ * snapshots of slack; the display only ever needs the latest.
+ */
+void startTasks() {
+  logQueue = xQueueCreate(4, sizeof(ControlSnapshot));
+  graphQueue = xQueueCreate(4, sizeof(ControlSnapshot));
+  displayQueue = xQueueCreate(1, sizeof(ControlSnapshot));
+  if (!logQueue || !graphQueue || !displayQueue) fatalError(F("Unable to create task queues."));
+
+  if (xTaskCreatePinnedToCore(controlTask, "control", 4096, NULL, CONTROLpriority, NULL, CONTROLcore) != pdPASS ||
+      xTaskCreatePinnedToCore(logTask, "log", 8192, NULL, IOpriority, NULL, IOcore) != pdPASS ||
+      xTaskCreatePinnedToCore(displayTask, "display", 4096, NULL, IOpriority, NULL, IOcore) != pdPASS ||
+      xTaskCreatePinnedToCore(graphTask, "graph", 4096, NULL, IOpriority, NULL, IOcore) != pdPASS ||
+      xTaskCreatePinnedToCore(rampTask, "ramp", 4096, NULL, IOpriority, NULL, IOcore) != pdPASS) {
+    fatalError(F("Unable to start tasks."));
+  }
+}
+
+/**
+ * Run controlPass() every CONTROLperiod ms.  vTaskDelayUntil keeps the period fixed no
+ * matter how long a pass takes.
+ */
+void controlTask(void *param) {
+  esp_task_wdt_add(NULL);
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    controlPass();
+    esp_task_wdt_reset();
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(CONTROLperiod));
+  }
+}
+
+/**
+ * Read the sensors, update targets and PIDs, set the relays, and hand a snapshot to
+ * any I/O task which is due for one.
+ */
+void controlPass() {
   // ***** Time Keeping *****
   now_ms = millis();
-  t = rtc.now();  // Do this every loop so called functions don't have to.
+  t = rtc.now();  // Do this every pass so called functions don't have to.
+  phaseMark = micros();
 
   // ***** INPUT FROM TEMPERATURE SENSORS *****
   getTemperatures();
+  loopPhaseDone(PHASE_SENSORS);
   // Update temperature targets.  This originally had a delay, but it takes almost no time.
   // checkTime(); // Print time of day, redundant with logging.
   getCurrentTargets();
   applyTargets();
   //ShowRampInfo(); // To display on serial monitor.
-
-  // ***** STORE DATA FOR GRAPHING ON OTHER DEVICES *****
-  if (now_ms - GRAPHt > GRAPHwindow) {
-    if (graphPoints.size() >= maxGraphPoints) graphPoints.erase(graphPoints.begin());
-    // Note that the next line implies passing the arguments to a DataPoint constructor.
-    graphPoints.emplace_back(now_ms, t, setPoint, tempT);
-    GRAPHt += GRAPHwindow;
-  }
+  loopPhaseDone(PHASE_TARGETS);
 
   // ***** UPDATE PIDs *****
-  for (i=0; i<NT; i++) pids[i].Compute();
+  for (int i=0; i<NT; i++) pids[i].Compute();
 
   //***** UPDATE RELAY STATE for TIME PROPORTIONAL CONTROL *****
   // For ESP we may want to slow this down if relays switch too often.
   updateRelays();
-
-  //***** UPDATE SERIAL MONITOR AND LOG *****
-  if (now_ms - SERIALt > SERIALwindow) {
+  loopPhaseDone(PHASE_CONTROL);
+
+  // ***** HAND OFF TO THE I/O TASKS *****
+  static ControlSnapshot snap;
+  bool graphDue = now_ms - GRAPHt > GRAPHwindow;
+  bool logDue = now_ms - SERIALt > SERIALwindow;
+  bool displayDue = now_ms - LCDt > LCDwindow;
+  if (graphDue || logDue || displayDue) takeSnapshot(snap);
+
+  // Store data for graphing on other devices.
+  if (graphDue) {
+    if (xQueueSend(graphQueue, &snap, 0) != pdPASS) snapshotDrops++;
+    GRAPHt += GRAPHwindow;
+  }
+  // Update the serial monitor and log.
+  if (logDue) {
     // Logging is skipped during certain web operations.
     if (!logPaused) {
-      SerialReceive();
-      SerialSend();
+      if (xQueueSend(logQueue, &snap, 0) != pdPASS) snapshotDrops++;
       SERIALt += SERIALwindow;
     } else {
       // Adjust timing so we log again promptly, but don't add extra "make up" log lines.
       SERIALt = millis() - SERIALwindow;
+    }
+  }
+  // Update the display.  An older snapshot not yet drawn is simply replaced.
+  if (displayDue) {
+    xQueueOverwrite(displayQueue, &snap);
+    LCDt += LCDwindow;
+  }
+  loopPhaseDone(PHASE_HANDOFF);
+  loopTimingReport();
+}
+
+void takeSnapshot(ControlSnapshot &s) {
+  s.ms = now_ms;
+  s.t = t;
+  for (int i=0; i<NT; i++) {
+    s.setPoint[i] = setPoint[i];
+    s.tempInput[i] = tempInput[i];
+    s.tempT[i] = tempT[i];
+    s.controlOutput[i] = controlOutput[i];
+    strcpy(s.relayState[i], RelayStateStr[i]);
+    strcpy(s.lightState[i], LightStateStr[i]);
+  }
+}
+
+/**
+ * Write a log line for each snapshot from controlTask, and roll the log over when
+ * Settings.ini asks for it.
+ */
+void logTask(void *param) {
+  ControlSnapshot s;
+  for (;;) {
+    if (xQueueReceive(logQueue, &s, portMAX_DELAY) != pdPASS) continue;
+    // Logging may have been paused since this snapshot was queued.  The graph points
+    // from the pause are journaled from graphPoints once it ends.
+    if (logPaused) continue;
+    SerialReceive();
+    SerialSend(s);
+    journalGraphPoints();
+    if (logRollDue(s.t)) rollLog();
+  }
+}
+
+/**
+ * True if the log has reached LOGROLLKB, or LOGROLLTIME has come around since
+ * the last daily rollover.  RTC time is local, so days start at multiples of 86400.
+ * After a failed rollover LOGROLLKB waits until logRollRetry, unless the clock was set back.
+ */
+bool logRollDue(const DateTime &now) {
+  uint32_t secs = now.unixtime();
+  bool retryDue = secs >= logRollRetry || logRollRetry > secs + LOGrollRetrySeconds;
+  if (logRollKB && logWriter.size() >= logRollKB * 1024 && retryDue) return true;
+  if (logRollMinutes < 0) return false;
+  if (nextLogRoll == 0 || nextLogRoll > secs + 86400) {
+    // First time, or the clock was set back.  Never roll over for a time already passed.
+    nextLogRoll = secs - secs % 86400 + logRollMinutes * 60;
+    if (nextLogRoll <= secs) nextLogRoll += 86400;
+    return false;
+  }
+  if (secs < nextLogRoll) return false;
+  while (nextLogRoll <= secs) nextLogRoll += 86400;
+  return true;
+}
+
+/**
+ * Redraw the display from the latest snapshot.  This task owns the screen once loop()
+ * starts, so it also shows and clears the warning while logging is paused, and shows
+ * the message from taskFatalError() until the restart.
+ */
+void displayTask(void *param) {
+  ControlSnapshot s;
+  bool warned = false;
+  const __FlashStringHelper *shown = NULL;
+  for (;;) {
+    if (xQueueReceive(displayQueue, &s, portMAX_DELAY) != pdPASS) continue;
+    if (fatalMessage) {
+      // Shown once, and left up until loop() restarts the board.
+      if (fatalMessage != shown) tftFatalError(fatalMessage);
+      shown = fatalMessage;
+      continue;
+    }
+    if (warned && !logPaused) {
+      tftPauseWarning(false);
+      warned = false;
+    }
+    displayTemperatureStatusBold(s);
+    if (logPaused) {
       tftPauseWarning(true);
+      warned = true;
     }
   }
+}
 
-  //***** UPDATE LCD *****
-  if (now_ms - LCDt > LCDwindow)
-  {
-    displayTemperatureStatusBold();
-    LCDt += LCDwindow;
+/**
+ * Add a DataPoint to graphPoints for each snapshot.  When graphPoints is full the oldest point is dropped.
+ * Each point is also pushed to chart pages listening on /events.  logTask journals it from graphPoints.
+ */
+void graphTask(void *param) {
+  ControlSnapshot s;
+  for (;;) {
+    if (xQueueReceive(graphQueue, &s, portMAX_DELAY) != pdPASS) continue;
+    DataPoint p(s.ms + graphMsOffset, s.t, s.setPoint, s.tempT);
+    xSemaphoreTake(graphMutex, portMAX_DELAY);
+    if (graphPoints.full() && (int32_t)(graphPoints.front().timestamp - lastJournaled) > 0) journalDrops++;
+    addGraphPoint(p);
+    xSemaphoreGive(graphMutex);
+    pushGraphPoint(p);
   }
-  esp_task_wdt_reset();  // Reboot if hung for WDT_TIMEOUT seconds
-  if (rebootMillis && now_ms > rebootMillis) ESP.restart(); // Support web reboots.
 }
 
-void SerialSend()
-{
-  //WARNING: the last argument to open() must be _WRITE for Mega, but _APPEND for ESP32. New: O_WRONLY | O_CREAT for SdFat.
-  logFile = SDF.open("/LOG.txt",  O_WRONLY | O_CREAT | O_APPEND);
-  //uint64_t lfs = logFile.size();
-  if (!logFile) {
-    Serial.println("ERROR: failed to write log file.");
-    checkSD("After failing to open LOG.txt"); // debug
-    fatalError(F("Unable to open LOG.txt for writing."));
+/**
+ * Read the next window of a PLANFILE ramp plan when controlTask asks for it.  Idle otherwise.
+ */
+void rampTask(void *param) {
+  for (;;) rampStream.serve();
+}
+
+/**
+ * Store p in graphPoints and sum it into the coarser tiers.  Caller holds graphMutex.
+ */
+void addGraphPoint(const DataPoint &p) {
+  graphPoints.emplace_back(p);
+  if (minuteSums.add(p)) {
+    DataPoint m = p;
+    minuteSums.done.meansTo(m);
+    graphMinutes.emplace_back(m);
   }
-  // more reliable than O_APPEND alone ?
-  logFile.seekEnd(0);
+  if (tenMinuteSums.add(p)) graphTenMinutes.emplace_back(tenMinuteSums.done);
+}
+
+/**
+ * Format one log line and send it to the serial monitor and to logWriter, which
+ * writes it to the log when a sector fills.  The line is built whole so lines from
+ * different tasks can never interleave in the file.  With a binary log the card
+ * gets a fixed-width record instead, which /LogDownload turns back into this line.
+ */
+void SerialSend(const ControlSnapshot &s)
+{
   if (SerialOutCount > serialHeaderPeriod) {
     printLogHeader();
     SerialOutCount = 0;
   }
-  // General data items not tied to a specific tank:
-  Serial.printf("%s,%s,%d,%d,%d,%d,", logLabel.c_str(), getdate(), now_ms, t.hour(), t.minute(), t.second());
-  logFile.printf("%s,%s,%d,%d,%d,%d,", logLabel.c_str(), getdate(), now_ms, t.hour(), t.minute(), t.second());
-  // Per-tank items
-  for (i=0; i<NT; i++) {
-    if (switchLights) {
-      Serial.printf("%.2f,%.2f,%.2f,%.1f,%s,%s,", setPoint[i], tempInput[i], tempT[i], controlOutput[i], RelayStateStr[i], LightStateStr[i]);
-      logFile.printf("%.2f,%.2f,%.2f,%.1f,%s,%s,", setPoint[i], tempInput[i], tempT[i], controlOutput[i], RelayStateStr[i], LightStateStr[i]);    
-    } else {
-      Serial.printf("%.2f,%.2f,%.2f,%.1f,%s,", setPoint[i], tempInput[i], tempT[i], controlOutput[i], RelayStateStr[i]);
-      logFile.printf("%.2f,%.2f,%.2f,%.1f,%s,", setPoint[i], tempInput[i], tempT[i], controlOutput[i], RelayStateStr[i]);
-    }
-  }
-  printlnBoth();
+  LogSample sample;
+  logSampleFrom(s, sample);
+  char line[LOGlineMax];
+  int n = formatLogLine(line, sizeof(line), logLabel.c_str(), switchLights, NT, sample);
+  Serial.print(line);
   Serial.flush();
-  //logFile.sync(); // Same as flush() on Arduino, close covers this.
-  //Serial.printf("Log size increased from %llu to %llu.\n", lfs, (uint64_t)logFile.size());
-  logFile.close();
-  //Serial.println("Closed log file.");
+  bool written;
+  uint32_t at;
+  if (binaryLog) {
+    uint8_t record[LOGrecordMax];
+    written = logWriter.append((const char *)record, logDataRecord(record, sample), &at);
+  } else {
+    written = logWriter.append(line, n, &at);
+  }
+  if (written) logIndex.note(sample.epoch, at, logHeaderAt);
+  if (!written && !logWriter.isOpen()) {
+    Serial.println("ERROR: failed to write log file.");
+    checkSD("After failing to open the log"); // debug
+    taskFatalError(F("Unable to open the log file for writing."));
+  }
   SerialOutCount++;
 }
 
 /**
- * Typically this will be called once from setup() with no logFile open
- * and then periodically during loop().  Having the code here keeps
- * the two versions in sync.
+ * Called from SerialSend() at the top of each new log and every serialHeaderPeriod lines.
  * This assumes 5 data items per tank after the date and time information.
  *
- * This originally used printBoth for everything.  Not that it really matters
- * but this printf approach is about 4 times faster.  Unfortunately it means
- * either a loop with "ifs" inside for the log file, or one "if" and two loops.
+ * This originally used printBoth for everything.  Now the header is built once and
+ * sent to both the serial monitor and the log, like the data lines.  A binary log
+ * gets a header record, which also says how to read the records after it.
  */
 void printLogHeader() {
-  Serial.print(F("LogLabel,Date,N_ms,Th,Tm,Ts,"));
-  if (logFile) {
-    logFile.print(F("LogLabel,Date,N_ms,Th,Tm,Ts,"));
-
-    // Normally loop from 0, but here we want tank numbers.
-    for (int i=1; i<=NT; i++) {
-      logFile.printf("T%dSP,T%dinT,TempT%d,T%doutT,T%dRelayState", i, i, i, i, i);
-      if (i < NT) logFile.print(",");
-    }
-    logFile.println();
-  }
-  for (int i=1; i<=NT; i++) {
-    Serial.printf("T%dSP,T%dinT,TempT%d,T%doutT,T%dRelayState", i, i, i, i, i);
-    if (i < NT) Serial.print(",");
+  char line[LOGlineMax];
+  int n = formatLogHeader(line, sizeof(line), NT);
+  Serial.print(line);
+  if (binaryLog) {
+    uint8_t record[LOGheaderMax];
+    logWriter.append((const char *)record, logHeaderRecord(record, logLabel.c_str(), switchLights), &logHeaderAt);
+  } else {
+    logWriter.append(line, n, &logHeaderAt);
   }
-  Serial.println();
 }
 
 void SerialReceive()
@@ -459,18 +716,38 @@ void setupMessages() {
 }
 
 /**
- * Tell the sensors to get fresh temperatures and then store them after
- * applying any corrections we may have in place.
+ * Collect temperatures without waiting for the sensors.  A DS18B20 takes up to
+ * 750 ms to convert at 12 bits, and requestTemperatures() used to block for
+ * all of it on every pass through loop().  Now each call does one short step:
+ *   SENSORS_START      - start a conversion on all sensors at once.
+ *   SENSORS_CONVERTING - return until the conversion time has passed.
+ *   SENSORS_READING    - read one thermometer[] per call, applying any correction.
+ * After the last sensor is read the next conversion starts immediately.
+ * Returns true on the call which completes a full set of readings.
  */
-void getTemperatures() {
-  sensors.requestTemperatures();
-
-  // Get temperatures for each tank by address so we have a definite
-  // association between tanks, sensors, and addresses.
-  for (i=0; i<NT; i++) {
-    tempT[i] = sensors.getTempC(thermometer[i]) - correction[i];
-    if (0.0 < tempT[i] && tempT[i] < 80.0)  tempInput[i] = tempT[i];
+bool getTemperatures() {
+  switch (sensorPhase) {
+    case SENSORS_START:
+      sensors.requestTemperatures();  // Returns at once since waitForConversion is off.
+      conversionStart = millis();
+      sensorPhase = SENSORS_CONVERTING;
+      return false;
+    case SENSORS_CONVERTING:
+      if (millis() - conversionStart < conversionMs) return false;
+      sensorToRead = 0;
+      sensorPhase = SENSORS_READING;
+      // Fall through and read the first sensor now.
+    case SENSORS_READING:
+      // Get temperatures for each tank by address so we have a definite
+      // association between tanks, sensors, and addresses.
+      tempT[sensorToRead] = sensors.getTempC(thermometer[sensorToRead]) - correction[sensorToRead];
+      if (0.0 < tempT[sensorToRead] && tempT[sensorToRead] < 80.0)  tempInput[sensorToRead] = tempT[sensorToRead];
+      if (++sensorToRead < NT) return false;
+      sensorPhase = SENSORS_START;
+      getTemperatures();
+      return true;
   }
+  return false;
   /*  Original approach
   for (i=0; i<NT; i++) {
     tempT[i] = sensors.getTempCByIndex(i) - correction[i];
@@ -479,6 +756,36 @@ void getTemperatures() {
    */
 }
 
+/**
+ * Add the time since the last phase ended to the totals for phase p.
+ */
+void loopPhaseDone(LoopPhase p) {
+  if (!loopTimingPasses) return;
+  unsigned long now = micros();
+  unsigned long d = now - phaseMark;
+  phaseTotal[p] += d;
+  if (d > phaseMax[p]) phaseMax[p] = d;
+  phaseMark = now;
+}
+
+/**
+ * Print the average and worst time of each loop phase once loopTimingPasses
+ * passes have been timed, then start over.
+ */
+void loopTimingReport() {
+  if (!loopTimingPasses || ++timedPasses < loopTimingPasses) return;
+  unsigned long total = 0;
+  Serial.printf("Loop timing over %u passes, us avg/max:", timedPasses);
+  for (int p = 0; p < LOOP_PHASES; p++) {
+    Serial.printf(" %s %lu/%lu", loopPhaseNames[p], phaseTotal[p] / timedPasses, phaseMax[p]);
+    total += phaseTotal[p];
+    phaseTotal[p] = 0;
+    phaseMax[p] = 0;
+  }
+  Serial.printf(", pass %lu\n", total / timedPasses);
+  timedPasses = 0;
+}
+
 void ShowRampInfo() {
   for (int i=0; i<NT; i++) {
     Serial.printf("Tank %d target: %7.2f\n", (i+1), setPoint[i]);
@@ -8,6 +8,22 @@
  */
 
 struct DataPoint;  // pre-declare a struct used as a function argument below.
+struct HistoryQuery;
+struct ControlSnapshot;
+struct FileDownload;
+class LogTranscoder;
+class LogTextRange;
+struct GraphRollup;
+template <typename T> class RingBuffer;
+
+// Longest line SerialSend() or printLogHeader() will write.  8 tanks with lights need about 400.
+const int LOGlineMax = 512;
+
+// Month names as log lines have them, from RTC.ino.
+extern const char monthsOfTheYear[12][4];
+
+// The parts of a control pass timed when loopTimingPasses > 0.
+enum LoopPhase { PHASE_SENSORS, PHASE_TARGETS, PHASE_CONTROL, PHASE_HANDOFF, LOOP_PHASES };
 
 // Prototypes, typically just the first line of the function
 //  definition with " {" replaced by ";".
@@ -20,17 +36,18 @@ IPAddress connectWiFi();
 void readRampPlan();
 void rampOffsets();
 void getCurrentTargets();
+uint32_t rampSecond(const DateTime &now);
 void PIDinit();
 void applyTargets();
 void ShowRampInfo();
 void sensorsInit();
 String gettime();
 void relayTest();
-void getTemperatures();
+bool getTemperatures();
 void updateRelays();
 void SerialReceive();
-void SerialSend();
-void displayTemperatureStatusBold();
+void SerialSend(const ControlSnapshot &s);
+void displayTemperatureStatusBold(const ControlSnapshot &s);
 void printLogHeader();
 void printBoth(const char *str);
 void printBoth(unsigned int d);
@@ -39,31 +56,155 @@ void printBoth(double d, int places);
 void printlnBoth();
 String getdate();
 void fatalError(const __FlashStringHelper *msg);
+void taskFatalError(const __FlashStringHelper *msg);
+void tftFatalError(const __FlashStringHelper *msg);
 void nonfatalError(const __FlashStringHelper *msg);
 void defineWebCallbacks();
-void checkSD(char* txt);
+void checkSD(const char* txt);
 void setupMessages();
 void pauseLogging(boolean a);
-String dataPointToJSON(DataPoint p);
-void dataPointPrint(DataPoint p);
+void sendPage(AsyncWebServerRequest *request, PGM_P page, const char *contentType);
+void sendTemplate(AsyncWebServerRequest *request, int code, const char *contentType, PGM_P page);
+void compileTemplates();
+void tableForNT(Print &out);
+void directoryInput(Print &out);
+void sendSDFile(AsyncWebServerRequest *request, const char *path, const char *contentType, const char *downloadName);
+void sendBinaryLog(AsyncWebServerRequest *request);
+void sendLogRange(AsyncWebServerRequest *request, uint32_t from, uint32_t to);
+bool logTimeParam(AsyncWebServerRequest *request, const char *name, uint32_t &epoch);
+size_t fileChunks(FileDownload &d, uint8_t *buffer, size_t maxLen);
+int parseRange(const String &range, uint32_t size, uint32_t &first, uint32_t &end);
+String dataPointToJSON(const DataPoint &p);
+void dataPointPrint(const DataPoint &p);
+int hundredthsToStr(int16_t h, char *out);
+int dataPointToChars(const DataPoint &p, char *buf);
+size_t firstPointAtOrAfter(unsigned long oldest);
+void pushGraphPoint(const DataPoint &p);
+void addGraphPoint(const DataPoint &p);
+void restoreGraphHistory();
+void discardGraphHistory();
+void rebaseGraphHistory(uint32_t shift);
+void journalGraphPoints();
+bool checkpointGraph();
+void replayPoints(AsyncEventSourceClient *client);
+size_t fillHistory(HistoryQuery &q, uint8_t *buffer, size_t maxLen);
+void chooseHistoryTier(HistoryQuery &q);
+void decimateHistory(HistoryQuery &q, unsigned int maxPoints);
+bool historyStep(HistoryQuery &q, const RingBuffer<DataPoint> &ring);
+int bucketToChars(const RingBuffer<DataPoint> &ring, size_t first, size_t end, char *buf);
+int rollupToChars(const GraphRollup &r, char *buf);
+int hundredthsList(const int16_t *h, char *buf);
+void tftMessage(const char* msg, bool toSerial);
+void tftPauseWarning(boolean on);
+void checkWebPlaceholder();
+String getdate(DateTime t);
+String gettime(DateTime t);
+void setHeatRelay(int tank, boolean state, boolean push = true);
+void setChillRelay(int tank, boolean state, boolean push = true);
+void setLightRelay(int tank, boolean state, boolean push = true);
+int findSet(DeviceAddress a);
+void printAddressBytes(DeviceAddress deviceAddress);
+String rollLog();
+String rollLogFailed(const String &result, const DateTime &now);
+void loopPhaseDone(LoopPhase p);
+void loopTimingReport();
+void startTasks();
+void controlTask(void *param);
+void logTask(void *param);
+void displayTask(void *param);
+void graphTask(void *param);
+void rampTask(void *param);
+void controlPass();
+void takeSnapshot(ControlSnapshot &s);
+bool logRollDue(const DateTime &now);
+void box(const char* s, int line, int lineSize);
 
 // Store collected time and temperature information together.
 // old style as sent to Tchart.html:
 // {"NT":[4],"timeval":[54492],"CBASStod":["7:37:39"],"tempList":[19.8,20.1,19.8,20.6],"targetList":[24.0,24.0,24.0,24.0]}
+// Values are packed to keep many hours of history in memory: the time as Unix seconds
+// and temperatures in 1/100 degree, like the ramp plan.  This is 8 + 4*NT bytes per point
+// (24 bytes for 4 tanks) where doubles and a DateTime took 80.
+// dataPointToJSON() decodes them.
 struct DataPoint
 {
-  long unsigned int timestamp;
-  DateTime time; 
-  double target[NT];
-  double actual[NT];
+  uint32_t timestamp;  // millis() when recorded, plus graphMsOffset.  Tchart.html uses this as the key for each point.
+  uint32_t epoch;      // RTC time in seconds since 1970.
+  int16_t target[NT];  // Hundredths of a degree.
+  int16_t actual[NT];
     // A constructor so this can be built automatically by emplace_back
   DataPoint(long unsigned int t, DateTime dt, double tar[NT], double act[NT]) {
     timestamp = t;
-    time = dt;
-    //target = tar;
-    memcpy(&target, &tar[0], NT*sizeof(double));
-    memcpy(&actual, &act[0], NT*sizeof(double));
-  } 
+    epoch = dt.unixtime();
+    for (int i = 0; i < NT; i++) {
+      target[i] = toHundredths(tar[i]);
+      actual[i] = toHundredths(act[i]);
+    }
+  }
+  DataPoint() {}  // For reading from the graph journal.
+  DateTime time() const { return DateTime(epoch); }
+  // Round as "%.2f" does, so the JSON matches what was sent when doubles were stored.
+  static int16_t toHundredths(double d) {
+    if (!(d > INT16_MIN / 100.0)) return INT16_MIN;  // Also catches NaN.
+    if (d > INT16_MAX / 100.0) return INT16_MAX;
+    char s[12];
+    snprintf(s, sizeof(s), "%.2f", d);
+    char *dot = strchr(s, '.');
+    memmove(dot, dot + 1, strlen(dot));  // "-1.25" becomes "-125"
+    return (int16_t)atoi(s);
+  }
+};
+
+// The control state as of one pass of controlTask.  Copies go through queues
+// to the logging, display and graph tasks, so they never read values while
+// the control task is changing them.
+struct ControlSnapshot
+{
+  unsigned long ms;  // millis() at the start of the pass.
+  DateTime t;
+  double setPoint[NT];
+  double tempInput[NT];
+  double tempT[NT];
+  double controlOutput[NT];
+  char relayState[NT][4];
+  char lightState[NT][4];
+};
+
+// The progress of one /runT response.  The history is sent in chunks as the
+// web server asks for them, so this records where to pick up next.  The cursor
+// is a timestamp rather than a position because graphPoints shifts as points
+// are added.  With bucketMs set, each bucketMs of points from "from" on is
+// sent as at most two points; see bucketToChars().
+struct HistoryQuery
+{
+  byte tier = 0;          // 0 = graphPoints, 1 = graphMinutes, 2 = graphTenMinutes
+  unsigned long next;     // Timestamp of the next point to send.
+  unsigned long newest = ULONG_MAX;  // Timestamp of the last point wanted.
+  unsigned long from = 0;     // Start of the first bucket.
+  unsigned long bucketMs = 0; // 0 to send every point.
+  unsigned long started;  // millis() when the request arrived.
+  byte phase = 0;         // 0 = opening, 1 = points, 2 = closing, 3 = done
+  bool first = true;      // No comma before the first point.
+  bool truncated = false; // Out of time.  The closing includes "next" so the client can continue.
+  char pending[440];      // Up to two formatted points (or the closing) not yet copied out.
+  int pendingLen = 0;
+  int pendingPos = 0;
+  HistoryQuery(unsigned long oldest) : next(oldest), started(millis()) {}
+};
+
+// The progress of one download from the SD card.  Each response owns one, so
+// clients downloading at the same time each have their own file handle and
+// position.  It lives as long as the response, so a dropped connection still
+// closes the file and lets logging resume.
+struct FileDownload
+{
+  File32 file;
+  uint32_t next = 0;            // File position of the next byte to send.
+  uint32_t end = 0;             // One past the last byte to send.
+  LogTranscoder *csv = nullptr; // Set when LOG.bin goes out as CSV instead.
+  LogTextRange *lines = nullptr; // Set when part of LOG.txt goes out, for /LogRange.
+  FileDownload();
+  ~FileDownload();
 };
 
 // Colors are RGB, but 16 bits, not 24, allocated as 5, 6, and 5 bits for the 3 channels.
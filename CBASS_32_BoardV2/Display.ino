@@ -1,5 +1,4 @@
 // pre-declare this function
-void box(char* s, int line, int lineSize);
 
 void startDisplay() {
     // The dedicated SPI setup:
@@ -98,10 +97,33 @@ void tftMessage(const char* msg, bool toSerial) {
  * Put a message on the display and Serial monitor, and then
  * wait long enough to trigger a reboot.  Note that the argument
  * must be something like F("My message").
+ * This is for setup().  Once the tasks are running use taskFatalError().
  */
 void fatalError(const __FlashStringHelper *msg) {
   Serial.print(F("Fatal error: "));
   Serial.println(msg);
+  tftFatalError(msg);
+  // This is long enough to trigger the watchdog timer, causing a reboot.
+  // It prevents the run from starting and allows for a retry in case (for
+  // example) an SD card is inserted late.
+  delay(WDT_TIMEOUT*1000 + 1000);
+}
+
+/**
+ * fatalError() for the tasks started by startTasks().  Most of them are not
+ * watched by the watchdog, and displayTask owns the screen, so this only
+ * records the message.  displayTask shows it, and loop() restarts the board
+ * once FATALrestartMs have passed.  Only the first message is kept.
+ */
+void taskFatalError(const __FlashStringHelper *msg) {
+  if (fatalMessage) return;
+  Serial.print(F("Fatal error: "));
+  Serial.println(msg);
+  fatalMessage = msg;
+  rebootMillis = max(millis() + FATALrestartMs, 1UL);
+}
+
+void tftFatalError(const __FlashStringHelper *msg) {
   tft.fillScreen(BLACK);
   tft.setTextSize(3);
   tft.setTextColor(RED);
@@ -109,10 +131,6 @@ void fatalError(const __FlashStringHelper *msg) {
 
   tft.println(F("Fatal error: "));
   tft.print(msg);
-  // This is long enough to trigger the watchdog timer, causing a reboot.
-  // It prevents the run from starting and allows for a retry in case (for
-  // example) an SD card is inserted late.
-  delay(WDT_TIMEOUT*1000 + 1000);
 }
 
 void nonfatalError(const __FlashStringHelper *msg) {
@@ -128,7 +146,7 @@ void nonfatalError(const __FlashStringHelper *msg) {
   tft.print(msg);
   // In contrast to fatalError, wait 10 seconds without triggering
   // the watchdog timer.
-  for (i=0; i<5; i++) {
+  for (int i=0; i<5; i++) {
     delay(2000);
     esp_task_wdt_reset();
   }
@@ -159,7 +177,7 @@ void tftPauseWarning(boolean on) {
 }
 
 /*  Unbuffered version.  Faster and saves memory, but only significant on AVR-based Arduinos.
-void displayTemperatureStatusBold() {
+void displayTemperatureStatusBold(const ControlSnapshot &s) {
     tft.setTextSize(2);
     // Only clear below the heading for less flashing.  Also don't clear the boxes, which are refreshed anyway.
     //tft.fillRect(LINEHEIGHT*2, LINEHEIGHT3, TFT_WIDTH-LINEHEIGHT3*4, TFT_HEIGHT-LINEHEIGHT3, BLACK);
@@ -173,18 +191,18 @@ void displayTemperatureStatusBold() {
     int shiftUp = (NT >= 8) ? 5 : 0;
     int shrinkBox = (NT >= 8) ? 2 : 1;
     int lineTop;
-    for (i=0; i<NT; i++) {
+    for (int i=0; i<NT; i++) {
       lineTop = LINEHEIGHT3*(i+1) - shiftUp;
       if (NT >= 8) shiftUp = shiftUp + 2;
       tft.fillRect(LINEHEIGHT*2, lineTop, TFT_WIDTH-LINEHEIGHT3*4, LINEHEIGHT3, BLACK);
       tft.setCursor(0, lineTop);
       tft.print("T"); tft.print(i+1); tft.print(" ");
-      dtostrf(setPoint[i], 4, 1, setPointStr);
+      dtostrf(s.setPoint[i], 4, 1, setPointStr);
       tft.print(setPointStr);
       tft.print(" ");
-      dtostrf(tempInput[i], 4, 1, tempInputStr);
+      dtostrf(s.tempInput[i], 4, 1, tempInputStr);
       tft.print(tempInputStr);
-      box(RelayStateStr[i], lineTop, LINEHEIGHT3-2 - shrinkBox);
+      box(s.relayState[i], lineTop, LINEHEIGHT3-2 - shrinkBox);
     }
 
     // Add time and IP address in the smallest font at the bottom of the screen.
@@ -194,7 +212,7 @@ void displayTemperatureStatusBold() {
     tft.setTextColor(GREEN);
     tft.fillRect(0, TFT_HEIGHT-8, TFT_WIDTH, 8, BLACK);
 
-    tft.print(gettime());  tft.print("   IP: ");
+    tft.print(gettime(s.t));  tft.print("   IP: ");
     tft.print(myIP.toString().c_str());
 
     // Temporarily add boot time as a diagnostic
@@ -215,7 +233,7 @@ void displayTemperatureStatusBold() {
 // If enabled, a canvas variable will be needed globally or as a static here:
 GFXcanvas1 canvas(TFT_WIDTH-LINEHEIGHT3*2, LINEHEIGHT3); // For blink-free line updates on the screen.
 GFXcanvas1 canvasNarrow(TFT_WIDTH, 8); // For blink-free line updates on the screen.
-void displayTemperatureStatusBold() {
+void displayTemperatureStatusBold(const ControlSnapshot &s) {
     tft.setTextSize(2);
     // Only clear below the heading for less flashing.  Also don't clear the boxes, which are refreshed anyway.
     //tft.fillRect(LINEHEIGHT*2, LINEHEIGHT3, TFT_WIDTH-LINEHEIGHT3*4, TFT_HEIGHT-LINEHEIGHT3, BLACK);
@@ -229,21 +247,21 @@ void displayTemperatureStatusBold() {
     int shrinkBox = (NT >= 8) ? 2 : 1;
     int lineTop;
     canvas.setTextSize(3); // Drawing to a canvas first prevents display flashing.
-    for (i=0; i<NT; i++) {
+    for (int i=0; i<NT; i++) {
       lineTop = LINEHEIGHT3*(i+1) - shiftUp;
       if (NT >= 8) shiftUp = shiftUp + 2;
       canvas.fillScreen(BLACK);
       canvas.setCursor(0, 0);
       canvas.print("T"); canvas.print(i+1); canvas.print(" ");
-      dtostrf(setPoint[i], 4, 1, setPointStr);
+      dtostrf(s.setPoint[i], 4, 1, setPointStr);
       canvas.print(setPointStr);
       canvas.print(" ");
-      dtostrf(tempInput[i], 4, 1, tempInputStr);
+      dtostrf(s.tempInput[i], 4, 1, tempInputStr);
       canvas.print(tempInputStr);
       // The canvas is sized to overwrite the text in the old line, but not the relay box at the end.
       //tft.drawBitmap(0, LINEHEIGHT3 * (i+1), canvas.getBuffer(), TFT_WIDTH-LINEHEIGHT3*2, LINEHEIGHT3, WHITE, BLACK);
       tft.drawBitmap(0, lineTop, canvas.getBuffer(), TFT_WIDTH-LINEHEIGHT3*2, LINEHEIGHT3, WHITE, BLACK);
-      box(RelayStateStr[i], lineTop, LINEHEIGHT3-2 - shrinkBox);
+      box(s.relayState[i], lineTop, LINEHEIGHT3-2 - shrinkBox);
     }
 
         // Add time and IP address in the smallest font at the bottom of the screen.
@@ -252,7 +270,7 @@ void displayTemperatureStatusBold() {
     canvasNarrow.setTextColor(GREEN);
     canvasNarrow.fillRect(0, 0, TFT_WIDTH, 8, BLACK);
 
-    canvasNarrow.print(gettime());  canvasNarrow.print("   IP: ");
+    canvasNarrow.print(gettime(s.t));  canvasNarrow.print("   IP: ");
     canvasNarrow.print(myIP.toString().c_str());
 
     // Temporarily add boot time as a diagnostic
@@ -269,7 +287,7 @@ void displayTemperatureStatusBold() {
 
 // Draw a box with color based on relay state.
 // Place on the zero-based line specified.
-void box(char* s, int lineTop, int lineSize) {
+void box(const char* s, int lineTop, int lineSize) {
   word color;
   if (strcmp(s, "OFF") == 0) {
     color = BLACK;
@@ -286,7 +304,7 @@ void box(char* s, int lineTop, int lineSize) {
 
 // Draw a box with color based on relay state.
 // Place on the zero-based line specified.
-void boxOld(char* s, int line, int lineSize) {
+void boxOld(const char* s, int line, int lineSize) {
   word color;
   if (strcmp(s, "OFF") == 0) {
     color = BLACK;
@@ -0,0 +1,149 @@
+/**
+ * The graph history on the SD card, so a restart does not empty the chart.
+ *
+ * Two files hold it, both a series of records in the form below:
+ *   GRAPH.jnl  The journal.  logTask appends each new graph point as a 'P'
+ *              record, through a LogWriter, so it costs about one sector
+ *              write a minute.
+ *   GRAPH.ckp  A checkpoint of all three tiers of graphPoints and the
+ *              partial sums of the coarser ones, written every
+ *              GRAPHcheckpointMinutes.  It is written as GRAPH.new and
+ *              renamed, so there is always one whole checkpoint, and the
+ *              journal then starts again.
+ * At boot restoreGraphHistory() loads the checkpoint and replays the
+ * journal points which are newer.  Both are bounded, the checkpoint by the
+ * sizes of the tiers and the journal by the checkpoint period, so the boot
+ * time is too.
+ *
+ * Records:
+ *   Header, first in each file:
+ *     "CBASSGRF"  8 bytes
+ *     version     1 byte, GRAPHversion
+ *     tanks       1 byte, NT of the writer
+ *   Then records, each identified by its first byte:
+ *     'P'  a DataPoint in graphPoints
+ *     'M'  a DataPoint in graphMinutes
+ *     'T'  a GraphRollup in graphTenMinutes
+ *     'A'  minuteSums and tenMinuteSums, as they were
+ *     'E'  uint32 timestamp of the newest 'P' in the checkpoint; nothing follows
+ * Structures are stored as they are in memory, so a change to any of them, or
+ * to NT, must change GRAPHversion.  A file which does not match is ignored.
+ */
+#ifndef GRAPHJOURNAL_H
+#define GRAPHJOURNAL_H
+
+const char GRAPHjournalPath[] = "/GRAPH.jnl";
+const char GRAPHcheckpointPath[] = "/GRAPH.ckp";
+const char GRAPHnewPath[] = "/GRAPH.new";
+const unsigned long GRAPHcheckpointMinutes = 60;
+const unsigned long GRAPHsyncMs = 60000;  // Journal points lost to a power cut, at most.
+
+const char GRAPHmagic[] = "CBASSGRF";
+const uint8_t GRAPHversion = 1;
+const size_t GRAPHheaderSize = 10;
+const uint8_t GRAPHpoint = 'P';
+const uint8_t GRAPHminute = 'M';
+const uint8_t GRAPHtenMinute = 'T';
+const uint8_t GRAPHsums = 'A';
+const uint8_t GRAPHend = 'E';
+const size_t GRAPHrecordMax = 1 + 2 * sizeof(GraphAccumulator);
+
+// The bytes after the type byte, or 0 for an unknown type.
+inline size_t graphBodySize(uint8_t type) {
+  switch (type) {
+    case GRAPHpoint:
+    case GRAPHminute: return sizeof(DataPoint);
+    case GRAPHtenMinute: return sizeof(GraphRollup);
+    case GRAPHsums: return 2 * sizeof(GraphAccumulator);
+    case GRAPHend: return sizeof(uint32_t);
+  }
+  return 0;
+}
+
+inline size_t graphHeader(uint8_t *out) {
+  memcpy(out, GRAPHmagic, 8);
+  out[8] = GRAPHversion;
+  out[9] = NT;
+  return GRAPHheaderSize;
+}
+
+inline size_t graphRecord(uint8_t *out, uint8_t type, const void *body) {
+  out[0] = type;
+  memcpy(out + 1, body, graphBodySize(type));
+  return 1 + graphBodySize(type);
+}
+
+/**
+ * Records from a journal or checkpoint, read a sector at a time.  next()
+ * returns false at the end of the file, at a truncated last record, or at
+ * anything unrecognized, which is how a record cut short by a restart reads.
+ */
+class GraphReader {
+public:
+  ~GraphReader() { end(); }
+
+  // Open path and check its header.  False if it is missing or not ours.
+  bool begin(SdFat32 &sd, const char *path) {
+    end();
+    file = sd.open(path, O_RDONLY);
+    if (!file.isOpen()) return false;
+    uint8_t h[GRAPHheaderSize], want[GRAPHheaderSize];
+    graphHeader(want);
+    if (file.read(h, sizeof(h)) != (int)sizeof(h) || memcmp(h, want, sizeof(h))) {
+      end();
+      return false;
+    }
+    return true;
+  }
+
+  void end() {
+    if (file.isOpen()) file.close();
+    inPos = inLen = 0;
+    pos = GRAPHheaderSize;
+  }
+
+  uint32_t size() { return file.isOpen() ? file.fileSize() : 0; }
+
+  // Skip to a file position, which must be the start of a record.
+  bool seek(uint32_t to) {
+    inPos = inLen = 0;
+    pos = to;
+    return file.seekSet(to);
+  }
+
+  // The file position after the last record returned by next().
+  uint32_t position() const { return pos; }
+
+  // The next record's type, with body pointing to its bytes until the next call.
+  bool next(uint8_t &type, const uint8_t *&body) {
+    if (!file.isOpen() || !fill(1)) return false;
+    type = in[inPos];
+    size_t n = graphBodySize(type);
+    if (n == 0 || !fill(1 + n)) return false;
+    body = in + inPos + 1;
+    inPos += 1 + n;
+    pos += 1 + n;
+    return true;
+  }
+
+private:
+  bool fill(size_t need) {
+    if (inLen - inPos >= need) return true;
+    memmove(in, in + inPos, inLen - inPos);
+    inLen -= inPos;
+    inPos = 0;
+    while (inLen < need) {
+      int got = file.read(in + inLen, sizeof(in) - inLen);
+      if (got <= 0) return false;
+      inLen += got;
+    }
+    return true;
+  }
+
+  File32 file;
+  uint8_t in[512 + GRAPHrecordMax];
+  size_t inPos = 0, inLen = 0;
+  uint32_t pos = GRAPHheaderSize;
+};
+
+#endif
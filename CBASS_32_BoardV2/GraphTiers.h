@@ -0,0 +1,118 @@
+/**
+ * Coarser copies of the graph history, so the chart can show a whole
+ * multi-day assay without keeping every 5 s point.
+ *
+ * graphTask feeds each new DataPoint to a GraphAccumulator per tier.  When a
+ * point starts a new period the finished one is summarized and stored:
+ *   graphMinutes     1 minute means, as DataPoints
+ *   graphTenMinutes  10 minute GraphRollups: mean target, and the lowest,
+ *                    mean and highest actual temperature
+ * Periods are whole multiples of the period in millis(), and a summary takes
+ * the timestamp of its first point, so each tier stays in time order and a
+ * point's timestamp is still its key in the JSON.
+ *
+ * Adding a point is a few sums per tank, however much is stored.
+ */
+#ifndef GRAPHTIERS_H
+#define GRAPHTIERS_H
+
+struct GraphRollup
+{
+  uint32_t timestamp;     // millis() of the first point in the period.
+  uint32_t epoch;
+  int16_t target[NT];     // Means, in hundredths of a degree.
+  int16_t actual[NT];
+  int16_t actualMin[NT];
+  int16_t actualMax[NT];
+
+  // Copy the means into d, a DataPoint of the same period.
+  void meansTo(DataPoint &d) const {
+    d.timestamp = timestamp;
+    d.epoch = epoch;
+    memcpy(d.target, target, sizeof(target));
+    memcpy(d.actual, actual, sizeof(actual));
+  }
+};
+
+class GraphAccumulator {
+public:
+  explicit GraphAccumulator(uint32_t periodMs) : periodMs(periodMs) {}
+
+  // Add p.  Returns true if p began a new period, and the one before is now in done.
+  bool add(const DataPoint &p) {
+    uint32_t period = p.timestamp / periodMs;
+    bool finished = count > 0 && period != current;
+    if (finished) summarize();
+    if (count == 0 || finished) {
+      current = period;
+      count = 0;
+      first = p.timestamp;
+      firstEpoch = p.epoch;
+      for (int i = 0; i < NT; i++) {
+        targetSum[i] = actualSum[i] = 0;
+        lo[i] = hi[i] = p.actual[i];
+      }
+    }
+    for (int i = 0; i < NT; i++) {
+      targetSum[i] += p.target[i];
+      actualSum[i] += p.actual[i];
+      lo[i] = min(lo[i], p.actual[i]);
+      hi[i] = max(hi[i], p.actual[i]);
+    }
+    count++;
+    return finished;
+  }
+
+  GraphRollup done;  // The last finished period.
+
+  // Timestamp of the first point in the period being summed, or UINT32_MAX if none.
+  uint32_t openSince() const { return count ? first : UINT32_MAX; }
+
+  // Forget the period being summed.
+  void clear() { count = 0; }
+
+  // Move the period being summed ms earlier, along with the points it will meet.
+  // ms must be a multiple of periodMs, so the periods line up as before.
+  void rebase(uint32_t ms) {
+    first -= ms;
+    current -= ms / periodMs;
+  }
+
+private:
+  void summarize() {
+    done.timestamp = first;
+    done.epoch = firstEpoch;
+    for (int i = 0; i < NT; i++) {
+      done.target[i] = mean(targetSum[i]);
+      done.actual[i] = mean(actualSum[i]);
+      done.actualMin[i] = lo[i];
+      done.actualMax[i] = hi[i];
+    }
+  }
+
+  // Rounded to the nearest hundredth, halves away from zero.
+  int16_t mean(int32_t sum) const {
+    return (int16_t)((sum + (sum < 0 ? -(int32_t)count : (int32_t)count) / 2) / (int32_t)count);
+  }
+
+  uint32_t periodMs;
+  uint32_t current = 0;   // p.timestamp / periodMs of the period being summed.
+  uint32_t count = 0;
+  uint32_t first = 0, firstEpoch = 0;
+  int32_t targetSum[NT], actualSum[NT];
+  int16_t lo[NT], hi[NT];
+};
+
+// The index of the first item in ring with timestamp >= oldest, or ring.size().
+template <typename T>
+size_t firstAtOrAfter(const RingBuffer<T> &ring, unsigned long oldest) {
+  size_t lo = 0, hi = ring.size();
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (ring[mid].timestamp < oldest) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+#endif
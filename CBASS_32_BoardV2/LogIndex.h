@@ -0,0 +1,263 @@
+/**
+ * A sparse time index of the log, so /LogRange can send part of it without
+ * reading everything before.
+ *
+ * LOG.idx has an entry for the first line logged in each LOGindexSeconds of
+ * RTC time: the line's RTC time, its position in the log file, and the
+ * position of the header line (or header record) before it, so the range
+ * can start with the column names.  An entry is a few bytes written every
+ * LOGindexSeconds, so it costs nothing noticeable, and a lookup is a binary
+ * search of a few sector reads.  Entries are in time order as long as the
+ * clock does not go backwards; if it does, a lookup may start later than it
+ * should.
+ *
+ * The index belongs to whichever log is current, text or binary.  rollLog()
+ * removes it along with the log, and at boot trim() drops entries for lines
+ * which never reached the card.  A log with no index, or a time before the
+ * first entry, is read from the start.
+ *
+ * All calls hold a mutex, so any task may use them once begin() has been called.
+ */
+#ifndef LOGINDEX_H
+#define LOGINDEX_H
+
+const char LOGindexPath[] = "/LOG.idx";
+const uint32_t LOGindexSeconds = 600;
+
+struct LogIndexEntry
+{
+  uint32_t epoch = 0;   // RTC time of the line.
+  uint32_t offset = 0;  // File position of the line.
+  uint32_t header = 0;  // File position of the header before it.
+};
+
+class LogIndex {
+public:
+  unsigned long entries = 0;        // Written since boot.
+  unsigned long lookupMaxUs = 0;    // Longest find().
+
+  LogIndex(SdFat32 &sd, const char *path) : sd(sd), path(path) {}
+
+  void begin() {
+    if (!mutex) mutex = xSemaphoreCreateMutex();
+  }
+
+  /**
+   * Record a line just appended to the log at offset, if it is the first in its
+   * LOGindexSeconds.  header is the position of the latest header.  False if the
+   * index could not be written; the line is then only found by reading from an
+   * earlier entry.
+   */
+  bool note(uint32_t epoch, uint32_t offset, uint32_t header) {
+    uint32_t s = epoch / LOGindexSeconds;
+    if (!mutex || s == slot) return true;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    LogIndexEntry e;
+    e.epoch = epoch;
+    e.offset = offset;
+    e.header = header;
+    File32 f = sd.open(path, O_WRONLY | O_CREAT | O_APPEND);
+    bool ok = f.isOpen() && f.write((const uint8_t *)&e, sizeof(e)) == sizeof(e);
+    f.close();
+    if (ok) {
+      slot = s;
+      entries++;
+    }
+    xSemaphoreGive(mutex);
+    return ok;
+  }
+
+  // Forget the index, when the log it belongs to is moved away.
+  void clear() {
+    if (!mutex) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    sd.remove(path);
+    slot = UINT32_MAX;
+    xSemaphoreGive(mutex);
+  }
+
+  /**
+   * Drop entries at or beyond logSize, the size of the log at boot.  They are
+   * for lines lost in a restart, or the index is older than the log.
+   */
+  void trim(uint32_t logSize) {
+    if (!mutex) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    File32 f = sd.open(path, O_RDWR);
+    if (f.isOpen()) {
+      uint32_t n = f.fileSize() / sizeof(LogIndexEntry);
+      LogIndexEntry e;
+      while (n > 0 && readEntry(f, n - 1, e) && e.offset >= logSize) n--;
+      if (n * sizeof(LogIndexEntry) != f.fileSize()) f.truncate(n * sizeof(LogIndexEntry));
+      f.close();
+      if (n == 0) sd.remove(path);
+    }
+    xSemaphoreGive(mutex);
+  }
+
+  // The last entry at or before from, or an entry for the start of the log.
+  LogIndexEntry find(uint32_t from) {
+    LogIndexEntry found;
+    if (!mutex) return found;
+    unsigned long start = micros();
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    File32 f = sd.open(path, O_RDONLY);
+    if (f.isOpen()) {
+      uint32_t lo = 0, hi = f.fileSize() / sizeof(LogIndexEntry);
+      LogIndexEntry e;
+      while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (!readEntry(f, mid, e)) break;
+        if (e.epoch <= from) {
+          found = e;
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      f.close();
+    }
+    xSemaphoreGive(mutex);
+    unsigned long us = micros() - start;
+    if (us > lookupMaxUs) lookupMaxUs = us;
+    return found;
+  }
+
+private:
+  bool readEntry(File32 &f, uint32_t i, LogIndexEntry &e) {
+    return f.seekSet(i * sizeof(LogIndexEntry)) && f.read(&e, sizeof(e)) == (int)sizeof(e);
+  }
+
+  SdFat32 &sd;
+  const char *path;
+  SemaphoreHandle_t mutex = NULL;
+  uint32_t slot = UINT32_MAX;  // epoch / LOGindexSeconds of the last entry written.
+};
+
+/**
+ * The RTC time of a CSV log line, from its date and time fields.  False for
+ * anything else, such as the header line or the rollover note.
+ */
+inline bool logLineEpoch(const char *line, uint32_t &epoch) {
+  const char *p = strchr(line, ',');  // Past LogLabel.
+  if (!p) return false;
+  int year, day, hour, minute, second;
+  char month[4];
+  unsigned long ms;
+  if (sscanf(p + 1, "%d_%3[A-Za-z]_%d,%lu,%d,%d,%d", &year, month, &day, &ms, &hour, &minute, &second) != 7) return false;
+  for (int m = 0; m < 12; m++) {
+    if (!strcmp(month, monthsOfTheYear[m])) {
+      epoch = DateTime(year, m + 1, day, hour, minute, second).unixtime();
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Reads the lines of LOG.txt logged between two RTC times and hands them out
+ * a buffer at a time, for a chunked web response.  It starts at a LogIndex
+ * entry, sends the header line that entry names, and then skips lines until
+ * the first one at or after the start time.  The first line after the end
+ * time ends it.  The matching lines go out exactly as they are in the file.
+ */
+class LogTextRange {
+public:
+  ~LogTextRange() { end(); }
+
+  bool begin(SdFat32 &sd, const char *path, const LogIndexEntry &at, uint32_t fromEpoch, uint32_t toEpoch) {
+    end();
+    file = sd.open(path, O_RDONLY);
+    if (!file.isOpen() || !file.seekSet(at.header)) return false;
+    from = fromEpoch;
+    to = toEpoch;
+    skipTo = at.offset;
+    headerNext = true;
+    return true;
+  }
+
+  void end() {
+    if (file.isOpen()) file.close();
+    inPos = inLen = 0;
+    lineLen = linePos = 0;
+    started = false;
+  }
+
+  // Fill buffer with up to maxLen bytes of the range.  Returns 0, and closes the file, at the end.
+  size_t read(uint8_t *buffer, size_t maxLen) {
+    size_t n = 0;
+    while (n < maxLen) {
+      if (linePos == lineLen && !nextLine()) {
+        lineLen = linePos = 0;
+        break;
+      }
+      size_t take = min(maxLen - n, lineLen - linePos);
+      memcpy(buffer + n, line + linePos, take);
+      linePos += take;
+      n += take;
+    }
+    if (n == 0) end();
+    return n;
+  }
+
+private:
+  // Find the next line to send.  False at the end of the range.
+  bool nextLine() {
+    uint32_t epoch;
+    for (;;) {
+      if (!file.isOpen() || !readLine()) return false;
+      bool data = logLineEpoch(line, epoch);
+      if (headerNext) {
+        headerNext = false;
+        if (skipTo > file.curPosition() - (inLen - inPos)) {
+          file.seekSet(skipTo);
+          inPos = inLen = 0;
+        }
+        if (!data) return true;
+      }
+      if (data) {
+        if (epoch < from) continue;
+        if (epoch > to) {
+          file.close();
+          return false;
+        }
+        started = true;
+        return true;
+      }
+      if (started) return true;
+    }
+  }
+
+  // Read up to and including the next '\n' into line, or as much as fits.
+  bool readLine() {
+    lineLen = linePos = 0;
+    while (lineLen < sizeof(line) - 1) {
+      if (inPos == inLen) {
+        int got = file.read(in, sizeof(in));
+        if (got <= 0) break;
+        inPos = 0;
+        inLen = got;
+      }
+      const uint8_t *nl = (const uint8_t *)memchr(in + inPos, '\n', inLen - inPos);
+      size_t take = min((size_t)((nl ? nl + 1 : in + inLen) - (in + inPos)), sizeof(line) - 1 - lineLen);
+      memcpy(line + lineLen, in + inPos, take);
+      lineLen += take;
+      inPos += take;
+      if (line[lineLen - 1] == '\n') break;
+    }
+    line[lineLen] = 0;
+    return lineLen > 0;
+  }
+
+  File32 file;
+  uint8_t in[512];
+  size_t inPos = 0, inLen = 0;
+  uint32_t from = 0, to = UINT32_MAX;
+  uint32_t skipTo = 0;      // The index entry's line, sought once the header is read.
+  bool headerNext = false;  // The next line read is at the index entry's header.
+  bool started = false;     // A line in the range has been sent.
+  char line[LOGlineMax];
+  size_t lineLen = 0, linePos = 0;
+};
+
+#endif
@@ -0,0 +1,301 @@
+/**
+ * Log lines as fixed-width binary records, and the CSV they stand for.
+ *
+ * With "LOGFORMAT BINARY" in Settings.ini the log goes to LOG.bin instead of
+ * LOG.txt.  A line of about 145 characters (4 tanks, no lights) becomes a
+ * 49-byte record, so the card fills and is written about three times more
+ * slowly.  /LogDownload turns the records back into exactly the CSV LOG.txt
+ * would have held, so analysis scripts see no difference.
+ *
+ * The file is a series of records, each identified by its first byte:
+ *   Header, wherever the text log has its header line (each boot and every
+ *   serialHeaderPeriod lines), so what follows can be read on its own:
+ *     "CBASSLOG"  8 bytes
+ *     version     1 byte, LOGbinVersion
+ *     tanks       1 byte, NT of the writer
+ *     flags       1 byte, bit 0 set if lights are switched
+ *     labelLen    1 byte, then that many bytes of LogLabel
+ *   Data, one per log line:
+ *     'D'         1 byte
+ *     ms          uint32, millis()
+ *     epoch       uint32, RTC seconds since 1970
+ *     per tank    int16 setPoint, int16 tempInput, int16 tempT, all in hundredths,
+ *                 int32 controlOutput in tenths times 256, plus the relay state in
+ *                 bits 0-1, the light state in bits 2-3 and the minus bits of
+ *                 LogSample in bits 4-7.
+ * Numbers are little-endian, as the ESP32 stores them.
+ *
+ * Both the text and binary logs are formatted from a LogSample, so what is
+ * rounded for the binary record is also what the text line shows.
+ */
+#ifndef LOGRECORD_H
+#define LOGRECORD_H
+
+const char LOGbinMagic[] = "CBASSLOG";
+const uint8_t LOGbinVersion = 1;
+const uint8_t LOGbinData = 'D';
+const int LOGmaxTanks = 8;
+const size_t LOGheaderSize = 12;                    // Without the label.
+const size_t LOGheaderMax = LOGheaderSize + 255;
+const size_t LOGtankBytes = 3 * sizeof(int16_t) + sizeof(int32_t);
+const size_t LOGrecordMax = 9 + LOGmaxTanks * LOGtankBytes;
+
+inline size_t logRecordSize(int tanks) { return 9 + tanks * LOGtankBytes; }
+
+// The state strings, indexed by the codes stored in each record.
+const char *const LOGrelayNames[] = {"", "OFF", "HTR", "CHL"};
+const char *const LOGlightNames[] = {"", "DRK", "LGT", ""};
+
+// One log line with every value as it is printed.
+struct LogSample
+{
+  uint32_t ms;
+  uint32_t epoch;
+  int16_t setPoint[LOGmaxTanks];   // Hundredths of a degree.
+  int16_t tempInput[LOGmaxTanks];
+  int16_t tempT[LOGmaxTanks];
+  int32_t output[LOGmaxTanks];     // Tenths.
+  uint8_t relay[LOGmaxTanks];      // Index into LOGrelayNames.
+  uint8_t light[LOGmaxTanks];      // Index into LOGlightNames.
+  uint8_t minus[LOGmaxTanks];      // LOGminus bits for values of zero printed as "-0.00" or "-0.0".
+};
+
+// A value between -0.005 and 0 rounds to 0 hundredths but "%.2f" prints it as
+// "-0.00", as it always has in LOG.txt.  These bits keep that sign.
+enum LogMinus : uint8_t { LOGminusSetPoint = 1, LOGminusTempInput = 2, LOGminusTempT = 4, LOGminusOutput = 8 };
+
+inline uint8_t logMinus(double d, int32_t rounded, uint8_t bit) { return rounded == 0 && std::signbit(d) ? bit : 0; }
+
+// The value to print for v in units of 1/scale, with the sign kept by logMinus().
+inline double logValue(int32_t v, double scale, uint8_t minus, uint8_t bit) { return (minus & bit) ? -0.0 : v / scale; }
+
+inline uint8_t logStateCode(const char *s, const char *const names[], uint8_t n) {
+  for (uint8_t c = 1; c < n; c++) {
+    if (!strcmp(s, names[c])) return c;
+  }
+  return 0;
+}
+
+// Round as "%.1f" does, like DataPoint::toHundredths.  The PID output stays within +/-TPCwindow.
+inline int32_t logTenths(double d) {
+  if (!(d > -1e6)) return -10000000;  // Also catches NaN.
+  if (d > 1e6) return 10000000;
+  char s[16];
+  snprintf(s, sizeof(s), "%.1f", d);
+  char *dot = strchr(s, '.');
+  memmove(dot, dot + 1, strlen(dot));
+  return atol(s);
+}
+
+inline void logSampleFrom(const ControlSnapshot &s, LogSample &out) {
+  out.ms = s.ms;
+  out.epoch = s.t.unixtime();
+  for (int i = 0; i < NT; i++) {
+    out.setPoint[i] = DataPoint::toHundredths(s.setPoint[i]);
+    out.tempInput[i] = DataPoint::toHundredths(s.tempInput[i]);
+    out.tempT[i] = DataPoint::toHundredths(s.tempT[i]);
+    out.output[i] = logTenths(s.controlOutput[i]);
+    out.minus[i] = logMinus(s.setPoint[i], out.setPoint[i], LOGminusSetPoint) |
+                   logMinus(s.tempInput[i], out.tempInput[i], LOGminusTempInput) |
+                   logMinus(s.tempT[i], out.tempT[i], LOGminusTempT) |
+                   logMinus(s.controlOutput[i], out.output[i], LOGminusOutput);
+    out.relay[i] = logStateCode(s.relayState[i], LOGrelayNames, 4);
+    out.light[i] = logStateCode(s.lightState[i], LOGlightNames, 3);
+  }
+}
+
+// The CSV header line, as printLogHeader() has always written it.
+inline int formatLogHeader(char *line, size_t size, int tanks) {
+  int n = snprintf(line, size, "LogLabel,Date,N_ms,Th,Tm,Ts,");
+  // Normally loop from 0, but here we want tank numbers.
+  for (int i = 1; i <= tanks && n < (int)size; i++) {
+    n += snprintf(line + n, size - n, "T%dSP,T%dinT,TempT%d,T%doutT,T%dRelayState%s", i, i, i, i, i, (i < tanks) ? "," : "\r\n");
+  }
+  return min(n, (int)size - 1);
+}
+
+// One CSV log line, ending in "\r\n".
+inline int formatLogLine(char *line, size_t size, const char *label, bool lights, int tanks, const LogSample &s) {
+  DateTime t(s.epoch);
+  // General data items not tied to a specific tank:
+  int n = snprintf(line, size, "%s,%s,%lu,%d,%d,%d,", label, getdate(t).c_str(), (unsigned long)s.ms, t.hour(), t.minute(), t.second());
+  // Per-tank items
+  for (int i = 0; i < tanks && n < (int)size; i++) {
+    uint8_t m = s.minus[i];
+    n += snprintf(line + n, size - n, "%.2f,%.2f,%.2f,%.1f,%s,", logValue(s.setPoint[i], 100, m, LOGminusSetPoint),
+                  logValue(s.tempInput[i], 100, m, LOGminusTempInput), logValue(s.tempT[i], 100, m, LOGminusTempT),
+                  logValue(s.output[i], 10, m, LOGminusOutput), LOGrelayNames[s.relay[i] & 3]);
+    if (lights && n < (int)size) n += snprintf(line + n, size - n, "%s,", LOGlightNames[s.light[i] & 3]);
+  }
+  if (n < (int)size) n += snprintf(line + n, size - n, "\r\n");
+  return min(n, (int)size - 1);
+}
+
+inline size_t logHeaderRecord(uint8_t *out, const char *label, bool lights) {
+  size_t len = min(strlen(label), (size_t)255);
+  memcpy(out, LOGbinMagic, 8);
+  out[8] = LOGbinVersion;
+  out[9] = NT;
+  out[10] = lights ? 1 : 0;
+  out[11] = len;
+  memcpy(out + LOGheaderSize, label, len);
+  return LOGheaderSize + len;
+}
+
+inline size_t logDataRecord(uint8_t *out, const LogSample &s) {
+  uint8_t *p = out;
+  *p++ = LOGbinData;
+  memcpy(p, &s.ms, 4); p += 4;
+  memcpy(p, &s.epoch, 4); p += 4;
+  for (int i = 0; i < NT; i++) {
+    int32_t packed = s.output[i] * 256 + (s.relay[i] & 3) + ((s.light[i] & 3) << 2) + ((s.minus[i] & 15) << 4);
+    memcpy(p, &s.setPoint[i], 2); p += 2;
+    memcpy(p, &s.tempInput[i], 2); p += 2;
+    memcpy(p, &s.tempT[i], 2); p += 2;
+    memcpy(p, &packed, 4); p += 4;
+  }
+  return p - out;
+}
+
+// The inverse of logDataRecord(), for a record written with the given number of tanks.
+inline void logParseData(const uint8_t *p, int tanks, LogSample &s) {
+  p++;
+  memcpy(&s.ms, p, 4); p += 4;
+  memcpy(&s.epoch, p, 4); p += 4;
+  for (int i = 0; i < tanks; i++) {
+    int32_t packed;
+    memcpy(&s.setPoint[i], p, 2); p += 2;
+    memcpy(&s.tempInput[i], p, 2); p += 2;
+    memcpy(&s.tempT[i], p, 2); p += 2;
+    memcpy(&packed, p, 4); p += 4;
+    s.relay[i] = packed & 3;
+    s.light[i] = (packed >> 2) & 3;
+    s.minus[i] = (packed >> 4) & 15;
+    s.output[i] = (packed - (packed & 255)) / 256;
+  }
+}
+
+/**
+ * Reads LOG.bin and hands out the CSV for it a buffer at a time, for a
+ * chunked web response.  The file is read a sector at a time and one line
+ * is held until the response has taken all of it.  A truncated last record,
+ * or anything unrecognized, ends the output.  For /LogRange it can instead
+ * send a header record and then the records between two RTC times.
+ */
+class LogTranscoder {
+public:
+  ~LogTranscoder() { end(); }
+
+  bool isOpen() { return file.isOpen(); }
+
+  bool begin(SdFat32 &sd, const char *path) {
+    end();
+    file = sd.open(path, O_RDONLY);
+    return file.isOpen();
+  }
+
+  // Open path for the records logged from fromEpoch to toEpoch, found from the header
+  // record at header and the records from offset on.  See LogIndex.h.
+  bool begin(SdFat32 &sd, const char *path, uint32_t header, uint32_t offset, uint32_t fromEpoch, uint32_t toEpoch) {
+    if (!begin(sd, path) || !file.seekSet(header)) return false;
+    skipTo = offset > header ? offset : 0;
+    from = fromEpoch;
+    to = toEpoch;
+    return true;
+  }
+
+  void end() {
+    if (file.isOpen()) file.close();
+    inPos = inLen = 0;
+    lineLen = linePos = 0;
+    tanks = 0;
+    skipTo = from = 0;
+    to = UINT32_MAX;
+    headerSent = inRange = false;
+  }
+
+  // Fill buffer with up to maxLen bytes of CSV.  Returns 0, and closes the file, at the end.
+  size_t read(uint8_t *buffer, size_t maxLen) {
+    size_t n = 0;
+    while (n < maxLen) {
+      if (linePos == lineLen && !nextLine()) break;
+      size_t take = min(maxLen - n, (size_t)(lineLen - linePos));
+      memcpy(buffer + n, line + linePos, take);
+      linePos += take;
+      n += take;
+    }
+    if (n == 0) end();
+    return n;
+  }
+
+private:
+  // Make at least need bytes available from inPos.  False at the end of the file.
+  bool fill(size_t need) {
+    if (inLen - inPos >= need) return true;
+    memmove(in, in + inPos, inLen - inPos);
+    inLen -= inPos;
+    inPos = 0;
+    while (inLen < need) {
+      int got = file.read(in + inLen, sizeof(in) - inLen);
+      if (got <= 0) return false;
+      inLen += got;
+    }
+    return true;
+  }
+
+  // Decode the next record into line.  False at the end of the usable data.
+  bool nextLine() {
+    for (;;) {
+      if (!file.isOpen() || !fill(1)) return false;
+      if (in[inPos] == LOGbinData) {
+        if (tanks == 0 || !fill(logRecordSize(tanks))) return false;
+        LogSample s;
+        logParseData(in + inPos, tanks, s);
+        inPos += logRecordSize(tanks);
+        if (s.epoch < from) continue;  // Before a range.
+        if (s.epoch > to) return false;
+        inRange = true;
+        lineLen = formatLogLine(line, sizeof(line), label, lights, tanks, s);
+      } else {
+        if (!fill(LOGheaderSize) || memcmp(in + inPos, LOGbinMagic, 8)) return false;
+        const uint8_t *h = in + inPos;
+        if (h[8] != LOGbinVersion || h[9] < 1 || h[9] > LOGmaxTanks) return false;
+        size_t len = h[11];
+        if (!fill(LOGheaderSize + len)) return false;
+        h = in + inPos;  // fill() may have moved it.
+        tanks = h[9];
+        lights = h[10] & 1;
+        memcpy(label, h + LOGheaderSize, len);
+        label[len] = 0;
+        inPos += LOGheaderSize + len;
+        bool first = !headerSent;
+        headerSent = true;
+        if (skipTo) {
+          file.seekSet(skipTo);
+          inPos = inLen = 0;
+          skipTo = 0;
+        }
+        // Headers between a range's first header and its first record are not sent.
+        if (!first && !inRange) continue;
+        lineLen = formatLogHeader(line, sizeof(line), tanks);
+      }
+      linePos = 0;
+      return true;
+    }
+  }
+
+  File32 file;
+  uint8_t in[LOGheaderMax > 512 ? LOGheaderMax : 512];
+  size_t inPos = 0, inLen = 0;
+  int tanks = 0;           // From the latest header.  0 until one is read.
+  uint32_t skipTo = 0;     // Where to go after the first header, for a range.
+  uint32_t from = 0, to = UINT32_MAX;  // RTC times of the records wanted.
+  bool headerSent = false;
+  bool inRange = false;    // A record has been sent.
+  bool lights = false;
+  char label[256];
+  char line[LOGlineMax];
+  int lineLen = 0, linePos = 0;
+};
+
+#endif
@@ -0,0 +1,186 @@
+/**
+ * A buffered writer for the log file, LOG.txt or LOG.bin.
+ *
+ * SerialSend() used to open LOG.txt, seek to the end, write each field and
+ * close it again for every line.  Each open searches the directory, and each
+ * close rewrites the partly filled data sector and the directory entry, so a
+ * line of about 160 bytes cost five or six sector transfers on the card.
+ *
+ * LogWriter keeps the file open and collects lines in RAM.  Only whole
+ * 512-byte sectors, aligned with the file, are written as they fill.  Every
+ * syncMs, and on flush() or close(), the partial sector is written as well
+ * and the file synced, so a power failure loses at most syncMs of log.
+ *
+ * Call close() before anything else reads, copies or removes the file, and
+ * before a restart.  The next line reopens it.  All calls hold a mutex, so
+ * any task may use them once begin() has been called.
+ *
+ * Each append() is one record, a text line or a binary record, and is
+ * counted as dropped if any of it fails to reach the card.
+ */
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+class LogWriter {
+public:
+  static const size_t sectorSize = 512;
+  static const size_t bufferSize = 4 * sectorSize;
+  static const size_t maxRecords = bufferSize / 8;  // More than enough: log records are 12 bytes or more.
+
+  // Counters since boot.
+  unsigned long lines = 0;         // Lines passed to append().
+  unsigned long dropped = 0;       // Of those, lines lost because the file could not be opened or written.
+  unsigned long sectorWrites = 0;  // Sectors written, whole or partial.
+  unsigned long syncs = 0;
+  unsigned long writeCount = 0;    // Calls to the card, each writing one or more sectors and perhaps syncing.
+  uint64_t writeTotalUs = 0;
+  unsigned long writeMaxUs = 0;
+  unsigned long appendMaxUs = 0;   // Longest time a caller waited in append().
+  uint64_t appendTotalUs = 0;
+
+  LogWriter(SdFat32 &sd, const char *path, unsigned long syncMs) : sd(sd), path(path), syncMs(syncMs) {}
+
+  void begin() {
+    if (!mutex) mutex = xSemaphoreCreateMutex();
+  }
+
+  bool isOpen() { return file.isOpen(); }
+
+  const char *getPath() { return path; }
+
+  // Bytes in the file once everything buffered is written.  0 if the file is not open.
+  uint32_t size() {
+    if (!mutex) return 0;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    uint32_t n = file.isOpen() ? position + used : 0;
+    xSemaphoreGive(mutex);
+    return n;
+  }
+
+  // Close the current file, if open, and log to another.  path must stay valid.
+  void setPath(const char *newPath) {
+    close();
+    path = newPath;
+  }
+
+  /**
+   * Add text to the log, opening the file if needed.  The text is taken whole or
+   * not at all.  False if it was dropped.  If at is given it is set to the file
+   * position the text will have, for LogIndex.
+   */
+  bool append(const char *text, size_t len, uint32_t *at = NULL) {
+    if (!mutex || len > bufferSize) return false;
+    unsigned long start = micros();
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    lines++;
+    bool ok = openLocked();
+    if (ok && used + len > bufferSize) ok = writeLocked(false) && used + len <= bufferSize;
+    if (ok) {
+      if (at) *at = position + used;
+      memcpy(buffer + used, text, len);
+      used += len;
+      if (records == maxRecords) {  // Forget the oldest.  Only the dropped count suffers.
+        memmove(recordEnds, recordEnds + 1, --records * sizeof(recordEnds[0]));
+      }
+      recordEnds[records++] = position + used;
+      // Write any whole sectors, or everything if it is time to sync.
+      if (millis() - lastSync >= syncMs) writeLocked(true);
+      else if ((position % sectorSize) + used >= sectorSize) writeLocked(false);
+    } else {
+      dropped++;
+    }
+    xSemaphoreGive(mutex);
+    unsigned long us = micros() - start;
+    appendTotalUs += us;
+    if (us > appendMaxUs) appendMaxUs = us;
+    return ok;
+  }
+
+  // Write everything buffered and sync the file.
+  bool flush() {
+    if (!mutex) return false;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    bool ok = !file.isOpen() || writeLocked(true);
+    xSemaphoreGive(mutex);
+    return ok;
+  }
+
+  // Flush and close the file.  The next append() reopens it.
+  void close() {
+    if (!mutex) return;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    if (file.isOpen()) {
+      writeLocked(true);
+      file.close();
+    }
+    xSemaphoreGive(mutex);
+  }
+
+private:
+  bool openLocked() {
+    if (file.isOpen()) return true;
+    file = sd.open(path, O_WRONLY | O_CREAT | O_APPEND);
+    if (!file) return false;
+    file.seekEnd(0);
+    position = file.curPosition();
+    lastSync = millis();
+    return true;
+  }
+
+  /**
+   * Write the buffered sectors which are complete in the file, or everything
+   * followed by a sync if all is true.  On failure the buffered lines are
+   * counted as dropped and the file is closed so the next line reopens it.
+   */
+  bool writeLocked(bool all) {
+    size_t n = all ? used : ((position + used) / sectorSize) * sectorSize - position;
+    if (n == 0 && !all) return true;
+    unsigned long start = micros();
+    bool ok = file.write(buffer, n) == n;
+    if (ok) {
+      sectorWrites += (position % sectorSize + n + sectorSize - 1) / sectorSize;
+      position += n;
+      used -= n;
+      memmove(buffer, buffer + n, used);
+      forgetWritten();
+      if (all) {
+        ok = file.sync();
+        syncs++;
+        lastSync = millis();
+      }
+    }
+    if (!ok) {
+      dropped += records;
+      records = 0;
+      used = 0;
+      file.close();
+    }
+    unsigned long us = micros() - start;
+    writeCount++;
+    writeTotalUs += us;
+    if (us > writeMaxUs) writeMaxUs = us;
+    return ok;
+  }
+
+  // Keep only the records with some part still in the buffer.
+  void forgetWritten() {
+    size_t done = 0;
+    while (done < records && recordEnds[done] <= position) done++;
+    records -= done;
+    memmove(recordEnds, recordEnds + done, records * sizeof(recordEnds[0]));
+  }
+
+  SdFat32 &sd;
+  const char *path;
+  unsigned long syncMs;
+  SemaphoreHandle_t mutex = NULL;
+  File32 file;
+  uint32_t position = 0;          // File position of buffer[0].
+  unsigned long lastSync = 0;
+  size_t used = 0;
+  char buffer[bufferSize];
+  uint32_t recordEnds[maxRecords];  // File position just past each buffered record.
+  size_t records = 0;
+};
+
+#endif
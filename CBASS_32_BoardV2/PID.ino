@@ -1,7 +1,7 @@
 void applyTargets() {
   // Copy temperatures - it is not clear why we have both.  It may keep the PID values from
   // unwanted adjustments while the RAMP_START_TEMP values are being updated and adjusted.
-  for (i=0; i<NT; i++) setPoint[i] = RAMP_START_TEMP[i];
+  for (int i=0; i<NT; i++) setPoint[i] = RAMP_START_TEMP[i];
 }
 
 void rampOffsets() {
@@ -10,63 +10,39 @@ void rampOffsets() {
 }
 
 /**
- * Get the desired temperatures for the current time.
+ * Get the desired temperatures for the current time.  rampPlan holds the plan as
+ * compiled segments, so this is a multiply per tank.  See RampPlan.h.  With
+ * PLANFILE, rampStream has the steps near now instead; see RampStream.h.
  */
 void getCurrentTargets() {
-// Ramp temperatures would naturally be stored in a float (4 bytes), but the requirement of up to 12*24+1 points
-// per day uses too much memory.  Use an int (2 bytes), and consider it hundredths of a degree.  This saves
-// about 28% of possible global variable storage when the maximum points are used.
-
-  static short rampPos = 0; // latest index in the ramp plan. "static" makes it persist between calls.
-
-  unsigned int dayMin = t.minute() + 60 * t.hour();
-
-  //Apply relative time - dayMin can't go negative.
-  // Note that
-  if (relativeStart) {
-    if (dayMin > relativeStartTime) dayMin -= relativeStartTime;
-    else dayMin = (dayMin + 24*60) - relativeStartTime;
+  uint32_t second = rampSecond(t);
+  int16_t targets[NT];
+  xSemaphoreTake(rampMutex, portMAX_DELAY);
+  bool found = rampStream.isActive() ? rampStream.targetsAt(second, targets) : rampPlan.targetsAt(second, targets);
+  xSemaphoreGive(rampMutex);
+  if (found) {
+    for (int i=0; i<NT; i++) RAMP_START_TEMP[i] = targets[i] / 100.0;
+    return;
   }
+  Serial.printf("==ERROR== no current target found at minutes = %lu, relativeStartTime = %d\n", (unsigned long)(second / 60), relativeStartTime);
+  if (logFile) logFile.printf("==ERROR== no current target found at minutes = %lu, relativeStartTime = %d\n", (unsigned long)(second / 60), relativeStartTime);
+}
 
-
-  //Serial.print(" Relative start = "); Serial.println(relativeStartTime);
-  //Serial.print(" Adjusted dayMin = "); Serial.println(dayMin);
-  // We can be before the specified points, between two, or after all of them.
-  // rampPos is 0 at the start of a run, and the points to the latest position.
-  // If the time is less than the current start point, we are either before all
-  // points or wrapping past midnight.
-  if (rampMinutes[rampPos] > dayMin) rampPos = 0;
-
-  // Move up if necessary.
-  while (rampMinutes[rampPos+1] <= dayMin && rampPos < rampSteps - 1) {
-    rampPos++;
+/**
+ * Seconds into the ramp plan at RTC time now.  When START has a date they count
+ * from then, and before it the first step holds.  Otherwise they count from
+ * midnight, or the START time, each day.
+ */
+uint32_t rampSecond(const DateTime &now) {
+  if (relativeStartEpoch) {
+    uint32_t secs = now.unixtime();
+    return secs > relativeStartEpoch ? secs - relativeStartEpoch : 0;
   }
+  unsigned int dayMin = now.minute() + 60 * now.hour();
 
-  // Case 0: Before all points
-  if (dayMin < rampMinutes[rampPos]) {
-    for (i=0; i<NT; i++) RAMP_START_TEMP[i] = (double)rampHundredths[i][0] / 100.0;
-    return;
-  }
-  // Case 1: Between specified points.  This is the common case when ramps are active.
-  if (rampPos < rampSteps - 1) {
-    if (!interpolateT) {
-      for (i=0; i<NT; i++) RAMP_START_TEMP[i] = (double)rampHundredths[i][rampPos] / 100.0;
-      return;
-    }
-    double dayValue = (float)dayMin + t.second()/60.0;
-    double frac = (dayValue - rampMinutes[rampPos]) / (rampMinutes[rampPos+1] - rampMinutes[rampPos]);
-    for (i=0; i<NT; i++) {
-      RAMP_START_TEMP[i] = ((double)rampHundredths[i][rampPos] + frac * ((double)rampHundredths[i][rampPos+1] - (double)rampHundredths[i][rampPos])) / 100.0;
-    }
-    return;
-  }
-  // Case 2: past the last step, still on the same day.
-  if (rampPos == rampSteps - 1 && dayMin >= rampMinutes[rampPos]) {
-    for (i=0; i<NT; i++) RAMP_START_TEMP[i] = (double)rampHundredths[i][rampPos] / 100.0;
-    return;
-  }
-  Serial.printf("==ERROR== no current target found at minutes = %d, relativeStartTime = %d\n", dayMin, relativeStartTime);
-  if (logFile) logFile.printf("==ERROR== no current target found at minutes = %d, relativeStartTime = %d\n", dayMin, relativeStartTime);
+  //Apply relative time - dayMin can't go negative.
+  if (relativeStart) dayMin = (dayMin + 24*60 - relativeStartTime) % (24*60);
+  return dayMin * 60 + now.second();
 }
 
 
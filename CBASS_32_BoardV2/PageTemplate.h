@@ -0,0 +1,224 @@
+/**
+ * Web page templates, split once into literal text and placeholders.
+ *
+ * The library's template support scanned every byte of a page for '~' on
+ * each request and passed each name to processor(), which compared it with
+ * every known name in turn and returned the value as a new String.  Here
+ * each PROGMEM page is scanned once, at startup.  Placeholder names are
+ * hashed with templateKey(), which the compiler also runs on the names in
+ * templateFill()'s switch, so each placeholder is resolved to its fill
+ * function once.  A render is then a walk over a short list of segments:
+ * text copied straight from flash, and fill functions printing their values
+ * straight into the response buffer.
+ *
+ * Placeholders are as the library has them: ~NAME~ with a NAME of at most
+ * TEMPLATE_PARAM_NAME_LENGTH characters, and ~~ for a literal ~.  A name
+ * with no fill function gives nothing, as an empty processor() result did.
+ */
+#ifndef PAGETEMPLATE_H
+#define PAGETEMPLATE_H
+
+#include <string>
+
+// Prints the value of one placeholder.
+typedef void (*TemplateFill)(Print &out);
+
+// FNV-1a, 32 bits.
+constexpr uint32_t templateHash(const char *s, size_t n, uint32_t h) {
+  return n == 0 ? h : templateHash(s + 1, n - 1, (h ^ (uint8_t)*s) * 16777619u);
+}
+constexpr size_t templateLength(const char *s) {
+  return *s ? 1 + templateLength(s + 1) : 0;
+}
+constexpr uint32_t templateKey(const char *name) {
+  return templateHash(name, templateLength(name), 2166136261u);
+}
+constexpr uint32_t templateKey(const char *name, size_t len) {
+  return templateHash(name, len, 2166136261u);
+}
+
+// The fill function for a placeholder key, or NULL.  Defined in Server.ino.
+TemplateFill templateFill(uint32_t key);
+
+struct TemplateSegment {
+  const char *text;   // Literal text in flash, or NULL for a placeholder.
+  size_t len;
+  TemplateFill fill;
+};
+
+class PageTemplate {
+public:
+  explicit PageTemplate(PGM_P page) : page(page) {
+    const char *literal = page;
+    const char *p = page;
+    while ((p = strchr(p, TEMPLATE_PLACEHOLDER)) != NULL) {
+      const char *close = strchr(p + 1, TEMPLATE_PLACEHOLDER);
+      if (close == NULL || close - p - 1 > TEMPLATE_PARAM_NAME_LENGTH) {
+        p++;
+        continue;
+      }
+      if (close == p + 1) {
+        addText(literal, p + 1 - literal);  // Keep one ~ of the two.
+      } else {
+        addText(literal, p - literal);
+        TemplateFill fill = templateFill(templateKey(p + 1, close - p - 1));
+        if (fill) segments.push_back({NULL, 0, fill});
+      }
+      literal = p = close + 1;
+    }
+    addText(literal, strlen(literal));
+  }
+
+  PGM_P source() const { return page; }
+  const std::vector<TemplateSegment> &parts() const { return segments; }
+
+  // Render the whole page to out, for pages printed into a stream or inside another page.
+  void printTo(Print &out) const {
+    for (const TemplateSegment &s : segments) {
+      if (s.text) out.write((const uint8_t *)s.text, s.len);
+      else s.fill(out);
+    }
+  }
+
+private:
+  void addText(const char *text, size_t len) {
+    if (len == 0) return;
+    // Text either side of a ~~ is contiguous in flash, so join it.
+    if (!segments.empty() && segments.back().text && segments.back().text + segments.back().len == text) {
+      segments.back().len += len;
+    } else {
+      segments.push_back({text, len, NULL});
+    }
+  }
+
+  PGM_P page;
+  std::vector<TemplateSegment> segments;
+};
+
+/**
+ * The compiled form of page.  Pages are compiled on first use, and
+ * compileTemplates() in Server.ino asks for all of them at startup.
+ * Only the web server task uses this after startup.
+ */
+inline const PageTemplate &pageTemplate(PGM_P page) {
+  static std::vector<PageTemplate *> compiled;
+  for (const PageTemplate *t : compiled) {
+    if (t->source() == page) return *t;
+  }
+  compiled.push_back(new PageTemplate(page));
+  return *compiled.back();
+}
+
+/**
+ * A Print writing into the response buffer.  What does not fit is kept in
+ * spill, for the next buffer.
+ */
+class TemplateSink : public Print {
+public:
+  TemplateSink(uint8_t *buffer, size_t room, std::string &spill) : buffer(buffer), room(room), spill(spill) {}
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *data, size_t len) override {
+    size_t take = min(len, room - used);
+    memcpy(buffer + used, data, take);
+    used += take;
+    if (take < len) spill.append((const char *)data + take, len - take);
+    return len;
+  }
+  using Print::write;
+  size_t used = 0;
+
+private:
+  uint8_t *buffer;
+  size_t room;
+  std::string &spill;
+};
+
+// A Print appending to a std::string.
+class TemplateCapture : public Print {
+public:
+  explicit TemplateCapture(std::string &out) : out(out) {}
+  size_t write(uint8_t c) override { out += (char)c; return 1; }
+  size_t write(const uint8_t *data, size_t len) override { out.append((const char *)data, len); return len; }
+  using Print::write;
+
+private:
+  std::string &out;
+};
+
+/**
+ * One response's way through a PageTemplate, a buffer at a time, for a
+ * chunked or callback response.  capture() may be called first: it runs
+ * every fill function once and keeps the values, returning the hash and
+ * length of the page they make, and read() then sends exactly that.
+ */
+class TemplateRender {
+public:
+  explicit TemplateRender(const PageTemplate &t) : t(t) {}
+
+  // Returns an etagHash() of the page, starting from seed, and sets length.
+  uint64_t capture(uint64_t seed, size_t &length) {
+    values.clear();
+    uint64_t h = seed;
+    length = 0;
+    for (const TemplateSegment &s : t.parts()) {
+      if (s.text) {
+        h = etagHash(h, s.text, s.len);
+        length += s.len;
+      } else {
+        values.emplace_back();
+        TemplateCapture out(values.back());
+        s.fill(out);
+        h = etagHash(h, values.back().data(), values.back().size());
+        length += values.back().size();
+      }
+    }
+    captured = true;
+    return h;
+  }
+
+  // Fill buffer with up to maxLen bytes of the page.  0 at the end.
+  size_t read(uint8_t *buffer, size_t maxLen) {
+    size_t n = 0;
+    while (n < maxLen) {
+      if (spillPos < spill.size()) {
+        size_t take = min(maxLen - n, spill.size() - spillPos);
+        memcpy(buffer + n, spill.data() + spillPos, take);
+        spillPos += take;
+        n += take;
+        continue;
+      }
+      spill.clear();
+      spillPos = 0;
+      if (segment == t.parts().size()) break;
+      const TemplateSegment &s = t.parts()[segment];
+      if (s.text) {
+        size_t take = min(maxLen - n, s.len - offset);
+        memcpy(buffer + n, s.text + offset, take);
+        n += take;
+        offset += take;
+        if (offset < s.len) continue;
+      } else if (captured) {
+        spill.swap(values[value++]);
+      } else {
+        TemplateSink out(buffer + n, maxLen - n, spill);
+        s.fill(out);
+        n += out.used;
+      }
+      segment++;
+      offset = 0;
+    }
+    return n;
+  }
+
+private:
+  const PageTemplate &t;
+  size_t segment = 0;            // Next segment to send.
+  size_t offset = 0;             // Bytes of a literal segment already sent.
+  std::string spill;             // Fill output waiting for the next buffer.
+  size_t spillPos = 0;
+  bool captured = false;
+  std::vector<std::string> values;  // From capture(), in order.
+  size_t value = 0;
+};
+
+#endif
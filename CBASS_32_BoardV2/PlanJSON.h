@@ -0,0 +1,253 @@
+/**
+ * The body of a POST to /updateRampPlan, parsed as it arrives.
+ *
+ * The ramp plan page sends
+ *   [{"time":"00:00","tempList":["26.00","26.50","27.00","27.50"]},
+ *    {"time":"03:00","tempList":["28.00","28.50","29.00","29.50"]},
+ *    {"startTime":"13:00"},
+ *    {"magicWord":"..."}]
+ * in pieces of about one TCP segment, which may end anywhere, even inside a
+ * number.  The old handler appended the pieces to a String and then searched
+ * it over and over with indexOf().  feed() instead takes each piece as it
+ * comes and keeps only the token it is in, so memory does not grow with the
+ * body and each byte is looked at once.  Each row goes straight into plan,
+ * a staging RampPlan which receivePlanJSON() swaps in once all is accepted.
+ *
+ * Anything else stops the parse as soon as it is seen, with the offset of
+ * the byte: bad JSON, an unknown or repeated key, a value too long for a
+ * token, a time or temperature Settings.ini would not accept, a row without
+ * exactly NT temperatures, times going backwards, or too many rows.
+ * Temperatures may be strings, as the page sends them, or numbers.
+ */
+#ifndef PLANJSON_H
+#define PLANJSON_H
+
+const size_t PJtokenMax = 32;  // Longest key or value, a magic word included.
+
+class PlanJSON {
+public:
+  RampPlan plan;                 // The rows, in order.
+  int startMinutes = -1;         // startTime, or -1.
+  char magicWord[PJtokenMax + 1] = "";
+
+  const char *error = NULL;      // The first error, or NULL.
+  size_t errorAt = 0;            // Its offset in the body.
+
+  // Start a new body of total bytes, with room for up to maxSteps rows.
+  void begin(size_t total, size_t maxSteps) {
+    plan.clear();
+    // The shortest row the page sends is about 20 bytes plus 4 a temperature.
+    plan.reserve(min(maxSteps, total / (20 + 4 * NT) + 1));
+    this->maxSteps = maxSteps;
+    startMinutes = -1;
+    magicWord[0] = 0;
+    error = NULL;
+    errorAt = at = 0;
+    state = BeforeBody;
+    escaped = false;
+  }
+
+  // Parse the next len bytes of the body.  False once there is an error.
+  bool feed(const uint8_t *data, size_t len) {
+    for (size_t k = 0; k < len && !error; k++, at++) {
+      // A number ends at the character after it, which is then read again.
+      if (state == InNumber && !numberChar(data[k])) {
+        endTemperature();
+        if (error) break;
+        state = AfterTemperature;
+      }
+      step(data[k]);
+    }
+    return !error;
+  }
+
+  // The end of the body.  False unless it held a whole plan.
+  bool finish() {
+    if (error) return false;
+    if (state != AfterBody) fail("The plan ends part way through.");
+    else if (plan.size() < 2) fail("There must be at least two temperature input lines.");
+    else if (startMinutes < 0) fail("There is no startTime.");
+    return !error;
+  }
+
+private:
+  enum State : uint8_t {
+    BeforeBody, BeforeObject, BeforeKey, InKey, AfterKey, BeforeValue, InValue,
+    BeforeTemperature, InTemperature, InNumber, AfterTemperature, AfterValue, AfterObject, AfterBody
+  };
+  enum Key : uint8_t { Time = 1, TempList = 2, StartTime = 4, MagicWord = 8 };
+
+  void step(uint8_t c) {
+    bool space = c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    switch (state) {
+      case InKey:
+      case InValue:
+      case InTemperature:
+        quoted(c);
+        return;
+      case InNumber:
+        token(c);
+        return;
+      default:
+        if (space) return;
+    }
+    switch (state) {
+      case BeforeBody:
+        expect(c, '[', BeforeObject);
+        break;
+      case BeforeObject:
+        keys = 0;
+        count = 0;
+        expect(c, '{', BeforeKey);
+        break;
+      case BeforeKey:
+        startToken();
+        expect(c, '"', InKey);
+        break;
+      case AfterKey:
+        expect(c, ':', BeforeValue);
+        break;
+      case BeforeValue:
+        startToken();
+        if (key == TempList) expect(c, '[', BeforeTemperature);
+        else expect(c, '"', InValue);
+        break;
+      case BeforeTemperature:
+        startToken();
+        if (c == '"') {
+          state = InTemperature;
+        } else if (numberChar(c)) {
+          state = InNumber;
+          token(c);
+        } else {
+          fail("Expected a temperature.");
+        }
+        break;
+      case AfterTemperature:
+        if (c == ']') state = AfterValue;
+        else expect(c, ',', BeforeTemperature);
+        break;
+      case AfterValue:
+        if (c == '}') {
+          endObject();
+          state = AfterObject;
+        } else {
+          expect(c, ',', BeforeKey);
+        }
+        break;
+      case AfterObject:
+        if (c == ']') state = AfterBody;
+        else expect(c, ',', BeforeObject);
+        break;
+      default:  // AfterBody
+        fail("Unexpected text after the plan.");
+    }
+  }
+
+  // A character inside quotes.  Escapes are taken as the character escaped.
+  void quoted(uint8_t c) {
+    if (escaped) {
+      escaped = false;
+      if (c != '"' && c != '\\' && c != '/') fail("Unsupported escape in a string.");
+      else token(c);
+    } else if (c == '\\') {
+      escaped = true;
+    } else if (c == '"') {
+      if (state == InKey) {
+        endKey();
+        state = AfterKey;
+      } else if (state == InValue) {
+        endValue();
+        state = AfterValue;
+      } else {
+        endTemperature();
+        state = AfterTemperature;
+      }
+    } else if (c < ' ') {
+      fail("Control character in a string.");
+    } else {
+      token(c);
+    }
+  }
+
+  void endKey() {
+    static const char *const names[] = {"time", "tempList", "startTime", "magicWord"};
+    key = 0;
+    for (int k = 0; k < 4; k++) {
+      if (!strcmp(tok, names[k])) key = 1 << k;
+    }
+    if (!key) fail("Unknown key.");
+    else if (keys & key) fail("Repeated key.");
+    keys |= key;
+  }
+
+  void endValue() {
+    uint32_t m;
+    if (key == MagicWord) {
+      memcpy(magicWord, tok, tokLen + 1);
+    } else if (key == StartTime) {
+      if (iniTime(tok, tokLen, 23, m) != tokLen) fail("Start time must be in H:MM or HH:MM form.");
+      else startMinutes = m;
+    } else if (iniTime(tok, tokLen, INIrampHoursMax, m) != tokLen) {
+      fail("A time must be in H:MM or HH:MM form.");
+    } else {
+      minutes = m;
+    }
+  }
+
+  void endTemperature() {
+    int h;
+    if (count == NT) fail("There are more temperatures than tanks.");
+    else if (iniHundredths(tok, tokLen, h) != tokLen || tokLen == 0) fail("Expected a temperature.");
+    else temps[count++] = h;
+  }
+
+  // A row is checked and added once its object closes, whatever order its keys came in.
+  void endObject() {
+    if (!(keys & (Time | TempList))) return;
+    if (!(keys & Time)) fail("A row has no time.");
+    else if (count != NT) fail("A row does not have one temperature for each tank.");
+    else if (plan.size() > 0 && minutes < plan.minutes(plan.size() - 1)) fail("Ramp times must not go backwards.");
+    else if (plan.size() >= maxSteps) fail("There are more rows than MAX_RAMP_STEPS.");
+    else plan.add(minutes, temps);
+  }
+
+  static bool numberChar(uint8_t c) { return isdigit(c) || c == '-' || c == '+' || c == '.'; }
+
+  void startToken() {
+    tokLen = 0;
+    tok[0] = 0;
+  }
+  void token(uint8_t c) {
+    if (tokLen == PJtokenMax) {
+      fail("A key or value is too long.");
+      return;
+    }
+    tok[tokLen++] = c;
+    tok[tokLen] = 0;
+  }
+
+  void expect(uint8_t c, char want, State next) {
+    if (c != want) fail("Not the ramp plan JSON expected.");
+    else state = next;
+  }
+
+  void fail(const char *message) {
+    error = message;
+    errorAt = at;
+  }
+
+  size_t maxSteps = 0;
+  size_t at = 0;                 // Offset of the byte being parsed.
+  State state = BeforeBody;
+  char tok[PJtokenMax + 1];
+  size_t tokLen = 0;
+  bool escaped = false;
+  uint8_t key = 0;               // The key whose value is being parsed.
+  uint8_t keys = 0;              // Keys seen in this object.
+  uint32_t minutes = 0;          // The row's time,
+  int temps[NT];                 // and its temperatures,
+  int count = 0;                 // count of them so far.
+};
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * The ramp plan, compiled into a table of linear segments.
+ *
+ * Settings.ini gives the plan as steps, each a time and a temperature per
+ * tank.  getCurrentTargets() used to find the two steps around the current
+ * time on every pass and interpolate between them in double, for every tank.
+ * compile() now turns each step into a segment holding its start time in
+ * seconds, its temperatures in hundredths and, for each tank, the slope to
+ * the next step in hundredths per second, scaled by 2^RAMPslopeShift.  A
+ * target is then one multiply and shift per tank.  The cursor only moves
+ * forward through the day, so finding the segment is O(1) amortized.
+ *
+ * The table is as long as the plan, so a step every five minutes, or every
+ * minute, needs no rebuild with a larger MAX_RAMP_STEPS.  Before the first
+ * step its temperatures hold, as they do after the last one.  Plans too long
+ * to keep in memory are read from their own file a window at a time; see
+ * RampStream.h.
+ */
+#ifndef RAMPPLAN_H
+#define RAMPPLAN_H
+
+const int RAMPslopeShift = 16;
+
+struct RampSegment
+{
+  uint32_t start;      // Seconds after midnight, or after START.
+  int16_t from[NT];    // Hundredths of a degree at start.
+  int32_t slope[NT];   // Hundredths per second, << RAMPslopeShift.  0 with INTERP STEP and for the last step.
+};
+
+class RampPlan {
+public:
+  void clear() {
+    segments.clear();
+    cursor = 0;
+  }
+
+  void reserve(size_t steps) { segments.reserve(steps); }
+
+  // Add a step at minutes, with a temperature for each tank.  Steps come in time order.
+  void add(unsigned int minutes, const int hundredths[NT]) {
+    RampSegment s;
+    s.start = minutes * 60;
+    for (int i = 0; i < NT; i++) {
+      s.from[i] = max((int)INT16_MIN, min(hundredths[i], (int)INT16_MAX));
+      s.slope[i] = 0;
+    }
+    segments.push_back(s);
+  }
+
+  // Work out the slopes, once every step has been added.
+  void compile(bool interpolate) {
+    for (size_t k = 0; k < segments.size(); k++) {
+      RampSegment &s = segments[k];
+      int32_t span = k + 1 < segments.size() ? (int32_t)(segments[k + 1].start - s.start) : 0;
+      for (int i = 0; i < NT; i++) {
+        if (!interpolate || span <= 0) {
+          s.slope[i] = 0;
+          continue;
+        }
+        int64_t rise = (int64_t)(segments[k + 1].from[i] - s.from[i]) << RAMPslopeShift;
+        s.slope[i] = (int32_t)((rise + (rise < 0 ? -span : span) / 2) / span);
+      }
+    }
+    cursor = 0;
+  }
+
+  size_t size() const { return segments.size(); }
+  unsigned int minutes(size_t step) const { return segments[step].start / 60; }
+  uint32_t start(size_t step) const { return segments[step].start; }
+  int hundredths(int tank, size_t step) const { return segments[step].from[tank]; }
+
+  // Exchange with another plan, such as one just read and compiled.
+  void swap(RampPlan &other) {
+    segments.swap(other.segments);
+    cursor = 0;
+    other.cursor = 0;
+  }
+
+  // The step the last targetsAt() was in.
+  size_t position() const { return cursor; }
+
+  /**
+   * The targets second seconds after midnight (or START), in hundredths.
+   * False if the plan is empty.
+   */
+  bool targetsAt(uint32_t second, int16_t targets[NT]) {
+    if (segments.empty()) return false;
+    // Going back means a new day.
+    if (cursor >= segments.size() || segments[cursor].start > second) cursor = 0;
+    while (cursor + 1 < segments.size() && segments[cursor + 1].start <= second) cursor++;
+    const RampSegment &s = segments[cursor];
+    int64_t elapsed = second > s.start ? second - s.start : 0;
+    for (int i = 0; i < NT; i++) {
+      targets[i] = s.from[i] + (int16_t)((s.slope[i] * elapsed + (1 << (RAMPslopeShift - 1))) >> RAMPslopeShift);
+    }
+    return true;
+  }
+
+private:
+  std::vector<RampSegment> segments;  // One per step.
+  size_t cursor = 0;                  // The segment of the last targetsAt().
+};
+
+/**
+ * Parse a ramp line, "H:MM t1 t2 ...", into minutes and NT temperatures in
+ * hundredths.  H may be more than 23.  Returns 1 for a step, 0 for a blank
+ * line or comment, and -1 for anything else, including a step with fewer
+ * than NT temperatures.  Extra temperatures are ignored.
+ */
+inline int rampLine(const char *line, uint32_t &minutes, int hundredths[NT]) {
+  while (*line == ' ' || *line == '\t') line++;
+  if (*line == 0 || *line == '\r' || *line == '\n' || *line == '/') return 0;
+  char *end;
+  unsigned long h = strtoul(line, &end, 10);
+  if (end == line || *end != ':') return -1;
+  const char *p = end + 1;
+  unsigned long m = strtoul(p, &end, 10);
+  if (end == p || m > 59) return -1;
+  minutes = h * 60 + m;
+  p = end;
+  for (int i = 0; i < NT; i++) {
+    double v = strtod(p, &end);
+    if (end == p) return -1;
+    hundredths[i] = round(v * 100);
+    p = end;
+  }
+  return 1;
+}
+
+#endif
@@ -0,0 +1,344 @@
+/**
+ * A ramp plan too long to hold in memory, read from its own file a window
+ * at a time.
+ *
+ * PLANFILE in Settings.ini names a file of steps written like the ramp lines
+ * of Settings.ini, "H:MM t1 t2 ...", where H may pass 23 for a plan of
+ * several days.  Blank lines and lines starting with / are skipped.  A week
+ * at a step a minute is about 10,000 lines, far more than fits as a
+ * RampPlan, so only two windows of RAMPwindowSteps steps are kept, each
+ * compiled as a RampPlan of its own:
+ *   front  the steps around now, which controlTask reads
+ *   back   the steps after those, which rampTask reads before they are due
+ * Once controlTask is half way through the front it asks rampTask for the
+ * next window.  That window starts with the front's last step, so the
+ * slopes join up, and when the time reaches that step the two windows trade
+ * places.  If the time jumps instead, at boot or when the clock is set,
+ * rampTask finds the step with a binary search of the file.  Until the
+ * window arrives the front's nearest step holds.
+ *
+ * RAM use is the same for any length of plan.  load() reads the whole file
+ * once to check it, so a bad line stops the boot rather than the run days
+ * later.
+ *
+ * targetsAt(), end() and window() are called holding rampMutex, as for
+ * rampPlan.
+ */
+#ifndef RAMPSTREAM_H
+#define RAMPSTREAM_H
+
+const size_t RAMPwindowSteps = 64;    // An hour ahead at a step a minute.
+const uint32_t RAMPsearchBytes = 512; // Binary search down to this, then read through.
+const uint32_t RAMPsearch = UINT32_MAX;
+
+struct RampRequest
+{
+  uint32_t second;      // The plan time the window is for.
+  uint32_t from;        // File position of its first step, or RAMPsearch.
+  uint32_t generation;  // Of the plan it was made for.
+  bool replace;         // Straight to the front, for load().
+};
+
+/**
+ * The steps of a plan file in order, read a sector at a time.  Positions
+ * are file positions of the start of a line.
+ */
+class RampFileReader {
+public:
+  unsigned long line = 0;  // Lines read since open(); the line number when reading from the start.
+
+  bool open(SdFat32 &sd, const char *path) {
+    file = sd.open(path, O_RDONLY);
+    line = 0;
+    return seek(0);
+  }
+
+  void close() {
+    if (file.isOpen()) file.close();
+  }
+
+  uint32_t size() { return file.isOpen() ? file.fileSize() : 0; }
+
+  bool seek(uint32_t to) {
+    inPos = inLen = 0;
+    inAt = to;
+    return file.isOpen() && file.seekSet(to);
+  }
+
+  // Go to the first line starting after to - 1, which may be at to.
+  bool seekLine(uint32_t to) {
+    if (to == 0) return seek(0);
+    if (!seek(to - 1)) return false;
+    bool whole;
+    return readLine(whole);
+  }
+
+  // The next step and its position.  Returns 1 for a step, 0 at the end of the file, -1 for a bad line.
+  int next(uint32_t &at, uint32_t &minutes, int hundredths[NT]) {
+    bool whole;
+    for (;;) {
+      at = inAt + inPos;
+      if (!readLine(whole)) return 0;
+      line++;
+      if (!whole) return -1;
+      int got = rampLine(buf, minutes, hundredths);
+      if (got != 0) return got;
+    }
+  }
+
+private:
+  // Read up to and including the next '\n'.  whole is false if it did not fit in buf.
+  bool readLine(bool &whole) {
+    size_t len = 0;
+    bool any = false;
+    whole = true;
+    for (;;) {
+      if (inPos == inLen) {
+        inAt += inLen;
+        int got = file.read(in, sizeof(in));
+        if (got <= 0) break;
+        inPos = 0;
+        inLen = got;
+      }
+      any = true;
+      const uint8_t *nl = (const uint8_t *)memchr(in + inPos, '\n', inLen - inPos);
+      size_t take = (nl ? nl + 1 : in + inLen) - (in + inPos);
+      size_t keep = min(take, sizeof(buf) - 1 - len);
+      if (keep < take) whole = false;
+      memcpy(buf + len, in + inPos, keep);
+      len += keep;
+      inPos += take;
+      if (nl) break;
+    }
+    buf[len] = 0;
+    return any;
+  }
+
+  File32 file;
+  uint8_t in[512];
+  size_t inPos = 0, inLen = 0;
+  uint32_t inAt = 0;  // File position of in[0].
+  char buf[128];
+};
+
+class RampStream {
+public:
+  unsigned long steps = 0;        // In the file, counted by load().
+  uint32_t lastMinute = 0;        // Of the last step.
+  unsigned long errorLine = 0;    // Where load() stopped, when it fails.
+  unsigned long refills = 0;      // Windows read.
+  unsigned long refillMaxUs = 0;
+  unsigned long misses = 0;       // Control passes before the window they needed was read.
+
+  explicit RampStream(SdFat32 &sd) : sd(sd) {}
+
+  // Make the request queue.  mutex is rampMutex.
+  void begin(SemaphoreHandle_t mutex) {
+    rampMutex = mutex;
+    if (!requests) requests = xQueueCreate(1, sizeof(RampRequest));
+    if (!ioMutex) ioMutex = xSemaphoreCreateMutex();
+    for (int k = 0; k < 2; k++) windows[k].plan.reserve(RAMPwindowSteps);
+  }
+
+  /**
+   * Check every line of the plan at path and read the window for second, in
+   * plan time, into the front.  False, with errorLine set, if a line is not
+   * a step or the steps are not in time order; the plan in use is then
+   * unchanged.
+   */
+  bool load(const char *newPath, bool interpolate, uint32_t second) {
+    xSemaphoreTake(ioMutex, portMAX_DELAY);
+    bool ok = reader.open(sd, newPath);
+    unsigned long n = 0;
+    uint32_t at, minutes, prev = 0, firstAt = 0;
+    int h[NT];
+    int got;
+    while (ok && (got = reader.next(at, minutes, h)) != 0) {
+      if (got < 0 || (n > 0 && minutes <= prev)) {
+        ok = false;
+      } else {
+        if (n == 0) firstAt = at;
+        prev = minutes;
+        n++;
+      }
+    }
+    errorLine = ok ? 0 : reader.line;
+    reader.close();
+    if (ok && n == 0) ok = false;
+    if (ok) {
+      xSemaphoreTake(rampMutex, portMAX_DELAY);
+      generation++;
+      pending = true;
+      backReady = false;
+      steps = n;
+      lastMinute = prev;
+      xSemaphoreGive(rampMutex);
+      snprintf(path, sizeof(path), "%s", newPath);
+      linear = interpolate;
+      first = firstAt;
+      RampRequest r = {second, RAMPsearch, generation, true};
+      ok = readWindow(r);
+    }
+    xSemaphoreGive(ioMutex);
+    return ok;
+  }
+
+  // Stop, when a plan in Settings.ini or from the web replaces this one.
+  void end() {
+    active = false;
+    pending = backReady = false;
+    generation++;
+  }
+
+  bool isActive() const { return active; }
+  const char *getPath() const { return path; }
+
+  // The steps in front, for showing.
+  const RampPlan &window() const { return windows[front].plan; }
+
+  /**
+   * The targets second seconds into the plan, in hundredths, as for
+   * RampPlan::targetsAt().  Never reads the card.  False if no plan is loaded.
+   */
+  bool targetsAt(uint32_t second, int16_t targets[NT]) {
+    if (!active) return false;
+    if (backReady && windows[front ^ 1].covers(second)) {
+      front ^= 1;
+      backReady = false;
+    }
+    RampWindow &f = windows[front];
+    if (!f.covers(second)) {
+      misses++;
+      request(second, RAMPsearch);
+    } else if (!f.atEnd && !backReady && f.plan.position() >= f.plan.size() / 2) {
+      request(f.plan.start(f.plan.size() - 1), f.last);
+    }
+    return f.plan.targetsAt(second, targets);
+  }
+
+  // Wait for a request from targetsAt() and read its window.  rampTask calls this over and over.
+  void serve() {
+    RampRequest r;
+    if (xQueueReceive(requests, &r, portMAX_DELAY) != pdPASS) return;
+    xSemaphoreTake(ioMutex, portMAX_DELAY);
+    readWindow(r);
+    xSemaphoreGive(ioMutex);
+  }
+
+private:
+  struct RampWindow
+  {
+    RampPlan plan;
+    uint32_t last = 0;     // File position of its last step, where the next window starts.
+    bool atStart = false;  // It starts with the first step of the file.
+    bool atEnd = false;    // It ends with the last.
+
+    bool covers(uint32_t second) const {
+      size_t n = plan.size();
+      if (n == 0 || (second < plan.start(0) && !atStart)) return false;
+      return atEnd || second < plan.start(n - 1);
+    }
+  };
+
+  // Ask rampTask for a window, unless one is already coming.  Caller holds rampMutex.
+  void request(uint32_t second, uint32_t from) {
+    if (pending) return;
+    RampRequest r = {second, from, generation, false};
+    pending = true;
+    backReady = false;
+    xQueueOverwrite(requests, &r);
+  }
+
+  /**
+   * Read the window for r into the back, and hand it over.  Caller holds
+   * ioMutex.  targetsAt() leaves the back alone while a request is pending,
+   * so only the hand over needs rampMutex.
+   */
+  bool readWindow(const RampRequest &r) {
+    xSemaphoreTake(rampMutex, portMAX_DELAY);
+    bool current = r.generation == generation && pending;
+    xSemaphoreGive(rampMutex);
+    if (!current) return false;
+
+    unsigned long start = micros();
+    RampWindow &w = windows[front ^ 1];
+    w.plan.clear();
+    w.atEnd = false;
+    bool ok = reader.open(sd, path);
+    uint32_t from = r.from;
+    if (ok && from == RAMPsearch) from = search(r.second);
+    ok = ok && reader.seek(from);
+    w.atStart = from <= first;
+    uint32_t at, minutes;
+    int h[NT];
+    while (ok && !w.atEnd) {
+      int got = reader.next(at, minutes, h);
+      if (got == 0) {
+        w.atEnd = true;
+      } else if (got < 0) {
+        ok = false;  // Changed since load().
+      } else if (w.plan.size() == RAMPwindowSteps) {
+        break;
+      } else {
+        w.plan.add(minutes, h);
+        w.last = at;
+      }
+    }
+    reader.close();
+    w.plan.compile(linear);
+    ok = ok && w.plan.size() > 0;
+    unsigned long us = micros() - start;
+    if (us > refillMaxUs) refillMaxUs = us;
+    refills++;
+
+    xSemaphoreTake(rampMutex, portMAX_DELAY);
+    if (r.generation == generation) {
+      pending = false;
+      if (ok && r.replace) {
+        front ^= 1;
+        active = true;
+      } else if (ok) {
+        backReady = true;
+      }
+    }
+    xSemaphoreGive(rampMutex);
+    return ok;
+  }
+
+  // Position of the last step at or before second, or of the first step.  reader is open.
+  uint32_t search(uint32_t second) {
+    uint32_t lo = first, hi = reader.size();
+    uint32_t at, minutes;
+    int h[NT];
+    // Steps from lo on start at or before second; steps from hi on start after it.
+    while (hi - lo > RAMPsearchBytes) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (!reader.seekLine(mid) || reader.next(at, minutes, h) <= 0 || minutes * 60 > second) {
+        hi = mid;
+      } else {
+        lo = at;
+      }
+    }
+    uint32_t found = lo;
+    reader.seek(lo);
+    while (reader.next(at, minutes, h) > 0 && minutes * 60 <= second) found = at;
+    return found;
+  }
+
+  SdFat32 &sd;
+  SemaphoreHandle_t rampMutex = NULL;
+  SemaphoreHandle_t ioMutex = NULL;   // One reader of the file at a time: load() or rampTask.
+  QueueHandle_t requests = NULL;
+  RampFileReader reader;
+  RampWindow windows[2];
+  int front = 0;
+  bool active = false;
+  bool pending = false;     // A window has been asked for and not yet read.
+  bool backReady = false;   // The back holds a window which the front has not reached.
+  uint32_t generation = 0;  // Plans loaded, so a window read for an old one is dropped.
+  char path[32] = "";
+  bool linear = true;       // INTERP LINEAR.
+  uint32_t first = 0;       // File position of the first step.
+};
+
+#endif
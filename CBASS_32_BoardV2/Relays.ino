@@ -1,8 +1,10 @@
 // Prototypes which might have been auto-generated but are not.
 void updateShiftRegister();
-void MYshiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, uint32_t val);
+void MYshiftOut(uint8_t dataPin, uint8_t clockPin, uint8_t bitOrder, int32_t val);
+void pushRelays();
 
 int32_t shiftRegBits = 0;  // Size for up to 32 relays, though at first we use no more than 16.
+int32_t relayBitsSent = 0;  // shiftRegBits as last sent to the shift registers.
 
 void RelaysInit() {
   //-------( Initialize Pins so all relays are inactive at reset)----
@@ -177,40 +179,40 @@ void relayShow() {
  * others by a shift register.  Now two shift registers are used,
  * so the logic here is simpler.
  * The "tank" input is zero-based.
+ * Each call changes one bit of shiftRegBits and, unless push is false,
+ * sends it to the relays.  updateRelays() sets every relay with push
+ * false and then calls pushRelays() once.
  */
-void setHeatRelay(int tank, boolean state) {
- if (state) {
-    bitSet(shiftRegBits, HeaterRelay[tank]);
-    updateShiftRegister();
-  } else {
-    bitClear(shiftRegBits, HeaterRelay[tank]);
-    updateShiftRegister();
-  }
-  strcpy(RelayStateStr[i], state ? "HTR" : "OFF");
+void setHeatRelay(int tank, boolean state, boolean push) {
+  if (state) bitSet(shiftRegBits, HeaterRelay[tank]);
+  else bitClear(shiftRegBits, HeaterRelay[tank]);
+  strcpy(RelayStateStr[tank], state ? "HTR" : "OFF");
+  if (push) pushRelays();
 }
-void setChillRelay(int tank, boolean state) {
-if (state) {
-    bitSet(shiftRegBits, ChillRelay[tank]);
-    updateShiftRegister();
-  } else {
-    bitClear(shiftRegBits, ChillRelay[tank]);
-    updateShiftRegister();
-  }
-  strcpy(RelayStateStr[i], state ? "CHL" : "OFF");
+void setChillRelay(int tank, boolean state, boolean push) {
+  if (state) bitSet(shiftRegBits, ChillRelay[tank]);
+  else bitClear(shiftRegBits, ChillRelay[tank]);
+  strcpy(RelayStateStr[tank], state ? "CHL" : "OFF");
+  if (push) pushRelays();
 }
 
 /**
  * Set the light relay on or off.
  */
-void setLightRelay(int tank, boolean state) {
-  if (state) {
-    bitSet(shiftRegBits, LightRelay[tank]);
-    updateShiftRegister();
-  } else {
-    bitClear(shiftRegBits, LightRelay[tank]);
-    updateShiftRegister();
-  }
-  strcpy(LightStateStr[i], state ? "LGT" : "DRK");
+void setLightRelay(int tank, boolean state, boolean push) {
+  if (state) bitSet(shiftRegBits, LightRelay[tank]);
+  else bitClear(shiftRegBits, LightRelay[tank]);
+  strcpy(LightStateStr[tank], state ? "LGT" : "DRK");
+  if (push) pushRelays();
+}
+
+/**
+ * Send shiftRegBits to the relays if it differs from what they have.
+ * Most control passes change nothing, and then nothing is sent.
+ */
+void pushRelays() {
+  if (shiftRegBits == relayBitsSent) return;
+  updateShiftRegister();
 }
 
 /**
@@ -219,38 +221,39 @@ void setLightRelay(int tank, boolean state) {
  */
 void updateRelays() {
   bool lights = getLightState();
-  for (i = 0; i < NT; i++) {
+  for (int i = 0; i < NT; i++) {
     // Note that controlOutput is on a scale of +/- 10000, where 10000 indicates maximum heating.
     // tempInput is in degrees C.  It is a possibly adjusted version of the sensor temperature output.
     // Below, always have "OFF" lines before "ON" since the set*Relay calls set the state string.
     if (controlOutput[i] < 0) {  // Chilling
-      setHeatRelay(i, RELAY_OFF);
+      setHeatRelay(i, RELAY_OFF, false);
       if (tempInput[i] > setPoint[i] - chillOffset) {
-        setChillRelay(i, RELAY_ON);
+        setChillRelay(i, RELAY_ON, false);
       } else {
-        setChillRelay(i, RELAY_OFF);
+        setChillRelay(i, RELAY_OFF, false);
       }
     } else {  //Heating
-      setChillRelay(i, RELAY_OFF);
+      setChillRelay(i, RELAY_OFF, false);
       if (controlOutput[i] > 0.0) {
         if (tempInput[i] > setPoint[i] - chillOffset) {
-          setHeatRelay(i, RELAY_OFF);
+          setHeatRelay(i, RELAY_OFF, false);
         } else {
-          setHeatRelay(i, RELAY_ON);
+          setHeatRelay(i, RELAY_ON, false);
         }
       } else {  // controlOutput == 0
         if (tempInput[i] > setPoint[i] - chillOffset) {
-          setHeatRelay(i, RELAY_OFF);
+          setHeatRelay(i, RELAY_OFF, false);
         } else {
-          setHeatRelay(i, RELAY_ON);
+          setHeatRelay(i, RELAY_ON, false);
         }
       }
     }
     if (switchLights) {
-      if (lights) setLightRelay(i, RELAY_ON);
-      else setLightRelay(i, RELAY_OFF);
+      if (lights) setLightRelay(i, RELAY_ON, false);
+      else setLightRelay(i, RELAY_OFF, false);
     }
   }
+  pushRelays();  // One update of the shift registers, and only if a relay changed.
 }
 
 /**
@@ -269,6 +272,7 @@ void updateShiftRegister() {
   // has enough delays to make it work.
   MYshiftOut(DATA_PIN, CLOCK_PIN, MSBFIRST, shiftRegBits);
   digitalWrite(LATCH_PIN, HIGH);
+  relayBitsSent = shiftRegBits;
 }
 
 /*
@@ -0,0 +1,88 @@
+/**
+ * A fixed-capacity history store.  Once full, each new item replaces the
+ * oldest one in place, so adding a point costs the same no matter how much
+ * history is kept.  std::vector with erase(begin()) moved every stored point
+ * on each call, which took several ms per graph point at 12 hours of history.
+ *
+ * Index 0 is always the oldest item and size()-1 the newest, so code written
+ * for the vector (graphPoints[i], size(), range-for) works unchanged.
+ *
+ * Storage is a std::vector which is reserved once and never reallocated.
+ * Items are only ever constructed by emplace_back() and assigned over, so T
+ * needs no default constructor.
+ */
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <vector>
+#include <utility>
+
+template <typename T>
+class RingBuffer {
+public:
+  RingBuffer() {}
+
+  // Set the capacity and allocate all memory for it now.  Any stored items are discarded.
+  void reserve(size_t capacity) {
+    items.clear();
+    items.reserve(capacity);
+    cap = capacity;
+    head = 0;
+  }
+
+  // Add an item at the newest end, replacing the oldest item if full.
+  template <typename... Args>
+  void emplace_back(Args&&... args) {
+    if (cap == 0) return;
+    if (items.size() < cap) {
+      items.emplace_back(std::forward<Args>(args)...);
+    } else {
+      items[head] = T(std::forward<Args>(args)...);
+      head = (head + 1 == cap) ? 0 : head + 1;
+    }
+  }
+
+  void clear() {
+    items.clear();
+    head = 0;
+  }
+
+  size_t size() const { return items.size(); }
+  size_t capacity() const { return cap; }
+  bool empty() const { return items.empty(); }
+  bool full() const { return items.size() == cap; }
+
+  // i = 0 is the oldest item.
+  T& operator[](size_t i) { return items[physical(i)]; }
+  const T& operator[](size_t i) const { return items[physical(i)]; }
+  T& front() { return (*this)[0]; }
+  T& back() { return (*this)[items.size() - 1]; }
+
+  // Iterators visit items from oldest to newest.
+  class const_iterator {
+  public:
+    const_iterator(const RingBuffer *rb, size_t i) : rb(rb), i(i) {}
+    const T& operator*() const { return (*rb)[i]; }
+    const T* operator->() const { return &(*rb)[i]; }
+    const_iterator& operator++() { i++; return *this; }
+    bool operator!=(const const_iterator &other) const { return i != other.i; }
+    bool operator==(const const_iterator &other) const { return i == other.i; }
+  private:
+    const RingBuffer *rb;
+    size_t i;
+  };
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, items.size()); }
+
+private:
+  size_t physical(size_t i) const {
+    size_t p = head + i;
+    return (p >= cap) ? p - cap : p;
+  }
+
+  std::vector<T> items;
+  size_t cap = 0;
+  size_t head = 0;  // Position of the oldest item once the buffer is full.
+};
+
+#endif
@@ -1,18 +1,12 @@
 // Function prototypes
-void fillBuffer(byte c);
-void fillBuffer(byte c, boolean pin, boolean spaceOK);
-unsigned long timeInMinutes(byte c);
-int tempInHundredths(byte c);
 void printRampPlan();
 void printAsHM(unsigned int t);
-bool myFileCopy(const char* ooo, const char* nnn);
 bool resetSettings();
-bool createBackupFileName(char* name);
+bool reserveBackupName(char* name);
+bool commitSettingsINI(const char* backup);
+void recoverSettingsINI();
 String gettime();
 
-// Global settings file, since position isn't preserved unless the file is returned from functions (in SdFat).
-File32 settingsFile;
-
 // Length of one log line GRAPHPTS.LOG
 const byte bytesPerTempLine = 52;  // 5 digits for day, 4 for minute, 8 4-char floats, 9 commas, 2 for CRLF (0x0d 0x0a)
 const byte graphBufLen = bytesPerTempLine + 5;
@@ -70,15 +64,20 @@ void checkSD(const char* txt) {
 }
 
 /**
- * Read the ramp plan one line at a time.  This should be easier than the old
- * method.  It will take more memory, but we can afford that now.
- * Be sure to account for cases where NT has changed since Settings.ini was
- * written.
+ * Read Settings.ini in sdBufLen blocks, parsed in one pass by SettingsParser.
+ * An error is reported with its line and column.  Be sure to account for
+ * cases where NT has changed since Settings.ini was written.
  * Lines can be comments, ramp points, or key-value pairs as follows:
 
-  // A comment - must start at the beginning of a line
+  // A comment.  Comments may also follow a value on the same line.
 START 14:30
 INTERP LINEAR|STEP
+LIGHTON 6:00
+LIGHTOFF 18:00
+LOGFORMAT TEXT|BINARY
+LOGROLLKB 4096
+LOGROLLTIME 0:00
+PLANFILE /Week.txt
 // START, if provided, causes ramp times to be interpreted as relative to that time.  For example
 START 15:00
 0:00 30 30 30 30
@@ -92,19 +91,18 @@ START 15:00
   * 
   * These are the only two interpolation options, but something like a cubic spline could be added
   * for smooth simulation of diurnal variations.
+  *
+  * START may also have a date, as in START 2024-06-01 15:00.  The plan then runs once from that
+  * moment instead of every day, so its times can go past 23:59 (75:30 is 3:30 AM on the fourth
+  * day).  A plan too long to keep in memory, such as a week of logger data at one step a minute,
+  * goes in its own file of ramp lines, named by PLANFILE, and is read a window at a time (see
+  * RampStream.h).  Settings.ini then has no ramp lines of its own.
   */
 void readRampPlan() {
-  int maxLine = 128;
-  char lineBuffer[maxLine+1];
-  char *lb = lineBuffer;
-  int nRead, nParse, pos, hh, mm;
-  double tempRead;
-  int tank = 0;
-  int extra = 0;
-  bool ntFail = false;
-  bool foundON = false, foundOFF = false; 
-  int upTo8[8];  // Read this many temperatures if in the file, then check against NT.
-  if (SDF.exists("/Settings.ini")) {
+  RampPlan plan;  // Read into this, then swapped into rampPlan.
+  SettingsParser ini(plan, MAX_RAMP_STEPS);
+  recoverSettingsINI();
+  if (SDF.exists(INIpath)) {
     Serial.println("The ramp plan exists.");
   } else {
     if (!SDF.exists("/")) {
@@ -113,281 +111,92 @@ void readRampPlan() {
     }
     fatalError(F("---ERROR--- No ramp plan file (/Settings.ini)!"));
   }
-  rampSteps = 0;  // Otherwise we may append to a previous plan!
-  settingsFile = SDF.open("/Settings.ini", O_RDONLY);
-  while (settingsFile.available()) {
-    nRead = settingsFile.readBytesUntil('\n', lineBuffer, maxLine);  // One line is now in the buffer.
-    lineBuffer[max(0, nRead)] = 0;  // null terminate the line!
-    // There MAY be a problem since lines edited in different ways could end with \n, \r, or both.
-    // To be safe, see if one of those remains in the buffer or the file and get rid of it.
-    // Note that some of these four cases may never occur, but until proven otherwise, they should be kept.
-    if (lineBuffer[nRead-1] == '\n' || lineBuffer[nRead-1] == '\r') {
-        lineBuffer[max(0, nRead-1)] = 0;  // null terminate on top of the extra character!
-    } else {
-        lineBuffer[max(0, nRead)] = 0;  // null terminate the line normally
-    }
-    // Now discard any leftover end of line in the file.  This also removes any empty next line, but that's fine.
-    while (settingsFile.peek() == '\n') settingsFile.read();
-    while (settingsFile.peek() == '\r') settingsFile.read();
-
-    // Serial.printf("Read >%s<\n", lineBuffer);
-    if (nRead == 0 || lineBuffer[0] == '/') {
-      ;  // an empty line or comment, move on.
-    } else if (!strncmp(lineBuffer, "START", 5)) {
-      // The line should contain a start time after START
-      nParse = sscanf(lineBuffer + 5, "%d:%d", &hh, &mm);
-      if (nParse != 2) {
-        settingsFile.close();
-        fatalError(F("Invalid START time in Settings.ini"));
-      } else if (hh < 0 || hh > 23) {
-        settingsFile.close();
-        fatalError(F("START time hour must be from 0 to 23."));
-      } else if (mm < 0 || hh > 59) {
-        settingsFile.close();
-        fatalError(F("START time minutes must be from 0 to 59."));
-      }
-      relativeStartTime = hh * 60 + mm;
-      relativeStart = true;
-    } else if (!strncmp(lineBuffer, "INTERP", 6)) {
-      pos = 6;
-      while (isSpace(lineBuffer[pos])) pos++;
-      if (!strncmp(lineBuffer + pos, "LINEAR", 6)) {
-        interpolateT = true;
-      } else if (!strncmp(lineBuffer + pos, "STEP", 4)) {
-        interpolateT = true;
-      } else {
-        settingsFile.close();
-        fatalError(F("Unsupported interpolation option.  Must be LINEAR or STEP"));
-      }
-    } else if (!strncmp(lineBuffer, "LIGHTON", 7)) {
-      pos = 7;
-      while (isSpace(lineBuffer[pos])) pos++;
-      // There must be a time here, in 24-hour HH:MM or H:MM format.
-      Serial.print("Reading ON time.");
-      nParse = sscanf(lineBuffer + pos, "%d:%d", &hh, &mm);
-      Serial.printf("Parsed %d item(s).  pos = %d, lineBuffer >%s<\n", nParse, pos, lineBuffer);
-      if (nParse != 2) {
-        settingsFile.close();
-        fatalError(F("LIGHTON keyword must be followed by a time in 24-hour HH:MM or H:MM format."));
-      } else if (hh < 0 || hh > 23 || mm < 0 || mm > 59) {
-          settingsFile.close();
-          fatalError(F("In LIGHTON hour must be from 0 to 23 and minutes from 0 to 59."));
-      } else {
-        lightOnMinutes = hh*60 + mm;
-        Serial.printf("Found LIGHTON value %d.\n", lightOnMinutes);
-        foundON = true;
-      }
-
-    } else if (!strncmp(lineBuffer, "LIGHTOFF", 8)) {
-      pos = 8;
-      while (isSpace(lineBuffer[pos])) pos++;
-      // There must be a time here, in 24-hour HH:MM or H:MM format.
-      Serial.print("Reading OFF time.");
-      nParse = sscanf(lineBuffer + pos, "%d:%d", &hh, &mm);
-      if (nParse != 2) {
-        settingsFile.close();
-        fatalError(F("LIGHTOFF keyword must be followed by a time in 24-hour HH:MM or H:MM format."));
-      } else if (hh < 0 || hh > 23 || mm < 0 || mm > 59) {
-          settingsFile.close();
-          fatalError(F("In LIGHTOFF hour must be from 0 to 23 and minutes from 0 to 59."));
-      } else {
-        lightOffMinutes = hh*60 + mm;
-        Serial.printf("Found LIGHTOFF value %d.\n", lightOffMinutes);
-        foundOFF = true;
-      }
-
-    } else if (isDigit(lineBuffer[0])) {
-      // 07:00       26.00  26.00  26.00  26.00	24.0
-      // Time and temperature lines (and only such lines) should start with a digit.
-      // A time is required, ideally followed by NT temperatures, but handle the case
-      // where the number doesn't match!
-      nParse = sscanf(lineBuffer, "%d:%d", &hh, &mm);
-      //Serial.printf("On temp line got %d values, %d and %d\n", nParse, hh, mm);
-
-      rampMinutes[rampSteps] = hh * 60 + mm;
-      // There are ways to use sscanf in a loop, but strtok seems nicer here.
-      char* token;
-      token = strtok(lineBuffer, " \t");  // the time - already handled
-      token = strtok(NULL, " \t");        // first temperature in same line (NULL)
-      tank = 0;
-      extra = 0;
-      while (token != NULL) {
-        if (tank < NT) {
-          sscanf(token, "%lf", &tempRead);
-          // Serial.printf("Scanned temp as %lf for tank %d line %d\n", tempRead, tank, rampSteps);
-          rampHundredths[tank++][rampSteps] = round(tempRead * 100);
-          //Serial.printf("%d hundredths.\n", rampHundredths[tank-1][rampSteps]);
-        } else {
-          extra++;
-        }
-        token = strtok(NULL, " \t");
-      }
-      if (tank < NT) {
-        // Settings don't match the number of tanks, but don't stop until the available
-        // data is read so it can be edited rather than starting from scratch.
-        ntFail = true;
-      }
-      rampSteps++;
-    } else {
-      settingsFile.close();
-      Serial.printf("Bad line: >%s<\n", lineBuffer);
-      fatalError(F("Settings.ini has an illegal line.  Edit (/RampPlan) or reset (/ResetRampPlan)."));
-    }
-  }
-  if (extra > 0) {
-    Serial.printf("WARNING: Ignoring %d extra tanks in Settings.ini with NT = %d\n", extra, NT);
+  unsigned long start = micros();
+  File32 settingsFile = SDF.open(INIpath, O_RDONLY);
+  int n;
+  while ((n = settingsFile.read(sdBuffer, sdBufLen)) > 0 && ini.feed(sdBuffer, n)) {
   }
   settingsFile.close();
-  if (ntFail) {
+  ini.finish();
+  if (ini.error) {
+    Serial.printf("Settings.ini line %lu, column %lu: %s\n", ini.errorLine, ini.errorColumn, ini.error);
+    snprintf(iniBuffer, BUFMAX, "Settings.ini line %lu col %lu: %s", ini.errorLine, ini.errorColumn, ini.error);
+    fatalError((const __FlashStringHelper *)iniBuffer);
+  }
+  Serial.printf("Read %lu lines of Settings.ini in %lu us.\n", ini.lines, micros() - start);
+  if (ini.extraTemps > 0) {
+    Serial.printf("WARNING: Ignoring %d extra tanks in Settings.ini with NT = %d\n", ini.extraTemps, NT);
+  }
+  relativeStart = ini.relativeStart;
+  if (relativeStart) relativeStartTime = ini.startMinutes;
+  relativeStartEpoch = ini.startEpoch;
+  interpolateT = ini.interpolate;
+  if (ini.lightOnMinutes >= 0) lightOnMinutes = ini.lightOnMinutes;
+  if (ini.lightOffMinutes >= 0) lightOffMinutes = ini.lightOffMinutes;
+  switchLights = ini.lightOnMinutes >= 0 && ini.lightOffMinutes >= 0;
+  logFormatBinary = ini.logBinary;
+  logRollKB = ini.logRollKB;
+  logRollMinutes = ini.logRollMinutes;
+  nextLogRoll = 0;
+
+  if (ini.planFile[0] && plan.size()) {
+    fatalError(F("Settings.ini has ramp lines and a PLANFILE.  Use one or the other."));
+  }
+  // With PLANFILE, rampStream checks the whole file and reads the steps near now.
+  if (ini.planFile[0] && !rampStream.load(ini.planFile, interpolateT, rampSecond(t))) {
+    Serial.printf("%s line %lu is not a ramp step after the one before.\n", ini.planFile, rampStream.errorLine);
+    fatalError(F("The PLANFILE named in Settings.ini is missing or has a bad line."));
+  }
+  plan.compile(interpolateT);
+  xSemaphoreTake(rampMutex, portMAX_DELAY);
+  rampPlan.swap(plan);
+  if (!ini.planFile[0]) rampStream.end();
+  xSemaphoreGive(rampMutex);
+  if (ini.fewestTemps < NT) {
     // If the user specified NT tanks and the are less than NT in the plan, an experiment
     // could be ruined.  Consider this a fatal error.  Try to keep the web server
     // running so this can be addressed without pulling the card.
-    Serial.printf("Settings.ini supports %d tanks, but CBASS is configured for %d\n", tank, NT);
+    Serial.printf("Settings.ini supports %d tanks, but CBASS is configured for %d\n", ini.fewestTemps, NT);
     Serial.printf("Use the controls at http://%s/RampPlan or http://%s/ResetRampPlan\n", myIP.toString().c_str(), myIP.toString().c_str());
     fatalError(F("Settings.ini has fewer temperatures than you have tanks.  Edit (/RampPlan), reset (/ResetRampPlan), or adust NT."));
   } else {
     printRampPlan();
   }
-  switchLights = foundON && foundOFF;
-}
-
-// If no second argument, expect a keyword, not a pin.
-void fillBuffer(byte c) {
-  fillBuffer(c, false, false);
-}
-/**
-   We are expecting a keyword, PIN, or BLE name
-   If pin, accept anything except whitespace.
-   Spaces are allowed in BLE names, so in that case read to end of line.
-   If !pin and !spaceOK it's a keyword so only accept letters.
-   Fill the global buffer with any acceptable characters.
-   The buffer starts with c, which has already been read.
-   Leave the file ready to read from the first unwanted character read, so use "peek".
-   isWhitespace: space or tab
-   isSpace: also true for things like linefeeds
-*/
-void fillBuffer(byte c, boolean pin, boolean spaceOK) {
-  byte pos;
-  iniBuffer[0] = c;
-  pos = 1;
-  while (settingsFile.available()) {
-    c = settingsFile.peek();
-    if ((!pin && !spaceOK && isAlpha(c)) || (pin && !isSpace(c)) || (spaceOK && (!isSpace(c) || isWhitespace(c)))) {
-      iniBuffer[pos++] = c;
-      c = settingsFile.read();  // consume the character
-      if (pos >= BUFMAX) fatalError(F("Settings.ini keyword too long for BUFMAX."));
-    } else {
-      iniBuffer[pos] = 0;  // null terminate
-      return;
-    }
-  }
-}
-
-/**
-   We expect a time like 1:23 in hours and minutes, with optional leading zeros and
-   possibly on the hour.
-   Return it in minutes, which may be interpreted either relative to a base time
-   or relative to midnight, depending on context.
-   Leave the file ready to read from the first unwanted character read, so use "peek".
-*/
-unsigned long timeInMinutes(byte c) {
-  byte num;
-  unsigned int mins = 0;
-  // Read hours, which are mandatory.
-  num = c - '0';
-  while (settingsFile.available()) {
-    c = settingsFile.peek();
-    if (isDigit(c)) {
-      num = num * 10 + c - '0';
-      c = settingsFile.read();
-    } else {
-      // Must be at end of hour.
-      mins = num * 60;
-      break;
-    }
-  }
-  // See if there are minutes
-  if (settingsFile.peek() != ':') return mins;
-  settingsFile.read();  // consume the colon.
-  num = 0;
-  while (settingsFile.available()) {
-    c = settingsFile.peek();
-    if (isDigit(c)) {
-      num = num * 10 + c - '0';
-      c = settingsFile.read();
-    } else {
-      // Must be at end of minute.
-      mins = mins + num;
-      return mins;
-    }
-  }
-  return mins;  // We should get here only if there was a colon at the end of the file.
-}
-
-
-/**
-   We expect a temperature like 1.23 in degrees C, either an integer or with decimal places.
-   Leave the file ready to read from the first unwanted character read, so use "peek".
-
-   We return hundredths of a degree, so +-327 degrees is supported by a 2-byte int.
-*/
-int tempInHundredths(byte c) {
-  float divisor;
-  byte num;
-  float tValue = 0;
-  // Read integer degrees, which are mandatory.
-  num = c - '0';
-  while (settingsFile.available()) {
-    c = settingsFile.peek();
-    if (isDigit(c)) {
-      num = num * 10 + c - '0';
-      c = settingsFile.read();
-    } else {
-      // Must be at end of integer part.
-      tValue = (float)num;
-      break;
-    }
-  }
-  // See if there are decimals
-  if (settingsFile.peek() != '.') return round(tValue * 100);
-  settingsFile.read();  // consume the period.
-  num = 0;
-  divisor = 10;
-  while (settingsFile.available()) {
-    c = settingsFile.peek();
-    if (isDigit(c)) {
-      num = +c - '0';
-      tValue = tValue + (double)(c - '0') / divisor;
-      divisor = divisor * 10;
-      c = settingsFile.read();
-    } else {
-      // Must be at end of decimal places.
-      return round(tValue * 100);
-    }
-  }
-  return round(tValue * 100);  // We should get here only if there was a period at the end of the file.
 }
 
 void printRampPlan() {
-  Serial.printf("%d tanks and %d ramp lines.\n", NT, rampSteps);
+  Serial.printf("%d tanks and %d ramp lines.\n", NT, (int)rampPlan.size());
   printBoth("Temperature Ramp Plan");
   printlnBoth();
   if (relativeStart) {
     printBoth("Settings will be applied relative to start time ");
+    if (relativeStartEpoch) {
+      printBoth(DateTime(relativeStartEpoch).timestamp(DateTime::TIMESTAMP_DATE).c_str());
+      printBoth(" ");
+    }
     printAsHM(relativeStartTime);
     printlnBoth();
   }
+  if (rampStream.isActive()) {
+    printBoth(rampStream.getPath());
+    printBoth(" has ");
+    printBoth((unsigned int)rampStream.steps);
+    printBoth(" steps, the last at ");
+    printAsHM(rampStream.lastMinute);
+    printlnBoth();
+    return;
+  }
   printBoth("Time  ");
   for (int j = 0; j < NT; j++) {
     printBoth("  Tank ");
     printBoth(j + 1);
   }
   printlnBoth();
-  for (short k = 0; k < rampSteps; k++) {
-    printAsHM(rampMinutes[k]);
+  for (size_t k = 0; k < rampPlan.size(); k++) {
+    printAsHM(rampPlan.minutes(k));
     for (int j = 0; j < NT; j++) {
       printBoth("   ");
-      printBoth(((double)rampHundredths[j][k]) / 100.0, 2);
+      printBoth(((double)rampPlan.hundredths(j, k)) / 100.0, 2);
     }
     printlnBoth();
   }
@@ -406,107 +215,42 @@ void printAsHM(unsigned int t) {
 
 
 /**
- * Make a new copy of Settings.ini on the SD card from the current settings.
- * Add a comment that this has been done.  Ideally, prior comments will be retained.
+ * Make a new Settings.ini on the SD card from the current settings, keeping
+ * the old one in /WebBack.  Add a comment that this has been done.  Prior
+ * comments are lost.  See SettingsFile.h for how the file is replaced, and
+ * what happens after a restart part way through.
  *
- * XXX care take to keep a backup and check before deleting but there is NO
- * XXX lock to prevent both cores from trying to access a file at once.  Fix
- * XXX this if multi-core methods are used as planned for the web server.
+ * XXX there is NO lock to prevent both cores from trying to access a file at
+ * XXX once.  Fix this if multi-core methods are used as planned for the web
+ * XXX server.
  **/
 bool rewriteSettingsINI() {
-  // For safety, copy the original (short term backup)
-  Serial.println("rewrite 0");
-  if (SDF.exists("/SetCopy.ini")) {
-    Serial.println("Found old SetCopy.");
-    if (SDF.remove("/SetCopy.ini")) {
-      Serial.println("Removed old SetCopy.");
-    } else {
-      Serial.println("==============  FAILED to remove old SetCopy.");
-      return false;
-    }
-  }
-  if (!myFileCopy("/Settings.ini", "/SetCopy.ini")) return false;
-  Serial.println("rewrite 0.1");
-
-  // We must back up the previous file long term, so make a name.
-  if (!SDF.exists("/WebBack")) {
-    if (!SDF.mkdir("/WebBack")) {
-      Serial.println("ERROR: Failed to make a backup directory.  Abandoning INI rewrite.");
-      return false;
-    }
-  }
-  Serial.println("rewrite 1");
-
-  char newName[32];
-  bool goodName = createBackupFileName(newName);
-
-  Serial.println("rewrite 2");
-
-  if (!goodName) {
-    Serial.println("Could not make a valid INI backup name.  Too many files?");
+  unsigned long start = millis();
+  char backup[32];
+  if (!reserveBackupName(backup)) {
+    Serial.println("Could not make a valid INI backup name.  Abandoning INI rewrite.");
     return false;
   }
-  Serial.println("rewrite 3");
-
-
-  // Create new file, but still don't touch the old one.  First get rid of old copies if they exist.
-  if (SDF.exists("/SetMods.xxx")) {
-    Serial.println("Found old SetMods.");
-    if (SDF.remove("/SetMods.xxx")) {
-      Serial.println("Removed old SetMods.");
-    } else {
-      Serial.println("==============  FAILED to remove old SetMods.");
-    }
+  SectorFile mod;
+  // Room for the comments, keywords and lines as written below.
+  if (!mod.open(SDF, INInewPath, 512 + rampPlan.size() * (12 + 8 * NT))) {
+    Serial.println("Could not open Settings.new.  Abandoning INI rewrite.");
+    return false;
   }
-  File32 mod = SDF.open("/SetMods.xxx", O_WRONLY | O_CREAT);
-  // Calling size() just after open seems to give a bad value - it may even affect the file!
-  //Serial.printf("Empty (?) modified file size is %d\n", mod.size());
-
-  Serial.println("\n== Starting to write modified settings.==\n");
-
-  // WARNING: for some reason mod.println() writes a "carriage return" instead
-  // of the usual "newline".  This can be avoided by using mod.print("\n") or a printf()
 
+  mod.printf("// This file was modified via the web interface at %s on %s\n", gettime().c_str(), getdate().c_str());
+  mod.printf("// Prior comments have been lost.  The previous file is saved as %s\n", backup);
   if (relativeStart) {
-    mod.print("// This file was modified via the web interface at ");
-    // DDDDD
-    mod.flush();
-    Serial.printf("In-progress file size is %d\n", mod.size());
-    Serial.printf(" gettime gives >%s<", gettime().c_str());
-    mod.print(gettime().c_str());
-    mod.print(" on ");
-    Serial.printf(" getdate gives >%s<", getdate().c_str());
-    mod.print(getdate().c_str());
-    mod.print("\n// Prior comments have been lost.  The previous file will be saved as ");
-    mod.print(newName);
-    mod.print("\n");
-    // DDDDD
-    mod.flush();
-    Serial.printf("In-progress file size is %d\n", mod.size());
-    // Start time
-    if (relativeStart) {
-      mod.print("START ");
-      mod.print((int)(relativeStartTime / 60));
-      mod.print(":");
-      int min = relativeStartTime % 60;
-      if (min == 0) {
-        mod.print("00");
-      } else if (min < 10) {
-        mod.print("0");
-        mod.print(min);
-      } else {
-        mod.print(min);
-      }
-      mod.print("\n");
+    mod.print("START ");
+    if (relativeStartEpoch) {
+      DateTime d(relativeStartEpoch);
+      mod.printf("%04d-%02d-%02d ", d.year(), d.month(), d.day());
     }
+    mod.printf("%d:%02d\n", relativeStartTime / 60, relativeStartTime % 60);
     printBoth("Settings will be applied relative to start time ");
     printAsHM(relativeStartTime);
     printlnBoth();
   }
-  // DDDDD
-  mod.flush();
-  Serial.printf("In-progress file size is %d\n", mod.size());
-  Serial.println("rewrite 4");
 
   // Note that if other interpolation options (e.g. SPLINE) are implemented,
   // this must be updated.
@@ -515,7 +259,14 @@ bool rewriteSettingsINI() {
   } else {
     mod.print("INTERP STEP\n");
   }
-  Serial.println("rewrite 5");
+  if (switchLights) {
+    mod.printf("LIGHTON %d:%02d\n", lightOnMinutes / 60, lightOnMinutes % 60);
+    mod.printf("LIGHTOFF %d:%02d\n", lightOffMinutes / 60, lightOffMinutes % 60);
+  }
+  if (logFormatBinary) mod.print("LOGFORMAT BINARY\n");
+  if (logRollKB) mod.printf("LOGROLLKB %lu\n", logRollKB);
+  if (logRollMinutes >= 0) mod.printf("LOGROLLTIME %d:%02d\n", logRollMinutes / 60, logRollMinutes % 60);
+  if (rampStream.isActive()) mod.printf("PLANFILE %s\n", rampStream.getPath());
 
   // The ramp plan.
   if (relativeStart) {
@@ -523,69 +274,22 @@ bool rewriteSettingsINI() {
   } else {
     mod.print("// Ramp plan in 24-hour time of days.  Times are in H:MM or HH:MM.\n");
   }
-  Serial.println("rewrite 6");
-  // DDDDD
-  mod.flush();
-  Serial.printf("In-progress file size is %d\n", mod.size());
   mod.print("// Time");
-  for (int j = 0; j < NT; j++) {
-    mod.print("     T");
-    mod.print(j + 1);
-  }
+  for (int j = 0; j < NT; j++) mod.printf("     T%d", j + 1);
   mod.print("\n");
-  for (short k = 0; k < rampSteps; k++) {
-    int t = rampMinutes[k];
-    if (t < 10 * 60) mod.print("0");
-    mod.print((int)floor(t / 60));
-    mod.print(":");
-    if (t % 60 < 10) mod.print("0");
-    mod.print(t % 60);
-    mod.print("     ");
-
-    for (int j = 0; j < NT; j++) {
-      mod.print("  ");
-      mod.print(((double)(rampHundredths[j][k]) / 100.0), 2);
-    }
+  for (size_t k = 0; k < rampPlan.size(); k++) {
+    unsigned int t = rampPlan.minutes(k);
+    mod.printf("%02u:%02u     ", t / 60, t % 60);
+    for (int j = 0; j < NT; j++) mod.printf("  %.2f", rampPlan.hundredths(j, k) / 100.0);
     mod.print("\n");
   }
-  // DDDDD
-  mod.flush();
-  Serial.printf("In-progress file size is %d\n", mod.size());
-
-  mod.close();
-
-  Serial.println("rewrite 7");
-
-  // Now we are ready to move files.  Unfortunately, there is no "move" or "rename".  We have to
-  // open both files and copy the bytes!
-  // First the backup
-
-  if (!myFileCopy("/Settings.ini", newName)) {
-    // It it exists, unknown error.  If not try copying the modified file anyway.
-    if (SDF.exists("/Settings.ini")) return false;
-    // Carry on, hoping we can create one.
-  }
-  // Get rid of the old version of the active file which was just copied.
-  if (!SDF.remove("/Settings.ini")) return false;
-
-  // We just removed Settings.ini, but be sure.
-  if (SDF.exists("/Settings.ini")) {
-    Serial.println("Settings.ini was not removed as planned.  FATAL ERROR.");
+  if (!mod.close()) {
+    Serial.println("Failed to write Settings.new.  Settings.ini is unchanged.");
+    SDF.remove(INInewPath);
     return false;
-  } else {
-    Serial.println("Correctly, Settings.ini does not exist at this time.");
   }
-
-  // Copy in the fresh one.
-  if (!myFileCopy("/SetMods.xxx", "/Settings.ini")) {
-    Serial.println("FATAL ERROR: failed to copy modified Settings.ini to replace the removed one.");
-    return false;
-  }
-  Serial.println("rewrite 8");
-
-  SDF.remove("/SetMods.xxx");
-  Serial.println("rewrite 9");
-
+  if (!commitSettingsINI(backup)) return false;
+  Serial.printf("Rewrote Settings.ini in %lu ms.  The previous one is %s.\n", millis() - start, backup);
   return true;
 }
 
@@ -594,162 +298,110 @@ bool rewriteSettingsINI() {
  * This is mainly for a new SD card or after recovery from a serious error.
  */
 bool resetSettings() {
-  if (SDF.exists("/Settings.ini")) {
-    char newName[32];
-    bool goodName = createBackupFileName(newName);
-    if (!myFileCopy("/Settings.ini", newName)) {
-      Serial.println("FATAL ERROR: failed to copy an existing Settings.ini to a backup name.");
-      return false;
-    }
-    if (!SDF.remove("/Settings.ini")) {
-      Serial.println("Could not remove old Settings.ini.  Is it write protected?");
-      return false;
-    }
-    Serial.println("Removed old Settings.ini");
+  char backup[32] = "";
+  if (SDF.exists(INIpath) && !reserveBackupName(backup)) {
+    Serial.println("FATAL ERROR: could not make a backup name for the existing Settings.ini.");
+    return false;
   }
-  // Old Settings.ini is gone.  Write a new one.
-  File32 f = SDF.open("/Settings.ini", O_WRONLY | O_CREAT);
-  if (!f) {
+  SectorFile f;
+  if (!f.open(SDF, INInewPath, 1024)) {
     Serial.println("Could not open a new Settings.ini. Remove and repair the SD card.");
     return false;
-  } else {
-    Serial.println("Writing new Settings.ini with example values.");
-    // f.print(defaultINI);
-    f.print("// A typical ramp preceeded by some tests\n// Start time (1 PM in this example)\n");
-    f.print("START 13:00\n// LINEAR is the default, so this is just a reminder.\nINTERP LINEAR\n");
-    f.print("// Times in column 1 are relative to START.\n// The temperatures are targets for each tank in Celsius.\n");
-    int i;
-    f.print("0:00");
-    for (i = 0; i < NT; i++) f.printf("%5d", 24);
-    f.print("\n");
-    f.print("3:00");
-    for (i = 0; i < NT; i++) f.printf("%5d", 28 + i);
-    f.print("\n");
-    f.print("6:00");
-    for (i = 0; i < NT; i++) f.printf("%5d", 28 + i);
-    f.print("\n");
-    f.print("7:00");
-    for (i = 0; i < NT; i++) f.printf("%5d", 24);
-    f.print("\n");
-    f.close();
-    // Now refresh the arrays from the new file.
-    readRampPlan();
   }
+  Serial.println("Writing new Settings.ini with example values.");
+  f.print("// A typical ramp preceeded by some tests\n// Start time (1 PM in this example)\n");
+  f.print("START 13:00\n// LINEAR is the default, so this is just a reminder.\nINTERP LINEAR\n");
+  f.print("// Times in column 1 are relative to START.\n// The temperatures are targets for each tank in Celsius.\n");
+  int i;
+  f.print("0:00");
+  for (i = 0; i < NT; i++) f.printf("%5d", 24);
+  f.print("\n");
+  f.print("3:00");
+  for (i = 0; i < NT; i++) f.printf("%5d", 28 + i);
+  f.print("\n");
+  f.print("6:00");
+  for (i = 0; i < NT; i++) f.printf("%5d", 28 + i);
+  f.print("\n");
+  f.print("7:00");
+  for (i = 0; i < NT; i++) f.printf("%5d", 24);
+  f.print("\n");
+  if (!f.close() || !commitSettingsINI(backup)) {
+    Serial.println("Could not write a new Settings.ini. Remove and repair the SD card.");
+    SDF.remove(INInewPath);
+    return false;
+  }
+  // Now refresh the arrays from the new file.
+  readRampPlan();
   return true;
 }
 
-/*
- * Find an unused name in WebBack and set it in "name".  Make
- * the directory but not the file at this time.  Return true if successful.
+/**
+ * Set name to the next backup name in /WebBack, from the counter in Rbk.cnt,
+ * and advance the counter.  Make the directory but not the file.  A name
+ * already in use, as when the card held backups before the counter, is
+ * skipped.  Return true if successful.
  */
-bool createBackupFileName(char* name) {
-  if (!SDF.exists("/WebBack")) {
-    if (!SDF.mkdir("/WebBack")) {
-      Serial.println("ERROR: Failed to make a backup directory.  Abandoning INI rewrite.");
+bool reserveBackupName(char* name) {
+  File32 counter = SDF.open(INIcounterPath, O_RDWR | O_CREAT);
+  if (!counter.isOpen()) {
+    if (!SDF.mkdir(INIbackupDir)) {
+      Serial.println("ERROR: Failed to make a backup directory.");
       return false;
     }
-  }
-  for (int i = 0; i < 1000; i++) {
-    sprintf(name, "/WebBack/Rbk%03u.ini", i);
-    if (!SDF.exists(name)) {
-      return true;
+    counter = SDF.open(INIcounterPath, O_RDWR | O_CREAT);
+    if (!counter.isOpen()) return false;
+  }
+  char text[12] = "";
+  counter.read(text, sizeof(text) - 1);
+  unsigned long next = strtoul(text, NULL, 10);
+  for (int tries = 0;; tries++) {
+    if (tries == 1000) {
+      counter.close();
+      return false;
     }
-  }
-  return false;
+    snprintf(name, 32, "%s/Rbk%03lu.ini", INIbackupDir, next++);
+    if (!SDF.exists(name)) break;
+  }
+  // Always the same length, so the counter is rewritten in place.
+  counter.seekSet(0);
+  counter.printf("%010lu\n", next);
+  bool ok = counter.sync();
+  counter.close();
+  return ok;
 }
 
 /**
- * Alternative arguments.
+ * Put Settings.new in place of Settings.ini, renaming the old one to backup,
+ * or removing nothing if backup is empty.  If Settings.new cannot be renamed
+ * the old file is put back.
  */
-bool myFileCopy(const char* ooo, String nnn) {
-  return myFileCopy(ooo, nnn.c_str());
-}
-
-/**
- * File does not have a copy function, so open a new file and copy the contents.
- * return true if successful, otherwise false.
- */
-bool myFileCopy(const char* ooo, const char* nnn) {
-  Serial.printf("my Copy 0 from %s to %s\n", ooo, nnn);
-
-  if (ooo[0] != '/') {
-    Serial.println("ERROR: file to copy must start with forward slash!");
-    return false;
-  } else if (nnn[0] != '/') {
-    Serial.println("ERROR: copy destination must start with forward slash!");
-    return false;
-  }
-
-  if (!SDF.exists("/")) {
-    Serial.printf("SD root directory is gone!\n");
-    return false;
-  }
-
-  if (!SDF.exists(ooo)) {
-    Serial.printf("Original file %s does not exist!\n", ooo);
+bool commitSettingsINI(const char* backup) {
+  if (backup[0] && !SDF.rename(INIpath, backup) && SDF.exists(INIpath)) {
+    Serial.printf("Could not rename Settings.ini to %s.  It is unchanged.\n", backup);
+    SDF.remove(INInewPath);
     return false;
   }
-  Serial.println("my Copy 1");
-
-  File32 f = SDF.open(ooo, O_RDONLY);
-  File32 copy = SDF.open(nnn, O_WRONLY | O_CREAT);  // NOTE: this will overwrite if name is re-used!
-  int origSize = f.size();
-
-  if (!f) {
-    Serial.printf("FATAL ERROR: failed to open original file %s.\n", ooo);
-    return false;
-  } else if (!copy) {
-    Serial.printf("FATAL ERROR: failed to open new file %s for copying.\n", nnn);
+  if (!SDF.rename(INInewPath, INIpath)) {
+    Serial.println("FATAL ERROR: failed to rename Settings.new to Settings.ini.");
+    if (backup[0]) SDF.rename(backup, INIpath);
     return false;
   }
-  Serial.println("my Copy 2");
-
-  uint32_t m_start = millis();
-
-  int n;
-  uint8_t buf[4096];  // Was 128.  Why so small?  512 is typical for SD
-  int www;
-  int watchdog = 0;  // Occasionally reset the watchdog.
-  int dots = 0;
-  // TODO: check for www != n, or www = 0.  Could create an unending loop.
-  while ((n = f.read(buf, sizeof(buf))) > 0) {
-    // Serial.printf("Read %d bytes from original file of size %d.  ", n, origSize);
-    www = copy.write(buf, n);
-    copy.flush();
-    // Serial.printf(" wrote %d bytes to the copy.  New size = %d\n", www, copy.size());
-    Serial.print(".");
-    if (dots == 80) {
-      Serial.println();
-      dots = 0;
-    }
-    watchdog++;
-    if (watchdog == 256) {
-      // About once per megabyte, reset the timer.  In tests it times out at about 3.6 MB.
-      esp_task_wdt_reset();
-      watchdog = 0;
-    }
-  }
-  Serial.println("\nmy Copy 3");
+  return true;
+}
 
-  // Not a full check, but at least be sure the file sizes match.
-  copy.flush();
-  if (copy.size() != origSize) {
-    Serial.printf("my Copy 4 original size was %d, copied file was %d bytes.\n", origSize, copy.size());
-    f.close();
-    copy.close();
-    SDF.remove(nnn);
-    return false;
+/**
+ * Finish a replacement of Settings.ini cut short by a restart.  Settings.new
+ * is only renamed once it is complete, so it is used if Settings.ini is gone
+ * and removed otherwise.
+ */
+void recoverSettingsINI() {
+  if (!SDF.exists(INInewPath)) return;
+  if (SDF.exists(INIpath)) {
+    SDF.remove(INInewPath);
+    Serial.println("Removed Settings.new, left by a rewrite which did not finish.");
+  } else if (SDF.rename(INInewPath, INIpath)) {
+    Serial.println("Finished replacing Settings.ini, cut short by a restart.");
   }
-  Serial.printf("Copy took %d seconds for %d bytes.\n", (int)((millis() - m_start) / 1000UL), origSize);
-  Serial.println("my Copy 5");
-
-  f.close();
-  copy.close();
-
-
-  Serial.println("my Copy 6 (complete)");
-
-  return true;
 }
 
 /*
@@ -803,6 +455,251 @@ void printlnBoth() {
   if (logFile) logFile.println();
   Serial.println();
 }
+
+/**
+ * Load the graph history saved by checkpointGraph() and journalGraphPoints(), and set
+ * graphMsOffset so that new points follow it.  Called from setup() before the web server
+ * and the tasks start, so nothing else uses the tiers yet.
+ *
+ * The checkpoint is at most the size of the tiers, and only the last maxGraphPoints of
+ * the journal are read, so this takes about the same time however long the card has
+ * been collecting.  The time is printed and shown by logStats.
+ */
+void restoreGraphHistory() {
+  unsigned long start = millis();
+  // GRAPH.new is only complete if GRAPH.ckp was removed to make way for it.
+  if (SDF.exists(GRAPHnewPath)) {
+    if (SDF.exists(GRAPHcheckpointPath)) SDF.remove(GRAPHnewPath);
+    else SDF.rename(GRAPHnewPath, GRAPHcheckpointPath);
+  }
+
+  GraphReader in;
+  uint8_t type;
+  const uint8_t *body;
+  DataPoint p;
+  GraphRollup r;
+  uint32_t upTo = 0;  // Newest point loaded.
+  bool any = false;
+  if (in.begin(SDF, GRAPHcheckpointPath)) {
+    while (in.next(type, body)) {
+      switch (type) {
+        case GRAPHpoint:
+          memcpy(&p, body, sizeof(p));
+          graphPoints.emplace_back(p);
+          break;
+        case GRAPHminute:
+          memcpy(&p, body, sizeof(p));
+          graphMinutes.emplace_back(p);
+          break;
+        case GRAPHtenMinute:
+          memcpy(&r, body, sizeof(r));
+          graphTenMinutes.emplace_back(r);
+          break;
+        case GRAPHsums:
+          memcpy(&minuteSums, body, sizeof(minuteSums));
+          memcpy(&tenMinuteSums, body + sizeof(minuteSums), sizeof(tenMinuteSums));
+          break;
+        case GRAPHend:
+          memcpy(&upTo, body, sizeof(upTo));
+          any = true;
+          break;
+      }
+    }
+    in.end();
+  }
+
+  journalNeedsHeader = true;
+  if (in.begin(SDF, GRAPHjournalPath)) {
+    const uint32_t recordSize = 1 + sizeof(DataPoint);
+    uint32_t records = (in.size() - GRAPHheaderSize) / recordSize;
+    if (records > (uint32_t)maxGraphPoints) in.seek(GRAPHheaderSize + (records - maxGraphPoints) * recordSize);
+    while (in.next(type, body) && type == GRAPHpoint) {
+      memcpy(&p, body, sizeof(p));
+      // Points up to upTo are in the checkpoint already, if the journal outlived it.
+      if (any && (int32_t)(p.timestamp - upTo) <= 0) continue;
+      addGraphPoint(p);
+      upTo = p.timestamp;
+      any = true;
+    }
+    // A record cut short by a restart is cut off, so new records line up after the good ones.
+    uint32_t good = in.position();
+    bool whole = good == in.size();
+    in.end();
+    if (!whole) {
+      File32 f = SDF.open(GRAPHjournalPath, O_RDWR);
+      whole = f.isOpen() && f.truncate(good);
+      f.close();
+    }
+    journalNeedsHeader = !whole;
+  }
+  if (journalNeedsHeader) SDF.remove(GRAPHjournalPath);
+
+  // A history older than the coarsest tier covers is from an earlier experiment.
+  uint32_t now = rtc.now().unixtime();
+  if (!graphPoints.empty() && now > graphPoints.back().epoch && now - graphPoints.back().epoch > tenMinuteDays * 86400) {
+    Serial.println("The graph history on SD is too old to show.  Starting a new one.");
+    discardGraphHistory();
+  }
+  // Leave the real gap in the chart, as far as the clock tells it.
+  uint32_t gapMs = GRAPHwindow;
+  if (!graphPoints.empty() && now > graphPoints.back().epoch) gapMs = max(gapMs, (now - graphPoints.back().epoch) * 1000);
+  // Timestamps are compared as differences of up to 2^31 ms.  Before the next point gets that
+  // far, the history is moved to start near 0 and checkpointed that way.
+  if (!graphPoints.empty() && (uint64_t)graphPoints.back().timestamp + gapMs >= GRAPHtimestampLimit) {
+    uint32_t oldest = min(min(graphPoints.front().timestamp, minuteSums.openSince()), tenMinuteSums.openSince());
+    if (!graphMinutes.empty()) oldest = min(oldest, graphMinutes.front().timestamp);
+    if (!graphTenMinutes.empty()) oldest = min(oldest, graphTenMinutes.front().timestamp);
+    uint32_t shift = oldest - oldest % 600000;  // Whole ten minute periods, as tenMinuteSums sums them.
+    if ((uint64_t)graphPoints.back().timestamp + gapMs - shift >= GRAPHtimestampLimit) {
+      Serial.println("The graph history on SD spans too long to continue.  Starting a new one.");
+      discardGraphHistory();
+    } else {
+      rebaseGraphHistory(shift);
+      Serial.printf("Graph history moved %lu ms earlier.\n", (unsigned long)shift);
+    }
+  }
+  if (!graphPoints.empty()) graphMsOffset = graphPoints.back().timestamp + gapMs - millis();
+  lastJournaled = graphPoints.empty() ? 0 : graphPoints.back().timestamp;
+  graphRestored = graphPoints.size() + graphMinutes.size() + graphTenMinutes.size();
+  graphRestoreMs = millis() - start;
+  Serial.printf("Restored %lu graph points from SD in %lu ms.\n", graphRestored, graphRestoreMs);
+}
+
+/**
+ * Start the graph history afresh, in memory and on the card.  For restoreGraphHistory().
+ */
+void discardGraphHistory() {
+  graphPoints.clear();
+  graphMinutes.clear();
+  graphTenMinutes.clear();
+  minuteSums.clear();
+  tenMinuteSums.clear();
+  SDF.remove(GRAPHcheckpointPath);
+  SDF.remove(GRAPHjournalPath);
+  journalNeedsHeader = true;
+  graphMsOffset = 0;
+}
+
+/**
+ * Move every graph timestamp shift ms earlier, and save the history that way so the
+ * files on the card agree.  For restoreGraphHistory().
+ */
+void rebaseGraphHistory(uint32_t shift) {
+  for (size_t k = 0; k < graphPoints.size(); k++) graphPoints[k].timestamp -= shift;
+  for (size_t k = 0; k < graphMinutes.size(); k++) graphMinutes[k].timestamp -= shift;
+  for (size_t k = 0; k < graphTenMinutes.size(); k++) graphTenMinutes[k].timestamp -= shift;
+  minuteSums.rebase(shift);
+  tenMinuteSums.rebase(shift);
+  if (!checkpointGraph()) {
+    // The card still has the old timestamps.  Better no history at the next boot than a wrong one.
+    SDF.remove(GRAPHcheckpointPath);
+    SDF.remove(GRAPHjournalPath);
+    journalNeedsHeader = true;
+  }
+}
+
+/**
+ * Append the points in graphPoints newer than lastJournaled to GRAPH.jnl, and write a
+ * checkpoint every GRAPHcheckpointMinutes.  Called by logTask, the only task writing the
+ * log, so after logging is paused the points from the pause are written here too.
+ */
+void journalGraphPoints() {
+  static unsigned long lastCheckpoint = millis();
+  DataPoint batch[16];
+  uint8_t rec[GRAPHheaderSize + 1 + sizeof(DataPoint)];
+  for (;;) {
+    // A few at a time, so graphTask doesn't wait on the card for graphMutex.
+    xSemaphoreTake(graphMutex, portMAX_DELAY);
+    size_t i = firstAtOrAfter(graphPoints, lastJournaled + 1), count = 0;
+    while (i < graphPoints.size() && count < sizeof(batch) / sizeof(batch[0])) batch[count++] = graphPoints[i++];
+    xSemaphoreGive(graphMutex);
+    if (!count) break;
+    for (size_t k = 0; k < count; k++) {
+      size_t n = journalNeedsHeader ? graphHeader(rec) : 0;
+      n += graphRecord(rec + n, GRAPHpoint, &batch[k]);
+      if (graphJournal.append((const char *)rec, n)) journalNeedsHeader = false;
+    }
+    lastJournaled = batch[count - 1].timestamp;
+  }
+  if (millis() - lastCheckpoint >= GRAPHcheckpointMinutes * 60000) {
+    lastCheckpoint = millis();
+    checkpointGraph();
+  }
+}
+
+// Write the items in ring with timestamps before "before" as records of the given type.
+// graphMutex is held for one small batch at a time, so graphTask never waits long.
+template <typename T>
+bool writeGraphTier(File32 &f, const RingBuffer<T> &ring, uint8_t type, uint32_t before) {
+  uint8_t buf[16 * (1 + sizeof(T))];
+  uint32_t from = 0;  // Oldest timestamp not yet written.  Old items may go as new ones arrive.
+  for (;;) {
+    size_t n = 0;
+    xSemaphoreTake(graphMutex, portMAX_DELAY);
+    for (size_t i = firstAtOrAfter(ring, from); i < ring.size() && ring[i].timestamp < before; i++) {
+      if (n + 1 + sizeof(T) > sizeof(buf)) break;
+      n += graphRecord(buf + n, type, &ring[i]);
+      from = ring[i].timestamp + 1;
+    }
+    xSemaphoreGive(graphMutex);
+    if (n == 0) return true;
+    if (f.write(buf, n) != n) return false;
+  }
+}
+
+/**
+ * Save all three tiers and the partial sums as GRAPH.ckp, and start a new journal.
+ * Points graphTask adds meanwhile go in the new journal.  False if the card failed.
+ * If GRAPH.new could not be written, the old checkpoint and journal are kept.  If it
+ * could not be renamed, it is kept with the journal, and restoreGraphHistory() or the
+ * next checkpoint renames it.
+ */
+bool checkpointGraph() {
+  unsigned long start = millis();
+  // A GRAPH.new left by a failed rename is the only checkpoint.  Don't write over it.
+  if (SDF.exists(GRAPHnewPath) && !SDF.exists(GRAPHcheckpointPath) && !SDF.rename(GRAPHnewPath, GRAPHcheckpointPath)) {
+    return false;
+  }
+  xSemaphoreTake(graphMutex, portMAX_DELAY);
+  bool any = !graphPoints.empty();
+  uint32_t upTo = any ? graphPoints.back().timestamp : 0;
+  GraphAccumulator sums[2] = {minuteSums, tenMinuteSums};
+  xSemaphoreGive(graphMutex);
+  if (!any) return true;
+
+  File32 f = SDF.open(GRAPHnewPath, O_WRONLY | O_CREAT | O_TRUNC);
+  if (!f.isOpen()) return false;
+  uint8_t rec[GRAPHrecordMax];
+  size_t n = graphHeader(rec);
+  bool ok = f.write(rec, n) == n
+            && writeGraphTier(f, graphPoints, GRAPHpoint, upTo + 1)
+            && writeGraphTier(f, graphMinutes, GRAPHminute, sums[0].openSince())
+            && writeGraphTier(f, graphTenMinutes, GRAPHtenMinute, sums[1].openSince());
+  if (ok) {
+    n = graphRecord(rec, GRAPHsums, sums);
+    ok = f.write(rec, n) == n;
+  }
+  if (ok) {
+    n = graphRecord(rec, GRAPHend, &upTo);
+    ok = f.write(rec, n) == n && f.sync();
+  }
+  f.close();
+  if (!ok) {
+    SDF.remove(GRAPHnewPath);  // GRAPH.ckp is untouched.
+    checkpointMs = millis() - start;
+    return false;
+  }
+  graphJournal.close();
+  SDF.remove(GRAPHcheckpointPath);
+  ok = SDF.rename(GRAPHnewPath, GRAPHcheckpointPath);
+  if (ok) {
+    SDF.remove(GRAPHjournalPath);
+    journalNeedsHeader = true;
+    lastJournaled = upTo;
+  }
+  checkpointMs = millis() - start;
+  return ok;
+}
 //void printBoth(byte d) {
 //  if (logFile) logFile.print(d);
 //  Serial.print(d);
@@ -0,0 +1,73 @@
+/**
+ * A new file on the card, written a whole 512-byte sector at a time.
+ *
+ * open() reserves contiguous room with preAllocate(), so the card does not
+ * search for free clusters as the file grows.  Writes are gathered into one
+ * sector, and runs of whole sectors with nothing gathered go straight to the
+ * card.  close() cuts off the unused part of the reservation and syncs once.
+ *
+ * rewriteSettingsINI() and resetSettings() write Settings.new through one
+ * (see SettingsFile.h), and handleUpload() writes files sent to /Upload.
+ */
+#ifndef SECTORFILE_H
+#define SECTORFILE_H
+
+class SectorFile : public Print {
+public:
+  // Start path afresh, with room for about sizeHint bytes.
+  bool open(SdFat32 &sd, const char *path, uint32_t sizeHint) {
+    file = sd.open(path, O_WRONLY | O_CREAT | O_TRUNC);
+    used = 0;
+    ok = file.isOpen();
+    // Contiguous clusters, found once.  Without them the file just grows as usual.
+    if (ok) file.preAllocate(sizeHint);
+    return ok;
+  }
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *data, size_t len) override {
+    for (size_t left = len; left > 0;) {
+      // Whole sectors with nothing waiting in buf go straight to the card.
+      if (used == 0 && left >= sizeof(buf)) {
+        size_t whole = left - left % sizeof(buf);
+        ok = ok && file.write(data, whole) == whole;
+        data += whole;
+        left -= whole;
+        continue;
+      }
+      size_t take = min(left, sizeof(buf) - used);
+      memcpy(buf + used, data, take);
+      used += take;
+      data += take;
+      left -= take;
+      if (used == sizeof(buf)) writeBuffer();
+    }
+    return len;
+  }
+  using Print::write;
+
+  // Write the rest, cut off the unused part of the preallocation, and sync.
+  // False if any of the file failed to reach the card.
+  bool close() {
+    if (used > 0) writeBuffer();
+    ok = ok && file.truncate() && file.sync();
+    file.close();
+    return ok;
+  }
+
+  // False once anything failed to reach the card.
+  bool good() const { return ok; }
+
+private:
+  void writeBuffer() {
+    ok = ok && file.write(buf, used) == used;
+    used = 0;
+  }
+
+  File32 file;
+  uint8_t buf[512];
+  size_t used = 0;
+  bool ok = false;
+};
+
+#endif
@@ -162,6 +162,11 @@ void sensorsInit()
     }
     Serial.println("\n  }");
   }
+
+  // getTemperatures() starts a conversion and collects the results on later passes
+  // through loop(), so never let requestTemperatures() wait.
+  sensors.setWaitForConversion(false);
+  conversionMs = sensors.millisToWaitForConversion(sensors.getResolution());
 }
 
 /**
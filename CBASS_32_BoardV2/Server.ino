@@ -6,17 +6,29 @@
  * 2) Keep large static files on the SD card in /htdocs
  * 3) Keep smaller chunks of HTML, javascript, and possibly CSS in WebPieces.h as PROGMEM variables.
  * 4) Most pages will have a static header and footer and a dynamic body.
- * 5) The dynamic bodies will be defined in calls to "processor()"
+ * 5) The dynamic bodies will be filled in by the functions templateFill() names (PageTemplate.h).
  * 6) Pages will normally use a response object in addition to the request object allowing
  *    for headers and parts of the response to be added sequentially.
- * 7) Another convention: variables set to be picked up by processor() will start with "p_"
+ * 7) Another convention: variables set to be picked up by a fill function will start with "p_"
  */
 
 
 File32 fileForWeb;
 bool ledState = false;
 bool goodTimeChange = false;
-String postBuffer;
+PlanJSON planUpload;                       // The ramp plan being posted to /updateRampPlan,
+AsyncWebServerRequest *planUploader = NULL;  // by this request.
+SectorFile uploadFile;                     // The file being sent to /Upload,
+AsyncWebServerRequest *uploader = NULL;    // by this request,
+String uploadPath;                         // to here.
+unsigned long uploadStart = 0;             // millis() at its first piece.
+// What became of a file sent to /Upload, kept with its request in _tempObject until the
+// answer goes out, so a later upload can't change it.  The web server frees it.
+struct UploadOutcome {
+  const char *error;  // Why it failed, or NULL.
+};
+unsigned long uploads = 0, uploadBytes = 0;  // Files received, and the size
+float uploadKBs = 0;                       // and speed of the last, for logStats().
 String p_message, p_title;
 const int maxPathLen = 256;
 char dirPath[maxPathLen];  // For directory paths received as arguments.  Don't let this overrun.
@@ -28,53 +40,247 @@ void sendFromFile(WiFiClient client);
 void sendAsHM(unsigned int t, WiFiClient client);
 bool setNewStartTime(String queryString);
 int timeOrNegative(String s);
-void sendXYHistory(AsyncResponseStream *rs, unsigned long oldest = 0);
-String sendFileInfo();
+void sendFileInfo(Print &out);
 void sendRampForm(AsyncResponseStream *rs);
 void sendAsHM(unsigned int t, AsyncResponseStream *rs);
 bool rewriteSettingsINI();
-boolean receivePlanJSON(String js, AsyncResponseStream *response);
-String processor(const String &var);
+boolean receivePlanJSON(PlanJSON &upload, AsyncResponseStream *response);
 String showDateTime();
+void logStats(Print &out);
 char *getFileName(File32 &f);
 void pauseLogging(boolean a);
+boolean endUpload(boolean keep);
+
+// Downloads now open, and an upload if there is one.  Logging stays paused until the last one ends.
+int openDownloads = 0;
+
+FileDownload::FileDownload() {
+  if (openDownloads++ == 0) pauseLogging(true);
+}
+
+FileDownload::~FileDownload() {
+  if (file.isOpen()) file.close();
+  delete csv;
+  delete lines;
+  if (--openDownloads == 0) pauseLogging(false);
+}
+
+/**
+ * Send a templated page with a strong ETag, or "304 Not Modified" if the
+ * browser already has what it would say.  Each fill function runs once and
+ * the ETag hashes the page exactly as it will be sent, so a page only
+ * revalidates when none of its values have changed.  Status pages left on
+ * auto-refresh then cost a few hundred bytes instead of the whole page.
+ * Fill function side effects, such as clearing p_message, happen either way.
+ * Not for pages with ~ROLLLOG~, which acts rather than shows.
+ */
+void sendPage(AsyncWebServerRequest *request, PGM_P page, const char *contentType) {
+  std::shared_ptr<TemplateRender> render(new TemplateRender(pageTemplate(page)));
+  size_t length;
+  String etag = etagString(render->capture(ETAGseed, length));
+
+  if (etagMatches(request, etag)) {
+    sendNotModified(request, etag, "no-cache", false);
+    return;
+  }
+  AsyncWebServerResponse *response = request->beginResponse(contentType, length, [render](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+    return render->read(buffer, maxLen);
+  });
+  response->addHeader("Server", "ESP Async Web Server");
+  response->addHeader("ETag", etag);
+  response->addHeader("Cache-Control", "no-cache");  // Always revalidate.
+  request->send(response);
+}
+
+/**
+ * Send a templated page as it is filled in, with no validator, for pages
+ * which report the result of an action.
+ */
+void sendTemplate(AsyncWebServerRequest *request, int code, const char *contentType, PGM_P page) {
+  std::shared_ptr<TemplateRender> render(new TemplateRender(pageTemplate(page)));
+  AsyncWebServerResponse *response = request->beginChunkedResponse(contentType, [render](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+    return render->read(buffer, maxLen);
+  });
+  response->setCode(code);
+  response->addHeader("Server", "ESP Async Web Server");
+  request->send(response);
+}
+
+// Every page template, compiled before the server starts.
+void compileTemplates() {
+  PGM_P pages[] = {basePage, aboutPage, uploadHTML, dirListHTML, uploadSuccess, rollLogNow, rebootPage,
+                   rebootHTML, logHTML, syncTime, plotlyHTML, linkList, iniResetPage, rampPlanJavascript};
+  for (PGM_P page : pages) pageTemplate(page);
+}
+
+/**
+ * Send a file from the SD card.  It goes out a piece at a time from its own
+ * FileDownload, so any number of clients may download at once.  A Range
+ * header of one byte range is honored, so an interrupted download can be
+ * resumed; anything else gets the whole file.
+ * downloadName: if not NULL, the browser is asked to save the file under this name.
+ */
+void sendSDFile(AsyncWebServerRequest *request, const char *path, const char *contentType, const char *downloadName) {
+  std::shared_ptr<FileDownload> d = std::make_shared<FileDownload>();
+  d->file = SDF.open(path, O_RDONLY);
+  if (!d->file) {
+    Serial.printf("Unable to open %s for download.\n", path);
+    request->send(404, "text/plain", "Not found on this reef.");
+    return;
+  }
+  uint32_t size = d->file.fileSize();
+  d->end = size;
+  int code = 200;
+  char range[48];
+  if (request->hasHeader("Range")) {
+    int r = parseRange(request->header("Range"), size, d->next, d->end);
+    if (r < 0) {
+      AsyncWebServerResponse *response = request->beginResponse(416, "text/plain", "Range not satisfiable.");
+      snprintf(range, sizeof(range), "bytes */%lu", (unsigned long)size);
+      response->addHeader("Content-Range", range);
+      request->send(response);
+      return;
+    }
+    if (r > 0) code = 206;
+  }
+  Serial.printf("Sending %s, bytes %lu to %lu of %lu.\n", path, (unsigned long)d->next, (unsigned long)d->end, (unsigned long)size);
+  d->file.seekSet(d->next);
+  // The response holds d until it is finished or the client goes away.
+  AsyncWebServerResponse *response = request->beginResponse(contentType, d->end - d->next, [d](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+    return fileChunks(*d, buffer, maxLen);
+  });
+  response->setCode(code);
+  response->addHeader("Server", "ESP Async Web Server");
+  response->addHeader("Accept-Ranges", "bytes");
+  if (code == 206) {
+    snprintf(range, sizeof(range), "bytes %lu-%lu/%lu", (unsigned long)d->next, (unsigned long)d->end - 1, (unsigned long)size);
+    response->addHeader("Content-Range", range);
+  }
+  if (downloadName) response->addHeader("Content-Disposition", String("attachment; filename=\"") + downloadName + "\"");
+  request->send(response);
+}
+
+/**
+ * Send LOG.bin as the CSV LOG.txt would hold.  Its length is not known until it
+ * has all been converted, so this is chunked and ignores Range.
+ */
+void sendBinaryLog(AsyncWebServerRequest *request) {
+  std::shared_ptr<FileDownload> d = std::make_shared<FileDownload>();
+  d->csv = new LogTranscoder();
+  if (!d->csv->begin(SDF, "/LOG.bin")) {
+    request->send(404, "text/plain", "Not found on this reef.");
+    return;
+  }
+  Serial.println("Sending LOG.bin as CSV.");
+  AsyncWebServerResponse *response = request->beginChunkedResponse("text/plain", [d](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+    return fileChunks(*d, buffer, maxLen);
+  });
+  response->addHeader("Server", "ESP Async Web Server");
+  response->addHeader("Content-Disposition", "attachment; filename=\"LogDownload.csv\"");
+  request->send(response);
+}
+
+/**
+ * Send the lines logged from RTC time from to to, with the header line first, as
+ * CSV whichever the log format.  LOG.idx gives the place to start, so about
+ * LOGindexSeconds more than the range is read, however large the log.  Chunked,
+ * since the length is not known until the end of the range is found.
+ */
+void sendLogRange(AsyncWebServerRequest *request, uint32_t from, uint32_t to) {
+  std::shared_ptr<FileDownload> d = std::make_shared<FileDownload>();
+  LogIndexEntry at = logIndex.find(from);
+  bool ok;
+  if (binaryLog) {
+    d->csv = new LogTranscoder();
+    ok = d->csv->begin(SDF, "/LOG.bin", at.header, at.offset, from, to);
+  } else {
+    d->lines = new LogTextRange();
+    ok = d->lines->begin(SDF, "/LOG.txt", at, from, to);
+  }
+  if (!ok) {
+    request->send(404, "text/plain", "Not found on this reef.");
+    return;
+  }
+  Serial.printf("Sending the log from %lu to %lu, starting at byte %lu.\n", (unsigned long)from, (unsigned long)to,
+                (unsigned long)at.offset);
+  AsyncWebServerResponse *response = request->beginChunkedResponse("text/plain", [d](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+    return fileChunks(*d, buffer, maxLen);
+  });
+  response->addHeader("Server", "ESP Async Web Server");
+  response->addHeader("Content-Disposition", "attachment; filename=\"LogRange.csv\"");
+  request->send(response);
+}
+
+/**
+ * Read the optional parameter name as a time, Unix seconds or YYYY-MM-DDThh:mm[:ss]
+ * as a datetime-local input gives it.  Left as it is when missing or empty.
+ * False if it can't be read.
+ */
+bool logTimeParam(AsyncWebServerRequest *request, const char *name, uint32_t &epoch) {
+  if (!request->hasParam(name)) return true;
+  const char *v = request->getParam(name)->value().c_str();
+  if (!*v) return true;
+  char *stop;
+  unsigned long seconds = strtoul(v, &stop, 10);
+  if (!*stop) {
+    epoch = seconds;
+    return true;
+  }
+  int year, month, day, hour, minute, second = 0;
+  if (sscanf(v, "%d-%d-%dT%d:%d:%d", &year, &month, &day, &hour, &minute, &second) < 5) return false;
+  epoch = DateTime(year, month, day, hour, minute, second).unixtime();
+  return true;
+}
 
 /**
- * Return parts of a file. Each chunk is placed in the buffer, and
- * a static variable records the position of the next byte to read.
- * TODO: Verify that the correct thing happens if two users request
- * the same file (or different ones for that matter) simultaneously.
+ * Return the next part of a download.  Each chunk is placed in the buffer,
+ * and d records where to continue.
  * buffer: a buffer provided by the calling function, where output bytes are placed.
  * maxLen: the size of the buffer, thus an upper bound on the bytes to read.
- * fName: the name of the file in the filesystem.
  */
-uint32_t fileChunkPos = 0;
-size_t fileChunks(uint8_t *buffer, size_t maxLen, const char *fName) {
-  static File32 fileForChunks;
-  if (!fileChunkPos) Serial.printf("In file chunks for %s.\n", fName);
-  size_t maxRead = 4096;
-  int bytesRead = 0;
-  // Stop logging to avoid race conditions.  Be sure to reset
-  // this regardless of result.
-  pauseLogging(true);
-  if (!fileForChunks) {
-    fileForChunks = SDF.open(fName, O_RDONLY);
-  }
-  fileForChunks.seekSet(fileChunkPos);
+size_t fileChunks(FileDownload &d, uint8_t *buffer, size_t maxLen) {
   // Read no more than the server asks for, but also no more than maxRead,
   // which is meant as a reasonable speed/memory/safety compromise.
-  bytesRead = fileForChunks.read(buffer, min(maxRead, maxLen));
-  //Serial.printf("fileChunks returning %d bytes, start = %d,  maxLen = %d, maxRead = %d.\n", bytesRead, fileChunkPos, maxLen, maxRead);
+  size_t maxRead = min((size_t)4096, maxLen);
+  if (d.csv) return d.csv->read(buffer, maxRead);
+  if (d.lines) return d.lines->read(buffer, maxRead);
+  if (d.next >= d.end) return 0;
+  int bytesRead = d.file.read(buffer, min(maxRead, (size_t)(d.end - d.next)));
+  if (bytesRead <= 0) return 0;
+  d.next += bytesRead;
+  return bytesRead;
+}
 
-  if (bytesRead <= 0) {
-    fileChunkPos = 0;
-    fileForChunks.close();
-    pauseLogging(false);
-    Serial.printf("Completed sending %s.", fName);
-  } else {
-    fileChunkPos += bytesRead;
+/**
+ * Read a Range header of the form "bytes=first-last", "bytes=first-" or "bytes=-suffix".
+ * Returns 1 and sets first and end (one past the last byte) for a usable range,
+ * 0 if the header should be ignored (several ranges, or not understood), and -1 if
+ * the range lies beyond the end of the file.
+ */
+int parseRange(const String &range, uint32_t size, uint32_t &first, uint32_t &end) {
+  if (!range.startsWith("bytes=") || range.indexOf(',') >= 0) return 0;
+  const char *p = range.c_str() + 6;
+  char *stop;
+  if (*p == '-') {
+    unsigned long suffix = strtoul(p + 1, &stop, 10);
+    if (stop == p + 1 || *stop) return 0;
+    if (suffix == 0) return -1;
+    first = size - min((uint32_t)suffix, size);
+    end = size;
+    return size > 0 ? 1 : -1;
   }
-  return bytesRead;
+  unsigned long a = strtoul(p, &stop, 10);
+  if (stop == p || *stop != '-') return 0;
+  p = stop + 1;
+  unsigned long b = size ? size - 1 : 0;
+  if (*p) {
+    b = strtoul(p, &stop, 10);
+    if (*stop || b < a) return 0;
+  }
+  if (a >= size) return -1;
+  first = a;
+  end = min((uint32_t)b + 1, size);
+  return 1;
 }
 
 
@@ -126,12 +332,15 @@ int checkMagic(AsyncWebServerRequest *request, const char *extra = "") {
 /*
  * Send a file from the client to CBASS.  Note that we cannot use magicWord here because the
  * request object received does not have all of the parameters!
+ *
+ * This is called once for each piece of the file, about one TCP segment each.  The file is
+ * opened on the first piece, with room reserved for the whole request, and written through
+ * uploadFile in whole sectors.  It is closed on the final piece, or removed if the client
+ * goes away first.  One file is received at a time.
  */
 void handleUpload(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final) {
   // Save uploaded file to SD
   // On SD (maybe not on SPIFFS) files must start with "/".
-  Serial.printf("Upload index = %d\n", index);
-
   if (!index) {
     Serial.println("All parameters");
     int params = request->params();
@@ -147,64 +356,87 @@ void handleUpload(AsyncWebServerRequest *request, String filename, size_t index,
       }
     }
     Serial.println("End parameters");
-  }
-  // Convention: Files and directories start but do not end with a "/".
-  if (!filename.startsWith("/")) filename = "/" + filename;
-  if (filename.endsWith("/")) filename.remove(filename.lastIndexOf("/"));
-  static String dC;
-  static String nD;
-  static String fullPath;
-  if (!index) {
+    if (uploader) {
+      Serial.printf("Refused %s while another upload is being received.\n", filename.c_str());
+      return;
+    }
+    // Convention: Files and directories start but do not end with a "/".
+    if (!filename.startsWith("/")) filename = "/" + filename;
+    if (filename.endsWith("/")) filename.remove(filename.lastIndexOf("/"));
     Serial.printf("UploadStart: %s\n", filename.c_str());
+    // Whatever happens next, this request gets the answer.  Without one it is refused.
+    UploadOutcome *outcome = (UploadOutcome *)malloc(sizeof(UploadOutcome));
+    if (!outcome) return;
+    outcome->error = NULL;
+    request->_tempObject = outcome;
     AsyncWebParameter *p = request->getParam("dirChoices", true);  // "true" argument required since this is a POST, not GET.
-    Serial.printf("dirChoices printable? %s\n", p->value().c_str());
-    delay(1000);
-
-    //dC = String(p->value().c_str());
-    dC = p->value();
-
+    String dC = p ? p->value() : String("/");
     dC.trim();
     if (dC == "--new--") {
       // get the name, create the directory if needed, and change into it.
       p = request->getParam("newdir", true);
-      nD = p->value();
+      String nD = p ? p->value() : String();
       // For consistency, remove any leading "/"
       if (nD.startsWith("/")) nD.remove(0, 1);
-      if (filename.endsWith("/")) filename.remove(filename.lastIndexOf("/"));
-      if (SDF.exists(nD)) {
-        Serial.printf("ERROR: no upload.  File or directory %s already exists.\n", nD);
+      if (nD.length() == 0 || SDF.exists(nD)) {
+        Serial.printf("ERROR: no upload.  File or directory %s already exists.\n", nD.c_str());
+        outcome->error = "The new directory is missing or already exists.";
         return;
-        // XXX does this abort the upload or just the first of many calls?
       }
-      //File32 root = SDF.open("/", O_WRONLY);
       SDF.mkdir(nD);
-      fullPath = "/" + nD;
+      uploadPath = "/" + nD;
     } else if (dC == "/") {
-      fullPath = "/";
+      uploadPath = "";
     } else {
-      // change to the selected directory.  It should exist since it came from the dropdown,
-      // but check.
-      fullPath = "/" + dC;
+      // The selected directory should exist since it came from the dropdown.
+      uploadPath = "/" + dC;
     }
-    fullPath = fullPath + filename;
-    Serial.printf("Upload had dC = %s, nD = %s, fullPath = %s.\n", dC.c_str(), nD.c_str(), fullPath.c_str());
-    SDF.remove(fullPath);
+    uploadPath += filename;
+    Serial.printf("Upload to %s, %u bytes or fewer.\n", uploadPath.c_str(), request->contentLength());
+    openDownloads++;     // Logging stays paused until any downloads have ended too.
     pauseLogging(true);  // Do not interrupt during a log write, but pause it.
-  }
-  File32 file = SDF.open(fullPath, O_WRONLY | O_CREAT | O_APPEND);
-  file.seekEnd(0);  // Belt and suspenders.  Be sure we are at the end.
-  if (file) {
-    for (size_t i = 0; i < len; i++) {
-      file.write(data[i]);
+    uploadStart = millis();
+    // The request is a little longer than the file, and close() cuts off the rest.
+    if (!uploadFile.open(SDF, uploadPath.c_str(), request->contentLength())) {
+      outcome->error = "Could not create the file on CBASS.";
+      endUpload(false);
+      return;
     }
-    file.close();
-  } else {
-    Serial.printf("Failed to open destination %s on CBASS.\n", filename);
+    uploader = request;
+    // A client which goes away part way leaves no partial file behind.
+    request->onDisconnect([request]() {
+      if (uploader != request) return;
+      Serial.printf("Upload of %s abandoned.\n", uploadPath.c_str());
+      uploader = NULL;
+      endUpload(false);
+    });
   }
-  if (final) {
-    pauseLogging(false);
-    Serial.printf("UploadEnd: %s, %u B\n", fullPath.c_str(), index + len);
+  if (uploader != request) return;  // Refused, or failed already.
+  uploadFile.write(data, len);
+  if (!final && uploadFile.good()) return;
+
+  uploader = NULL;
+  if (!endUpload(final)) {
+    ((UploadOutcome *)request->_tempObject)->error = "Writing the file on CBASS failed.";
+    Serial.printf("Upload of %s failed after %u B.\n", uploadPath.c_str(), index + len);
+    return;
   }
+  unsigned long ms = max(millis() - uploadStart, 1UL);
+  uploads++;
+  uploadBytes = index + len;
+  uploadKBs = uploadBytes / 1.024 / ms;
+  Serial.printf("UploadEnd: %s, %u B in %lu ms, %.1f KB/s\n", uploadPath.c_str(), index + len, ms, uploadKBs);
+}
+
+/**
+ * Close the file from handleUpload(), remove it unless keep is true and it all
+ * reached the card, and let logging resume.  True if the file was kept.
+ */
+boolean endUpload(boolean keep) {
+  keep = uploadFile.close() && keep;
+  if (!keep) SDF.remove(uploadPath.c_str());
+  if (--openDownloads == 0) pauseLogging(false);
+  return keep;
 }
 
 /**
@@ -215,22 +447,22 @@ void handleUpload(AsyncWebServerRequest *request, String filename, size_t index,
  */
 void defineWebCallbacks() {
   Serial.print("Defining callbacks...");
+  compileTemplates();
+  // First, so it sees every request.  It never handles one.
+  server.addHandler(new KeepHeaders());
+
   // Root page
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
     Serial.println("Sending root web page.");
     p_title = "CBASS-32 Start Page";
-    AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", basePage, processor);
-    response->addHeader("Server", "ESP Async Web Server");
-    request->send(response);
+    sendPage(request, basePage, "text/html");
   });
 
   // About page
   server.on("/About", HTTP_GET, [](AsyncWebServerRequest *request) {
     Serial.println("Sending About page.");
     p_title = "About CBASS-32";
-    AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", aboutPage, processor);
-    response->addHeader("Server", "ESP Async Web Server");
-    request->send(response);
+    sendPage(request, aboutPage, "text/html");
   });
 
 
@@ -241,9 +473,7 @@ void defineWebCallbacks() {
   server.on("/LogManagement", HTTP_GET, [](AsyncWebServerRequest *request) {
     Serial.println("Sending log management page.");
     p_title = "CBASS-32 Log Management";
-    AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", logHTML, processor);
-    response->addHeader("Server", "ESP Async Web Server");
-    request->send(response);
+    sendPage(request, logHTML, "text/html");
   });
 
   // Roll over the log and let the user know the results.
@@ -255,9 +485,7 @@ void defineWebCallbacks() {
     int rCode = checkMagic(request, "");
 
     if (rCode != 200) {
-      AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", logHTML, processor);
-      response->addHeader("Server", "ESP Async Web Server");
-      request->send(response);
+      sendTemplate(request, 200, "text/html", logHTML);
       return;
     }
 
@@ -267,105 +495,109 @@ void defineWebCallbacks() {
     response->addHeader("Server", "ESP Async Web Server");
     request->send(response); */
     p_message = rollLog();
-    AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", logHTML, processor);
-    response->addHeader("Server", "ESP Async Web Server");
-    request->send(response);
+    sendTemplate(request, 200, "text/html", logHTML);
   });
 
   // Allow the user to synchroize CBASS time to their device.
   server.on("/SyncTime", HTTP_GET, [](AsyncWebServerRequest *request) {
     Serial.println("Synchronize time");
     p_title = "Synchronize CBASS Clock";
-    AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", syncTime, processor);
-    response->addHeader("Server", "ESP Async Web Server");
-    request->send(response);
+    sendPage(request, syncTime, "text/html");
   });
 
   // Javascript for the ramp plan
   server.on("/rampPlan.js", HTTP_GET, [](AsyncWebServerRequest *request) {
     Serial.println("Sending ramp plan plot javascript");
-    AsyncWebServerResponse *response = request->beginResponse_P(200, "text/javascript", rampPlanJavascript, processor);
-    response->addHeader("Server", "ESP Async Web Server");
-    request->send(response);
+    sendPage(request, rampPlanJavascript, "text/javascript");
   });
 
 
   /**
    * Part 1:
    * Receive data and update ramp plan
-   * WARNING: long request bodies will result in this being called more than once.  The
-   * user code is responsible for putting it back together. It breaks at arbitrary points, for
-   * example between digits of a number!
-   * 1620 bytes gets broken pretty close to the end.  Test with that much even though typical CBASS
-   * work will use less.  Maybe this is based on the typical 1500 byte ethernet packet?
+   * WARNING: long request bodies will result in this being called more than once.  They
+   * break at arbitrary points, for example between digits of a number!  Each piece goes
+   * straight to planUpload, which parses it as it comes (see PlanJSON.h).  After an error
+   * the rest of the body is ignored, and the message is sent once it has all arrived.
+   * One plan is received at a time.
    *
    * Note that this does not return a web page, just a message, so the usual HTML parts are omitted.
    */
   server.onRequestBody([](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
-    Serial.printf("Checking url for request body >%s<.\n", (request->url()).c_str());
-    if (request->url() == "/updateRampPlan") {
-      Serial.printf("In requestBody for updateRampPlan, len %d index %d total %d\n.", len, index, total);
-      // Is this the first part?
-      if (!index) {
-        postBuffer = "";  // This is a String.
-        Serial.printf("BodyStart: %u B\n", total);
-      }
-      // Save this chunk.
-      postBuffer += (const char *)data;
-      Serial.print("Latest buffer --->");
-      Serial.print(postBuffer);
-      Serial.println("<---");
-      for (size_t i = 0; i < len; i++) {
-        Serial.write(data[i]);
-      }
-      Serial.println();
-      // Have we got everything?
-      if (index + len == total) {
-        Serial.printf("BodyEnd: %u B\n", total);
-        AsyncResponseStream *response = request->beginResponseStream("text/html");
-
-        if (!receivePlanJSON(postBuffer, response)) {
-          // request->send(200, "text/plain", "false");
-          response->setCode(400);
-          request->send(response);
-        } else {
-          request->send(200, "text/plain", "true");
-        }
-        postBuffer = "";
+    if (request->url() != "/updateRampPlan") return;
+    if (index == 0) {
+      if (planUploader) {
+        Serial.println("Refused a ramp plan while another is being received.");
+        request->send(503, "application/json", "{\"msg\":\"Another ramp plan is being received.  Try again.\"}");
+        return;
       }
+      Serial.printf("Receiving a ramp plan of %u bytes.\n", total);
+      planUploader = request;
+      request->onDisconnect([request]() {
+        if (planUploader == request) planUploader = NULL;
+      });
+      planUpload.begin(total, MAX_RAMP_STEPS);
+    }
+    if (planUploader != request) return;  // Refused.
+    if (!planUpload.error) planUpload.feed(data, len);
+    if (index + len < total) return;
+
+    // Have we got everything?
+    planUploader = NULL;
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    if (!planUpload.finish()) {
+      Serial.printf("Ramp plan rejected at byte %u: %s\n", (unsigned)planUpload.errorAt, planUpload.error);
+      response->printf("{\"msg\":\"%s (at byte %u)\"}", planUpload.error, (unsigned)planUpload.errorAt);
+      response->setCode(400);
+    } else if (!receivePlanJSON(planUpload, response)) {
+      response->setCode(400);
+    } else {
+      response->print("true");
     }
+    request->send(response);
   });
 
   // Plot and monitor temperatures
   server.on("/Tchart.html", HTTP_GET, [](AsyncWebServerRequest *request) {
     Serial.println("Sending chart page.");
     p_title = "Temperature Monitor";
-    AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", plotlyHTML, processor);
-    response->addHeader("Server", "ESP Async Web Server");
-    request->send(response);
+    sendPage(request, plotlyHTML, "text/html");
   });
 
   // All stored temperature DataPoint values.
   // This will typically be whatever has accumulated since the last reboot, or
-  // 6 hours, whichever is less.  No processor() call is needed
-  // so we can just write to a stream.
+  // graphHours, whichever is less.  No template is needed, and the JSON
+  // is streamed from graphPoints by fillHistory() as the connection takes it.
+  // oldest and newest limit the time range, in millis() timestamps.  With
+  // maxPoints, a range holding more than that is thinned to about maxPoints.
+  // Once graphPoints no longer reaches back to oldest the answer comes from a
+  // coarser tier; see chooseHistoryTier().
   server.on("/runT", HTTP_GET, [](AsyncWebServerRequest *request) {
     //Serial.println("Sending temp history (server.on()).");
-    AsyncResponseStream *response = request->beginResponseStream("application/json");
-    response->addHeader("Server", "ESP CBASS-32");
     // If oldest is specified, we want only points that old or newer.  Get the value.
-    if (!request->hasParam("oldest")) {
-      sendXYHistory(response);
-    } else {
+    unsigned long oldest = 0;
+    if (request->hasParam("oldest")) {
       AsyncWebParameter *p = request->getParam("oldest");
       // Serial.printf("runT got oldest %s\n", p->value().c_str());
-      char *ptr;
-      sendXYHistory(response, strtoul(p->value().c_str(), &ptr, 10));  // Convert parameter to unsigned long, base 10.  ptr is required but not used here.
+      oldest = strtoul(p->value().c_str(), NULL, 10);  // Convert parameter to unsigned long, base 10.
     }
+    // The query state lives as long as the response, which may outlive this call.
+    std::shared_ptr<HistoryQuery> q = std::make_shared<HistoryQuery>(oldest);
+    if (request->hasParam("newest")) q->newest = strtoul(request->getParam("newest")->value().c_str(), NULL, 10);
+    chooseHistoryTier(*q);
+    if (request->hasParam("maxPoints")) decimateHistory(*q, request->getParam("maxPoints")->value().toInt());
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/json", [q](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+      return fillHistory(*q, buffer, maxLen);
+    });
+    response->addHeader("Server", "ESP CBASS-32");
     request->send(response);
     // Serial.print("Sent to "); Serial.println(request->client()->remoteIP());
   });
 
+  // New temperature DataPoints pushed to the chart page as they are stored.
+  events.onConnect(replayPoints);
+  server.addHandler(&events);
+
 
 
 
@@ -385,16 +617,14 @@ void defineWebCallbacks() {
       //ESP.restart();
       return;
     }
-    request->send_P(rCode, "text/html", rebootPage, processor);   
+    sendTemplate(request, rCode, "text/html", rebootPage);   
   });
 
   server.on("/AfterReboot", HTTP_GET, [](AsyncWebServerRequest *request) {
     Serial.println("Rebooted by Web request!");
     Serial.flush();
     p_title = "CBASS-32 Reboot In Progress";
-    AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", rebootHTML, processor);
-    response->addHeader("Server", "ESP Async Web Server");
-    request->send(response);
+    sendTemplate(request, 200, "text/html", rebootHTML);
   });
 
   // Update CBASS time from the user's device.
@@ -458,9 +688,7 @@ void defineWebCallbacks() {
     }
     p_title = "Directory Listing";
 
-    AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", dirListHTML, processor);
-    response->addHeader("Server", "ESP CBASS-32");
-    request->send(response);
+    sendPage(request, dirListHTML, "text/html");
   });
 
   // Display and edit the ramp plan.
@@ -502,43 +730,43 @@ void defineWebCallbacks() {
         rCode = 500;
       }
     }
-    request->send_P(rCode, "text/html", iniResetPage, processor);
+    sendTemplate(request, rCode, "text/html", iniResetPage);
   });
 
   /**
    * Note that his sends a file for download, so it doesn't have html code processing.
    */
-  //  Chunked response - my function will provide the chunks using the SdFat library.
+  //  Streamed response - sendSDFile() provides the pieces using the SdFat library.
   server.on("/LogDownload", HTTP_GET, [](AsyncWebServerRequest *request) {
-    fileChunkPos = 0;  // Lets the function know to start at zero.
     p_message = "";
 
     int rCode = checkMagic(request);
 
     if (rCode != 200) {
       // Send the management page with the message set above.
-      AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", logHTML, processor);
-      response->addHeader("Server", "ESP Async Web Server");
-      request->send(response);
+      sendTemplate(request, 200, "text/html", logHTML);
       return;
     }
 
     Serial.println("In LogDownload call.");
-    fileChunkPos = 0;  // Start at byte zero - this should already be set.
-
-    // The original sendChunked approach did not allow adding a header. Now we can set the desired .csv extension.
-    AsyncWebServerResponse *response = request->beginChunkedResponse("text/plain", [](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
-      //Write up to "maxLen" bytes into "buffer" and return the amount written.
-      //index equals the amount of bytes that have been already sent
-      //You will be asked for more data until 0 is returned
-      //Keep in mind that you can not delay or yield waiting for more data!
-      return fileChunks((uint8_t *)buffer, maxLen, "/LOG.txt");
-    });
-    response->addHeader("Server", "ESP Async Web Server");
-    response->addHeader("Content-Disposition", "attachment; filename=\"LogDownload.csv\"");
-    request->send(response);
+    // Set the desired .csv extension.  Logging pauses until the download ends.
+    if (binaryLog) sendBinaryLog(request);
+    else sendSDFile(request, "/LOG.txt", "text/plain", "LogDownload.csv");
+  });
 
-    pauseLogging(false);  // Normally set false in the last logChunks call, but verify.
+  // Part of the log, from and to as sendLogRange() takes them.  Either may be left out.
+  server.on("/LogRange", HTTP_GET, [](AsyncWebServerRequest *request) {
+    p_message = "";
+    if (checkMagic(request) != 200) {
+      sendTemplate(request, 200, "text/html", logHTML);
+      return;
+    }
+    uint32_t from = 0, to = UINT32_MAX;
+    if (!logTimeParam(request, "from", from) || !logTimeParam(request, "to", to)) {
+      request->send(400, "text/plain", "from and to must be Unix seconds or YYYY-MM-DDThh:mm:ss.");
+      return;
+    }
+    sendLogRange(request, from, to);
   });
 
 // File upload
@@ -546,9 +774,7 @@ void defineWebCallbacks() {
   server.on("/UploadPage", HTTP_GET, [](AsyncWebServerRequest *request) {
     Serial.println("Sending upload page.");
     p_title = "File Upload";
-    AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", uploadHTML, processor);
-    response->addHeader("Server", "ESP Async Web Server");
-    request->send(response);
+    sendPage(request, uploadHTML, "text/html");
   });
 
 
@@ -558,7 +784,6 @@ void defineWebCallbacks() {
    */
   server.on(
     "/Upload", HTTP_POST, [](AsyncWebServerRequest *request) {
-      AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", uploadSuccess, processor);
       Serial.println("In first response section of /Upload");
       int params = request->params();
       for (int i = 0; i < params; i++) {
@@ -572,23 +797,24 @@ void defineWebCallbacks() {
         }
       }
       Serial.println("End parameters (upper)");
-      request->send(response);
+      UploadOutcome *outcome = (UploadOutcome *)request->_tempObject;
+      if (!outcome) {
+        request->send(503, "text/plain", "Another upload is being received.  Try again.");
+      } else if (outcome->error) {
+        request->send(500, "text/plain", outcome->error);
+      } else {
+        sendTemplate(request, 200, "text/html", uploadSuccess);
+      }
     },
     handleUpload
   );
 #endif
 
 
-  //  Chunked response - my function will provide the chunks using the SdFat library.
+  //  Streamed from SD like the log.
   server.on("/32Board.png", HTTP_GET, [](AsyncWebServerRequest *request) {
     Serial.println("Sending board image.");
-    fileChunkPos = 0;  // Start at byte zero - this should already be set.
-    request->sendChunked(
-      "image/png",
-      [](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
-        // Generate some data
-        return fileChunks((uint8_t *)buffer, maxLen, "/htdocsSD/32Board.png");
-      });
+    sendSDFile(request, "/htdocsSD/32Board.png", "image/png", NULL);
   });
 
   /**
@@ -600,8 +826,11 @@ void defineWebCallbacks() {
    *
    * NOTE: Having this near the top of the list makes ALL calls slow!
    * Surprisingly, moving it here speeds everything up, even things served statically.
+   *
+   * StaticFiles replaces serveStatic() so a .gz copy is sent only to browsers which
+   * accept gzip.  plotly.js.gz is a third the size of plotly.js.  See StaticFiles.h.
    */
-  server.serveStatic("/", SPIFFS, "/htdocs/").setCacheControl("max-age=3600");  // for a full day: 86400");
+  server.addHandler(new StaticFiles(SPIFFS, "/htdocs", "max-age=3600"));  // for a full day: 86400");
 
   server.onNotFound([](AsyncWebServerRequest *request) {
     request->send(404, "text/plain", "Not found on this reef.");
@@ -611,15 +840,19 @@ void defineWebCallbacks() {
 
 
 /**
- * Copy the current LOG.txt file to a backup directory.
+ * Move the current LOG.txt (or LOG.bin) file to a backup directory.
  * A new empty log file will be automatically created
  * the next time a log line is added.
  *
+ * The file is renamed, not copied, so this takes the same few milliseconds
+ * however large the log has grown.  It runs from the web page and from
+ * logTask when LOGROLLKB or LOGROLLTIME in Settings.ini call for it.
+ *
  * The log copy will be timestamped in two ways.  It has proven
  * impractical to set a timestamp in the filesystem.  Also, filenames
  * of more than 8 characters (dot) 3 characters are no fully supported.
  * This is what will happen.
- * 1) A file name will be generated in the format YMDDHHMM.txt
+ * 1) A file name will be generated in the format YMDDHHMM.txt (.bin for a binary log)
  *    Y is the last digit of the current year.
  *    M is the month, written as 1-9, A, B, C for the 12 months.
  *    DD is the day of the month, zero padded
@@ -627,70 +860,99 @@ void defineWebCallbacks() {
  *    MM is the minute, 00 to 59
  *    This rather cryptic system will allow default alphabetization to put
  *    the files in time order.
- * 2) A last line will be appended to the file stating the rollover time in a normal format.
+ * 2) A last line will be appended to a text log stating the rollover time in a normal format.
  *
  * An early version appended text to the response stream, but not build a single String
- * of output so this can be inserted by the processor().
+ * of output so this can be inserted by the ~ROLLLOG~ fill function.
  */
 String rollLog() {
   String result;
-  // Generate the new file name.
-  t = rtc.now();
+  unsigned long started = millis();
+  // Held from the name checks to the rename, so a web and an automatic rollover can't pick the same name.
+  xSemaphoreTake(rollMutex, portMAX_DELAY);
+  // Generate the new file name.  Not in the global t, which belongs to controlTask.
+  DateTime now = rtc.now();
   // Year
   String newName = String("/SaveLogs/");
-  newName += String(t.year() % 10);
+  newName += String(now.year() % 10);
   // Month 1-9, A, B, C
-  if (t.month() < 10) {
-    newName += String(t.month());
+  if (now.month() < 10) {
+    newName += String(now.month());
   } else {
     // Cast to char is critical, or it prints the ASCII value as decimal.
-    newName += String((char)('A' + t.month() - 10));
+    newName += String((char)('A' + now.month() - 10));
   }
   // Day, hour, and minutes are all 2 digits, zero padded.
   char buffer[64];  // Long enough for either the new file name (12+1 characters) or the human-friendly time and text later on.
-  sprintf(buffer, "%02d%02d%02d.txt", t.day(), t.hour(), t.minute());
+  sprintf(buffer, "%02d%02d%02d.%s", now.day(), now.hour(), now.minute(), binaryLog ? "bin" : "txt");
   newName += String(buffer);
 
-  // Copy LOG.txt to the new name.  First be sure the directory is there.
-  if (!SDF.exists("/SaveLogs")) {
-    if (!SDF.mkdir("/SaveLogs")) {
-      Serial.println("ERROR: Failed to make a log archive directory.  Abandoning log rollover!");
-      result = "Failed to roll over the log.  Could not find or created directory /SaveLogs.";
-      return result;
-    }
+  // Move the log to the new name.  First be sure the directory is there.
+  if (!SDF.exists("/SaveLogs") && !SDF.mkdir("/SaveLogs")) {
+    Serial.println("ERROR: Failed to make a log archive directory.  Abandoning log rollover!");
+    result = "Failed to roll over the log.  Could not find or created directory /SaveLogs.";
+    return rollLogFailed(result, now);
+  }
+  if (SDF.exists(newName.c_str())) {
+    result = "The log was already archived this minute as " + newName + ".  Try again later.";
+    return rollLogFailed(result, now);
   }
 
   // Important: make sure there's no conflict between this an ongoing logging.
+  // This also writes out and closes the log.
   pauseLogging(true);
-  delay(40);  // Probably not necessary, but allow any in-progress log line to complete.  A timing gave 2088 ms for 100 rapidly-sent log lines.
-
-  if (myFileCopy("/LOG.txt", newName.c_str())) {
-    SDF.remove("/LOG.txt");
-    // Re-open the copy and append a message about the save date.
-    Serial.println("Appending date and time to archived log file.");
-    File32 newFile = SDF.open(newName.c_str(), O_WRONLY | O_CREAT | O_APPEND);
-    newFile.seekEnd(0);
-    sprintf(buffer, "archived on %s at %s local CBASS time.\n", getdate(t).c_str(), gettime(t).c_str());
-    newFile.printf("\nThis file was %s", buffer);
-    newFile.close();
-    result = "Log copy was ";
+
+  sprintf(buffer, "archived on %s at %s local CBASS time.", getdate(now).c_str(), gettime(now).c_str());
+  // Note the save date at the end of the log.  A binary log is left as it is so it
+  // can still be read.
+  if (!binaryLog) {
+    String note = String("\nThis file was ") + buffer + "\n";
+    logWriter.append(note.c_str(), note.length());
+    logWriter.close();
+  }
+  bool renamed = SDF.rename(logWriter.getPath(), newName.c_str());
+  if (renamed) {
+    result = "Log was ";
     result += buffer;
+    result += " It is now " + newName + String(", moved in ") + String(millis() - started) + " ms.";
     Serial.println(result);
+    logIndex.clear();
   } else {
-    result = "Log copy.  The original is unchanged.";
+    result = "Failed to rename the log.  It will continue as before.";
   }
-  pauseLogging(false);
-
-  //TODO HERE - this works, but could use some error checking.  Also, only an empty page is returned!
-
   // Ensure that the next logging call will include a header.
   SerialOutCount = serialHeaderPeriod + 1;
+  pauseLogging(false);
+  if (!renamed) return rollLogFailed(result, now);
+  logRollRetry = 0;
+  xSemaphoreGive(rollMutex);
+  return result;
+}
 
+/**
+ * End a rollLog() which left the log where it was.  LOGROLLKB would otherwise call for
+ * another try with every log line, so it waits LOGrollRetrySeconds first.  Releases rollMutex.
+ */
+String rollLogFailed(const String &result, const DateTime &now) {
+  logRollRetry = now.unixtime() + LOGrollRetrySeconds;
+  xSemaphoreGive(rollMutex);
   return result;
 }
 
 /**
- * Send out all accumulated temperature data points as JSON.  
+ * Send accumulated temperature data points as JSON, a piece at a time.
+ * The web server calls this with its own buffer whenever the connection can
+ * take more data, and the response ends when it returns 0.  Nothing is built
+ * up in memory, so the whole history can go out in one response.
+ *
+ * Each call fills the buffer but stops early after historySliceMs so other web
+ * requests get a turn.  If the whole response takes more than historyBudgetMs
+ * the points list is closed early and "next" gives the timestamp to pass as
+ * "oldest" to get the rest, e.g. ...}},"next":123456}
+ * A response thinned by decimateHistory() ends with the bucket width, as in
+ * ...}},"bucketMs":60000}
+ * One from a coarser tier ends with its period, and with "next" so the client
+ * asks again for the finer points since, as in ...}},"next":123456,"periodMs":600000}
  *
  * New DataPoint format:
  * "54492":{"datetime":[2024-04-11T16:29:51],"target":[24.00,24.00,24.00,24.00],"actual":[23.44,23.81,23.62,23.69]}
@@ -702,65 +964,243 @@ String rollLog() {
   }
 }
  */
-void sendXYHistory(AsyncResponseStream *rs, unsigned long oldest) { /* oldest default 0 is in forward declaration */
-  esp_task_wdt_reset();                                             // Not sure if timeouts are an issue here, but be safer.
-  short debug = 0;
-  long unsigned startSend;
-  if (debug) startSend = millis();
-  // Too large a response can hang the system.  Send no more than this many of the oldest lines.
-  // 1000 points move in about 370 ms in testing, allowing for one check per second with plenty of
-  // slack.  Once caught up the batches become much smaller.
-  const int maxBatch = 1000;  // If this doesn't finish before the next call it causes a reboot.  SOLVE THIS! XXX
-  int i;
-  int start = 0;
-  // Default to all points, but if "oldest" is specifed return only points from that
-  // timestamp or later.  This is not very efficient, but normally we will be
-  // returning all points (oldest == 0) or just a few.
-  // Times as 0 ms, so leave it as is.
-  if (oldest > 0) {
-    for (i = graphPoints.size() - 1; i >= 0; i--) {
-      if (graphPoints[i].timestamp >= oldest) {
-        start = i;
+const unsigned long historySliceMs = 20;     // Longest time spent in one call.
+const unsigned long historyBudgetMs = 20000; // Longest time for the whole response.
+
+size_t fillHistory(HistoryQuery &q, uint8_t *buffer, size_t maxLen) {
+  size_t n = 0;
+  unsigned long sliceStart = millis();
+  while (n < maxLen) {
+    // Copy out anything already formatted.
+    if (q.pendingPos < q.pendingLen) {
+      size_t c = min((size_t)(q.pendingLen - q.pendingPos), maxLen - n);
+      memcpy(buffer + n, q.pending + q.pendingPos, c);
+      q.pendingPos += c;
+      n += c;
+      continue;
+    }
+    q.pendingLen = q.pendingPos = 0;
+    if (q.phase == 0) {
+      q.pendingLen = sprintf(q.pending, "{\"NT\":%d,\"points\":{", NT);
+      q.phase = 1;
+    } else if (q.phase == 1) {
+      if (millis() - q.started > historyBudgetMs) {
+        q.truncated = true;
+        q.phase = 2;
+        continue;
+      }
+      if (n > 0 && millis() - sliceStart > historySliceMs) break;  // Let other requests run.
+      // Search again on each point since graphPoints may have shifted.
+      // Hold graphMutex so graphTask can't replace the point while it is copied.
+      xSemaphoreTake(graphMutex, portMAX_DELAY);
+      bool found;
+      if (q.tier == 2) {
+        size_t i = firstAtOrAfter(graphTenMinutes, q.next);
+        found = i < graphTenMinutes.size() && graphTenMinutes[i].timestamp <= q.newest;
+        if (found) {
+          if (!q.first) q.pending[q.pendingLen++] = ',';
+          q.pendingLen += rollupToChars(graphTenMinutes[i], q.pending + q.pendingLen);
+          q.next = graphTenMinutes[i].timestamp + 1;
+          q.first = false;
+        }
       } else {
-        break;
+        found = historyStep(q, q.tier == 1 ? graphMinutes : graphPoints);
       }
-    }
-    if (start == 0) {
-      // No points need sending.  Do not start at zero in this case!
-      rs->printf("{\"NT\":%d,\"points\":{}}", NT);
-      if (debug) Serial.printf("Nothing to send.  Oldest was %8d, last graphPoint %d\n", oldest, graphPoints[graphPoints.size() - 1].timestamp);
-      return;
+      xSemaphoreGive(graphMutex);
+      if (!found) {
+        q.phase = 2;
+        continue;
+      }
+    } else if (q.phase == 2) {
+      q.pendingLen = sprintf(q.pending, "}");
+      if (q.truncated || (q.tier && !q.first)) q.pendingLen += sprintf(q.pending + q.pendingLen, ",\"next\":%lu", q.next);
+      if (q.bucketMs) q.pendingLen += sprintf(q.pending + q.pendingLen, ",\"bucketMs\":%lu", q.bucketMs);
+      if (q.tier) q.pendingLen += sprintf(q.pending + q.pendingLen, ",\"periodMs\":%d", q.tier == 1 ? 60000 : 600000);
+      q.pendingLen += sprintf(q.pending + q.pendingLen, "}");
+      q.phase = 3;
+    } else {
+      break;
     }
   }
-  rs->printf("{\"NT\":%d,\"points\":{", NT);
-  int end = min((int)graphPoints.size(), start + maxBatch);
-  // Is it the rs-> lines that are slow?  Faster to batch the strings?  YES!
-  /*
-  for (int i=start; i<end; i++) {
-    rs->print(dataPointToJSON(graphPoints[i]));
-    if (i < end-1) rs->print(",");
-  } */
-  String pp[20];
-  int sCount = 0;
-  for (int i = start; i < end; i++) {
-    pp[sCount] = dataPointToJSON(graphPoints[i]);
-    sCount++;
-    if (sCount == 20) {
-      // Tedious, but much faster than sending one at a time.
-      if (i == end - 1) rs->printf("%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s", pp[0].c_str(), pp[1].c_str(), pp[2].c_str(), pp[3].c_str(), pp[4].c_str(), pp[5].c_str(), pp[6].c_str(), pp[7].c_str(), pp[8].c_str(), pp[9].c_str(), pp[10].c_str(), pp[11].c_str(), pp[12].c_str(), pp[13].c_str(), pp[14].c_str(), pp[15].c_str(), pp[16].c_str(), pp[17].c_str(), pp[18].c_str(), pp[19].c_str());
-      else rs->printf("%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,", pp[0].c_str(), pp[1].c_str(), pp[2].c_str(), pp[3].c_str(), pp[4].c_str(), pp[5].c_str(), pp[6].c_str(), pp[7].c_str(), pp[8].c_str(), pp[9].c_str(), pp[10].c_str(), pp[11].c_str(), pp[12].c_str(), pp[13].c_str(), pp[14].c_str(), pp[15].c_str(), pp[16].c_str(), pp[17].c_str(), pp[18].c_str(), pp[19].c_str());
-      sCount = 0;
+  return n;
+}
+
+/**
+ * Format the next point, or bucket of points, of ring for q.  False when
+ * there are no more.  Caller holds graphMutex.
+ */
+bool historyStep(HistoryQuery &q, const RingBuffer<DataPoint> &ring) {
+  size_t i = firstAtOrAfter(ring, q.next);
+  if (i >= ring.size() || ring[i].timestamp > q.newest) return false;
+  const DataPoint &p = ring[i];
+  if (!q.first) q.pending[q.pendingLen++] = ',';
+  if (q.bucketMs) {
+    // The rest of p's bucket, up to newest.
+    unsigned long bucketEnd = q.from + ((p.timestamp - q.from) / q.bucketMs + 1) * q.bucketMs;
+    size_t end = i + 1;
+    while (end < ring.size() && ring[end].timestamp < bucketEnd && ring[end].timestamp <= q.newest) end++;
+    q.pendingLen += bucketToChars(ring, i, end, q.pending + q.pendingLen);
+    q.next = bucketEnd;
+  } else {
+    q.pendingLen += dataPointToChars(p, q.pending + q.pendingLen);
+    q.next = p.timestamp + 1;
+  }
+  q.first = false;
+  return true;
+}
+
+/**
+ * Answer q from the finest tier of history which still reaches back to
+ * q.next: one holding everything since boot, or whose oldest point is no
+ * newer.  Failing both, the ten minute tier, which reaches back furthest.
+ */
+void chooseHistoryTier(HistoryQuery &q) {
+  xSemaphoreTake(graphMutex, portMAX_DELAY);
+  if (!graphPoints.full() || graphPoints[0].timestamp <= q.next) q.tier = 0;
+  else if (!graphMinutes.full() || graphMinutes[0].timestamp <= q.next) q.tier = 1;
+  else q.tier = 2;
+  xSemaphoreGive(graphMutex);
+}
+
+/**
+ * Thin a /runT response to at most maxPoints points, if its range holds more.
+ * The range is cut into maxPoints / 2 buckets of equal time, and each bucket
+ * is sent as two points by bucketToChars().  fillHistory() then works through
+ * it one bucket per step, so the cost is still spread over many calls, and a
+ * bucket costs one scan of its points rather than one formatted point each.
+ *
+ * Min/max buckets were chosen over Largest-Triangle-Three-Buckets because a
+ * short excursion from the set point is what a chart of a heat stress
+ * experiment must not hide, and LTTB keeps at most one point of it.  Each
+ * bucket also stands alone, where LTTB looks at the next one.
+ *
+ * The ten minute tier is never thinned: it already carries its own lows and
+ * highs, and two weeks of it is 2016 points.
+ */
+void decimateHistory(HistoryQuery &q, unsigned int maxPoints) {
+  if (maxPoints < 2 || q.tier == 2) return;
+  xSemaphoreTake(graphMutex, portMAX_DELAY);
+  const RingBuffer<DataPoint> &ring = q.tier == 1 ? graphMinutes : graphPoints;
+  size_t first = firstAtOrAfter(ring, q.next);
+  size_t end = (q.newest == ULONG_MAX) ? ring.size() : firstAtOrAfter(ring, q.newest + 1);
+  if (end > first && end - first > maxPoints) {
+    q.from = ring[first].timestamp;
+    unsigned long span = ring[end - 1].timestamp - q.from + 1;
+    unsigned long buckets = maxPoints / 2;
+    q.bucketMs = (span + buckets - 1) / buckets;
+  }
+  xSemaphoreGive(graphMutex);
+}
+
+/**
+ * Format ring[first] to ring[end - 1] as at most two points, the first and
+ * last times of the bucket.  Each tank's lowest and highest actual
+ * temperature go to those two in the order they happened, so the line still
+ * reaches both, and likewise its targets.  Caller holds graphMutex.
+ */
+int bucketToChars(const RingBuffer<DataPoint> &ring, size_t first, size_t end, char *buf) {
+  if (end - first == 1) return dataPointToChars(ring[first], buf);
+  DataPoint a = ring[first], b = ring[end - 1];
+  for (int t = 0; t < NT; t++) {
+    size_t lo = first, hi = first, tlo = first, thi = first;
+    for (size_t j = first + 1; j < end; j++) {
+      const DataPoint &p = ring[j];
+      if (p.actual[t] < ring[lo].actual[t]) lo = j;
+      if (p.actual[t] > ring[hi].actual[t]) hi = j;
+      if (p.target[t] < ring[tlo].target[t]) tlo = j;
+      if (p.target[t] > ring[thi].target[t]) thi = j;
     }
+    a.actual[t] = ring[min(lo, hi)].actual[t];
+    b.actual[t] = ring[max(lo, hi)].actual[t];
+    a.target[t] = ring[min(tlo, thi)].target[t];
+    b.target[t] = ring[max(tlo, thi)].target[t];
   }
+  int n = dataPointToChars(a, buf);
+  buf[n++] = ',';
+  return n + dataPointToChars(b, buf + n);
+}
+
+/**
+ * The index in graphPoints of the first point with timestamp >= oldest, or
+ * graphPoints.size() if there is none.  Points are in time order, so this is
+ * a binary search.
+ */
+size_t firstPointAtOrAfter(unsigned long oldest) {
+  return firstAtOrAfter(graphPoints, oldest);
+}
 
-  // Send any remaining items in the set.
-  for (int i = 0; i < sCount; i++) {
-    rs->print(pp[i]);
-    if (i < sCount - 1) rs->print(",");
+/**
+ * Server-sent events on /events carry each new DataPoint to open chart pages
+ * as graphTask stores it.  The work is one message per point however many
+ * pages are open, where polling /runT cost a request per page every few
+ * seconds.
+ *
+ * A "points" event holds the same JSON as /runT, and its id is the timestamp
+ * of its last point.  A browser which loses the connection reconnects by
+ * itself after eventRetryMs and sends that id as Last-Event-ID, and
+ * replayPoints() sends what it missed.  A new connection gets the last
+ * eventReplayMs of points, which covers anything stored since the page's
+ * /runT request; the page skips points it already has.  If more is missing
+ * than the library can queue (32 messages per client), a "resync" event asks
+ * the page to catch up through /runT and connect again.
+ */
+const unsigned long eventReplayMs = 60000;  // Replayed to a connection with no Last-Event-ID.
+const size_t eventBatchPoints = 24;         // Points per replayed event.
+const size_t eventReplayMax = 20 * eventBatchPoints;
+const uint32_t eventRetryMs = 3000;         // Browser reconnect delay.
+
+// Called by graphTask once it has released graphMutex.  events.send() takes the library's
+// client lock, which it also holds while replayPoints() runs and waits for graphMutex.
+void pushGraphPoint(const DataPoint &p) {
+  if (events.count() == 0) return;
+  char buf[240];
+  int n = sprintf(buf, "{\"NT\":%d,\"points\":{", NT);
+  n += dataPointToChars(p, buf + n);
+  strcpy(buf + n, "}}");
+  events.send(buf, "points", p.timestamp);
+}
+
+// The onConnect callback for /events.  Each batch is formatted under graphMutex and sent
+// after it is released, as for pushGraphPoint().  A point pushed meanwhile may arrive
+// twice, and the page skips the copy by its timestamp.
+void replayPoints(AsyncEventSourceClient *client) {
+  client->send("connected", "hello", 0, eventRetryMs);
+  char *buf = (char *)malloc(eventBatchPoints * 200 + 40);
+  bool resync = buf == NULL;
+  unsigned long from = 0;
+  if (!resync) {
+    xSemaphoreTake(graphMutex, portMAX_DELAY);
+    unsigned long newest = graphPoints.empty() ? 0 : graphPoints.back().timestamp;
+    if (client->lastId() == 0) from = newest > eventReplayMs ? newest - eventReplayMs : 0;
+    else from = client->lastId() + 1;
+    size_t i = firstPointAtOrAfter(from);
+    // Too far behind, dropped from graphPoints, or from before a reboot.
+    resync = client->lastId() > newest || graphPoints.size() - i > eventReplayMax ||
+             (client->lastId() && i == 0 && !graphPoints.empty() && graphPoints[0].timestamp > from);
+    xSemaphoreGive(graphMutex);
+  }
+  if (resync) {
+    free(buf);
+    client->send("{}", "resync");
+    return;
+  }
+  for (;;) {
+    xSemaphoreTake(graphMutex, portMAX_DELAY);
+    size_t i = firstPointAtOrAfter(from);
+    size_t end = min(i + eventBatchPoints, graphPoints.size());
+    unsigned long last = end > i ? graphPoints[end - 1].timestamp : 0;
+    int n = sprintf(buf, "{\"NT\":%d,\"points\":{", NT);
+    for (size_t j = i; j < end; j++) {
+      if (j > i) buf[n++] = ',';
+      n += dataPointToChars(graphPoints[j], buf + n);
+    }
+    strcpy(buf + n, "}}");
+    xSemaphoreGive(graphMutex);
+    if (end == i) break;
+    client->send(buf, "points", last);
+    from = last + 1;
   }
-  rs->print("}}");  // Close points list and the overall JSON string.
-  esp_task_wdt_reset();
-  if (debug) Serial.printf("Sent %5d points in %4lu ms (cumulative).  Max was %4d.  Oldest was %8d Start was %5d  %7d s runtime.\n", end - start, millis() - startSend, maxBatch, oldest, start, (int)(millis() / 1000));
+  free(buf);
 }
 
 /**
@@ -768,32 +1208,30 @@ void sendXYHistory(AsyncResponseStream *rs, unsigned long oldest) { /* oldest de
  * Originally this received a stream to write to and a path to examine.  Now the path
  * is a global and this returns a String.
  */
-String sendFileInfo() {
+void sendFileInfo(Print &out) {
   // dirPath is a global containing the directory to list.
-  Serial.print("In sendFileInfo.\n");
   if (strlen(dirPath) == 0) {
-    return String("No path, or the specified path is too long.");
+    out.print("No path, or the specified path is too long.");
+    return;
   }
-  const int maxOutputBuffer = 2048;
-  char outputBuffer[maxOutputBuffer];  // The ugly process of building a String using sprintf or snprintf needs a buffer.
   pauseLogging(true);
   File32 root;
   root.open(dirPath);
   if (!root) {
     Serial.printf("Path >%s< not opened.\n", dirPath);
-    sprintf(outputBuffer, "The specified path, \"%s\" could not be opened.", dirPath);
+    out.printf("The specified path, \"%s\" could not be opened.", dirPath);
     pauseLogging(false);
-    return String(outputBuffer);
+    return;
   }
   if (!root.isDirectory()) {
     Serial.printf("Path >%s< is not a directory.\n", dirPath);
-    sprintf(outputBuffer, "The specified path, \"%s\" is not a directory.", dirPath);
+    out.printf("The specified path, \"%s\" is not a directory.", dirPath);
     pauseLogging(false);
-    return String(outputBuffer);
+    return;
   }
 
   // The output is a table with one row per file (and .. if a subdirectory)
-  String rString = "<div class=\"wrapper flex fittwowide\"><table><tr><th>Type</th><th>Name</th><th>Size</th></tr>\n";
+  out.print("<div class=\"wrapper flex fittwowide\"><table><tr><th>Type</th><th>Name</th><th>Size</th></tr>\n");
 
   // Enable going up a level if not already at the top
   if (strlen(dirPath) > 1) {
@@ -802,16 +1240,15 @@ String sendFileInfo() {
     int pos = last - dirPath;
     if (pos == 0) {
       // Going to root, no parameter needed.
-      sprintf(outputBuffer, "<tr><td>UP</td><td><a href=\"http://%s/files\">..</a></td></tr>\n", myIP.toString().c_str());
+      out.printf("<tr><td>UP</td><td><a href=\"http://%s/files\">..</a></td></tr>\n", myIP.toString().c_str());
     } else {
       //Serial.printf("Adding up line with last of %s, pos = %d\n", last, pos);
       char sub[1 + strlen(dirPath)];  // Size for anything <= the full path.
       strncpy(sub, dirPath, pos);
       sub[pos] = '\0';  // strncpy doesn't do this automatically!
-      sprintf(outputBuffer, "<tr><td>UP</td><td><a href=\"http://%s/files?path=%s\">..</a></td></tr>\n",
-              myIP.toString().c_str(), sub);
+      out.printf("<tr><td>UP</td><td><a href=\"http://%s/files?path=%s\">..</a></td></tr>\n",
+                 myIP.toString().c_str(), sub);
     }
-    rString += String(outputBuffer);
   }
 
   // SD.h way: File32 file = root.openNextFile();
@@ -824,9 +1261,9 @@ String sendFileInfo() {
       Serial.print("  DIR : ");
       Serial.println(fnBuffer);
       if (strlen(dirPath) > 1) {
-        sprintf(outputBuffer, "<tr><td>DIR</td><td><a href=\"http://%s/files?path=%s/%s\">%s</a></td></tr>\n", myIP.toString().c_str(), dirPath, fnBuffer, fnBuffer);
+        out.printf("<tr><td>DIR</td><td><a href=\"http://%s/files?path=%s/%s\">%s</a></td></tr>\n", myIP.toString().c_str(), dirPath, fnBuffer, fnBuffer);
       } else {
-        sprintf(outputBuffer, "<tr><td>DIR</td><td><a href=\"http://%s/files?path=/%s\">%s</a></td></tr>\n", myIP.toString().c_str(), fnBuffer, fnBuffer);
+        out.printf("<tr><td>DIR</td><td><a href=\"http://%s/files?path=/%s\">%s</a></td></tr>\n", myIP.toString().c_str(), fnBuffer, fnBuffer);
       }
     } else {
       Serial.print("  FILE: ");
@@ -837,20 +1274,15 @@ String sendFileInfo() {
       // set them as files are created!!!
       // time_t tt = file.getLastWrite();  // Returns seconds from 1970, but DateTime uses 2000.
 
-      sprintf(outputBuffer, "<tr><td>FILE</td><td>%s</td><td>%d</td></tr>\n", fnBuffer, file.size());
+      out.printf("<tr><td>FILE</td><td>%s</td><td>%d</td></tr>\n", fnBuffer, file.size());
     }
-    rString += String(outputBuffer);
     // SD.h way: file = root.openNextFile();
     file.close();  // Even though we call a method on file once each pass, examples close it each time.
   }
-  rString += "</table></div>\n";
+  out.print("</table></div>\n");
   file.close();
   root.close();
   pauseLogging(false);
-
-  //Serial.println("Before return, rString is:");
-  //Serial.println(rString);
-  return rString;
 }
 
 /**
@@ -902,13 +1334,17 @@ void sendRampForm(AsyncResponseStream *rs) {
   for (j = 0; j < NT; j++) rs->printf("<th>Tank %d</th>", (j + 1));
   rs->println("</tr>");
 
-  for (short k = 0; k < rampSteps; k++) {
+  // A PLANFILE plan is too long to show, so this is only the steps near now.  Saving
+  // the table replaces it with a plan in Settings.ini.
+  xSemaphoreTake(rampMutex, portMAX_DELAY);
+  const RampPlan &shown = rampStream.isActive() ? rampStream.window() : rampPlan;
+  for (size_t k = 0; k < shown.size(); k++) {
     rs->print("<tr><td contenteditable=\"true\" class=\"time\" onblur=\"validateCellTime(this)\">");
-    sendAsHM(rampMinutes[k], rs);
+    sendAsHM(shown.minutes(k), rs);
     rs->print("</td>");
     for (j = 0; j < NT; j++) {
       rs->print("<td contenteditable=\"true\" class=\"temperature\" onblur=\"validateCellTemp(this)\">");
-      rs->print(((double)(rampHundredths[j][k]) / 100.0), 1);
+      rs->print(((double)(shown.hundredths(j, k)) / 100.0), 1);
       rs->print("</td>");
     }
     //  Here we add icons to add or remove rows.  Don't allow the first to be deleted, and keep at least 2.
@@ -919,6 +1355,7 @@ void sendRampForm(AsyncResponseStream *rs) {
     }
     rs->println("</tr>");
   }
+  xSemaphoreGive(rampMutex);
 
   rs->println("</table></div>");
   rs->print("<div id=\"rgraph\" class=\"wrapper flex fittwowide\"></div>");
@@ -959,7 +1396,8 @@ void sendRampForm(AsyncResponseStream *rs) {
     rs->println("Times in the ramp plan represent time of day.<br>");
   }
 
-  rs->println(manualProcess(linkList));
+  pageTemplate(linkList).printTo(*rs);
+  rs->println();
   rs->println("</div></body></html>");
 }
 
@@ -974,131 +1412,39 @@ void sendAsHM(unsigned int t, AsyncResponseStream *rs) {
 
 
 /**
- * This receives the data from a ramp plan update request.  It is parsed and validated,
- * and if that passes the Settings.ini file (after backup) is updated and the
- * running ramp is adjusted to match.
- *
- * The incoming data looks like:
- *  [{"time":"00:00","temp1":"52.00","temp2":"5.00","temp3":"5.00","temp4":"5.00"},
- *   {"time":"00:01","temp1":"5.00","temp2":"52.00","temp3":"52.00","temp4":"52.00"},
- *   {"time":"00:02","temp1":"52.00","temp2":"5.00","temp3":"5.00","temp4":"5.00"},
- *   {"time":"00:03","temp1":"5.00","temp2":"52.00","temp3":"52.00","temp4":"52.00"},
- *   {"startTime":"11:54"},
- *   {"magicWord":""}
- *  ]
- * Be sure that we handle NT != 4.
- *
- * Rather than writing a general JSON parser, which can be complex, just assume that
- * this data order will be consistent and parse the String manually.
- *
- * TODO: there is some validity checking, but another coding pass to catch more cases is needed.
+ * Use a ramp plan received at /updateRampPlan, once upload has parsed the whole of it.
+ * If the magic word matches, the plan replaces the running one, and Settings.ini (after
+ * backup) is rewritten to match.  Messages for the user go to rs as {"msg":"..."}.
  */
-boolean receivePlanJSON(String js, AsyncResponseStream *rs) {
-  Serial.printf("Received JSON string:\n%s.\n", js.c_str());
-  //Serial.println("012345678901234567890123456789012345678901234567890123456789012345678901234567890");
-  //Serial.println("0---------1---------2---------3---------4---------5---------6---------7---------8");
-
-  String val;
-
-  unsigned int minutes[MAX_RAMP_STEPS];  // Time for each ramp step.
-  int hundredths[NT][MAX_RAMP_STEPS];    // Temperatures in 1/100 degree, because that takes half the storage of a float.
-  int step = 0;
-  int n = 0;
-  int colon = 0;
-  int startIndex = 0, endIndex = 0, newStart = 0;
-  // Get all rows starting with time  indexOf returns -1 if not found.
-  while ((startIndex = js.indexOf("\"time\"", endIndex) + 8) > 8) {
-
-    // Get the time
-    endIndex = js.indexOf("\",", startIndex);  // to next comma
-    val = js.substring(startIndex, endIndex);  // Time as HH:MM or H:MM.
-    Serial.printf("  debug 2 found %s time at %d for step %d\n", val, startIndex, step);
-
-    colon = val.indexOf(":");
-    minutes[step] = val.substring(0, colon).toInt() * 60 + val.substring(colon + 1).toInt();
-    // Get NT temperatures, always working forward from the last position.
-    // This was a list of single key:value pairs, but now we have one key, tempList
-    // and a list (array).
-    startIndex = js.indexOf("\"tempList", endIndex);
-    startIndex += 13;  // past the name and punctuation
-    for (n = 0; n < NT; n++) {
-      endIndex = js.indexOf("\"", startIndex);
-      val = js.substring(startIndex, endIndex);
-      hundredths[n][step] = (int)(val.toFloat() * 100);
-      startIndex = endIndex + 3;  // past ","  Not used after the last pass.
-    }
-    Serial.println();
-
-    ///////////           request->send(200, "text/plain", "true");
-    if (n != NT) {
-      rs->printf("Found only %d temperatures for %d tanks.", n, NT);
-      Serial.printf("Found only %d temperatures for %d tanks.\n", n, NT);
-      return false;
-    }
-    step++;
-  }
-  // Serial.printf("debug 3 step (row) count is %d\n", step);
-
-  if (step < 2) {
-    rs->println("There must be at least two temperature input lines.");
-    Serial.println("There must be at least two temperature input lines.");
-    return false;
-  } else if (MAX_RAMP_STEPS < step) {
-    rs->printf("There are more than %d temperature input lines. Use fewer steps or recompile with a larger MAX_RAMP_STEPS.\n", MAX_RAMP_STEPS);
-    Serial.printf("There are more than %d temperature input lines. Use fewer steps or recompile with a larger MAX_RAMP_STEPS.\n", MAX_RAMP_STEPS);
-    return false;
-  } else {
-    // Save the new step count.
-    rampSteps = step;
-  }
-  // No more times. Now get the start time and magic word.
-  // These start from the front of the string so order doesn't matter.
-  startIndex = js.indexOf("\"startTime\"") + 13;
-  endIndex = 1 + js.indexOf("\"}", startIndex);
-  val = js.substring(startIndex, endIndex);
-  if (val.length() == 0 || val.indexOf(":") <= 0
-      || val.indexOf(":") >= val.length() - 1) {
-    rs->printf("Start time \"%s\" must be in H:MM or H:MM form.", val);
-    Serial.printf("Start time \"%s\" must be in H:MM or H:MM form.", val);
+boolean receivePlanJSON(PlanJSON &upload, AsyncResponseStream *rs) {
+  if (strcmp(upload.magicWord, MAGICWORD)) {
+    rs->println("{\"msg\":\"Magic word missing or incorrect.\"}");
+    Serial.println("Magic word missing or incorrect.");
     return false;
   }
-
-  newStart = val.substring(0, colon).toInt() * 60 + val.substring(colon + 1).toInt();  // Minutes since midnight
+  RampPlan &plan = upload.plan;
+  int newStart = upload.startMinutes;
+  Serial.printf("Received a ramp plan of %d steps.\n", (int)plan.size());
   if (newStart == 0) {
-    // rs->println("Ramp start time is midnight.  Be sure this is what you want.");
     Serial.println("Ramp start time is midnight.  Be sure this is what you want.");
-  } else if (newStart >= 24 * 60) {
-    rs->printf("Ramp start time in minutes (%d) is more than the minutes in a day!", newStart);
-    Serial.printf("Ramp start time in minutes (%d) is more than the minutes in a day!", newStart);
-    return false;
-  }
-
-  // Magic word (in JSON)
-  startIndex = js.indexOf("\"magicWord\"") + 13;
-  endIndex = js.indexOf("\"}", startIndex);
-  val = js.substring(startIndex, endIndex);
-  if (!val.equals(MAGICWORD)) {
-    rs->println("{\"msg\":\"Magic word missing or incorrect.\"}");
-    Serial.println("Magic word missing or incorrect.");
-    return false;
   }
 
-  // Now we trust the input.  Change arrays and save safely to Settings.ini.
-  int j;
-  for (int i = 0; i < step; i++) {
-    rampMinutes[i] = minutes[i];
-    for (j = 0; j < NT; j++) {
-      rampHundredths[j][i] = hundredths[j][i];
-    }
-  }
+  // Now we trust the input.  Use the new plan and save it safely to Settings.ini.
+  plan.compile(interpolateT);
+  xSemaphoreTake(rampMutex, portMAX_DELAY);
+  rampPlan.swap(plan);
+  rampStream.end();
+  // A dated START keeps its date.
+  if (relativeStartEpoch) relativeStartEpoch += ((int)newStart - (int)relativeStartTime) * 60;
   relativeStartTime = newStart;
+  xSemaphoreGive(rampMutex);
 
   // Everything is updated. Commit to file in case of restarts.
   if (rewriteSettingsINI()) {
     Serial.println("===== Successful update of ramp plan! =====");
     return true;
   } else {
-    rs->println("Failed to save Settings.ini of CBASS-32!  Modify card manually if necessary.");
+    rs->println("{\"msg\":\"Failed to save Settings.ini of CBASS-32!  Modify card manually if necessary.\"}");
     Serial.println("Failed to save Settings.ini of CBASS-32!  Modify SD card manually if necessary.");
     return false;
   }
@@ -1108,45 +1454,39 @@ boolean receivePlanJSON(String js, AsyncResponseStream *rs) {
  * Generate a table with temperatures for each of NT tanks.  Values
  * will be filled in by the javascript in the page.
  */
-String tableForNT() {
-  Serial.println("In tableForNT");
-  String s = "<table>\n<tr><td>Current T:</td>";
+void tableForNT(Print &out) {
+  out.print("<table>\n<tr><td>Current T:</td>");
 
-  // String objects seem to be better tolerated with ESP32 than the old processors,
-  // but it still seems bad to create and destroy a String for each column.  Instead
+  // Rather than print each column separately,
   // go to the trouble of making a single buffer output for each supported number of tanks,
   // currently 1 to 8.
   // The compiler should be able to reduce this to a single line since NT is fixed.
   switch (NT) {
-    case 1: s += "<td id=\"temp1\">T1</td>"; break;
-    case 2: s += "<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td>"; break;
-    case 3: s += "<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td><td id=\"temp3\">T3</td>"; break;
-    case 4: s += "<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td><td id=\"temp3\">T3</td><td id=\"temp4\">T4</td>"; break;
-    case 5: s += "<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td><td id=\"temp3\">T3</td><td id=\"temp4\">T4</td><td id=\"temp5\">T5</td>"; break;
-    case 6: s += "<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td><td id=\"temp3\">T3</td><td id=\"temp4\">T4</td><td id=\"temp5\">T5</td><td id=\"temp6\">T6</td>"; break;
-    case 7: s += "<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td><td id=\"temp3\">T3</td><td id=\"temp4\">T4</td><td id=\"temp5\">T5</td><td id=\"temp6\">T6</td><td id=\"temp7\">T7</td>"; break;
-    case 8: s += "<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td><td id=\"temp3\">T3</td><td id=\"temp4\">T4</td><td id=\"temp5\">T5</td><td id=\"temp6\">T6</td><td id=\"temp7\">T7</td><td id=\"temp8\">T8</td>"; break;
-    default: s += "<td colspan=\"2\">WARNING: unsupported tank count</td>";
+    case 1: out.print("<td id=\"temp1\">T1</td>"); break;
+    case 2: out.print("<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td>"); break;
+    case 3: out.print("<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td><td id=\"temp3\">T3</td>"); break;
+    case 4: out.print("<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td><td id=\"temp3\">T3</td><td id=\"temp4\">T4</td>"); break;
+    case 5: out.print("<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td><td id=\"temp3\">T3</td><td id=\"temp4\">T4</td><td id=\"temp5\">T5</td>"); break;
+    case 6: out.print("<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td><td id=\"temp3\">T3</td><td id=\"temp4\">T4</td><td id=\"temp5\">T5</td><td id=\"temp6\">T6</td>"); break;
+    case 7: out.print("<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td><td id=\"temp3\">T3</td><td id=\"temp4\">T4</td><td id=\"temp5\">T5</td><td id=\"temp6\">T6</td><td id=\"temp7\">T7</td>"); break;
+    case 8: out.print("<td id=\"temp1\">T1</td><td id=\"temp2\">T2</td><td id=\"temp3\">T3</td><td id=\"temp4\">T4</td><td id=\"temp5\">T5</td><td id=\"temp6\">T6</td><td id=\"temp7\">T7</td><td id=\"temp8\">T8</td>"); break;
+    default: out.print("<td colspan=\"2\">WARNING: unsupported tank count</td>");
   }
-  Serial.println("In tableForNT 2");
 
-  s += "<td id=\"cbassTime\">CBASS Time: 0:00</td></tr>\n<tr><td>Target T:</td>";
+  out.print("<td id=\"cbassTime\">CBASS Time: 0:00</td></tr>\n<tr><td>Target T:</td>");
   // Same thing for the target temperatures.
   switch (NT) {
-    case 1: s += "<td id=\"set1\">T1</td>"; break;
-    case 2: s += "<td id=\"set1\">T1</td><td id=\"set2\">T2</td>"; break;
-    case 3: s += "<td id=\"set1\">T1</td><td id=\"set2\">T2</td><td id=\"set3\">T3</td>"; break;
-    case 4: s += "<td id=\"set1\">T1</td><td id=\"set2\">T2</td><td id=\"set3\">T3</td><td id=\"set4\">T4</td>"; break;
-    case 5: s += "<td id=\"set1\">T1</td><td id=\"set2\">T2</td><td id=\"set3\">T3</td><td id=\"set4\">T4</td><td id=\"set5\">T5</td>"; break;
-    case 6: s += "<td id=\"set1\">T1</td><td id=\"set2\">T2</td><td id=\"set3\">T3</td><td id=\"set4\">T4</td><td id=\"set5\">T5</td><td id=\"set6\">T6</td>"; break;
-    case 7: s += "<td id=\"set1\">T1</td><td id=\"set2\">T2</td><td id=\"set3\">T3</td><td id=\"set4\">T4</td><td id=\"set5\">T5</td><td id=\"set6\">T6</td><td id=\"set7\">T7</td>"; break;
-    case 8: s += "<td id=\"set1\">T1</td><td id=\"set2\">T2</td><td id=\"set3\">T3</td><td id=\"set4\">T4</td><td id=\"set5\">T5</td><td id=\"set6\">T6</td><td id=\"set7\">T7</td><td id=\"set8\">T8</td>"; break;
-    default: s += "<td colspan=\"2\">WARNING: unsupported tank count</td>";
+    case 1: out.print("<td id=\"set1\">T1</td>"); break;
+    case 2: out.print("<td id=\"set1\">T1</td><td id=\"set2\">T2</td>"); break;
+    case 3: out.print("<td id=\"set1\">T1</td><td id=\"set2\">T2</td><td id=\"set3\">T3</td>"); break;
+    case 4: out.print("<td id=\"set1\">T1</td><td id=\"set2\">T2</td><td id=\"set3\">T3</td><td id=\"set4\">T4</td>"); break;
+    case 5: out.print("<td id=\"set1\">T1</td><td id=\"set2\">T2</td><td id=\"set3\">T3</td><td id=\"set4\">T4</td><td id=\"set5\">T5</td>"); break;
+    case 6: out.print("<td id=\"set1\">T1</td><td id=\"set2\">T2</td><td id=\"set3\">T3</td><td id=\"set4\">T4</td><td id=\"set5\">T5</td><td id=\"set6\">T6</td>"); break;
+    case 7: out.print("<td id=\"set1\">T1</td><td id=\"set2\">T2</td><td id=\"set3\">T3</td><td id=\"set4\">T4</td><td id=\"set5\">T5</td><td id=\"set6\">T6</td><td id=\"set7\">T7</td>"); break;
+    case 8: out.print("<td id=\"set1\">T1</td><td id=\"set2\">T2</td><td id=\"set3\">T3</td><td id=\"set4\">T4</td><td id=\"set5\">T5</td><td id=\"set6\">T6</td><td id=\"set7\">T7</td><td id=\"set8\">T8</td>"); break;
+    default: out.print("<td colspan=\"2\">WARNING: unsupported tank count</td>");
   }
-  s += "<td id=\"updateTime\">Last Update: 0:00</td></tr>\n</table>";
-  Serial.println("In tableForNT 3");
-
-  return s;
+  out.print("<td id=\"updateTime\">Last Update: 0:00</td></tr>\n</table>");
 }
 
 /**
@@ -1155,27 +1495,25 @@ String tableForNT() {
  * typed name to be placed under root.
  */
 #ifdef ALLOW_UPLOADS
-String directoryInput() {
+void directoryInput(Print &out) {
   // dirPath is a global containing the directory to list.
   Serial.print("In directoryInput.\n");
-  const int maxOutputBuffer = 2048;
-  char outputBuffer[maxOutputBuffer];  // The ugly process of building a String using sprintf or snprintf needs a buffer.
   File32 root;
   root.open("/");
   if (!root) {
     Serial.printf("Path >%s< not opened.\n", dirPath);
-    sprintf(outputBuffer, "The specified path, \"%s\" could not be opened.", dirPath);
-    return String(outputBuffer);
+    out.printf("The specified path, \"%s\" could not be opened.", dirPath);
+    return;
   }
   if (!root.isDirectory()) {
     Serial.printf("Path >%s< is not a directory.\n", dirPath);
-    sprintf(outputBuffer, "The specified path, \"%s\" is not a directory.", dirPath);
-    return String(outputBuffer);
+    out.printf("The specified path, \"%s\" is not a directory.", dirPath);
+    return;
   }
 
   // The output is a drop-down list
-  String rString = "<label for=\"dirs\">Choose the target directory:</label><select name=\"dirChoices\" id=\"dirChoices\" onchange=updateNewName()>\n";
-  rString += "<option value=\"/\">/, the base directory</option>\n";
+  out.print("<label for=\"dirs\">Choose the target directory:</label><select name=\"dirChoices\" id=\"dirChoices\" onchange=updateNewName()>\n");
+  out.print("<option value=\"/\">/, the base directory</option>\n");
 
   File32 file;
   int pass = 0;
@@ -1184,8 +1522,7 @@ String directoryInput() {
     if (file.isDirectory()) {
       Serial.print("  DIR : ");
       Serial.println(fnBuffer);
-      sprintf(outputBuffer, "<option value=\"%s\">%s</option>\n", fnBuffer, fnBuffer);
-      rString += String(outputBuffer);
+      out.printf("<option value=\"%s\">%s</option>\n", fnBuffer, fnBuffer);
     }
 
     // SD.h way: file = root.openNextFile();
@@ -1194,13 +1531,10 @@ String directoryInput() {
 
 
 
-  rString += "<option value=\"--new--\">new directory</option></select>\n<br><label for=\"newdir\">New directory:</label><input type=\"text\" id=\"newdir\" name=\"newdir\" disabled><br>\n";
+  out.print("<option value=\"--new--\">new directory</option></select>\n<br><label for=\"newdir\">New directory:</label><input type=\"text\" id=\"newdir\" name=\"newdir\" disabled><br>\n");
 
   file.close();
   root.close();
-  //Serial.println("Before return, rString is:");
-  //Serial.println(rString);
-  return rString;
 }
 #endif
 
@@ -1211,61 +1545,67 @@ String showDateTime() {
   return getdate() + " " + gettime();
 }
 
+/**
+ * Counters from logWriter and the log queue, for the log management page.
+ */
+void logStats(Print &out) {
+  unsigned long writes = max(logWriter.writeCount, 1UL);
+  unsigned long lines = max(logWriter.lines, 1UL);
+  out.printf("%lu lines, %lu dropped (%lu more not queued), %lu sectors written, %lu syncs, "
+             "card write %.1f ms average, %.1f ms max, line %.2f ms average.",
+             logWriter.lines, logWriter.dropped, snapshotDrops, logWriter.sectorWrites, logWriter.syncs,
+             logWriter.writeTotalUs / 1000.0 / writes, logWriter.writeMaxUs / 1000.0, logWriter.appendTotalUs / 1000.0 / lines);
+  out.printf(" Index: %lu entries written, longest lookup %.1f ms.", logIndex.entries, logIndex.lookupMaxUs / 1000.0);
+  out.printf(" Graph history: %lu points restored at boot in %lu ms, %lu not journaled, last checkpoint %lu ms.",
+             graphRestored, graphRestoreMs, journalDrops + graphJournal.dropped, checkpointMs);
+  if (uploads > 0) {
+    out.printf(" Uploads: %lu files received, the last %lu B at %.1f KB/s.", uploads, uploadBytes, uploadKBs);
+  }
+  if (rampStream.isActive()) {
+    out.printf(" Ramp plan: %lu steps streamed from %s, %lu windows read, longest %.1f ms, %lu passes waited for one.",
+               rampStream.steps, rampStream.getPath(), rampStream.refills, rampStream.refillMaxUs / 1000.0, rampStream.misses);
+  }
+}
+
 /**
  * This defines the replacements for any text between ~ characters in web templates.
- * This if/else structure isn't very efficient, but we don't make tons of calls and
- * it can help to put the most-used replacements first.
+ * Each case is the fill function for one name, found when the templates are
+ * compiled.  The case labels are hashed by the compiler, which would also
+ * reject two names with the same hash.
  *
  * NOTE: the default delimiter for substitution strings is "%", but that is too
  * commonly used.  "@" was used until needed for CSS.  Now we have "~" in WebResponseImpl.h.
  */
-String processor(const String &var) {
-  static char nt[5];  // Normally holds a 1 or 2-digit number, plus terminator.
-  if (strlen(nt) == 0) {
-    // Since nt is static, this only has to run once.
-    sprintf(nt, "%d", NT);
-  }
-  if (var == "ERROR_MSG") {
-    String m = p_message;
-    p_message = "";  // Don't let it carry over to later
-    return m;
-  } else if (var == "TITLE") {
-    if (p_title.isEmpty()) return String("CBASS-32");
-    else return p_title;
-  } else if (var == "LINKLIST") return linkList;
-  else if (var == "ROLLLOG") return rollLog();
-  else if (var == "DIRLIST") return sendFileInfo();
-  else if (var == "NT") return nt;
-  else if (var == "IP") return myIP.toString();
-  else if (var == "TABLE_NT") return tableForNT();
-  else if (var == "DATETIME") return showDateTime();
-  else if (var == "MAGIC") return magicBlank;
+TemplateFill templateFill(uint32_t key) {
+  switch (key) {
+    case templateKey("ERROR_MSG"):
+      return [](Print &out) {
+        out.print(p_message);
+        p_message = "";  // Don't let it carry over to later
+      };
+    case templateKey("TITLE"):
+      return [](Print &out) {
+        if (p_title.isEmpty()) out.print("CBASS-32");
+        else out.print(p_title);
+      };
+    case templateKey("LINKLIST"): return [](Print &out) { pageTemplate(linkList).printTo(out); };
+    case templateKey("ROLLLOG"): return [](Print &out) { out.print(rollLog()); };
+    case templateKey("DIRLIST"): return [](Print &out) { sendFileInfo(out); };
+    case templateKey("NT"): return [](Print &out) { out.print(NT); };
+    case templateKey("IP"): return [](Print &out) { out.print(myIP.toString()); };
+    case templateKey("TABLE_NT"): return [](Print &out) { tableForNT(out); };
+    case templateKey("DATETIME"): return [](Print &out) { out.print(showDateTime()); };
+    case templateKey("LOGSTATS"): return [](Print &out) { logStats(out); };
+    case templateKey("MAGIC"): return [](Print &out) { out.print(magicBlank); };
 #ifdef ALLOW_UPLOADS
-  else if (var == "DIRECTORY_CHOICE") return directoryInput();
-  else if (var == "UPLOAD_LINK") return String("<li><a href=\"/UploadPage\">Upload any file.</a></li>");
+    case templateKey("DIRECTORY_CHOICE"): return [](Print &out) { directoryInput(out); };
+    case templateKey("UPLOAD_LINK"): return [](Print &out) { out.print("<li><a href=\"/UploadPage\">Upload any file.</a></li>"); };
 #else
-  else if (var == "UPLOAD_LINK" || var == "DIRECTORY_CHOICE") return String(" ");
+    case templateKey("UPLOAD_LINK"):
+    case templateKey("DIRECTORY_CHOICE"): return [](Print &out) { out.print(" "); };
 #endif
-  // If the whole if-else falls through return an empty String.
-  return String();
-}
-
-/**
- * A kludge due to the fact that in the RampPlan page the response is computed on the fly
- * rather than contained in a string.  This means that there is no built-in way to run the
- * text processors to replace placeholders.  This takes the list of links and replaces
- * ~UPLOAD_LINK~ appropriately.
- * An alternative would be to put the whole computation of the page inside the processor(), but
- * that seems even messier.
- */
-String manualProcess(const String &var) {
-  int pos;
-  if ((pos = var.indexOf("~UPLOAD_LINK~")) >= 0) {
-    Serial.println("GOT IT");
-    return var.substring(0, pos) + processor("UPLOAD_LINK") + var.substring(pos + 13);
-  } else {
-    return var;
   }
+  return NULL;
 }
 
 /**
@@ -1278,11 +1618,12 @@ void pauseLogging(boolean a) {
       startPause = millis();
       logPaused = true;  // Don't let a new log line start.
       delay(100);        // Let any in-progress log line complete.
+      logWriter.close(); // Get everything onto the card before anyone else opens LOG.txt.
+      graphJournal.close();
     }
-  } else {
+  } else if (openDownloads == 0) {  // The last download to finish resumes logging.
     startPause = 0;
-    logPaused = false;
-    tftPauseWarning(false);
+    logPaused = false;  // displayTask clears the warning.
   }
 }
 
@@ -1294,38 +1635,87 @@ void pauseLogging(boolean a) {
  * NOTE: To avoid String construction a version was made which wrote
  * directly to the stream with rs->print() and rs->printf() calls.  It was MUCH slower.
  */
-String dataPointToJSON(DataPoint p) {
+String dataPointToJSON(const DataPoint &p) {
+  char buf[200];
+  dataPointToChars(p, buf);
+  return String(buf);
+}
+
+/**
+ * Format one point into buf and return the length.
+ */
+int dataPointToChars(const DataPoint &p, char *buf) {
   // Example output with silly temperatures
   // {"NT":[4],"datetime":[2020-04-16T18:34:56],"Target":[1.0,2.0,3.0,4.0],"Actual":[0.0,0.0,0.0,0.0]}
   // Without temps, 68 characters:
   // {"NT":[4],"datetime":[2020-04-16T18:34:56],"Target":[],"Actual":[]}
   // Using 12.34 format for temps and up to 8 tanks add 5*16 + 14 for the values and commas.  94 characters.
-  // Make the buffer 68 + 94 bytes, and round up for safety: 162 -> 200
-  char buf[200];
-  char fb[7];  // one formatted int, normally 5 characters plus a terminator.
-  sprintf(buf, "\"%ld\":{\"datetime\":\"%s\",\"target\":[", p.timestamp, p.time.timestamp().c_str());
+  // The buffer must be 68 + 94 bytes, and round up for safety: 162 -> 200
+  int n = sprintf(buf, "\"%lu\":{\"datetime\":\"%s\",\"target\":[", (unsigned long)p.timestamp, p.time().timestamp().c_str());
   int i;
   for (i = 0; i < NT; i++) {
-    dtostrf(p.target[i], 5, 2, fb);
-    strcat(buf, fb);
-    if (i < NT - 1) strcat(buf, ",");
+    n += hundredthsToStr(p.target[i], buf + n);
+    if (i < NT - 1) buf[n++] = ',';
   }
-  strcat(buf, "],\"actual\":[");
+  n += sprintf(buf + n, "],\"actual\":[");
   for (i = 0; i < NT; i++) {
-    dtostrf(p.actual[i], 5, 2, fb);
-    strcat(buf, fb);
-    if (i < NT - 1) strcat(buf, ",");
+    n += hundredthsToStr(p.actual[i], buf + n);
+    if (i < NT - 1) buf[n++] = ',';
   }
-  strcat(buf, "]}");
-  return String(buf);
+  n += sprintf(buf + n, "]}");
+  return n;
+}
+
+/**
+ * A ten minute summary for the graphing page.  "target" and "actual" are
+ * means, so the page can plot it as a DataPoint, and "min" and "max" are the
+ * extremes of the actual temperature.
+ * "600000":{"datetime":"2024-04-11T16:29:51","target":[...],"actual":[...],"min":[...],"max":[...]}
+ */
+int rollupToChars(const GraphRollup &r, char *buf) {
+  int n = sprintf(buf, "\"%lu\":{\"datetime\":\"%s\",\"target\":", (unsigned long)r.timestamp, DateTime(r.epoch).timestamp().c_str());
+  n += hundredthsList(r.target, buf + n);
+  n += sprintf(buf + n, ",\"actual\":");
+  n += hundredthsList(r.actual, buf + n);
+  n += sprintf(buf + n, ",\"min\":");
+  n += hundredthsList(r.actualMin, buf + n);
+  n += sprintf(buf + n, ",\"max\":");
+  n += hundredthsList(r.actualMax, buf + n);
+  buf[n++] = '}';
+  buf[n] = 0;
+  return n;
 }
 
-void dataPointPrint(DataPoint p) {
-  Serial.printf("%d tanks at %s %s\n", NT, getdate(p.time), gettime(p.time));
+// NT temperatures as a JSON list, e.g. [24.00,23.50].
+int hundredthsList(const int16_t *h, char *buf) {
+  int n = 0;
+  buf[n++] = '[';
+  for (int i = 0; i < NT; i++) {
+    if (i) buf[n++] = ',';
+    n += hundredthsToStr(h[i], buf + n);
+  }
+  buf[n++] = ']';
+  buf[n] = 0;
+  return n;
+}
+
+/**
+ * Write a temperature in hundredths of a degree as dtostrf(h/100.0, 5, 2, out)
+ * would, e.g. "26.00" or " 5.25".  Returns the length.
+ */
+int hundredthsToStr(int16_t h, char *out) {
+  unsigned int a = (h < 0) ? -(int)h : h;
+  char digits[10];
+  sprintf(digits, "%s%u.%02u", (h < 0) ? "-" : "", a / 100, a % 100);
+  return sprintf(out, "%5s", digits);
+}
+
+void dataPointPrint(const DataPoint &p) {
+  Serial.printf("%d tanks at %s %s\n", NT, getdate(p.time()).c_str(), gettime(p.time()).c_str());
   Serial.print("Target: ");
   int i;
-  for (i = 0; i < NT; i++) Serial.printf(" %6.2f ", p.target[i]);
+  for (i = 0; i < NT; i++) Serial.printf(" %6.2f ", p.target[i] / 100.0);
   Serial.print("\nActual: ");
-  for (i = 0; i < NT; i++) Serial.printf(" %6.2f ", p.actual[i]);
+  for (i = 0; i < NT; i++) Serial.printf(" %6.2f ", p.actual[i] / 100.0);
   Serial.println();
-}
\ No newline at end of file
+}
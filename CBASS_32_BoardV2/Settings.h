@@ -29,7 +29,7 @@
 
 // ***** Temp Program Inputs *****
 double RAMP_START_TEMP[NT];
-const short MAX_RAMP_STEPS = 20; // Could be as low as 7, 24*12+1 allows every 5 minutes for a day, with endpoints.
+const short MAX_RAMP_STEPS = 24*60+1; // Memory is only used for the steps in the plan.  This allows one a minute for a day.
 
 #ifdef COLDWATER
 #define CHILLER_OFFSET 0.0
@@ -0,0 +1,28 @@
+/**
+ * Settings.ini replaced in one step, so the card always has a whole one.
+ *
+ * rewriteSettingsINI() used to copy Settings.ini twice, once as SetCopy.ini
+ * and once as a backup, then copy a modified file over it, flushing after
+ * nearly every print.  A web edit cost hundreds of sector transfers, and a
+ * restart part way through could leave no Settings.ini at all.
+ *
+ * Now the new text goes once into Settings.new through a SectorFile, which
+ * reserves room for it with preAllocate() and writes whole 512-byte sectors.
+ * Once that is synced, the old Settings.ini is renamed to a backup name in
+ * /WebBack and Settings.new is renamed into its place.  A rename rewrites
+ * only directory entries.  Backup names come from a counter kept in
+ * /WebBack/Rbk.cnt, so there is no search for an unused one.
+ *
+ * A restart between the two renames leaves Settings.new and no Settings.ini,
+ * and recoverSettingsINI() finishes the job at boot.  A Settings.new next to
+ * a Settings.ini is from a write which never finished, and is removed.
+ */
+#ifndef SETTINGSFILE_H
+#define SETTINGSFILE_H
+
+const char INIpath[] = "/Settings.ini";
+const char INInewPath[] = "/Settings.new";
+const char INIbackupDir[] = "/WebBack";
+const char INIcounterPath[] = "/WebBack/Rbk.cnt";  // The number of the next backup.
+
+#endif
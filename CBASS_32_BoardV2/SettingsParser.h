@@ -0,0 +1,350 @@
+/**
+ * Settings.ini, parsed in one pass over blocks of the file.
+ *
+ * readRampPlan() reads the file a block at a time into sdBuffer and hands
+ * each block to feed().  Lines may end in \n, \r\n or \r, and a block may end
+ * anywhere, even between the \r and \n of one line end.  Each line is then
+ * tokenized with a cursor: the keyword or time first, then its values, with
+ * no sscanf or strtok.  Temperatures go straight into hundredths of a degree
+ * with integer arithmetic.
+ *
+ * The first error stops the parse and is kept with its line and column, both
+ * counted from 1, so the message can point at the character.  Values go into
+ * the public fields below, which hold the defaults for anything the file
+ * leaves out, and ramp lines go into a RampPlan.  See readRampPlan() for the
+ * keywords.  Text after a value is only allowed as a comment starting with /.
+ */
+#ifndef SETTINGSPARSER_H
+#define SETTINGSPARSER_H
+
+const size_t INIlineMax = 160;
+const uint32_t INIrampHoursMax = 99999;  // Ramp line times, so seconds fit in 32 bits.
+
+/**
+ * A temperature at s, at most len characters, in hundredths of a degree: an
+ * optional sign, at most four whole digits, and any number of decimals,
+ * rounded half away from zero as round() would.  Returns the characters
+ * used, or 0 if there is no temperature there.
+ */
+inline size_t iniHundredths(const char *s, size_t len, int &out) {
+  size_t pos = 0;
+  bool negative = len > 0 && s[0] == '-';
+  if (negative || (len > 0 && s[0] == '+')) pos++;
+  int32_t whole = 0, frac = 0;
+  int digits = 0, fracDigits = 0, up = 0;
+  while (pos < len && isdigit((uint8_t)s[pos])) {
+    if (++digits > 4) return 0;
+    whole = whole * 10 + (s[pos++] - '0');
+  }
+  if (pos < len && s[pos] == '.') {
+    pos++;
+    while (pos < len && isdigit((uint8_t)s[pos])) {
+      int d = s[pos++] - '0';
+      if (fracDigits < 2) frac = frac * 10 + d;
+      else if (fracDigits == 2) up = d >= 5;
+      fracDigits++;
+    }
+  }
+  if (digits + fracDigits == 0) return 0;
+  while (fracDigits < 2) {
+    frac *= 10;
+    fracDigits++;
+  }
+  out = whole * 100 + frac + up;
+  if (negative) out = -out;
+  return pos;
+}
+
+/**
+ * A time at s, at most len characters, as H:MM with at most maxHours hours
+ * and 0 to 59 minutes.  Returns the characters used, or 0 if there is no
+ * time there.
+ */
+inline size_t iniTime(const char *s, size_t len, uint32_t maxHours, uint32_t &minutes) {
+  size_t pos = 0;
+  uint32_t h = 0, m = 0;
+  while (pos < len && isdigit((uint8_t)s[pos])) {
+    if (pos == 5) return 0;
+    h = h * 10 + (s[pos++] - '0');
+  }
+  if (pos == 0 || h > maxHours || pos == len || s[pos] != ':') return 0;
+  size_t mAt = ++pos;
+  while (pos < len && isdigit((uint8_t)s[pos])) {
+    if (pos - mAt == 2) return 0;
+    m = m * 10 + (s[pos++] - '0');
+  }
+  if (pos == mAt || m > 59) return 0;
+  minutes = h * 60 + m;
+  return pos;
+}
+
+class SettingsParser {
+public:
+  bool relativeStart = false;       // START was given.
+  unsigned int startMinutes = 0;    // Its time of day.
+  uint32_t startEpoch = 0;          // Its date and time, if it has a date.
+  bool interpolate = true;          // INTERP LINEAR rather than STEP.
+  int lightOnMinutes = -1;          // LIGHTON, or -1.
+  int lightOffMinutes = -1;         // LIGHTOFF, or -1.
+  bool logBinary = false;           // LOGFORMAT BINARY.
+  unsigned long logRollKB = 0;
+  int logRollMinutes = -1;          // LOGROLLTIME, or -1.
+  char planFile[32] = "";           // PLANFILE, if any.
+  int fewestTemps = NT;             // On any ramp line.
+  int extraTemps = 0;               // Beyond NT, on all ramp lines together.
+  unsigned long lines = 0;          // Lines parsed so far.
+
+  const char *error = NULL;         // The first error, or NULL.
+  unsigned long errorLine = 0, errorColumn = 0;
+
+  // Ramp lines are added to plan, up to maxSteps of them.
+  SettingsParser(RampPlan &plan, size_t maxSteps) : plan(plan), maxSteps(maxSteps) {}
+
+  // Parse the next len bytes of the file.  False once there is an error.
+  bool feed(const char *data, size_t len) {
+    const char *p = data, *end = data + len;
+    while (p < end && !error) {
+      if (skipLF) {
+        skipLF = false;
+        if (*p == '\n') {
+          p++;
+          continue;
+        }
+      }
+      const char *eol = p;
+      while (eol < end && *eol != '\n' && *eol != '\r') eol++;
+      size_t n = eol - p;
+      if (lineLen + n > INIlineMax) {
+        lines++;
+        fail("Line is too long.", INIlineMax);
+        break;
+      }
+      memcpy(line + lineLen, p, n);
+      lineLen += n;
+      p = eol;
+      if (p < end) {
+        skipLF = *p == '\r';
+        p++;
+        endLine();
+      }
+    }
+    return !error;
+  }
+
+  // The end of the file, which ends a last line with no line end.
+  bool finish() {
+    if (!error && lineLen > 0) endLine();
+    return !error;
+  }
+
+private:
+  void endLine() {
+    lines++;
+    pos = 0;
+    parseLine();
+    lineLen = 0;
+  }
+
+  void parseLine() {
+    skipSpace();
+    int c = peek();
+    if (c < 0 || c == '/') return;  // Blank, or a comment.
+    if (isdigit(c)) {
+      rampLine();
+      return;
+    }
+    size_t at = pos;
+    char kw[16];
+    if (!word(kw, sizeof(kw))) {
+      fail("Expected a keyword, a time, or a comment.", at);
+      return;
+    }
+    if (!strcmp(kw, "START")) {
+      startValue();
+    } else if (!strcmp(kw, "INTERP")) {
+      const char *options[] = {"LINEAR", "STEP"};
+      int k = choice(options, 2, "INTERP must be LINEAR or STEP.");
+      if (k >= 0) interpolate = k == 0;
+    } else if (!strcmp(kw, "LIGHTON")) {
+      timeValue(lightOnMinutes, "LIGHTON must be followed by a time in 24-hour HH:MM or H:MM format.");
+    } else if (!strcmp(kw, "LIGHTOFF")) {
+      timeValue(lightOffMinutes, "LIGHTOFF must be followed by a time in 24-hour HH:MM or H:MM format.");
+    } else if (!strcmp(kw, "LOGFORMAT")) {
+      const char *options[] = {"TEXT", "BINARY"};
+      int k = choice(options, 2, "LOGFORMAT must be TEXT or BINARY.");
+      if (k >= 0) logBinary = k == 1;
+    } else if (!strcmp(kw, "LOGROLLKB")) {
+      skipSpace();
+      uint32_t kb;
+      if (!number(kb, 9)) fail("LOGROLLKB must be followed by a size in KB, or 0 for no limit.", pos);
+      else logRollKB = kb;
+    } else if (!strcmp(kw, "LOGROLLTIME")) {
+      timeValue(logRollMinutes, "LOGROLLTIME must be followed by a time in 24-hour HH:MM or H:MM format.");
+    } else if (!strcmp(kw, "PLANFILE")) {
+      skipSpace();
+      size_t n = 0, from = pos;
+      while (peek() > ' ' && n < sizeof(planFile) - 1) planFile[n++] = line[pos++];
+      planFile[n] = 0;
+      if (n == 0 || planFile[0] != '/' || peek() > ' ') fail("PLANFILE must be followed by a file name starting with /, up to 31 characters.", from);
+    } else {
+      fail("Unknown keyword.", at);
+    }
+    if (!error) lineEnd();
+  }
+
+  // A time, then temperatures.
+  void rampLine() {
+    uint32_t minutes;
+    if (!time(minutes, INIrampHoursMax)) {
+      fail("A ramp line must start with a time in H:MM or HH:MM format.", pos);
+      return;
+    }
+    int temps[NT] = {0};
+    int count = 0;
+    for (;;) {
+      skipSpace();
+      int c = peek();
+      if (c < 0 || c == '/') break;
+      size_t at = pos;
+      int h;
+      if (!hundredths(h) || (peek() >= 0 && !isSpaceOrTab(peek()) && peek() != '/')) {
+        fail("Expected a temperature.", at);
+        return;
+      }
+      if (count < NT) temps[count] = h;
+      count++;
+    }
+    if (plan.size() > 0 && minutes < plan.minutes(plan.size() - 1)) {
+      fail("Ramp times must not go backwards.", 0);
+      return;
+    }
+    if (plan.size() >= maxSteps) {
+      fail("There are more ramp lines than MAX_RAMP_STEPS.", 0);
+      return;
+    }
+    fewestTemps = min(fewestTemps, count);
+    extraTemps += max(0, count - NT);
+    plan.add(minutes, temps);
+  }
+
+  // START H:MM, or START YYYY-MM-DD H:MM.
+  void startValue() {
+    skipSpace();
+    size_t at = pos;
+    uint32_t yy = 0, mo = 0, dd = 0, minutes;
+    size_t digits = pos;
+    while (isdigit(peek())) pos++;
+    bool dated = peek() == '-';
+    pos = digits;
+    if (dated) {
+      if (!number(yy, 4) || !expect('-') || !number(mo, 2) || !expect('-') || !number(dd, 2) ||
+          yy < 2000 || mo < 1 || mo > 12 || dd < 1 || dd > 31 || !isSpaceOrTab(peek())) {
+        fail("START date must be YYYY-MM-DD.", at);
+        return;
+      }
+      skipSpace();
+      at = pos;
+    }
+    if (!time(minutes, 23)) {
+      fail("START must be followed by a time in 24-hour HH:MM or H:MM format.", at);
+      return;
+    }
+    relativeStart = true;
+    startMinutes = minutes;
+    startEpoch = dated ? DateTime(yy, mo, dd, minutes / 60, minutes % 60, 0).unixtime() : 0;
+  }
+
+  // A time of day after a keyword.
+  void timeValue(int &minutes, const char *message) {
+    skipSpace();
+    size_t at = pos;
+    uint32_t m;
+    if (!time(m, 23)) fail(message, at);
+    else minutes = m;
+  }
+
+  // One of options, as an index, or -1 after failing with message.
+  int choice(const char *const *options, int n, const char *message) {
+    skipSpace();
+    size_t at = pos;
+    char v[16];
+    if (word(v, sizeof(v))) {
+      for (int k = 0; k < n; k++) {
+        if (!strcmp(v, options[k])) return k;
+      }
+    }
+    fail(message, at);
+    return -1;
+  }
+
+  // Nothing but blanks or a comment may follow the value.
+  void lineEnd() {
+    skipSpace();
+    if (peek() >= 0 && peek() != '/') fail("Unexpected text after the value.", pos);
+  }
+
+  // A time at pos, moving past it.  See iniTime().
+  bool time(uint32_t &minutes, uint32_t maxHours) {
+    size_t n = iniTime(line + pos, lineLen - pos, maxHours, minutes);
+    pos += n;
+    return n > 0;
+  }
+
+  // A temperature at pos, moving past it.  See iniHundredths().
+  bool hundredths(int &out) {
+    size_t n = iniHundredths(line + pos, lineLen - pos, out);
+    pos += n;
+    return n > 0;
+  }
+
+  // Unsigned decimal digits, at most maxDigits of them.
+  bool number(uint32_t &n, int maxDigits) {
+    int digits = 0;
+    n = 0;
+    while (isdigit(peek())) {
+      if (++digits > maxDigits) return false;
+      n = n * 10 + (line[pos++] - '0');
+    }
+    return digits > 0;
+  }
+
+  // Letters, as a string.  False if there are none, or too many for out.
+  bool word(char *out, size_t size) {
+    size_t n = 0;
+    while (isalpha(peek())) {
+      if (n + 1 >= size) return false;
+      out[n++] = line[pos++];
+    }
+    out[n] = 0;
+    return n > 0;
+  }
+
+  bool expect(char c) {
+    if (peek() != c) return false;
+    pos++;
+    return true;
+  }
+
+  static bool isSpaceOrTab(int c) { return c == ' ' || c == '\t'; }
+  void skipSpace() {
+    while (isSpaceOrTab(peek())) pos++;
+  }
+
+  // The character at pos, or -1 at the end of the line.
+  int peek() const { return pos < lineLen ? (uint8_t)line[pos] : -1; }
+
+  void fail(const char *message, size_t at) {
+    error = message;
+    errorLine = lines;
+    errorColumn = at + 1;
+  }
+
+  RampPlan &plan;
+  size_t maxSteps;
+  char line[INIlineMax];
+  size_t lineLen = 0;
+  size_t pos = 0;        // The next character to tokenize.
+  bool skipLF = false;   // The last line ended in \r, so a \n next is part of it.
+};
+
+#endif
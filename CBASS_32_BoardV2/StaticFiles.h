@@ -0,0 +1,153 @@
+/**
+ * Web handlers for files in SPIFFS /htdocs, and for the request headers the
+ * sketch reads.
+ *
+ * SPIFFS_uploadV2 stores a gzip-compressed copy (name.gz) of each file which
+ * has one on the SD card, instead of the plain file.  plotly.js drops from
+ * 998853 to 333814 bytes, so the chart page loads in about a third of the
+ * time and the partition has room for more.  Browsers all send
+ * "Accept-Encoding: gzip", and StaticFiles then sends the .gz with
+ * "Content-Encoding: gzip".  A plain file is sent to clients which do not
+ * accept gzip, if there is one.
+ *
+ * The library's serveStatic() also falls back to a .gz file, but never looks
+ * at Accept-Encoding and sends no "Vary" header, so caches could hand the
+ * compressed copy to a client which cannot read it.
+ *
+ * Each file gets a strong ETag, a hash of its contents worked out the first
+ * time it is asked for.  Files only change when SPIFFS_uploadV2 runs, which
+ * replaces this sketch, so the hash stays good until the next boot.  A
+ * browser revalidating with If-None-Match gets "304 Not Modified" and no body.
+ * sendPage() in Server.ino gives templated pages ETags the same way.
+ */
+#ifndef STATICFILES_H
+#define STATICFILES_H
+
+#include <map>
+
+// FNV-1a, 64 bits.  Start with ETAGseed and feed it the bytes of a response body.
+const uint64_t ETAGseed = 14695981039346656037ULL;
+
+inline uint64_t etagHash(uint64_t h, const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  for (size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+inline String etagString(uint64_t h) {
+  char s[20];
+  snprintf(s, sizeof(s), "\"%08lx%08lx\"", (unsigned long)(uint32_t)(h >> 32), (unsigned long)(uint32_t)h);
+  return String(s);
+}
+
+// True if the request's If-None-Match lists etag, or is "*".
+inline bool etagMatches(AsyncWebServerRequest *request, const String &etag) {
+  if (etag.isEmpty() || !request->hasHeader("If-None-Match")) return false;
+  String inm = request->header("If-None-Match");
+  inm.trim();
+  // A weak W/"..." in the list also matches, as RFC 9110 asks for If-None-Match.
+  return inm == "*" || inm.indexOf(etag) >= 0;
+}
+
+// A body-less "304 Not Modified" repeating the headers a cache needs.
+inline void sendNotModified(AsyncWebServerRequest *request, const String &etag, const char *cacheControl, bool vary) {
+  AsyncWebServerResponse *response = request->beginResponse(304);
+  response->addHeader("ETag", etag);
+  response->addHeader("Cache-Control", cacheControl);
+  if (vary) response->addHeader("Vary", "Accept-Encoding");
+  request->send(response);
+}
+
+/**
+ * The library discards every request header no handler has asked for before
+ * the handler runs.  server.on() handlers cannot ask, so this one, added
+ * first, asks on their behalf and then lets the request pass on.
+ */
+class KeepHeaders : public AsyncWebHandler {
+public:
+  bool canHandle(AsyncWebServerRequest *request) override {
+    request->addInterestingHeader("Range");            // sendSDFile()
+    request->addInterestingHeader("Accept-Encoding");  // StaticFiles
+    request->addInterestingHeader("If-None-Match");    // StaticFiles, sendPage()
+    return false;
+  }
+  void handleRequest(AsyncWebServerRequest *request) override { (void)request; }
+};
+
+class StaticFiles : public AsyncWebHandler {
+public:
+  // dir is the SPIFFS directory holding files for the URL "/", without a trailing slash.
+  StaticFiles(fs::FS &fs, const char *dir, const char *cacheControl) : fs(fs), dir(dir), cacheControl(cacheControl) {}
+
+  bool canHandle(AsyncWebServerRequest *request) override {
+    if (request->method() != HTTP_GET) return false;
+    String path = dir + request->url();
+    return fs.exists(path + ".gz") || fs.exists(path);
+  }
+
+  void handleRequest(AsyncWebServerRequest *request) override {
+    String path = dir + request->url();
+    bool gz = fs.exists(path + ".gz") && (acceptsGzip(request) || !fs.exists(path));
+    String file = gz ? path + ".gz" : path;
+    String etag = etagFor(file);
+    if (etagMatches(request, etag)) {
+      sendNotModified(request, etag, cacheControl, true);
+      return;
+    }
+    // The type given explicitly, so the .gz is typed as what it holds.
+    AsyncWebServerResponse *response = request->beginResponse(fs, file, contentType(path));
+    if (gz) response->addHeader("Content-Encoding", "gzip");
+    response->addHeader("Vary", "Accept-Encoding");
+    response->addHeader("Cache-Control", cacheControl);
+    if (etag.length()) response->addHeader("ETag", etag);
+    request->send(response);
+  }
+
+  // The ETag of a file, hashing it on first use.  Empty if it cannot be read.
+  String etagFor(const String &file) {
+    auto known = etags.find(file);
+    if (known != etags.end()) return known->second;
+    File f = fs.open(file, "r");
+    if (!f) return String();
+    uint64_t h = ETAGseed;
+    uint8_t buf[1024];
+    size_t n;
+    while ((n = f.read(buf, sizeof(buf))) > 0) h = etagHash(h, buf, n);
+    f.close();
+    String etag = etagString(h);
+    etags[file] = etag;
+    return etag;
+  }
+
+  static bool acceptsGzip(AsyncWebServerRequest *request) {
+    if (!request->hasHeader("Accept-Encoding")) return false;
+    String ae = request->header("Accept-Encoding");
+    int i = ae.indexOf("gzip");
+    if (i < 0) return false;
+    // "gzip;q=0" means never.
+    String rest = ae.substring(i + 4);
+    return !rest.startsWith(";q=") || rest.substring(3).toFloat() > 0;
+  }
+
+  static const char *contentType(const String &path) {
+    if (path.endsWith(".js")) return "application/javascript";
+    if (path.endsWith(".css")) return "text/css";
+    if (path.endsWith(".html") || path.endsWith(".htm")) return "text/html";
+    if (path.endsWith(".png")) return "image/png";
+    if (path.endsWith(".svg")) return "image/svg+xml";
+    if (path.endsWith(".ico")) return "image/x-icon";
+    if (path.endsWith(".json")) return "application/json";
+    return "text/plain";
+  }
+
+private:
+  fs::FS &fs;
+  String dir;
+  const char *cacheControl;
+  std::map<String, String> etags;  // By SPIFFS path.
+};
+
+#endif
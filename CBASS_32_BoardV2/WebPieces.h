@@ -283,6 +283,8 @@ const char logHTML[] PROGMEM = R"rawliteral(
  It gives the most direct confirmation of the actual temperatures in the 
  test areas, though there may alternate monitoring methods as well.
  Because of this it must be <b>handled with care.</b></p>
+<p>With LOGFORMAT BINARY in Settings.ini the log is kept in the smaller LOG.bin instead.
+ The download is the same CSV either way.</p>
 
 <p>You must enter the "Magic Word".  Note that it is not a secure password<br>
 
@@ -292,8 +294,12 @@ const char logHTML[] PROGMEM = R"rawliteral(
 <br>
  <a id="dl" href="/LogDownload" download="LogDownload.csv"><button formaction="/LogDownload"  onclick="clearMessage()">Download Current Log</button></a>
 <button formaction="/LogRoll" type="submit" id="roll" href="/LogRoll" onclick="clearMessage()">Archive the log and start a new one.</button>
+<br>
+Only the lines from <input name="from" type="datetime-local" step="1"> to <input name="to" type="datetime-local" step="1">
+<button formaction="/LogRange" onclick="clearMessage()">Download Part of the Log</button>
 
 </form>
+<p>Log writer: ~LOGSTATS~</p>
 </div>
 
 ~LINKLIST~
@@ -430,6 +436,7 @@ const char plotlyHTML[] PROGMEM = R"rawliteral(
   var latest = -1; // Latest timestamp already plotted.
   var oldLatest = -2;  // If they have the same one twice the call will be skipped.
   var pointsReceived = 0;
+  var morePoints = false;  // True when a response ended early with a "next" cursor.
   var data = [];
   var trace;
   // NT temperatures
@@ -467,27 +474,49 @@ const char plotlyHTML[] PROGMEM = R"rawliteral(
   // the graph well after CBASS started.  Do that a little more aggressively than once we are caught up.
 
   // Get data points.
-  // The default maximum batch size on the CBASS-32 side is 1000 points, but we'll only be getting 1 to 6 points
+  // The first request normally gets the whole history, but we'll only be getting 1 to 6 points
   // once the graph catches up to real time.
   // Note that an early version with setInterval was unreliable.  setTimeout is more suitable for sequential
   // actions of unknown duration.
+  // Once caught up, new points are pushed from /events as CBASS stores them, and
+  // polling only continues if the browser can't do that.
   console.log("Starting point collection.");
 
   pointsReceived = 10000;
   let fetchDelay = 1000;  // Start getting points every second for fast startup.
+  let source = null;      // The /events connection, once caught up.
   function collectData() {
     getPoints(TESTER)
       .then(() => {
-        if (true) {
-          // Slow down to every 5 seconds once we catch up.
-          if (pointsReceived < 100 && pointsReceived > 0) fetchDelay = 5000;
-          setTimeout(collectData, fetchDelay);
+        if (!morePoints && typeof EventSource !== "undefined") {
+          listen();
+          return;
         }
+        // Slow down to every 5 seconds once we catch up.
+        if (pointsReceived < 100 && pointsReceived > 0) fetchDelay = 5000;
+        // If CBASS ran out of time before sending everything, ask for the rest now.
+        setTimeout(collectData, morePoints ? 0 : fetchDelay);
       })
-      .catch(e => console.log(e));
+      .catch(e => { console.log(e); setTimeout(collectData, fetchDelay); });
   }
   collectData();
 
+  // The browser reconnects by itself when the connection drops, and CBASS
+  // replays the points missed in between.
+  function listen() {
+    source = new EventSource("http://~IP~/events");
+    source.addEventListener('points', e => plotPoints(JSON.parse(e.data)));
+    // CBASS could not replay everything missed.  Catch up with /runT and listen again.
+    source.addEventListener('resync', () => {
+      source.close();
+      collectData();
+    });
+    source.onerror = () => {
+      // CLOSED means the browser gave up rather than retrying.
+      if (source.readyState == EventSource.CLOSED) setTimeout(collectData, fetchDelay);
+    };
+  }
+
 
 
   // must be async to use await.
@@ -496,7 +525,10 @@ const char plotlyHTML[] PROGMEM = R"rawliteral(
     if (latest == oldLatest) return;
     let jjj;
     if (debug) console.log("last rec = " + pointsReceived + " latest = " + latest + " fetchDelay = " + fetchDelay);
-    const res = await fetch("http://~IP~/runT?oldest=" + (latest+1));
+    let url = "http://~IP~/runT?oldest=" + (latest+1);
+    // A long history is thinned by CBASS to about two points per pixel across the plot.
+    if (latest < 0 || morePoints) url += "&maxPoints=" + Math.max(400, 2 * TESTER.clientWidth);
+    const res = await fetch(url);
     // console.log('Response status: ' + res.status);
     if (!res.ok) {
       throw new Error(`HTTP error: ${res.status}`);
@@ -509,9 +541,19 @@ const char plotlyHTML[] PROGMEM = R"rawliteral(
     //  }');
 
     pointsReceived = Object.keys(jjj.points).length;
+    morePoints = ("next" in jjj);
     if (debug) console.log("Received " + pointsReceived + " points.  Latest was " + latest);
     if (pointsReceived == 0) return;
     oldLatest = latest;
+    plotPoints(jjj);
+  }
+
+  // Add points from /runT or /events to the plot, skipping any already there.
+  function plotPoints(jjj) {
+    var debug = 0;
+    const keys = Object.keys(jjj.points).filter(k => parseInt(k) > latest);
+    const pointsReceived = keys.length;
+    if (pointsReceived == 0) return;
 
     //if (~NT~ != jjj.NT) {
     //  document.getElementById('bbb').innerText="ERROR: NT in data (" + jjj.NT + ") != NT of this page (" + ~NT~ + ")";
@@ -531,7 +573,7 @@ const char plotlyHTML[] PROGMEM = R"rawliteral(
     let times = Array(2 * jjj.NT).fill().map(() => Array(pointsReceived));
     let temps = Array(2 * jjj.NT).fill().map(() => Array(pointsReceived));  // Double length due to targets.
     let n = 0;
-    for (var key in jjj.points) {
+    for (const key of keys) {
       latest = parseInt(key);
       const pt = jjj.points[key];
       for (let i=0; i < jjj.NT; i++) {
@@ -571,7 +613,7 @@ const char plotlyHTML[] PROGMEM = R"rawliteral(
     Plotly.extendTraces(TESTER, data, listNT, 6*3600/5);
 
     // === Update text information ===
-    pt = jjj.points[latest];
+    const pt = jjj.points[latest];
 
     let delta = 0.0;
     for (let i=1; i <= ~NT~; i++) {
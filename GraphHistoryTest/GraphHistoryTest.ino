@@ -0,0 +1,96 @@
+/*
+ * Benchmark for the graph history store used by CBASS_32_BoardV2.
+ *
+ * Every GRAPHwindow ms the main loop adds a DataPoint and, once the history
+ * is full, drops the oldest one.  This compares the old approach (std::vector
+ * with erase(begin())) to the RingBuffer now used, by timing the append as the
+ * history fills and then runs full.  The vector's cost grows with the number
+ * of stored points; the ring buffer's should stay flat.
+ *
+ * To run on a board, copy RingBuffer.h from CBASS_32_BoardV2 into this folder.
+ * The HostSim build finds it there directly (target graph_history_bench).
+ */
+#define NT 8  // Worst case for memory.
+#include <RTClib.h>
+#include <vector>
+#include <esp_timer.h>
+#include "RingBuffer.h"
+
+// The same as the DataPoint in CBASS_32_BoardV2/Definitions.h, without the rounding helper.
+struct DataPoint
+{
+  uint32_t timestamp;
+  uint32_t epoch;
+  int16_t target[NT];
+  int16_t actual[NT];
+  DataPoint(long unsigned int t, DateTime dt, double tar[NT], double act[NT]) {
+    timestamp = t;
+    epoch = dt.unixtime();
+    for (int i = 0; i < NT; i++) {
+      target[i] = (int16_t)lrint(tar[i] * 100.0);
+      actual[i] = (int16_t)lrint(act[i] * 100.0);
+    }
+  }
+};
+
+// These would be varying values in the application.  Here they just fill space.
+double setPoint[] = {21, 22, 23, 24, 25, 26, 27, 28};
+double tempT[] = {22, 23, 24, 25, 26, 27, 28, 29};
+DateTime t = DateTime("2024-04-05T10:56:59");
+
+const int maxGraphPoints = (int)6*60*60/5; // 6 hours of points every 5 seconds.  12 hours may not fit twice.
+const int batch = 540;                     // Appends timed together.  A 16th of maxGraphPoints.
+
+void benchVector() {
+  std::vector<DataPoint> graphPoints;
+  graphPoints.reserve(maxGraphPoints);
+  Serial.println("std::vector with erase(begin())");
+  Serial.println("  size   us/append");
+  for (int n = 0; n < 2*maxGraphPoints; n += batch) {
+    int64_t start = esp_timer_get_time();
+    for (int j = 0; j < batch; j++) {
+      if (graphPoints.size() >= maxGraphPoints) graphPoints.erase(graphPoints.begin());
+      graphPoints.emplace_back(n + j, t, setPoint, tempT);
+    }
+    Serial.printf("%6d %11.2f\n", graphPoints.size(), (double)(esp_timer_get_time() - start) / batch);
+  }
+}
+
+void benchRing() {
+  RingBuffer<DataPoint> graphPoints;
+  graphPoints.reserve(maxGraphPoints);
+  Serial.println("RingBuffer");
+  Serial.println("  size   us/append");
+  for (int n = 0; n < 2*maxGraphPoints; n += batch) {
+    int64_t start = esp_timer_get_time();
+    for (int j = 0; j < batch; j++) {
+      graphPoints.emplace_back(n + j, t, setPoint, tempT);
+    }
+    Serial.printf("%6d %11.2f\n", graphPoints.size(), (double)(esp_timer_get_time() - start) / batch);
+  }
+  // Sanity check: the oldest point kept should be exactly maxGraphPoints behind the newest.
+  Serial.printf("Oldest %lu, newest %lu\n", graphPoints[0].timestamp, graphPoints.back().timestamp);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(5000);  // Serial does not initialize properly without a delay.
+  Serial.printf("sizeof(DataPoint) = %d, maxGraphPoints = %d\n", sizeof(DataPoint), maxGraphPoints);
+  benchVector();  // Each benchmark frees its memory before the next starts.
+  benchRing();
+}
+
+void loop() {
+  delay(1000);
+}
+
+/* Results on the host (HostSim, x86-64), NT = 8, 4320 points:
+  144-byte DataPoint (doubles and a DateTime):
+    std::vector: 0.06 us/append while filling, then 14 us/append once full.
+    RingBuffer:  0.01 to 0.07 us/append throughout.
+  40-byte packed DataPoint:
+    std::vector: 0.06 us/append while filling, then about 4 us/append once full.
+    RingBuffer:  about 0.05 us/append throughout.
+  The ESP32 moves memory far more slowly than the host, so the full-vector
+  cost there is several ms per point.
+ */
@@ -0,0 +1,46 @@
+# The etags test: a templated page, the chart page and a file from /htdocs,
+# asked for again with the ETags they were sent, must come back as 304 with no
+# body.  /LogManagement shows the size of the log, which grows between the two
+# boots, so it must come back whole.
+#   cmake -DSIM=cbass_sim -DCARD=dir -P ETags.cmake
+if(NOT SIM OR NOT CARD)
+  message(FATAL_ERROR "Set SIM to cbass_sim and CARD to the card directory.")
+endif()
+set(same / /Tchart.html /plotly.js)
+set(changed /LogManagement)
+set(gets)
+foreach(url ${same} ${changed})
+  list(APPEND gets --get ${url})
+endforeach()
+file(REMOVE_RECURSE ${CARD})
+
+execute_process(COMMAND ${SIM} --hours 0.01 --quiet --start 2024-06-01T08:00:00 --sd ${CARD} ${gets}
+  OUTPUT_VARIABLE out ERROR_QUIET RESULT_VARIABLE status)
+if(NOT status EQUAL 0)
+  message(FATAL_ERROR "cbass_sim failed.")
+endif()
+string(REGEX MATCHALL "ETag: \"[0-9a-f]+\"" tags "${out}")
+list(LENGTH tags n)
+if(NOT n EQUAL 4)
+  message(FATAL_ERROR "Expected 4 ETags, got ${n}: ${tags}")
+endif()
+string(REPLACE "ETag: " "" tags "${tags}")
+string(REPLACE ";" ", " tags "${tags}")
+
+execute_process(COMMAND ${SIM} --hours 0.05 --quiet --start 2024-06-01T08:01:00 --sd ${CARD}
+  --header "If-None-Match: ${tags}" ${gets}
+  OUTPUT_VARIABLE out ERROR_QUIET RESULT_VARIABLE status)
+if(NOT status EQUAL 0)
+  message(FATAL_ERROR "cbass_sim failed.")
+endif()
+foreach(url ${same})
+  string(REGEX MATCH "GET ${url} -> [^\n]*" line "${out}")
+  if(NOT line MATCHES "-> 304 .*, 0 bytes$")
+    message(FATAL_ERROR "Expected 304 with no body, got: ${line}")
+  endif()
+endforeach()
+string(REGEX MATCH "GET ${changed} -> [^\n]*" line "${out}")
+if(NOT line MATCHES "-> 200 ")
+  message(FATAL_ERROR "A changed page was not sent again: ${line}")
+endif()
+message("Unchanged pages and files 304, a changed page 200.")
@@ -0,0 +1,407 @@
+/**
+ * Host simulation driver for CBASS-32.
+ *
+ * Runs the unmodified CBASS_32_BoardV2 sketch against stand-in libraries and
+ * a thermal model of the tanks, on a virtual clock.  A 24 hour ramp runs in
+ * seconds, with LOG.txt and the rest of the "SD card" written to a host
+ * directory and the web server reachable through simulated requests.
+ *
+ * Usage: cbass_sim [options]
+ *   --hours H       Virtual hours to run after setup() (default 24).
+ *   --tick MS       Minimum virtual time per pass through loop() (default 10).
+ *   --start T       Boot time as Unix seconds or YYYY-MM-DDThh:mm:ss.
+ *   --sd DIR        Host directory for the microSD card (default ./sdcard).
+ *   --spiffs DIR    Host directory for SPIFFS (default: the sketch directory,
+ *                   so /htdocs/ is found).
+ *   --ambient C     Room temperature (default 25).
+ *   --get URL       Request URL after the run and print the response.  May be
+ *                   repeated.  The virtual time and SD traffic for each go
+ *                   to stderr.
+ *   --post URL FILE POST the contents of FILE to URL as JSON after the run, in
+ *                   order with the --get requests, and print the response.
+ *   --header H      Send header H, "Name: value", with each --get request.
+ *                   May be repeated.
+ *   --quiet         Discard the sketch's Serial output.
+ *   --max-error C   Exit with status 1 if any tank is further than C from its
+ *                   set point, after the first simulated hour.
+ *   --loop-timing N Have the sketch print control pass timing every N passes.
+ *                   The times are virtual, so only sensor waits, delays and
+ *                   bus transfers show up.
+ *   --load-test N   After the run, download the log and the board image with
+ *                   N clients at once.  Every third client drops part way and
+ *                   resumes with a Range request.  Exit status 1 if any body
+ *                   differs from the file on the card.
+ *   --relays FILE   Write the relay timeline to FILE as CSV: the virtual time
+ *                   in seconds and the latched shift register bits, one line
+ *                   each time an output changes.
+ *   --fail-renames N
+ *                   Make the first N renames on the card fail, as on a card
+ *                   going bad.
+ *   --events N      Keep N clients on /events through the run, as chart pages.
+ *                   Half way through each drops for a minute and reconnects
+ *                   with Last-Event-ID.  Exit status 1 unless each received
+ *                   every graph point exactly once, in order.
+ *
+ * Exit status is 2 if the watchdog fires, 3 if the sketch reboots itself.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#include "Sim.h"
+#include "SketchGlue.h"
+#include "ThermalModel.h"
+#include "libraries/ESPAsyncWebSrv.h"
+#include "libraries/RTClib.h"
+
+#ifndef CBASS_SKETCH_DIR
+#define CBASS_SKETCH_DIR "../CBASS_32_BoardV2"
+#endif
+
+static bool copyIfMissing(const std::string &from, const std::string &to) {
+  struct stat st;
+  if (stat(to.c_str(), &st) == 0) return true;
+  FILE *in = fopen(from.c_str(), "rb");
+  if (!in) return false;
+  FILE *out = fopen(to.c_str(), "wb");
+  if (!out) {
+    fclose(in);
+    return false;
+  }
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) fwrite(buf, 1, n, out);
+  fclose(in);
+  fclose(out);
+  return true;
+}
+
+static std::string readFile(const std::string &path) {
+  std::string s;
+  FILE *in = fopen(path.c_str(), "rb");
+  if (!in) return s;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) s.append(buf, n);
+  fclose(in);
+  return s;
+}
+
+struct LoadClient {
+  String url;
+  std::string path;  // The file on the card the body should match.
+  bool drop;         // Disconnect half way and resume with a Range request.
+  std::unique_ptr<SimExchange> ex;
+  std::string body;
+  size_t total = 0;
+  bool resumed = false;
+};
+
+static std::unique_ptr<SimExchange> startDownload(const String &url, size_t from) {
+  SimHttpRequest req;
+  req.url = url;
+  if (from) req.headers.emplace_back("Range", String("bytes=") + String((unsigned long)from) + "-");
+  return sketch::webServer().simBegin(req);
+}
+
+/**
+ * Download the log and the board image with several clients at once, taking
+ * a TCP window from each in turn as AsyncTCP would.  Returns the number of
+ * clients that got the wrong bytes.
+ */
+static int loadTest(int clients) {
+  std::vector<LoadClient> all(clients);
+  for (int i = 0; i < clients; i++) {
+    LoadClient &c = all[i];
+    bool log = i % 2 == 0;
+    c.url = log ? String("/LogDownload?magicWord=") + sketch::magicWord : String("/32Board.png");
+    c.path = sim::sdPath(log ? "/LOG.txt" : "/htdocsSD/32Board.png");
+    c.drop = i % 3 == 2;
+    c.ex = startDownload(c.url, 0);
+    c.total = c.ex->response() ? c.ex->response()->contentLength() : 0;
+  }
+  uint64_t startUs = sim::micros64();
+  size_t bytes = 0;
+  int failures = 0, active = clients;
+  std::vector<uint8_t> buf(1436);
+  while (active > 0) {
+    for (LoadClient &c : all) {
+      if (!c.ex) continue;
+      size_t n = c.ex->pull(buf.data(), buf.size());
+      c.body.append((const char *)buf.data(), n);
+      bytes += n;
+      if (n && c.drop && !c.resumed && c.body.size() >= c.total / 2) {
+        c.ex->disconnect();
+        c.ex = startDownload(c.url, c.body.size());
+        c.resumed = true;
+        const AsyncWebServerResponse *r = c.ex->response();
+        const AsyncWebHeader *range = r ? r->header("Content-Range") : nullptr;
+        if (!r || r->code() != 206 || !range) {
+          fprintf(stderr, "Load test: resuming %s did not give a 206 with Content-Range.\n", c.url.c_str());
+          failures++;
+          c.ex.reset();
+          active--;
+        }
+        continue;
+      }
+      if (n) continue;
+      bool ok = c.body.size() == c.total && c.body == readFile(c.path);
+      if (!ok) {
+        fprintf(stderr, "Load test: %s gave %zu bytes of %zu, not matching %s.\n", c.url.c_str(), c.body.size(), c.total, c.path.c_str());
+        failures++;
+      }
+      c.ex.reset();
+      active--;
+    }
+  }
+  fprintf(stderr, "Load test: %d clients, %zu bytes in %.1f ms virtual time, %d wrong.\n", clients, bytes,
+          (sim::micros64() - startUs) / 1e3, failures);
+  return failures;
+}
+
+/**
+ * A chart page listening on /events.  Points are kept as the page keeps
+ * them, skipping any not newer than the last.
+ */
+struct EventClient {
+  std::unique_ptr<SimExchange> ex;
+  std::string pending;             // Stream text not yet parsed.
+  std::string lastId;
+  std::vector<unsigned long> times;
+  size_t events = 0, bytes = 0, repeats = 0, resyncs = 0, reconnects = 0;
+
+  void connect() {
+    SimHttpRequest req;
+    req.url = "/events";
+    if (lastId.size()) req.headers.emplace_back("Last-Event-ID", String(lastId.c_str()));
+    ex = sketch::webServer().simBegin(req);
+  }
+
+  // Take everything the server has queued, as the browser would.
+  void pump() {
+    if (!ex) return;
+    uint8_t buf[1436];
+    size_t n;
+    while ((n = ex->pull(buf, sizeof(buf))) > 0) {
+      pending.append((const char *)buf, n);
+      bytes += n;
+    }
+    size_t end;
+    while ((end = pending.find("\r\n\r\n")) != std::string::npos) {
+      parse(pending.substr(0, end + 2));
+      pending.erase(0, end + 4);
+    }
+  }
+
+  void parse(const std::string &ev) {
+    std::string name, data;
+    for (size_t at = 0, eol; (eol = ev.find("\r\n", at)) != std::string::npos; at = eol + 2) {
+      std::string line = ev.substr(at, eol - at);
+      if (!line.compare(0, 4, "id: ")) lastId = line.substr(4);
+      else if (!line.compare(0, 7, "event: ")) name = line.substr(7);
+      else if (!line.compare(0, 6, "data: ")) data += line.substr(6);
+    }
+    events++;
+    if (name == "resync") resyncs++;
+    if (name != "points") return;
+    // Keys are the timestamps: "54492":{"datetime":...
+    for (size_t at = 0; (at = data.find("\":{\"datetime\"", at)) != std::string::npos; at++) {
+      size_t open = data.rfind('"', at - 1);
+      unsigned long t = strtoul(data.c_str() + open + 1, nullptr, 10);
+      if (!times.empty() && t <= times.back()) repeats++;
+      else times.push_back(t);
+    }
+  }
+};
+
+static void usage() {
+  fprintf(stderr,
+          "usage: cbass_sim [--hours H] [--tick MS] [--start T] [--sd DIR] [--spiffs DIR]\n"
+          "                 [--ambient C] [--get URL]... [--post URL FILE]... [--header H]... [--quiet] [--max-error C]\n"
+          "                 [--loop-timing N] [--load-test N] [--events N] [--fail-renames N]\n");
+  exit(64);
+}
+
+int main(int argc, char **argv) {
+  double hours = 24;
+  uint32_t tickMs = 10;
+  double ambient = 25.0;
+  double maxError = -1;
+  int loadClients = 0;
+  int eventClients = 0;
+  const char *relayPath = nullptr;
+  std::vector<std::pair<String, std::string>> gets;  // URLs, with a body to POST or empty.
+  std::vector<std::pair<String, String>> headers;
+  sim::spiffsRoot = CBASS_SKETCH_DIR;
+
+  for (int a = 1; a < argc; a++) {
+    auto next = [&]() -> const char * {
+      if (a + 1 >= argc) usage();
+      return argv[++a];
+    };
+    if (!strcmp(argv[a], "--hours")) hours = atof(next());
+    else if (!strcmp(argv[a], "--tick")) tickMs = atoi(next());
+    else if (!strcmp(argv[a], "--sd")) sim::sdRoot = next();
+    else if (!strcmp(argv[a], "--spiffs")) sim::spiffsRoot = next();
+    else if (!strcmp(argv[a], "--ambient")) ambient = atof(next());
+    else if (!strcmp(argv[a], "--get")) gets.emplace_back(next(), std::string());
+    else if (!strcmp(argv[a], "--post")) {
+      String url = next();
+      std::string body = readFile(next());
+      if (body.empty()) usage();
+      gets.emplace_back(url, body);
+    }
+    else if (!strcmp(argv[a], "--header")) {
+      String h = next();
+      int colon = h.indexOf(':');
+      if (colon < 1) usage();
+      String value = h.substring(colon + 1);
+      value.trim();
+      headers.emplace_back(h.substring(0, colon), value);
+    } else if (!strcmp(argv[a], "--quiet")) sim::quiet = true;
+    else if (!strcmp(argv[a], "--max-error")) maxError = atof(next());
+    else if (!strcmp(argv[a], "--loop-timing")) sketch::setLoopTiming(atoi(next()));
+    else if (!strcmp(argv[a], "--load-test")) loadClients = atoi(next());
+    else if (!strcmp(argv[a], "--events")) eventClients = atoi(next());
+    else if (!strcmp(argv[a], "--relays")) relayPath = next();
+    else if (!strcmp(argv[a], "--fail-renames")) sim::sdRenameFailures = atoi(next());
+    else if (!strcmp(argv[a], "--start")) {
+      const char *s = next();
+      sim::epochAtBoot = strchr(s, 'T') ? DateTime(s).unixtime() : strtoul(s, nullptr, 10);
+    } else usage();
+  }
+
+  // A fresh card gets the example Settings.ini and the board image the
+  // sketch serves from SD.
+  mkdir(sim::sdRoot.c_str(), 0755);
+  copyIfMissing(CBASS_SKETCH_DIR "/INI/Settings.ini", sim::sdPath("/Settings.ini"));
+  mkdir(sim::sdPath("/htdocsSD").c_str(), 0755);
+  copyIfMissing(CBASS_SKETCH_DIR "/htdocsSD/32Board.png", sim::sdPath("/htdocsSD/32Board.png"));
+
+  ThermalModel plant(sketch::tanks, sketch::heaterRelay, sketch::chillRelay, sketch::latchPin, sketch::dataPin, sketch::clockPin);
+  plant.ambientC = ambient;
+  for (TankParams &p : plant.tanks) p.startC = ambient;
+  plant.attach();
+  FILE *relayLog = nullptr;
+  if (relayPath) {
+    relayLog = fopen(relayPath, "w");
+    if (!relayLog) {
+      fprintf(stderr, "Cannot write %s.\n", relayPath);
+      return 1;
+    }
+    fprintf(relayLog, "seconds,outputs\n");
+    plant.onOutputs = [relayLog](uint64_t us, uint32_t outputs) {
+      fprintf(relayLog, "%.6f,0x%04x\n", us / 1e6, (unsigned)outputs);
+    };
+  }
+
+  auto wallStart = std::chrono::steady_clock::now();
+  unsigned long loops = 0;
+  double worstError = 0;
+  int status = 0;
+  std::vector<EventClient> listeners(eventClients);
+  try {
+    sketch::setup();
+    uint64_t setupEndUs = sim::micros64();
+    uint64_t endUs = setupEndUs + (uint64_t)(hours * 3600e6);
+    uint64_t tickUs = (uint64_t)tickMs * 1000;
+    uint64_t dropUs = setupEndUs + (endUs - setupEndUs) / 2, backUs = dropUs + 60000000;
+    for (EventClient &c : listeners) c.connect();
+    while (sim::micros64() < endUs) {
+      uint64_t before = sim::micros64();
+      sketch::loop();
+      loops++;
+      for (EventClient &c : listeners) {
+        c.pump();
+        if (c.ex && c.reconnects == 0 && before >= dropUs) {
+          c.ex.reset();
+        } else if (!c.ex && before >= backUs) {
+          c.connect();
+          c.reconnects++;
+        }
+      }
+      uint64_t spent = sim::micros64() - before;
+      if (spent < tickUs) sim::spend(tickUs - spent);
+      if (sim::micros64() - setupEndUs > 3600000000ULL) {
+        for (int i = 0; i < sketch::tanks; i++) {
+          worstError = std::max(worstError, std::fabs(sketch::temperature(i) - sketch::setPoint(i)));
+        }
+      }
+    }
+  } catch (const sim::Watchdog &w) {
+    fprintf(stderr, "Watchdog reset at %.3f s virtual time.\n", w.atUs / 1e6);
+    status = 2;
+  } catch (const sim::Restart &r) {
+    fprintf(stderr, "Sketch restarted itself at %.3f s virtual time.\n", r.atUs / 1e6);
+    status = 3;
+  }
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  double virt = sim::micros64() / 1e6;
+
+  fprintf(stderr, "Simulated %.2f h in %.2f s wall time (%.0fx), %lu loop passes, %.1f us wall per pass.\n",
+          virt / 3600, wall, virt / wall, loops, loops ? wall * 1e6 / loops : 0.0);
+  fprintf(stderr, "SD card sectors read %llu, written %llu.\n",
+          (unsigned long long)sim::sdSectorReads, (unsigned long long)sim::sdSectorWrites);
+  fprintf(stderr, "Relay latches %lu, output changes %lu, graph points %zu.\n",
+          plant.latchPulses(), plant.relayChanges(), sketch::graphPointCount());
+  if (relayLog) {
+    plant.onOutputs = nullptr;
+    fclose(relayLog);
+  }
+  for (int i = 0; i < sketch::tanks; i++) {
+    fprintf(stderr, "  Tank %d: set %.2f C, water %.2f C, heater on %.0f s, chiller on %.0f s\n", i + 1,
+            sketch::setPoint(i), plant.temperature(i), plant.heaterSeconds(i), plant.chillerSeconds(i));
+  }
+  if (loops) fprintf(stderr, "Largest tracking error after the first hour: %.2f C\n", worstError);
+  if (status == 0 && maxError >= 0 && worstError > maxError) {
+    fprintf(stderr, "FAIL: tracking error exceeds %.2f C\n", maxError);
+    status = 1;
+  }
+
+  for (const auto &g : gets) {
+    const String &url = g.first;
+    const char *method = g.second.empty() ? "GET" : "POST";
+    uint64_t startUs = sim::micros64(), reads = sim::sdSectorReads, writes = sim::sdSectorWrites;
+    SimHttpRequest req;
+    req.url = url;
+    req.headers = headers;
+    if (!g.second.empty()) {
+      req.method = HTTP_POST;
+      req.body = g.second;
+      req.headers.emplace_back("Content-Type", "application/json");
+    }
+    SimHttpResult r = sketch::webServer().simFetch(req);
+    fprintf(stderr, "%s %s took %.1f ms virtual time, SD sectors read %llu, written %llu.\n", method, url.c_str(),
+            (sim::micros64() - startUs) / 1e3, (unsigned long long)(sim::sdSectorReads - reads),
+            (unsigned long long)(sim::sdSectorWrites - writes));
+    printf("%s %s -> %d %s, %zu bytes\n", method, url.c_str(), r.code, r.contentType.c_str(), r.body.size());
+    for (const AsyncWebHeader &h : r.headers) printf("%s: %s\n", h.name().c_str(), h.value().c_str());
+    printf("\n");
+    fwrite(r.body.data(), 1, r.body.size(), stdout);
+    printf("\n");
+  }
+  if (loadClients > 0 && loadTest(loadClients) > 0 && status == 0) status = 1;
+  if (eventClients > 0) {
+    for (EventClient &c : listeners) c.pump();
+    std::vector<unsigned long> stored = sketch::graphPointTimes();
+    int wrong = 0;
+    for (const EventClient &c : listeners) {
+      // Points restored from the card at boot are older than any client.
+      auto first = std::lower_bound(stored.begin(), stored.end(), c.times.empty() ? 0 : c.times.front());
+      wrong += !std::equal(c.times.begin(), c.times.end(), first, stored.end()) || c.repeats || c.resyncs;
+    }
+    const EventClient &c = listeners[0];
+    fprintf(stderr, "Events: %d clients, each %zu events, %zu bytes, %zu points of %zu stored, %zu repeats, %zu resyncs; %d wrong.\n",
+            eventClients, c.events, c.bytes, c.times.size(), stored.size(), c.repeats, c.resyncs, wrong);
+    fprintf(stderr, "Events: polling /runT every 5 s instead would have taken %.0f requests.\n",
+            eventClients * hours * 3600 / 5);
+    if (wrong && status == 0) status = 1;
+  }
+  return status;
+}
@@ -0,0 +1,43 @@
+# The log_format test: the same hours on a text card and on a LOGFORMAT BINARY
+# card must download as the same CSV.  At 27 C the PID outputs pass through
+# values which print as "-0.0", so the minus sign of a zero is covered too.
+#   cmake -DSIM=cbass_sim -DOUT=dir -P LogFormat.cmake
+if(NOT SIM OR NOT OUT)
+  message(FATAL_ERROR "Set SIM to cbass_sim and OUT to a directory for the cards.")
+endif()
+file(READ ${CMAKE_CURRENT_LIST_DIR}/../CBASS_32_BoardV2/INI/Settings.ini settings)
+foreach(format text binary)
+  set(card ${OUT}/sd_log_${format})
+  file(REMOVE_RECURSE ${card})
+  file(MAKE_DIRECTORY ${card})
+  if(format STREQUAL binary)
+    file(WRITE ${card}/Settings.ini "${settings}LOGFORMAT BINARY\n")
+  else()
+    file(WRITE ${card}/Settings.ini "${settings}")
+  endif()
+  execute_process(
+    COMMAND ${SIM} --hours 10 --quiet --ambient 27 --start 2024-06-01T12:00:00 --sd ${card}
+            --get /LogDownload?magicWord=Auckland
+    OUTPUT_VARIABLE out ERROR_QUIET RESULT_VARIABLE status)
+  if(NOT status EQUAL 0)
+    message(FATAL_ERROR "cbass_sim failed on the ${format} card.")
+  endif()
+  # The body follows the status line and headers.
+  string(FIND "${out}" "\n\n" end)
+  if(end LESS 0 OR NOT out MATCHES "^GET [^\n]* -> 200 ")
+    message(FATAL_ERROR "No log download from the ${format} card.")
+  endif()
+  math(EXPR end "${end} + 2")
+  string(SUBSTRING "${out}" ${end} -1 body_${format})
+endforeach()
+if(NOT EXISTS ${OUT}/sd_log_binary/LOG.bin OR EXISTS ${OUT}/sd_log_binary/LOG.txt)
+  message(FATAL_ERROR "The binary card did not log to LOG.bin.")
+endif()
+if(NOT body_text MATCHES ",-0\\.0,")
+  message(FATAL_ERROR "The text log has no -0.0 to compare.")
+endif()
+if(NOT body_text STREQUAL body_binary)
+  message(FATAL_ERROR "The binary log downloads differently from the text log.")
+endif()
+string(LENGTH "${body_text}" bytes)
+message("Text and binary logs download the same, ${bytes} bytes.")
@@ -0,0 +1,51 @@
+# Writes the ramp plan bodies for the ramp_upload tests, as the ramp plan
+# page would POST them to /updateRampPlan.
+#   cmake -DOUT=dir -DTANKS=4 -P PlanJSON.cmake
+# plan.json has 300 rows, four minutes apart.  Tank k in row r is
+#   26.00 + 0.50 * k + 0.01 * r
+# so the last row, at 19:56, is 28.99, 29.49, ...  plan_bad.json is the same
+# with rows 200 and 201 swapped, so its times go backwards.
+if(NOT OUT OR NOT TANKS)
+  message(FATAL_ERROR "Set OUT to the output directory and TANKS to NT.")
+endif()
+math(EXPR lastTank "${TANKS} - 1")
+foreach(variant good bad)
+  set(rows "")
+  foreach(r RANGE 0 299)
+    set(m ${r})
+    if(variant STREQUAL "bad" AND r EQUAL 200)
+      set(m 201)
+    elseif(variant STREQUAL "bad" AND r EQUAL 201)
+      set(m 200)
+    endif()
+    math(EXPR m "${m} * 4")
+    math(EXPR h "${m} / 60")
+    math(EXPR mm "${m} % 60")
+    if(h LESS 10)
+      set(h "0${h}")
+    endif()
+    if(mm LESS 10)
+      set(mm "0${mm}")
+    endif()
+    set(temps "")
+    foreach(k RANGE 0 ${lastTank})
+      math(EXPR t "2600 + ${k} * 50 + ${r}")
+      math(EXPR whole "${t} / 100")
+      math(EXPR frac "${t} % 100")
+      if(frac LESS 10)
+        set(frac "0${frac}")
+      endif()
+      if(k GREATER 0)
+        string(APPEND temps ",")
+      endif()
+      string(APPEND temps "\"${whole}.${frac}\"")
+    endforeach()
+    string(APPEND rows "{\"time\":\"${h}:${mm}\",\"tempList\":[${temps}]},")
+  endforeach()
+  set(body "[${rows}{\"startTime\":\"13:00\"},{\"magicWord\":\"Auckland\"}]")
+  if(variant STREQUAL "good")
+    file(WRITE ${OUT}/plan.json "${body}")
+  else()
+    file(WRITE ${OUT}/plan_bad.json "${body}")
+  endif()
+endforeach()
@@ -0,0 +1,73 @@
+#include "Sim.h"
+
+#include <utility>
+#include <vector>
+
+namespace sim {
+
+static uint64_t nowUs = 0;
+
+uint32_t epochAtBoot = 1717243200;  // 2024-06-01 12:00:00
+uint32_t wdtTimeoutSeconds = 0;
+static std::vector<std::pair<void *, uint64_t>> wdtLastReset;  // Per subscribed task.
+
+std::string sdRoot = "sdcard";
+std::string spiffsRoot = ".";
+bool quiet = false;
+
+uint64_t sdSectorReads = 0;
+uint64_t sdSectorWrites = 0;
+uint32_t sdReadUs = 250;    // 512 bytes over SPI at 20 MHz, plus command overhead.
+uint32_t sdWriteUs = 1000;  // Typical busy time of a single-block write.
+uint32_t sdCallUs = 2;      // SdFat's checks and cache lookup on an ESP32.
+int sdRenameFailures = 0;
+
+std::function<void(uint8_t, uint8_t)> onPinWrite;
+int sensorCount = 0;
+std::function<float(int)> readSensor;
+
+uint64_t micros64() {
+  return nowUs;
+}
+
+void advanceMicros(uint64_t us) {
+  nowUs += us;
+  for (const auto &w : wdtLastReset) {
+    if (nowUs - w.second > (uint64_t)wdtTimeoutSeconds * 1000000ULL) throw Watchdog{nowUs};
+  }
+}
+
+void wdtAdd(void *task) {
+  for (const auto &w : wdtLastReset) {
+    if (w.first == task) return;
+  }
+  wdtLastReset.emplace_back(task, nowUs);
+}
+
+void wdtReset(void *task) {
+  for (auto &w : wdtLastReset) {
+    if (w.first == task) w.second = nowUs;
+  }
+}
+
+void advanceMillis(uint32_t ms) {
+  advanceMicros((uint64_t)ms * 1000ULL);
+}
+
+// Paths on the sketch side always start at the root of the card.  Strip
+// any leading slashes and hang them under the host directory.
+static std::string under(const std::string &root, const char *path) {
+  while (*path == '/') path++;
+  if (*path == 0) return root;
+  return root + "/" + path;
+}
+
+std::string sdPath(const char *path) {
+  return under(sdRoot, path);
+}
+
+std::string spiffsPath(const char *path) {
+  return under(spiffsRoot, path);
+}
+
+}  // namespace sim
@@ -0,0 +1,86 @@
+/**
+ * Shared state for the host simulation of CBASS-32.
+ *
+ * The stand-in libraries under libraries/ know nothing about tanks or relays.
+ * Everything they need from the simulated world comes through this header:
+ * 1) A virtual clock.  millis(), delay() and the RTC all read it, so a 24 hour
+ *    ramp can run in seconds.
+ * 2) Host directories standing in for the microSD card and SPIFFS.
+ * 3) Hooks which the thermal model (or a test) fills in: pin writes and
+ *    sensor readings.
+ */
+#ifndef CBASS_SIM_H
+#define CBASS_SIM_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace sim {
+
+// ===== Virtual clock =====
+// Microseconds since simulated power-on.  Only the task scheduler, and
+// spend() while the loop task is alone, move it forward.
+uint64_t micros64();
+void advanceMicros(uint64_t us);
+void advanceMillis(uint32_t ms);
+
+// The calling task spends us microseconds: in delay(), on a bus, or pushing
+// pixels.  Other FreeRTOS tasks may run meanwhile (see FreeRTOS.h).
+void spend(uint64_t us);
+
+// Unix time (seconds) at simulated power-on, used by the RTC stand-in.
+extern uint32_t epochAtBoot;
+
+// ===== Watchdog =====
+// esp_task_wdt_* record here, per subscribed task.  If the virtual clock
+// moves past the timeout without a reset from each of them, the driver is
+// told by a Watchdog exception.
+extern uint32_t wdtTimeoutSeconds;
+void wdtAdd(void *task);
+void wdtReset(void *task);
+
+struct Watchdog {
+  uint64_t atUs;
+};
+struct Restart {
+  uint64_t atUs;
+};
+
+// ===== Filesystems =====
+// Host directories that play the part of the microSD card and SPIFFS.
+extern std::string sdRoot;
+extern std::string spiffsRoot;
+std::string sdPath(const char *path);
+std::string spiffsPath(const char *path);
+
+// ===== microSD traffic =====
+// The SdFat stand-in counts 512-byte sector transfers roughly as SdFat makes
+// them, with its one-sector cache, and spends this long on each.  Each
+// read(), peek() or write() call also costs sdCallUs, even from the cache, so
+// a byte at a time is slow as it is on the board.  exists() reads a directory
+// sector.
+extern uint64_t sdSectorReads;
+extern uint64_t sdSectorWrites;
+extern uint32_t sdReadUs;
+extern uint32_t sdWriteUs;
+extern uint32_t sdCallUs;
+// This many SdFat32::rename() calls fail before they change anything, as on
+// a card going bad.  Counts down.
+extern int sdRenameFailures;
+
+// ===== Console =====
+// When quiet, Serial output is discarded.  Useful for long runs.
+extern bool quiet;
+
+// ===== Hardware hooks =====
+// Called for every digitalWrite(), after the pin state is stored.
+extern std::function<void(uint8_t pin, uint8_t val)> onPinWrite;
+// Number of DS18B20 sensors on the OneWire bus.
+extern int sensorCount;
+// Temperature in C of sensor "index" at the current virtual time.
+extern std::function<float(int index)> readSensor;
+
+}  // namespace sim
+
+#endif
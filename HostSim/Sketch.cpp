@@ -0,0 +1,47 @@
+/**
+ * The CBASS_32_BoardV2 sketch, compiled for the host.
+ *
+ * The Arduino IDE concatenates the .ino files of a sketch, main file first
+ * and the rest in alphabetical order, and compiles the result as one
+ * translation unit.  This file does the same with #include.  Prototypes the
+ * IDE would generate come from Definitions.h, as the sketch asks.
+ *
+ * Nothing here changes the sketch.  The few lines at the end let the
+ * simulation driver reach setup(), loop() and the pin and relay tables.
+ */
+#include "../CBASS_32_BoardV2/CBASS_32_BoardV2.ino"
+#include "../CBASS_32_BoardV2/Display.ino"
+#include "../CBASS_32_BoardV2/PID.ino"
+#include "../CBASS_32_BoardV2/RTC.ino"
+#include "../CBASS_32_BoardV2/Relays.ino"
+#include "../CBASS_32_BoardV2/SD.ino"
+#include "../CBASS_32_BoardV2/Sensors.ino"
+#include "../CBASS_32_BoardV2/Server.ino"
+#include "../CBASS_32_BoardV2/WiFi.ino"
+
+#include "SketchGlue.h"
+
+namespace sketch {
+
+const int tanks = NT;
+const uint8_t *heaterRelay = HeaterRelay;
+const uint8_t *chillRelay = ChillRelay;
+const uint8_t latchPin = LATCH_PIN;
+const uint8_t dataPin = DATA_PIN;
+const uint8_t clockPin = CLOCK_PIN;
+const char *magicWord = MAGICWORD;
+
+void setup() { ::setup(); }
+void loop() { ::loop(); }
+AsyncWebServer &webServer() { return server; }
+double setPoint(int tank) { return ::setPoint[tank]; }
+double temperature(int tank) { return ::tempT[tank]; }
+size_t graphPointCount() { return graphPoints.size(); }
+std::vector<unsigned long> graphPointTimes() {
+  std::vector<unsigned long> t;
+  for (const DataPoint &p : graphPoints) t.push_back(p.timestamp);
+  return t;
+}
+void setLoopTiming(unsigned int passes) { loopTimingPasses = passes; }
+
+}  // namespace sketch
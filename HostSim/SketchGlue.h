@@ -0,0 +1,36 @@
+/**
+ * What the simulation driver, tests and benchmarks may use from the sketch.
+ * The sketch's globals are not visible outside Sketch.cpp, so everything
+ * goes through here.
+ */
+#ifndef CBASS_SKETCHGLUE_H
+#define CBASS_SKETCHGLUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class AsyncWebServer;
+
+namespace sketch {
+
+extern const int tanks;
+extern const uint8_t *heaterRelay;
+extern const uint8_t *chillRelay;
+extern const uint8_t latchPin;
+extern const uint8_t dataPin;
+extern const uint8_t clockPin;
+extern const char *magicWord;
+
+void setup();
+void loop();
+AsyncWebServer &webServer();
+double setPoint(int tank);
+double temperature(int tank);
+size_t graphPointCount();
+std::vector<unsigned long> graphPointTimes();
+void setLoopTiming(unsigned int passes);
+
+}  // namespace sketch
+
+#endif
@@ -0,0 +1,40 @@
+# The static_gzip test: /plotly.js from SPIFFS /htdocs, once from a browser
+# which accepts gzip and once from one which does not.  The first must get
+# plotly.js.gz as is, the second the plain file, and both must say the body
+# depends on Accept-Encoding.
+#   cmake -DSIM=cbass_sim -DCARD=dir -DHTDOCS=dir -P StaticGzip.cmake
+if(NOT SIM OR NOT CARD OR NOT HTDOCS)
+  message(FATAL_ERROR "Set SIM to cbass_sim, CARD to the card directory and HTDOCS to the sketch's htdocs.")
+endif()
+file(REMOVE_RECURSE ${CARD})
+file(SIZE ${HTDOCS}/plotly.js plain)
+file(SIZE ${HTDOCS}/plotly.js.gz gzipped)
+foreach(accept "gzip, deflate, br" "identity")
+  execute_process(COMMAND ${SIM} --hours 0.01 --quiet --sd ${CARD} --header "Accept-Encoding: ${accept}" --get /plotly.js
+    OUTPUT_VARIABLE out ERROR_QUIET RESULT_VARIABLE status)
+  if(NOT status EQUAL 0)
+    message(FATAL_ERROR "cbass_sim failed.")
+  endif()
+  # The status line and headers, before the body.
+  string(FIND "${out}" "\n\n" end)
+  string(SUBSTRING "${out}" 0 ${end} head)
+  if(NOT head MATCHES "\nVary: Accept-Encoding(\n|$)")
+    message(FATAL_ERROR "No Vary: Accept-Encoding for ${accept}:\n${head}")
+  endif()
+  if(accept MATCHES "gzip")
+    if(NOT head MATCHES "-> 200 application/javascript, ${gzipped} bytes" OR NOT head MATCHES "\nContent-Encoding: gzip(\n|$)")
+      message(FATAL_ERROR "plotly.js.gz was not sent to a gzip browser:\n${head}")
+    endif()
+  else()
+    if(NOT head MATCHES "-> 200 application/javascript, ${plain} bytes" OR head MATCHES "Content-Encoding")
+      message(FATAL_ERROR "The plain plotly.js was not sent:\n${head}")
+    endif()
+    file(READ ${HTDOCS}/plotly.js file)
+    math(EXPR start "${end} + 2")
+    string(SUBSTRING "${out}" ${start} ${plain} body)
+    if(NOT body STREQUAL file)
+      message(FATAL_ERROR "The plain plotly.js body differs from the file.")
+    endif()
+  endif()
+endforeach()
+message("plotly.js sent gzipped only to a browser which accepts it.")
@@ -0,0 +1,66 @@
+#include "ThermalModel.h"
+
+#include <cmath>
+#include "Sim.h"
+
+ThermalModel::ThermalModel(int tanks, const uint8_t *heaterBit, const uint8_t *chillBit, uint8_t latchPin, uint8_t dataPin, uint8_t clockPin)
+    : tanks(tanks), _n(tanks), _heaterBit(heaterBit, heaterBit + tanks), _chillBit(chillBit, chillBit + tanks),
+      _latchPin(latchPin), _dataPin(dataPin), _clockPin(clockPin),
+      _tempC(tanks), _heatOnS(tanks, 0.0), _chillOnS(tanks, 0.0) {
+  for (int i = 0; i < _n; i++) _tempC[i] = this->tanks[i].startC;
+}
+
+void ThermalModel::attach() {
+  for (int i = 0; i < _n; i++) _tempC[i] = tanks[i].startC;
+  _lastUs = sim::micros64();
+  sim::sensorCount = _n;
+  sim::onPinWrite = [this](uint8_t pin, uint8_t val) { pinWrite(pin, val); };
+  sim::readSensor = [this](int i) { return (float)temperature(i); };
+}
+
+void ThermalModel::pinWrite(uint8_t pin, uint8_t val) {
+  if (pin == _dataPin) {
+    _data = val;
+  } else if (pin == _clockPin) {
+    if (val && !_clock) _shift = ((_shift << 1) | (_data ? 1 : 0)) & 0xFFFF;  // Two 8-bit stages.
+    _clock = val;
+  } else if (pin == _latchPin) {
+    if (val && !_latch) {
+      _latches++;
+      if (_shift != _outputs) {
+        advanceTo(sim::micros64());
+        _outputs = _shift;
+        _changes++;
+        if (onOutputs) onOutputs(sim::micros64(), _outputs);
+      }
+    }
+    _latch = val;
+  }
+}
+
+double ThermalModel::temperature(int tank) {
+  advanceTo(sim::micros64());
+  return _tempC[tank];
+}
+
+// dT/dt = (P - k (T - ambient)) / C has the solution
+// T(t) = Teq + (T0 - Teq) exp(-k t / C), with Teq = ambient + P / k.
+void ThermalModel::advanceTo(uint64_t us) {
+  if (us <= _lastUs) return;
+  double dt = (us - _lastUs) / 1e6;
+  _lastUs = us;
+  for (int i = 0; i < _n; i++) {
+    const TankParams &p = tanks[i];
+    double watts = 0;
+    if (heaterOn(i)) {
+      watts += p.heaterWatts;
+      _heatOnS[i] += dt;
+    }
+    if (chillerOn(i)) {
+      watts -= p.chillerWatts;
+      _chillOnS[i] += dt;
+    }
+    double eq = ambientC + watts / p.lossToRoom;
+    _tempC[i] = eq + (_tempC[i] - eq) * std::exp(-p.lossToRoom * dt / p.heatCapacity);
+  }
+}
@@ -0,0 +1,76 @@
+/**
+ * A simple thermal plant for the host simulation.
+ *
+ * Each tank is a single lumped heat capacity which loses heat to the room
+ * through a fixed conductance and gains or loses it through one heater and
+ * one chiller.  Relay states come from an emulated 74HC595 chain: the model
+ * watches the latch, data and clock pins, shifts on each rising clock edge,
+ * and copies the shift stage to the outputs on each rising latch edge, just
+ * as the chips on the board do.  The result is the value of shiftRegBits.
+ *
+ * Between relay changes the power in each tank is constant, so the exact
+ * exponential solution is used and the model never has to be stepped.
+ * Temperatures are brought up to date when a sensor is read or an output
+ * changes.
+ */
+#ifndef CBASS_THERMALMODEL_H
+#define CBASS_THERMALMODEL_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct TankParams {
+  double heatCapacity = 41800.0;  // J/K, about 10 L of water.
+  double lossToRoom = 2.0;        // W/K
+  double heaterWatts = 300.0;
+  double chillerWatts = 150.0;
+  double startC = 25.0;
+};
+
+class ThermalModel {
+public:
+  // heaterBit[i] and chillBit[i] are the shift register outputs for tank i,
+  // the same tables the sketch uses (HeaterRelay and ChillRelay).
+  ThermalModel(int tanks, const uint8_t *heaterBit, const uint8_t *chillBit, uint8_t latchPin, uint8_t dataPin, uint8_t clockPin);
+
+  // Install the sim::onPinWrite and sim::readSensor hooks.
+  void attach();
+
+  double ambientC = 25.0;
+  std::vector<TankParams> tanks;
+
+  // Temperature of tank i now, integrating from the last update.
+  double temperature(int tank);
+  // The relay outputs as latched by the emulated shift registers.
+  uint32_t outputs() const { return _outputs; }
+  bool heaterOn(int tank) const { return (_outputs >> _heaterBit[tank]) & 1; }
+  bool chillerOn(int tank) const { return (_outputs >> _chillBit[tank]) & 1; }
+
+  // Total seconds each relay has been on, for reporting.
+  double heaterSeconds(int tank) const { return _heatOnS[tank]; }
+  double chillerSeconds(int tank) const { return _chillOnS[tank]; }
+  // Number of latch pulses which changed at least one output.
+  unsigned long relayChanges() const { return _changes; }
+  // Number of latch pulses in total.
+  unsigned long latchPulses() const { return _latches; }
+
+  // Optional observer called whenever the outputs change.
+  std::function<void(uint64_t us, uint32_t outputs)> onOutputs;
+
+  void pinWrite(uint8_t pin, uint8_t val);
+
+private:
+  void advanceTo(uint64_t us);
+
+  int _n;
+  std::vector<uint8_t> _heaterBit, _chillBit;
+  uint8_t _latchPin, _dataPin, _clockPin;
+  uint8_t _latch = 0, _data = 0, _clock = 0;
+  uint32_t _shift = 0, _outputs = 0;
+  uint64_t _lastUs = 0;
+  std::vector<double> _tempC, _heatOnS, _chillOnS;
+  unsigned long _changes = 0, _latches = 0;
+};
+
+#endif
@@ -0,0 +1,42 @@
+# Writes a card for the ramp_week test: a Settings.ini whose START has a date
+# and names a PLANFILE, and /Week.txt, a step a minute for seven days.
+#   cmake -DCARD=dir -P WeekPlan.cmake
+# Tank k at minute m of the plan is
+#   26.00 + 4.00 * (distance from midnight, in half days) + 0.20 * day + 0.50 * k
+# so a target read from the wrong day or tank shows in the log.
+if(NOT CARD)
+  message(FATAL_ERROR "Set CARD to the card directory.")
+endif()
+file(MAKE_DIRECTORY ${CARD})
+file(WRITE ${CARD}/Settings.ini
+  "// A week of logger temperatures, a step a minute, from midnight on 1 June.\n"
+  "START 2024-06-01 0:00\n"
+  "INTERP LINEAR\n"
+  "PLANFILE /Week.txt\n")
+
+set(lines "// Time  T1  T2  T3  T4\n")
+foreach(m RANGE 0 10080)
+  math(EXPR day "${m} / 1440")
+  math(EXPR dayMin "${m} % 1440")
+  if(dayMin GREATER 720)
+    math(EXPR dayMin "1440 - ${dayMin}")
+  endif()
+  math(EXPR base "2600 + (${dayMin} * 400 + 360) / 720 + ${day} * 20")
+  math(EXPR h "${m} / 60")
+  math(EXPR mm "${m} % 60")
+  if(mm LESS 10)
+    set(mm "0${mm}")
+  endif()
+  string(APPEND lines "${h}:${mm}")
+  foreach(k RANGE 0 3)
+    math(EXPR t "${base} + ${k} * 50")
+    math(EXPR whole "${t} / 100")
+    math(EXPR frac "${t} % 100")
+    if(frac LESS 10)
+      set(frac "0${frac}")
+    endif()
+    string(APPEND lines " ${whole}.${frac}")
+  endforeach()
+  string(APPEND lines "\n")
+endforeach()
+file(WRITE ${CARD}/Week.txt "${lines}")
@@ -0,0 +1,8 @@
+// Host build of the GraphHistoryTest sketch.  The whole benchmark runs in setup().
+#include <Arduino.h>  // The IDE adds this ahead of every sketch.
+#include "../../GraphHistoryTest/GraphHistoryTest.ino"
+
+int main() {
+  setup();
+  return 0;
+}
@@ -0,0 +1,67 @@
+// Bytes and host time for /runT over 12 hours of graph points: the whole
+// history, and thinned with maxPoints as a phone-sized chart asks for it.
+// Times are real host time.  Like template_bench, the whole sketch is built
+// into this program.
+#include "../Sketch.cpp"
+
+#include <cstdio>
+#include <sys/stat.h>
+#include <esp_timer.h>
+
+#ifndef CBASS_SKETCH_DIR
+#define CBASS_SKETCH_DIR "../CBASS_32_BoardV2"
+#endif
+
+double usPerGet(const char *url, int reps, size_t &bytes) {
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < reps; i++) bytes = server.simGet(url).body.size();
+  return (double)(esp_timer_get_time() - start) / reps;
+}
+
+int main() {
+  // setup() needs a card with Settings.ini.
+  sim::quiet = true;
+  sim::spiffsRoot = CBASS_SKETCH_DIR;
+  sim::sdRoot = "history_bench_sd";
+  mkdir(sim::sdRoot.c_str(), 0755);
+  FILE *in = fopen(CBASS_SKETCH_DIR "/INI/Settings.ini", "rb");
+  FILE *out = fopen(sim::sdPath("/Settings.ini").c_str(), "wb");
+  if (!in || !out) {
+    fprintf(stderr, "Cannot copy Settings.ini to %s.\n", sim::sdRoot.c_str());
+    return 1;
+  }
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) fwrite(buf, 1, n, out);
+  fclose(in);
+  fclose(out);
+  ::setup();
+
+  // 12 hours of points, 5 s apart, each tank following a slow ramp with noise.
+  graphPoints.clear();
+  DateTime t0(2024, 6, 1, 12, 0, 0);
+  for (unsigned long i = 0; i < 8640; i++) {
+    double tar[NT], act[NT];
+    for (int k = 0; k < NT; k++) {
+      tar[k] = 26 + 6 * sin(i / 1400.0 + k);
+      act[k] = tar[k] + 0.3 * sin(i * 0.7 + k) + ((i * 7919 + k) % 17 == 0 ? 1.5 : 0);
+    }
+    graphPoints.emplace_back(10000 + i * 5000, t0 + TimeSpan(i * 5), tar, act);
+  }
+
+  const char *urls[] = {"/runT", "/runT?maxPoints=1600", "/runT?maxPoints=600", "/runT?maxPoints=200"};
+  const int reps = 20;
+  size_t fullBytes = 0;
+  double fullUs = 0;
+  printf("%-22s %9s %10s %8s %8s\n", "request", "bytes", "us", "smaller", "faster");
+  for (const char *url : urls) {
+    size_t bytes;
+    double us = usPerGet(url, reps, bytes);
+    if (!fullBytes) {
+      fullBytes = bytes;
+      fullUs = us;
+    }
+    printf("%-22s %9zu %10.0f %7.1fx %7.1fx\n", url, bytes, us, (double)fullBytes / bytes, fullUs / us);
+  }
+  return 0;
+}
@@ -0,0 +1,86 @@
+// Host time to find the targets for every second of a day, with the old
+// interpolation of getCurrentTargets() and with the compiled RampPlan, for
+// plans with a step every five minutes and every minute.  Also the largest
+// difference between the two.  Times are real host time.  Like
+// template_bench, the whole sketch is built into this program.
+#include "../Sketch.cpp"
+
+#include <cstdio>
+#include <cmath>
+#include <esp_timer.h>
+
+// getCurrentTargets() before RampPlan, with its arrays passed in.
+struct LegacyRamp {
+  std::vector<unsigned int> minutes;
+  std::vector<short> hundredths[NT];
+  short rampPos = 0;
+
+  void targetsAt(unsigned int dayMin, int second, double out[NT]) {
+    short steps = minutes.size();
+    if (minutes[rampPos] > dayMin) rampPos = 0;
+    while (rampPos < steps - 1 && minutes[rampPos + 1] <= dayMin) rampPos++;
+    if (dayMin < minutes[rampPos]) {
+      for (int i = 0; i < NT; i++) out[i] = (double)hundredths[i][0] / 100.0;
+      return;
+    }
+    if (rampPos < steps - 1) {
+      double dayValue = (float)dayMin + second / 60.0;
+      double frac = (dayValue - minutes[rampPos]) / (minutes[rampPos + 1] - minutes[rampPos]);
+      for (int i = 0; i < NT; i++) {
+        out[i] = ((double)hundredths[i][rampPos] + frac * ((double)hundredths[i][rampPos + 1] - (double)hundredths[i][rampPos])) / 100.0;
+      }
+      return;
+    }
+    for (int i = 0; i < NT; i++) out[i] = (double)hundredths[i][rampPos] / 100.0;
+  }
+};
+
+void bench(unsigned int everyMinutes) {
+  LegacyRamp legacy;
+  RampPlan plan;
+  for (unsigned int m = 0; m <= 24 * 60; m += everyMinutes) {
+    int h[NT];
+    for (int i = 0; i < NT; i++) h[i] = (int)lround(2700 + 600 * sin(m / 180.0 + i));
+    legacy.minutes.push_back(m);
+    for (int i = 0; i < NT; i++) legacy.hundredths[i].push_back(h[i]);
+    plan.add(m, h);
+  }
+  plan.compile(true);
+
+  const int days = 20;
+  volatile double sink = 0;
+  double old[NT];
+  int64_t start = esp_timer_get_time();
+  for (int d = 0; d < days; d++) {
+    for (uint32_t s = 0; s < 86400; s++) {
+      legacy.targetsAt(s / 60, s % 60, old);
+      sink = sink + old[0];
+    }
+  }
+  double legacyNs = (esp_timer_get_time() - start) * 1000.0 / days / 86400;
+
+  int16_t now[NT];
+  start = esp_timer_get_time();
+  for (int d = 0; d < days; d++) {
+    for (uint32_t s = 0; s < 86400; s++) {
+      plan.targetsAt(s, now);
+      sink = sink + now[0];
+    }
+  }
+  double compiledNs = (esp_timer_get_time() - start) * 1000.0 / days / 86400;
+
+  double worst = 0;
+  for (uint32_t s = 0; s < 86400; s++) {
+    legacy.targetsAt(s / 60, s % 60, old);
+    plan.targetsAt(s, now);
+    for (int i = 0; i < NT; i++) worst = std::max(worst, fabs(old[i] - now[i] / 100.0));
+  }
+  printf("%5zu steps %12.1f %12.1f %7.1fx %10.3f\n", plan.size(), legacyNs, compiledNs, legacyNs / compiledNs, worst);
+}
+
+int main() {
+  printf("%11s %12s %12s %8s %10s\n", "plan", "legacy ns", "compiled ns", "faster", "max diff");
+  bench(5);
+  bench(1);
+  return 0;
+}
@@ -0,0 +1,371 @@
+// Settings.ini on the card.  By default, the time to read a 300 line plan at
+// boot with the old line reader (readBytesUntil, peek, strtok and sscanf) and
+// with readRampPlan() and SettingsParser, and to save it after a web edit with
+// rewriteSettingsINI(), in host time and in the simulator's virtual card time.
+// With --rewrite, a saved plan must read back the same, and the files left by
+// a restart part way through a save must be repaired.  With --fuzz N, N files
+// mutated from the INI examples and the sample lines of ParseSettingsTest are
+// each parsed whole and in small random blocks, and any two parses of a file
+// must agree, errors must point inside the file, and the examples must parse.
+// Either check exits with status 1 on failure.  Like template_bench, the whole
+// sketch is built into this program.
+#include "../Sketch.cpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <esp_timer.h>
+
+#ifndef CBASS_SKETCH_DIR
+#define CBASS_SKETCH_DIR "../CBASS_32_BoardV2"
+#endif
+
+static std::string readHostFile(const std::string &path) {
+  std::string s;
+  FILE *in = fopen(path.c_str(), "rb");
+  if (!in) return s;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) s.append(buf, n);
+  fclose(in);
+  return s;
+}
+
+static bool writeHostFile(const std::string &path, const std::string &s) {
+  FILE *out = fopen(path.c_str(), "wb");
+  if (!out) return false;
+  fwrite(s.data(), 1, s.size(), out);
+  fclose(out);
+  return true;
+}
+
+// The ramp line handling of readRampPlan() before SettingsParser.  Returns the steps read.
+static int legacyRead() {
+  const int maxLine = 128;
+  char lineBuffer[maxLine + 1];
+  int nRead, hh, mm, pos;
+  double tempRead;
+  RampPlan plan;
+  int temps[NT];
+  File32 f = SDF.open("/Settings.ini", O_RDONLY);
+  while (f.available()) {
+    nRead = f.readBytesUntil('\n', lineBuffer, maxLine);
+    lineBuffer[max(0, nRead)] = 0;
+    if (nRead > 0 && (lineBuffer[nRead - 1] == '\n' || lineBuffer[nRead - 1] == '\r')) lineBuffer[nRead - 1] = 0;
+    while (f.peek() == '\n') f.read();
+    while (f.peek() == '\r') f.read();
+    if (nRead == 0 || lineBuffer[0] == '/') {
+      ;
+    } else if (!strncmp(lineBuffer, "START", 5)) {
+      sscanf(lineBuffer + 5, "%d:%d", &hh, &mm);
+    } else if (!strncmp(lineBuffer, "INTERP", 6)) {
+      pos = 6;
+      while (isSpace(lineBuffer[pos])) pos++;
+    } else if (isDigit(lineBuffer[0])) {
+      sscanf(lineBuffer, "%d:%d", &hh, &mm);
+      char *token = strtok(lineBuffer, " \t");
+      token = strtok(NULL, " \t");
+      int tank = 0;
+      while (token != NULL) {
+        if (tank < NT) {
+          sscanf(token, "%lf", &tempRead);
+          temps[tank++] = round(tempRead * 100);
+        }
+        token = strtok(NULL, " \t");
+      }
+      plan.add(hh * 60 + mm, temps);
+    }
+  }
+  f.close();
+  return plan.size();
+}
+
+// A fresh card with a 300 line Settings.ini, and setup() run on it.  Returns the file's size, or 0.
+static size_t bootCard() {
+  sim::quiet = true;
+  sim::spiffsRoot = CBASS_SKETCH_DIR;
+  sim::sdRoot = "settings_bench_sd";
+  std::filesystem::remove_all(sim::sdRoot);  // Backups from the last run.
+  mkdir(sim::sdRoot.c_str(), 0755);
+  std::string ini = "// 300 steps, four minutes apart.\nSTART 6:00\nINTERP LINEAR\n";
+  char line[96];
+  for (int k = 0; k < 300; k++) {
+    int m = k * 4;
+    snprintf(line, sizeof(line), "%d:%02d", m / 60, m % 60);
+    ini += line;
+    for (int i = 0; i < NT; i++) {
+      snprintf(line, sizeof(line), "\t%.2f", 26 + 4 * sin(k / 30.0 + i));
+      ini += line;
+    }
+    ini += "\n";
+  }
+  if (!writeHostFile(sim::sdPath("/Settings.ini"), ini)) {
+    fprintf(stderr, "Cannot write Settings.ini in %s.\n", sim::sdRoot.c_str());
+    return 0;
+  }
+  ::setup();
+  return ini.size();
+}
+
+static int bench() {
+  size_t size = bootCard();
+  if (!size) return 1;
+
+  const int reps = 20;
+  printf("%d byte Settings.ini, %d ramp lines, %d runs each\n", (int)size, 300, reps);
+  printf("%-20s %10s %12s %14s %14s\n", "", "host us", "virtual ms", "sector reads", "sector writes");
+  const char *names[] = {"readBytesUntil", "SettingsParser", "rewriteSettingsINI"};
+  for (int pass = 0; pass < 3; pass++) {
+    uint64_t virt = sim::micros64(), reads = sim::sdSectorReads, writes = sim::sdSectorWrites;
+    int64_t host = esp_timer_get_time();
+    for (int r = 0; r < reps; r++) {
+      if (pass == 0) legacyRead();
+      else if (pass == 1) readRampPlan();
+      else rewriteSettingsINI();
+    }
+    printf("%-20s %10.0f %12.1f %14.1f %14.1f\n", names[pass], (double)(esp_timer_get_time() - host) / reps,
+           (sim::micros64() - virt) / 1000.0 / reps, (double)(sim::sdSectorReads - reads) / reps,
+           (double)(sim::sdSectorWrites - writes) / reps);
+  }
+  printf("Ramp plan now has %d steps.\n", (int)rampPlan.size());
+  return 0;
+}
+
+// ===== Rewriting =====
+
+static std::string planText() {
+  std::string out;
+  for (size_t k = 0; k < rampPlan.size(); k++) {
+    out += std::to_string(rampPlan.minutes(k));
+    for (int i = 0; i < NT; i++) out += "," + std::to_string(rampPlan.hundredths(i, k));
+    out += ";";
+  }
+  return out;
+}
+
+static int problems = 0;
+static void check(bool ok, const char *what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    problems++;
+  }
+}
+
+/**
+ * rewriteSettingsINI() as a web edit uses it: the plan must read back the
+ * same, with each old file kept under the next backup name.  Then the two
+ * states a restart can leave, which readRampPlan() must repair.
+ */
+static int rewrite() {
+  if (!bootCard()) return 1;
+  std::string plan = planText();
+  check(rewriteSettingsINI(), "rewrite");
+  readRampPlan();
+  check(planText() == plan, "the plan reads back the same");
+  check(SDF.exists("/WebBack/Rbk000.ini"), "the first backup is Rbk000.ini");
+  check(rewriteSettingsINI() && SDF.exists("/WebBack/Rbk001.ini"), "the second backup is Rbk001.ini");
+
+  // A card from before the counter: the names in use are skipped.
+  SDF.remove(INIcounterPath);
+  check(rewriteSettingsINI() && SDF.exists("/WebBack/Rbk002.ini"), "without Rbk.cnt, the next free name is used");
+  check(readHostFile(sim::sdPath(INIcounterPath)) == "0000000003\n", "Rbk.cnt is advanced");
+
+  // Cut off between the two renames.
+  std::string text = readHostFile(sim::sdPath(INIpath));
+  SDF.rename(INIpath, "/WebBack/Rbk003.ini");
+  writeHostFile(sim::sdPath(INInewPath), text);
+  readRampPlan();
+  check(SDF.exists(INIpath) && !SDF.exists(INInewPath), "Settings.new is renamed into place");
+  check(planText() == plan, "the plan from Settings.new is the same");
+
+  // Cut off while Settings.new was written.
+  writeHostFile(sim::sdPath(INInewPath), text.substr(0, text.size() / 2) + "12:3");
+  readRampPlan();
+  check(!SDF.exists(INInewPath), "a partial Settings.new is removed");
+  check(readHostFile(sim::sdPath(INIpath)) == text && planText() == plan, "Settings.ini is unchanged");
+  printf("%d problems.\n", problems);
+  return problems ? 1 : 0;
+}
+
+// ===== Fuzzing =====
+
+static uint32_t rng = 2463534242u;
+static uint32_t rnd(uint32_t n) {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return n ? rng % n : 0;
+}
+
+// Everything a parse produced, as text, so two parses can be compared.
+static std::string parse(const std::string &in, size_t maxBlock, unsigned long &errorLine, unsigned long &errorColumn,
+                         const char *&error) {
+  RampPlan plan;
+  SettingsParser ini(plan, MAX_RAMP_STEPS);
+  size_t at = 0;
+  while (at < in.size()) {
+    size_t n = maxBlock ? 1 + rnd(maxBlock) : in.size();
+    n = std::min(n, in.size() - at);
+    if (!ini.feed(in.data() + at, n)) break;
+    at += n;
+  }
+  ini.finish();
+  errorLine = ini.errorLine;
+  errorColumn = ini.errorColumn;
+  error = ini.error;
+  char buf[512];
+  snprintf(buf, sizeof(buf), "err=%s@%lu:%lu start=%d,%u,%u interp=%d lights=%d,%d log=%d,%lu,%d plan=%s temps=%d,%d steps=%d;",
+           ini.error ? ini.error : "-", ini.errorLine, ini.errorColumn, ini.relativeStart, ini.startMinutes,
+           (unsigned)ini.startEpoch, ini.interpolate, ini.lightOnMinutes, ini.lightOffMinutes, ini.logBinary, ini.logRollKB,
+           ini.logRollMinutes, ini.planFile, ini.fewestTemps, ini.extraTemps, (int)plan.size());
+  std::string out = buf;
+  for (size_t k = 0; k < plan.size(); k++) {
+    out += std::to_string(plan.minutes(k));
+    for (int i = 0; i < NT; i++) out += "," + std::to_string(plan.hundredths(i, k));
+    out += ";";
+  }
+  return out;
+}
+
+// The lines of s, split independently of SettingsParser, for checking where errors point.
+static std::vector<size_t> lineLengths(const std::string &s) {
+  std::vector<size_t> lengths;
+  size_t len = 0;
+  for (size_t k = 0; k < s.size(); k++) {
+    if (s[k] == '\n' || s[k] == '\r') {
+      lengths.push_back(len);
+      len = 0;
+      if (s[k] == '\r' && k + 1 < s.size() && s[k + 1] == '\n') k++;
+    } else {
+      len++;
+    }
+  }
+  if (len) lengths.push_back(len);
+  return lengths;
+}
+
+static std::string randomLine(const std::string &s) {
+  std::vector<size_t> starts{0};
+  for (size_t k = 0; k < s.size(); k++) {
+    if (s[k] == '\n') starts.push_back(k + 1);
+  }
+  size_t a = starts[rnd(starts.size())];
+  size_t b = s.find('\n', a);
+  return s.substr(a, b == std::string::npos ? std::string::npos : b + 1 - a);
+}
+
+static void mutate(std::string &s, const std::vector<std::string> &seeds) {
+  static const char alphabet[] = "0123456789:.-+ \t\r\n/STARTINTERPLINEARSTEPLIGHTONOFF xyz";
+  char pick = rnd(20) == 0 ? (char)rnd(256) : alphabet[rnd(sizeof(alphabet) - 1)];
+  size_t at = rnd(s.size() + 1);
+  switch (rnd(9)) {
+    case 0:
+      if (!s.empty()) s[std::min(at, s.size() - 1)] = pick;
+      break;
+    case 1:
+      s.insert(at, 1, pick);
+      break;
+    case 2:
+      s.erase(at, 1 + rnd(8));
+      break;
+    case 3:
+      s.insert(s.find('\n', at) == std::string::npos ? s.size() : s.find('\n', at) + 1, randomLine(s));
+      break;
+    case 4: {
+      std::string out;
+      const char *eol = rnd(2) ? "\r\n" : "\r";
+      for (char c : s) {
+        if (c == '\n') out += eol;
+        else out += c;
+      }
+      s = out;
+      break;
+    }
+    case 5:
+      s.insert(at, 1 + rnd(200), rnd(2) ? '9' : ' ');
+      break;
+    case 6:
+      s.resize(at);
+      break;
+    case 7:
+      s.insert(s.find('\n', at) == std::string::npos ? s.size() : s.find('\n', at) + 1, randomLine(seeds[rnd(seeds.size())]));
+      break;
+    default: {
+      // A number somewhere, often out of range.
+      const char *numbers[] = {"24:00", "23:59", "0:60", "99999:00", "100000:00", "-1", "1e3", "327.68", "-327.68",
+                               "26.005", "0026", ".5", "5.", "2024-13-01", "2024-06-01", "4294967296"};
+      s.insert(at, numbers[rnd(sizeof(numbers) / sizeof(numbers[0]))]);
+      break;
+    }
+  }
+}
+
+static int fuzz(long count) {
+  std::vector<std::string> seeds;
+  for (const char *name : {"Settings.ini", "EightTankExample.ini", "SystemTestExample.ini"}) {
+    seeds.push_back(readHostFile(std::string(CBASS_SKETCH_DIR "/INI/") + name));
+    if (seeds.back().empty()) {
+      fprintf(stderr, "Cannot read INI/%s.\n", name);
+      return 1;
+    }
+  }
+  // The lines ParseSettingsTest was written against, and the keywords added since.
+  seeds.push_back("START 14:30\nINTERP STEP\n07:00       26.00  26.00  26.00  26.00\t24.0\n"
+                  "08:00  27.5 27.5 27.5 27.5 // Comment after a value\n");
+  seeds.push_back("START 2024-06-01 0:00\r\nINTERP LINEAR\r\nLIGHTON 6:07\r\nLIGHTOFF 18:23\r\n"
+                  "LOGFORMAT BINARY\r\nLOGROLLKB 4096\r\nLOGROLLTIME 0:00\r\n0:00 26 26 26 26\r\n75:30 -1.5 +2 .25 30.125\r\n");
+  seeds.push_back("// Streamed\nSTART 13:00\nPLANFILE /Week.txt\n");
+
+  int bad = 0;
+  unsigned long line, column;
+  const char *error;
+  for (size_t k = 0; k < seeds.size(); k++) {
+    parse(seeds[k], 0, line, column, error);
+    if (error) {
+      printf("Example %d fails at line %lu, column %lu: %s\n", (int)k, line, column, error);
+      bad++;
+    }
+  }
+  std::string first = parse(seeds[0], 0, line, column, error);
+  if (first.find("4;0,2600,2600,2600,2600;180,2800,3000,3200,3400;360,") == std::string::npos) {
+    printf("INI/Settings.ini parsed as %s\n", first.c_str());
+    bad++;
+  }
+
+  long errors = 0;
+  for (long n = 0; n < count; n++) {
+    std::string s = seeds[rnd(seeds.size())];
+    for (int m = 1 + rnd(4); m > 0; m--) mutate(s, seeds);
+    std::string whole = parse(s, 0, line, column, error);
+    std::vector<size_t> lengths = lineLengths(s);
+    if (error) {
+      errors++;
+      bool tooLong = column == INIlineMax + 1;
+      if (line < 1 || line > lengths.size() || column < 1 ||
+          (!tooLong && column > lengths[line - 1] + 1) || (tooLong && lengths[line - 1] <= INIlineMax)) {
+        printf("File %ld: error at line %lu, column %lu is outside the file (%d lines).\n", n, line, column,
+               (int)lengths.size());
+        bad++;
+      }
+    }
+    for (size_t block : {1, 2, 7, 64}) {
+      std::string split = parse(s, block, line, column, error);
+      if (split != whole) {
+        printf("File %ld: blocks of up to %d give\n  %s\nnot\n  %s\n", n, (int)block, split.c_str(), whole.c_str());
+        bad++;
+        break;
+      }
+    }
+    if (bad > 10) break;
+  }
+  printf("%ld files, %ld with errors, %d problems.\n", count, errors, bad);
+  return bad ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc == 3 && !strcmp(argv[1], "--fuzz")) return fuzz(atol(argv[2]));
+  if (argc == 2 && !strcmp(argv[1], "--rewrite")) return rewrite();
+  return bench();
+}
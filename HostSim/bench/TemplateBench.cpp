@@ -0,0 +1,84 @@
+// Render time per page: the precompiled templates (PageTemplate.h) against
+// the way pages were rendered before, the library scanning each page for
+// placeholders and an if/else processor() returning Strings.  Times are real
+// host time.  The whole sketch is built into this program, so it is linked
+// against the stand-ins only, not cbass_sketch.
+#include "../Sketch.cpp"
+
+#include <cstdio>
+#include <sys/stat.h>
+#include <esp_timer.h>
+
+#ifndef CBASS_SKETCH_DIR
+#define CBASS_SKETCH_DIR "../CBASS_32_BoardV2"
+#endif
+
+// The old processor(): each name compared in turn, each value a new String.
+String legacyProcessor(const String &var) {
+  static const char *names[] = {"ERROR_MSG", "TITLE", "LINKLIST", "ROLLLOG", "DIRLIST", "NT", "IP",
+                                "TABLE_NT", "DATETIME", "LOGSTATS", "MAGIC", "DIRECTORY_CHOICE", "UPLOAD_LINK"};
+  for (const char *name : names) {
+    if (var == name) {
+      std::string value;
+      TemplateCapture out(value);
+      templateFill(templateKey(name))(out);
+      return String(value.c_str());
+    }
+  }
+  return String();
+}
+
+size_t renderLegacy(PGM_P page) {
+  AsyncProgmemResponse response(200, "text/html", (const uint8_t *)page, strlen(page), legacyProcessor);
+  uint8_t buf[1436];
+  size_t n, total = 0;
+  while ((n = response.simFill(buf, sizeof(buf))) > 0) total += n;
+  return total;
+}
+
+size_t renderCompiled(PGM_P page) {
+  TemplateRender render(pageTemplate(page));
+  uint8_t buf[1436];
+  size_t n, total = 0;
+  while ((n = render.read(buf, sizeof(buf))) > 0) total += n;
+  return total;
+}
+
+double usPerRender(size_t (*render)(PGM_P), PGM_P page, int reps) {
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < reps; i++) render(page);
+  return (double)(esp_timer_get_time() - start) / reps;
+}
+
+int main() {
+  // setup() needs a card with Settings.ini.
+  sim::quiet = true;
+  sim::spiffsRoot = CBASS_SKETCH_DIR;
+  sim::sdRoot = "template_bench_sd";
+  mkdir(sim::sdRoot.c_str(), 0755);
+  FILE *in = fopen(CBASS_SKETCH_DIR "/INI/Settings.ini", "rb");
+  FILE *out = fopen(sim::sdPath("/Settings.ini").c_str(), "wb");
+  if (!in || !out) {
+    fprintf(stderr, "Cannot copy Settings.ini to %s.\n", sim::sdRoot.c_str());
+    return 1;
+  }
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) fwrite(buf, 1, n, out);
+  fclose(in);
+  fclose(out);
+  ::setup();
+
+  // Pages which read the SD card are left out; the card would dominate.
+  struct { const char *name; PGM_P page; } pages[] = {
+      {"basePage", basePage}, {"aboutPage", aboutPage}, {"logHTML", logHTML}, {"syncTime", syncTime},
+      {"plotlyHTML", plotlyHTML}, {"rampPlanJavascript", rampPlanJavascript}, {"rebootPage", rebootPage}};
+  const int reps = 2000;
+  printf("%-20s %7s %12s %12s %8s\n", "page", "bytes", "old us", "compiled us", "speedup");
+  for (auto &p : pages) {
+    double before = usPerRender(renderLegacy, p.page, reps);
+    double after = usPerRender(renderCompiled, p.page, reps);
+    printf("%-20s %7zu %12.2f %12.2f %7.1fx\n", p.name, renderCompiled(p.page), before, after, before / after);
+  }
+  return 0;
+}
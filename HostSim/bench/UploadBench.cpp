@@ -0,0 +1,224 @@
+// A file sent to /Upload, as the upload page sends it, in pieces of one TCP
+// segment.  By default, the time for a 256 KB file with the old handler
+// (open, seek to the end, write a byte at a time and close for each piece,
+// after a one second delay) and with handleUpload() as it is now, in host
+// time and in the simulator's virtual card time, with the rate in KB/s.
+// With --check, uploads of several sizes must arrive whole, a second upload
+// while one is open must be refused, and a client which goes away part way
+// must leave no file behind, an upload which starts before the last one is
+// answered must not change that answer, and the graph points from a long upload must be
+// journaled once it ends.  The check exits with status 1 on failure.
+// Like settings_bench, the whole sketch is built into this program.
+#include "../Sketch.cpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <sys/stat.h>
+#include <esp_timer.h>
+
+#ifndef CBASS_SKETCH_DIR
+#define CBASS_SKETCH_DIR "../CBASS_32_BoardV2"
+#endif
+
+static std::string readHostFile(const std::string &path) {
+  std::string s;
+  FILE *in = fopen(path.c_str(), "rb");
+  if (!in) return s;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) s.append(buf, n);
+  fclose(in);
+  return s;
+}
+
+static void bootCard() {
+  sim::quiet = true;
+  sim::spiffsRoot = CBASS_SKETCH_DIR;
+  sim::sdRoot = "upload_bench_sd";
+  std::filesystem::remove_all(sim::sdRoot);
+  mkdir(sim::sdRoot.c_str(), 0755);
+  // The example settings, as cbass_sim gives a fresh card.
+  std::filesystem::copy_file(CBASS_SKETCH_DIR "/INI/Settings.ini", sim::sdPath("/Settings.ini"));
+  ::setup();
+  // Uploads run on the web server's task, which the watchdog does not watch.
+  sim::wdtTimeoutSeconds = 1000000;
+}
+
+// Run the sketch for us microseconds of virtual time, as cbass_sim does.
+static void run(uint64_t us) {
+  uint64_t end = sim::micros64() + us;
+  while (sim::micros64() < end) {
+    sketch::loop();
+    sim::spend(10000);
+  }
+}
+
+// The number of points in graphPoints which are not in GRAPH.jnl, once what
+// logTask has written is on the card.
+static size_t unjournaledPoints() {
+  graphJournal.close();
+  std::set<uint32_t> journaled;
+  GraphReader in;
+  uint8_t type;
+  const uint8_t *body;
+  DataPoint p;
+  if (in.begin(SDF, GRAPHjournalPath)) {
+    while (in.next(type, body) && type == GRAPHpoint) {
+      memcpy(&p, body, sizeof(p));
+      journaled.insert(p.timestamp);
+    }
+    in.end();
+  }
+  size_t missing = 0;
+  for (size_t i = 0; i < graphPoints.size(); i++) missing += !journaled.count(graphPoints[i].timestamp);
+  return missing;
+}
+
+static std::string content(size_t size, unsigned seed) {
+  std::string s(size, 0);
+  for (size_t k = 0; k < size; k++) {
+    seed = seed * 1103515245 + 12345;
+    s[k] = seed >> 16;
+  }
+  return s;
+}
+
+static SimHttpRequest uploadRequest(const char *name, const std::string &data) {
+  SimHttpRequest req;
+  req.method = HTTP_POST;
+  req.url = "/Upload";
+  req.form.push_back({"dirChoices", "/"});
+  req.uploadName = name;
+  req.uploadData = data;
+  return req;
+}
+
+// handleUpload() before the upload context, with its messages left out.
+static void legacyUpload(const char *name, const std::string &data, size_t chunk) {
+  String fullPath = String("/") + name;
+  for (size_t index = 0; index < data.size(); index += chunk) {
+    size_t len = min(chunk, data.size() - index);
+    const uint8_t *piece = (const uint8_t *)data.data() + index;
+    if (!index) {
+      delay(1000);
+      SDF.remove(fullPath);
+      pauseLogging(true);
+    }
+    File32 file = SDF.open(fullPath, O_WRONLY | O_CREAT | O_APPEND);
+    file.seekEnd(0);
+    if (file) {
+      for (size_t i = 0; i < len; i++) file.write(piece[i]);
+      file.close();
+    }
+    if (index + len == data.size()) pauseLogging(false);
+  }
+}
+
+static int bench() {
+  bootCard();
+  const size_t size = 256 * 1024;
+  const int reps = 5;
+  std::string data = content(size, 1);
+  printf("%u byte file in %u byte pieces, %d runs each\n", (unsigned)size, 1460u, reps);
+  printf("%-16s %10s %12s %10s %14s %14s\n", "", "host us", "virtual ms", "KB/s", "sector reads", "sector writes");
+  const char *names[] = {"open per piece", "handleUpload"};
+  for (int pass = 0; pass < 2; pass++) {
+    uint64_t virt = sim::micros64(), reads = sim::sdSectorReads, writes = sim::sdSectorWrites;
+    int64_t host = esp_timer_get_time();
+    for (int r = 0; r < reps; r++) {
+      if (pass == 0) legacyUpload("bench.bin", data, 1460);
+      else sketch::webServer().simFetch(uploadRequest("bench.bin", data));
+    }
+    double ms = (sim::micros64() - virt) / 1000.0 / reps;
+    printf("%-16s %10.0f %12.1f %10.1f %14.1f %14.1f\n", names[pass], (double)(esp_timer_get_time() - host) / reps,
+           ms, size / 1.024 / ms, (double)(sim::sdSectorReads - reads) / reps,
+           (double)(sim::sdSectorWrites - writes) / reps);
+    if (readHostFile(sim::sdPath("/bench.bin")) != data) {
+      printf("FAILED: %s left a different file.\n", names[pass]);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// ===== Checking =====
+
+static int problems = 0;
+static void check(bool ok, const char *what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    problems++;
+  }
+}
+
+static int checkUploads() {
+  bootCard();
+  // Empty, under a sector, whole sectors, and pieces which split sectors every way.
+  const size_t sizes[] = {0, 1, 511, 512, 1460, 2048, 5000, 65536 + 7};
+  for (size_t size : sizes) {
+    std::string data = content(size, size);
+    SimHttpResult r = sketch::webServer().simFetch(uploadRequest("sized.bin", data));
+    check(r.code == 200, "an upload was not accepted");
+    check(readHostFile(sim::sdPath("/sized.bin")) == data, "an upload did not arrive whole");
+  }
+  check(openDownloads == 0 && !logPaused, "logging did not resume after the uploads");
+
+  // A second upload while the first is open is refused, and the first is
+  // removed when its client goes away.
+  SimHttpRequest first = uploadRequest("first.bin", content(20000, 7));
+  first.uploadStall = 8 * 1460;
+  std::unique_ptr<SimExchange> open = sketch::webServer().simBegin(first);
+  check(!open->response(), "a stalled upload was answered");
+  check(logPaused, "logging went on during an upload");
+  SimHttpResult r = sketch::webServer().simFetch(uploadRequest("second.bin", content(3000, 8)));
+  check(r.code == 503, "a second upload at once was not refused");
+  check(!std::filesystem::exists(sim::sdPath("/second.bin")), "a refused upload left a file");
+  open->disconnect();
+  check(!std::filesystem::exists(sim::sdPath("/first.bin")), "an abandoned upload left a file");
+  check(openDownloads == 0 && !logPaused, "logging did not resume after an abandoned upload");
+
+  // After that, uploads go through again.
+  std::string data = content(3000, 9);
+  r = sketch::webServer().simFetch(uploadRequest("third.bin", data));
+  check(r.code == 200 && readHostFile(sim::sdPath("/third.bin")) == data, "an upload after an abandoned one failed");
+
+  // Each upload keeps its own outcome, though another starts between its last
+  // piece and its answer.
+  SimHttpRequest held = uploadRequest("held.bin", content(5000, 11));
+  held.holdEnd = true;
+  open = sketch::webServer().simBegin(held);
+  r = sketch::webServer().simFetch(uploadRequest("between.bin", data));
+  check(r.code == 200, "an upload after the last piece of another was not accepted");
+  open->finish();
+  check(open->response() && open->response()->code() == 200, "an upload was refused because another followed it");
+  open->disconnect();
+
+  // A new directory which already exists is an error, and nothing is written.
+  SimHttpRequest clash = uploadRequest("clash.bin", data);
+  clash.form = {{"dirChoices", "--new--"}, {"newdir", "third.bin"}};
+  r = sketch::webServer().simFetch(clash);
+  check(r.code == 500, "an upload into an existing name was accepted");
+  check(!std::filesystem::exists(sim::sdPath("/third.bin/clash.bin")), "a refused upload left a file");
+  check(openDownloads == 0 && !logPaused, "logging did not resume after a refused upload");
+
+  // Logging pauses for an upload, however long.  The graph points from then on are
+  // journaled from graphPoints when it ends.
+  SimHttpRequest slow = uploadRequest("slow.bin", content(20000, 10));
+  slow.uploadStall = 1460;
+  open = sketch::webServer().simBegin(slow);
+  run(300000000);
+  open->disconnect();
+  run(10000000);
+  // The newest point may wait for the next snapshot.
+  check(unjournaledPoints() <= 1, "graph points from a long upload were not journaled");
+
+  if (!problems) printf("All uploads checked.\n");
+  return problems ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc == 2 && !strcmp(argv[1], "--check")) return checkUploads();
+  return bench();
+}
@@ -0,0 +1,66 @@
+/**
+ * Adafruit_GFX stand-in.  Nothing is drawn.  Displays report the pixels
+ * they would push so the cost of a screen update can be charged to the
+ * virtual clock; off-screen canvases cost nothing.
+ */
+#ifndef SIM_ADAFRUIT_GFX_H
+#define SIM_ADAFRUIT_GFX_H
+
+#include <cstdint>
+#include <vector>
+#include "Arduino.h"
+
+class Adafruit_GFX : public Print {
+public:
+  Adafruit_GFX(int16_t w, int16_t h) : _width(w), _height(h) {}
+
+  void setCursor(int16_t x, int16_t y) { cursorX = x; cursorY = y; }
+  void setTextSize(uint8_t s) { textSize = s ? s : 1; }
+  void setTextColor(uint16_t c) { textColor = c; }
+  void setTextColor(uint16_t c, uint16_t bg) { textColor = c; (void)bg; }
+  void setRotation(uint8_t r) { rotation = r & 3; }
+  int16_t width() const { return (rotation & 1) ? _height : _width; }
+  int16_t height() const { return (rotation & 1) ? _width : _height; }
+
+  void fillScreen(uint16_t color) { fillRect(0, 0, width(), height(), color); }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    (void)x; (void)y; (void)color;
+    pushPixels((uint32_t)std::max<int16_t>(w, 0) * std::max<int16_t>(h, 0));
+  }
+  void drawBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t color, uint16_t bg) {
+    (void)x; (void)y; (void)bitmap; (void)color; (void)bg;
+    pushPixels((uint32_t)w * h);
+  }
+
+  size_t write(uint8_t c) override {
+    if (c == '\n') {
+      cursorX = 0;
+      cursorY += 8 * textSize;
+    } else if (c != '\r') {
+      pushPixels(6u * 8u * textSize * textSize);
+      cursorX += 6 * textSize;
+    }
+    return 1;
+  }
+  using Print::write;
+
+protected:
+  virtual void pushPixels(uint32_t count) { (void)count; }
+
+  int16_t _width, _height;
+  int16_t cursorX = 0, cursorY = 0;
+  uint8_t textSize = 1;
+  uint8_t rotation = 0;
+  uint16_t textColor = 0xFFFF;
+};
+
+class GFXcanvas1 : public Adafruit_GFX {
+public:
+  GFXcanvas1(uint16_t w, uint16_t h) : Adafruit_GFX(w, h), buffer(((w + 7) / 8) * h) {}
+  uint8_t *getBuffer() { return buffer.data(); }
+
+private:
+  std::vector<uint8_t> buffer;
+};
+
+#endif
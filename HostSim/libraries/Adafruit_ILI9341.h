@@ -0,0 +1,45 @@
+/**
+ * ILI9341 stand-in.  Each pixel is 16 bits over SPI, charged to the virtual
+ * clock at the 40 MHz the Adafruit driver uses on the ESP32.
+ */
+#ifndef SIM_ADAFRUIT_ILI9341_H
+#define SIM_ADAFRUIT_ILI9341_H
+
+#include "Adafruit_GFX.h"
+#include "SPI.h"
+
+#define ILI9341_TFTWIDTH 240
+#define ILI9341_TFTHEIGHT 320
+
+#define ILI9341_BLACK 0x0000
+#define ILI9341_NAVY 0x000F
+#define ILI9341_BLUE 0x001F
+#define ILI9341_GREEN 0x07E0
+#define ILI9341_CYAN 0x07FF
+#define ILI9341_RED 0xF800
+#define ILI9341_MAGENTA 0xF81F
+#define ILI9341_YELLOW 0xFFE0
+#define ILI9341_WHITE 0xFFFF
+
+class Adafruit_ILI9341 : public Adafruit_GFX {
+public:
+  Adafruit_ILI9341(SPIClass *spiClass, int8_t dc, int8_t cs = -1, int8_t rst = -1)
+      : Adafruit_GFX(ILI9341_TFTWIDTH, ILI9341_TFTHEIGHT) {
+    (void)spiClass; (void)dc; (void)cs; (void)rst;
+  }
+  void begin(uint32_t freq = 0) { (void)freq; }
+  uint16_t color565(uint8_t r, uint8_t g, uint8_t b) {
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+  }
+
+  // Pixels pushed since the simulation started.
+  uint64_t pixelsPushed = 0;
+
+protected:
+  void pushPixels(uint32_t count) override {
+    pixelsPushed += count;
+    sim::spend((uint64_t)count * 16 / 40);
+  }
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "Arduino.h"
+
+#include <unistd.h>
+#include "SPI.h"
+
+HardwareSerial Serial;
+EspClass ESP;
+SPIClass SPI(FSPI);
+
+static uint8_t pinState[64];
+
+unsigned long millis() {
+  return (unsigned long)(sim::micros64() / 1000ULL);
+}
+
+unsigned long micros() {
+  return (unsigned long)sim::micros64();
+}
+
+void delay(uint32_t ms) {
+  sim::spend((uint64_t)ms * 1000ULL);
+}
+
+void delayMicroseconds(uint32_t us) {
+  sim::spend(us);
+}
+
+void yield() {}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin < sizeof(pinState)) pinState[pin] = val ? HIGH : LOW;
+  if (sim::onPinWrite) sim::onPinWrite(pin, val ? HIGH : LOW);
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < sizeof(pinState) ? pinState[pin] : LOW;
+}
+
+char *dtostrf(double val, signed char width, unsigned char prec, char *sout) {
+  sprintf(sout, "%*.*f", width, prec, val);
+  return sout;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (!sim::quiet) fputc(c, stdout);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (!sim::quiet) fwrite(buffer, 1, size, stdout);
+  return size;
+}
+
+void HardwareSerial::flush() {
+  if (!sim::quiet) fflush(stdout);
+}
+
+void EspClass::restart() {
+  throw sim::Restart{sim::micros64()};
+}
+
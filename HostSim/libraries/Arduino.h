@@ -0,0 +1,106 @@
+/**
+ * Arduino core for the host simulation of CBASS-32 on a Nano ESP32.
+ *
+ * Timing functions read the virtual clock in Sim.h.  Pin writes are stored
+ * and passed to sim::onPinWrite so the simulated shift registers can follow
+ * them.  Pin names D0-D13 use the Nano ESP32 GPIO numbers.
+ */
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Print.h"
+#include "WString.h"
+#include "../Sim.h"
+
+using std::max;
+using std::min;
+
+typedef bool boolean;
+typedef uint8_t byte;
+typedef uint16_t word;
+
+#define PROGMEM
+#define PGM_P const char *
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+// Nano ESP32 pin names map to ESP32-S3 GPIO numbers.
+#define D0 44
+#define D1 43
+#define D2 5
+#define D3 6
+#define D4 7
+#define D5 8
+#define D6 9
+#define D7 10
+#define D8 17
+#define D9 18
+#define D10 21
+#define D11 38
+#define D12 47
+#define D13 48
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+inline bool isDigit(int c) { return isdigit(c); }
+inline bool isAlpha(int c) { return isalpha(c); }
+inline bool isSpace(int c) { return isspace(c); }
+inline bool isWhitespace(int c) { return c == ' ' || c == '\t'; }
+inline bool isAlphaNumeric(int c) { return isalnum(c); }
+
+char *dtostrf(double val, signed char width, unsigned char prec, char *sout);
+
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void flush() override;
+  operator bool() const { return true; }
+};
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+  [[noreturn]] void restart();
+  uint32_t getFreeHeap() { return 200000; }
+};
+extern EspClass ESP;
+
+// The ESP32 core includes FreeRTOS for every sketch.
+#include "FreeRTOS.h"
+
+#include "IPAddress.h"
+
+#endif
@@ -0,0 +1,93 @@
+#include "DallasTemperature.h"
+
+#include <cmath>
+#include <cstring>
+#include "Arduino.h"
+
+// Simulated ROM codes: family 0x28 (DS18B20), "SIM", then the bus index.
+static void simAddress(uint8_t *a, uint8_t index) {
+  const uint8_t rom[8] = {0x28, 'S', 'I', 'M', 0x00, 0x00, index, 0x00};
+  memcpy(a, rom, 8);
+}
+
+void DallasTemperature::begin() {
+  for (float &s : _scratch) s = 85.0f;  // DS18B20 power-on scratchpad value.
+}
+
+uint8_t DallasTemperature::getDeviceCount() {
+  return (uint8_t)std::min(sim::sensorCount, 16);
+}
+
+bool DallasTemperature::getAddress(uint8_t *deviceAddress, uint8_t index) {
+  if (index >= getDeviceCount()) return false;
+  simAddress(deviceAddress, index);
+  return true;
+}
+
+bool DallasTemperature::setResolution(const uint8_t *deviceAddress, uint8_t newResolution, bool skip) {
+  (void)deviceAddress;
+  (void)skip;
+  if (newResolution < 9) newResolution = 9;
+  if (newResolution > 12) newResolution = 12;
+  _resolution = std::max(_resolution, newResolution);
+  return true;
+}
+
+uint8_t DallasTemperature::getResolution(const uint8_t *deviceAddress) {
+  (void)deviceAddress;
+  return _resolution;
+}
+
+int16_t DallasTemperature::millisToWaitForConversion(uint8_t bitResolution) {
+  switch (bitResolution) {
+    case 9: return 94;
+    case 10: return 188;
+    case 11: return 375;
+    default: return 750;
+  }
+}
+
+DallasTemperature::request_t DallasTemperature::requestTemperatures() {
+  _converting = true;
+  _conversionDoneUs = sim::micros64() + (uint64_t)millisToWaitForConversion() * 1000ULL;
+  if (_waitForConversion) {
+    delay(millisToWaitForConversion());
+    latchIfDone();
+  }
+  return request_t{true, millis()};
+}
+
+bool DallasTemperature::isConversionComplete() {
+  latchIfDone();
+  return !_converting;
+}
+
+void DallasTemperature::latchIfDone() {
+  if (!_converting || sim::micros64() < _conversionDoneUs) return;
+  float step = 0.5f / (1 << (_resolution - 9));
+  for (int i = 0; i < getDeviceCount(); i++) {
+    float c = sim::readSensor ? sim::readSensor(i) : 25.0f;
+    _scratch[i] = std::floor(c / step) * step;
+  }
+  _converting = false;
+}
+
+int DallasTemperature::indexOf(const uint8_t *deviceAddress) {
+  uint8_t a[8];
+  for (int i = 0; i < getDeviceCount(); i++) {
+    simAddress(a, i);
+    if (!memcmp(a, deviceAddress, 8)) return i;
+  }
+  return -1;
+}
+
+float DallasTemperature::getTempC(const uint8_t *deviceAddress) {
+  latchIfDone();
+  int i = indexOf(deviceAddress);
+  return i < 0 ? DEVICE_DISCONNECTED_C : _scratch[i];
+}
+
+float DallasTemperature::getTempCByIndex(uint8_t index) {
+  latchIfDone();
+  return index < getDeviceCount() ? _scratch[index] : DEVICE_DISCONNECTED_C;
+}
@@ -0,0 +1,60 @@
+/**
+ * DallasTemperature stand-in for DS18B20 sensors on the simulated bus.
+ *
+ * A conversion takes the datasheet maximum for the configured resolution
+ * (94 ms at 9 bits up to 750 ms at 12 bits) of virtual time.  With
+ * waitForConversion set, as the library defaults, requestTemperatures()
+ * blocks for that long, exactly like the real call does.  Readings are
+ * taken from sim::readSensor when the conversion completes and quantized to
+ * the resolution.
+ */
+#ifndef SIM_DALLASTEMPERATURE_H
+#define SIM_DALLASTEMPERATURE_H
+
+#include <cstdint>
+#include "OneWire.h"
+
+typedef uint8_t DeviceAddress[8];
+
+#define DEVICE_DISCONNECTED_C -127
+
+class DallasTemperature {
+public:
+  explicit DallasTemperature(OneWire *bus) : _bus(bus) {}
+
+  void begin();
+  uint8_t getDeviceCount();
+  bool getAddress(uint8_t *deviceAddress, uint8_t index);
+  bool setResolution(const uint8_t *deviceAddress, uint8_t newResolution, bool skipGlobalBitResolutionCalculation = false);
+  uint8_t getResolution(const uint8_t *deviceAddress);
+  uint8_t getResolution() { return _resolution; }
+  void setWaitForConversion(bool flag) { _waitForConversion = flag; }
+  bool getWaitForConversion() { return _waitForConversion; }
+  void setCheckForConversion(bool flag) { (void)flag; }
+
+  struct request_t {
+    bool result;
+    unsigned long timestamp;
+    operator bool() { return result; }
+  };
+  request_t requestTemperatures();
+  bool isConversionComplete();
+  int16_t millisToWaitForConversion(uint8_t bitResolution);
+  int16_t millisToWaitForConversion() { return millisToWaitForConversion(_resolution); }
+
+  float getTempC(const uint8_t *deviceAddress);
+  float getTempCByIndex(uint8_t index);
+
+private:
+  void latchIfDone();
+  int indexOf(const uint8_t *deviceAddress);
+
+  OneWire *_bus;
+  uint8_t _resolution = 9;
+  bool _waitForConversion = true;
+  bool _converting = false;
+  uint64_t _conversionDoneUs = 0;
+  float _scratch[16];
+};
+
+#endif
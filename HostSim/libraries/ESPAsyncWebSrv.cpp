@@ -0,0 +1,607 @@
+#include "ESPAsyncWebSrv.h"
+
+#include <algorithm>
+#include <cstring>
+#include "SPIFFS.h"
+
+WiFiClass WiFi;
+
+static bool sameName(const String &a, const char *b) {
+  return strcasecmp(a.c_str(), b) == 0;
+}
+
+static String urlDecode(const std::string &s) {
+  std::string out;
+  for (size_t i = 0; i < s.size(); i++) {
+    if (s[i] == '+') {
+      out += ' ';
+    } else if (s[i] == '%' && i + 2 < s.size()) {
+      out += (char)strtol(s.substr(i + 1, 2).c_str(), nullptr, 16);
+      i += 2;
+    } else {
+      out += s[i];
+    }
+  }
+  return String(out.c_str());
+}
+
+static String contentTypeFor(const String &path) {
+  static const char *map[][2] = {
+      {".html", "text/html"}, {".htm", "text/html"}, {".css", "text/css"},
+      {".js", "application/javascript"}, {".json", "application/json"},
+      {".png", "image/png"}, {".gif", "image/gif"}, {".jpg", "image/jpeg"},
+      {".ico", "image/x-icon"}, {".svg", "image/svg+xml"}, {".txt", "text/plain"},
+      {".gz", "application/x-gzip"}};
+  for (auto &m : map) {
+    if (path.endsWith(m[0])) return m[1];
+  }
+  return "text/plain";
+}
+
+// ===== Responses =====
+
+const AsyncWebHeader *AsyncWebServerResponse::header(const char *name) const {
+  for (const auto &h : _headers) {
+    if (sameName(h.name(), name)) return &h;
+  }
+  return nullptr;
+}
+
+size_t AsyncAbstractResponse::simFill(uint8_t *buf, size_t maxLen) {
+  if (!_callback) {
+    size_t n = _fillBuffer(buf, maxLen);
+    _index += n;
+    return n;
+  }
+  return fillTemplated(buf, maxLen);
+}
+
+// Template expansion follows the library: ~NAME~ is replaced by the
+// processor's result, ~~ is a literal ~, and a ~ with no closing ~ within
+// TEMPLATE_PARAM_NAME_LENGTH characters is passed through.  The host build
+// expands the whole source at once, which gives the same bytes.
+size_t AsyncAbstractResponse::fillTemplated(uint8_t *buf, size_t maxLen) {
+  if (!_sourceDone) {
+    uint8_t tmp[1460];
+    size_t n;
+    while ((n = _fillBuffer(tmp, sizeof(tmp))) > 0) _raw.append((const char *)tmp, n);
+    _sourceDone = true;
+    for (size_t i = 0; i < _raw.size(); i++) {
+      if (_raw[i] != TEMPLATE_PLACEHOLDER) {
+        _pending += _raw[i];
+        continue;
+      }
+      size_t close = _raw.find(TEMPLATE_PLACEHOLDER, i + 1);
+      if (close == std::string::npos || close - i - 1 > TEMPLATE_PARAM_NAME_LENGTH) {
+        _pending += _raw[i];
+      } else if (close == i + 1) {
+        _pending += TEMPLATE_PLACEHOLDER;
+        i = close;
+      } else {
+        _pending += _callback(String(_raw.substr(i + 1, close - i - 1).c_str())).std();
+        i = close;
+      }
+    }
+    _raw.clear();
+  }
+  size_t n = std::min(maxLen, _pending.size() - _index);
+  memcpy(buf, _pending.data() + _index, n);
+  _index += n;
+  return n;
+}
+
+size_t AsyncBasicResponse::_fillBuffer(uint8_t *buf, size_t maxLen) {
+  size_t n = std::min(maxLen, _content.size() - _pos);
+  memcpy(buf, _content.data() + _pos, n);
+  _pos += n;
+  return n;
+}
+
+size_t AsyncProgmemResponse::_fillBuffer(uint8_t *buf, size_t maxLen) {
+  size_t n = std::min(maxLen, _len - _pos);
+  memcpy(buf, _content + _pos, n);
+  _pos += n;
+  return n;
+}
+
+size_t AsyncCallbackResponse::_fillBuffer(uint8_t *buf, size_t maxLen) {
+  if (_contentLength) {
+    if (_filled >= _contentLength) return 0;
+    maxLen = std::min(maxLen, _contentLength - _filled);
+  }
+  size_t n = _filler(buf, maxLen, _filled);
+  _filled += n;
+  return n;
+}
+
+AsyncFileResponse::AsyncFileResponse(fs::File file, const String &path, const String &contentType, bool download, AwsTemplateProcessor callback)
+    : AsyncAbstractResponse(200, contentType, callback), _file(file) {
+  if (_contentType.isEmpty()) _contentType = contentTypeFor(path);
+  _contentLength = _file.size();
+  if (download) {
+    int slash = path.lastIndexOf('/');
+    addHeader("Content-Disposition", "attachment; filename=\"" + path.substring(slash + 1) + "\"");
+  }
+}
+
+size_t AsyncFileResponse::_fillBuffer(uint8_t *buf, size_t maxLen) {
+  return _file.read(buf, maxLen);
+}
+
+size_t AsyncResponseStream::simFill(uint8_t *buf, size_t maxLen) {
+  size_t n = std::min(maxLen, _content.size() - _pos);
+  memcpy(buf, _content.data() + _pos, n);
+  _pos += n;
+  return n;
+}
+
+// ===== Requests =====
+
+AsyncWebServerRequest::~AsyncWebServerRequest() {
+  if (_onDisconnect) _onDisconnect();
+  if (_tempObject) free(_tempObject);
+}
+
+const char *AsyncWebServerRequest::methodToString() const {
+  switch (_method) {
+    case HTTP_GET: return "GET";
+    case HTTP_POST: return "POST";
+    case HTTP_PUT: return "PUT";
+    case HTTP_DELETE: return "DELETE";
+    case HTTP_HEAD: return "HEAD";
+    default: return "UNKNOWN";
+  }
+}
+
+bool AsyncWebServerRequest::hasParam(const String &name, bool post, bool file) const {
+  return getParam(name, post, file) != nullptr;
+}
+
+AsyncWebParameter *AsyncWebServerRequest::getParam(const String &name, bool post, bool file) const {
+  for (const auto &p : _params) {
+    if (p->name() == name && p->isPost() == post && p->isFile() == file) return p.get();
+  }
+  return nullptr;
+}
+
+AsyncWebParameter *AsyncWebServerRequest::getParam(size_t num) const {
+  return num < _params.size() ? _params[num].get() : nullptr;
+}
+
+bool AsyncWebServerRequest::hasArg(const char *name) const {
+  for (const auto &p : _params) {
+    if (p->name() == name) return true;
+  }
+  return false;
+}
+
+const String &AsyncWebServerRequest::arg(const String &name) const {
+  static const String empty;
+  for (const auto &p : _params) {
+    if (p->name() == name) return p->value();
+  }
+  return empty;
+}
+
+bool AsyncWebServerRequest::hasHeader(const String &name) const {
+  return getHeader(name) != nullptr;
+}
+
+AsyncWebHeader *AsyncWebServerRequest::getHeader(const String &name) const {
+  for (const auto &h : _headers) {
+    if (sameName(h->name(), name.c_str())) return h.get();
+  }
+  return nullptr;
+}
+
+AsyncWebHeader *AsyncWebServerRequest::getHeader(size_t num) const {
+  return num < _headers.size() ? _headers[num].get() : nullptr;
+}
+
+String AsyncWebServerRequest::header(const char *name) const {
+  AsyncWebHeader *h = getHeader(name);
+  return h ? h->value() : String();
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(int code, const String &contentType, const String &content) {
+  return new AsyncBasicResponse(code, contentType, content);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(fs::FS &fs, const String &path, const String &contentType, bool download, AwsTemplateProcessor callback) {
+  fs::File f = fs.open(path, "r");
+  if (!f || f.isDirectory()) return beginResponse(404);
+  return new AsyncFileResponse(f, path, contentType, download, callback);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse_P(int code, const String &contentType, const uint8_t *content, size_t len, AwsTemplateProcessor callback) {
+  return new AsyncProgmemResponse(code, contentType, content, len, callback);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse_P(int code, const String &contentType, PGM_P content, AwsTemplateProcessor callback) {
+  return beginResponse_P(code, contentType, (const uint8_t *)content, strlen(content), callback);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginResponse(const String &contentType, size_t len, AwsResponseFiller callback, AwsTemplateProcessor templateCallback) {
+  return new AsyncCallbackResponse(200, contentType, len, callback, templateCallback);
+}
+
+AsyncWebServerResponse *AsyncWebServerRequest::beginChunkedResponse(const String &contentType, AwsResponseFiller callback, AwsTemplateProcessor templateCallback) {
+  return new AsyncCallbackResponse(200, contentType, 0, callback, templateCallback);
+}
+
+AsyncResponseStream *AsyncWebServerRequest::beginResponseStream(const String &contentType, size_t bufferSize) {
+  return new AsyncResponseStream(contentType, bufferSize);
+}
+
+void AsyncWebServerRequest::send(AsyncWebServerResponse *response) {
+  if (_response) {
+    delete response;  // Only the first response is sent, as in the library.
+    return;
+  }
+  _response.reset(response);
+}
+
+void AsyncWebServerRequest::send(int code, const String &contentType, const String &content) {
+  send(beginResponse(code, contentType, content));
+}
+
+void AsyncWebServerRequest::send(fs::FS &fs, const String &path, const String &contentType, bool download, AwsTemplateProcessor callback) {
+  send(beginResponse(fs, path, contentType, download, callback));
+}
+
+void AsyncWebServerRequest::send_P(int code, const String &contentType, PGM_P content, AwsTemplateProcessor callback) {
+  send(beginResponse_P(code, contentType, content, callback));
+}
+
+void AsyncWebServerRequest::sendChunked(const String &contentType, AwsResponseFiller callback, AwsTemplateProcessor templateCallback) {
+  send(beginChunkedResponse(contentType, callback, templateCallback));
+}
+
+void AsyncWebServerRequest::redirect(const String &url) {
+  AsyncWebServerResponse *response = beginResponse(302);
+  response->addHeader("Location", url);
+  send(response);
+}
+
+// ===== Handlers =====
+
+bool AsyncCallbackWebHandler::canHandle(AsyncWebServerRequest *request) {
+  if (!_onRequest || !(_method & request->method())) return false;
+  if (_uri.length() && _uri.endsWith("*")) return request->url().startsWith(_uri.substring(0, _uri.length() - 1));
+  return _uri.isEmpty() || request->url() == _uri || request->url().startsWith(_uri + "/");
+}
+
+void AsyncCallbackWebHandler::handleRequest(AsyncWebServerRequest *request) {
+  if (_onRequest) _onRequest(request);
+  else request->send(500);
+}
+
+void AsyncCallbackWebHandler::handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) {
+  if (_onUpload) _onUpload(request, filename, index, data, len, final);
+}
+
+void AsyncCallbackWebHandler::handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+  if (_onBody) _onBody(request, data, len, index, total);
+}
+
+AsyncStaticWebHandler::AsyncStaticWebHandler(const char *uri, fs::FS &fs, const char *path, const char *cache_control)
+    : _fs(fs), _uri(uri), _path(path), _cache_control(cache_control ? cache_control : "") {
+  if (_uri.endsWith("/")) _uri = _uri.substring(0, _uri.length() - 1);
+  if (_path.endsWith("/")) _path = _path.substring(0, _path.length() - 1);
+}
+
+bool AsyncStaticWebHandler::canHandle(AsyncWebServerRequest *request) {
+  if (request->method() != HTTP_GET) return false;
+  if (!request->url().startsWith(_uri)) return false;
+  String path = _path + request->url().substring(_uri.length());
+  if (path.endsWith("/")) path += _default_file;
+  if (!_fs.exists(path) && !_fs.exists(path + ".gz")) return false;
+  if (_cache_control.length()) request->addInterestingHeader("If-None-Match");
+  return true;
+}
+
+// As in the library: the plain file wins, the .gz variant is the fallback,
+// and with cache control set the ETag is the file size.
+void AsyncStaticWebHandler::handleRequest(AsyncWebServerRequest *request) {
+  String path = _path + request->url().substring(_uri.length());
+  if (path.endsWith("/")) path += _default_file;
+  bool gzipped = !_fs.exists(path);
+  fs::File f = _fs.open(gzipped ? path + ".gz" : path, "r");
+  if (!f) {
+    request->send(404);
+    return;
+  }
+  String etag = String((unsigned long)f.size());
+  if (_cache_control.length() && request->hasHeader("If-None-Match") && request->header("If-None-Match") == etag) {
+    AsyncWebServerResponse *response = request->beginResponse(304);
+    response->addHeader("Cache-Control", _cache_control);
+    response->addHeader("ETag", etag);
+    request->send(response);
+    return;
+  }
+  AsyncWebServerResponse *response = new AsyncFileResponse(f, path, contentTypeFor(path), false, _callback);
+  if (gzipped) response->addHeader("Content-Encoding", "gzip");
+  if (_cache_control.length()) {
+    response->addHeader("Cache-Control", _cache_control);
+    response->addHeader("ETag", etag);
+  }
+  request->send(response);
+}
+
+// ===== Server-sent events =====
+
+// The library's generateEventMessage(): each line of the message gets its own
+// "data:" field.
+static std::string eventMessage(const char *message, const char *event, uint32_t id, uint32_t reconnect) {
+  std::string ev;
+  if (reconnect) ev += "retry: " + std::to_string(reconnect) + "\r\n";
+  if (id) ev += "id: " + std::to_string(id) + "\r\n";
+  if (event) ev += std::string("event: ") + event + "\r\n";
+  if (message) {
+    const char *p = message;
+    do {
+      size_t len = strcspn(p, "\r\n");
+      ev += "data: ";
+      ev.append(p, len);
+      ev += "\r\n";
+      p += len;
+      if (*p == '\r' && p[1] == '\n') p++;
+      if (*p) p++;
+    } while (*p);
+  }
+  ev += "\r\n";
+  return ev;
+}
+
+AsyncEventSourceClient::AsyncEventSourceClient(AsyncWebServerRequest *request, AsyncEventSource *server) : _server(server) {
+  if (request->hasHeader("Last-Event-ID")) _lastId = atoi(request->header("Last-Event-ID").c_str());
+  _server->_clients.push_back(this);
+  if (_server->_connectcb) _server->_connectcb(this);
+}
+
+AsyncEventSourceClient::~AsyncEventSourceClient() {
+  if (_server) {
+    auto &c = _server->_clients;
+    c.erase(std::remove(c.begin(), c.end(), this), c.end());
+  }
+}
+
+void AsyncEventSourceClient::close() { _connected = false; }
+
+void AsyncEventSourceClient::write(const char *message, size_t len) {
+  if (!_connected) return;
+  if (_messages.size() >= SSE_MAX_QUEUED_MESSAGES) {
+    // The library logs "Too many messages queued" and drops it.
+    if (_server) _server->simDropped++;
+    return;
+  }
+  _messages.emplace_back(message, len);
+}
+
+void AsyncEventSourceClient::send(const char *message, const char *event, uint32_t id, uint32_t reconnect) {
+  std::string ev = eventMessage(message, event, id, reconnect);
+  write(ev.data(), ev.size());
+}
+
+void AsyncEventSource::close() {
+  for (AsyncEventSourceClient *c : _clients) {
+    c->close();
+    c->_server = nullptr;
+  }
+  _clients.clear();
+}
+
+void AsyncEventSource::send(const char *message, const char *event, uint32_t id, uint32_t reconnect) {
+  std::string ev = eventMessage(message, event, id, reconnect);
+  for (AsyncEventSourceClient *c : _clients) c->write(ev.data(), ev.size());
+}
+
+size_t AsyncEventSource::count() const {
+  size_t n = 0;
+  for (AsyncEventSourceClient *c : _clients) n += c->connected();
+  return n;
+}
+
+size_t AsyncEventSource::avgPacketsWaiting() const {
+  size_t total = 0, n = 0;
+  for (AsyncEventSourceClient *c : _clients) {
+    if (!c->connected()) continue;
+    total += c->packetsWaiting();
+    n++;
+  }
+  return n ? (total + n - 1) / n : 0;
+}
+
+bool AsyncEventSource::canHandle(AsyncWebServerRequest *request) {
+  if (request->method() != HTTP_GET || request->url() != _url) return false;
+  request->addInterestingHeader("Last-Event-ID");
+  return true;
+}
+
+void AsyncEventSource::handleRequest(AsyncWebServerRequest *request) {
+  request->send(new AsyncEventSourceResponse(this, request));
+}
+
+AsyncEventSourceResponse::AsyncEventSourceResponse(AsyncEventSource *server, AsyncWebServerRequest *request)
+    : AsyncWebServerResponse(200, "text/event-stream") {
+  addHeader("Cache-Control", "no-cache");
+  addHeader("Connection", "keep-alive");
+  _client = new AsyncEventSourceClient(request, server);
+}
+
+AsyncEventSourceResponse::~AsyncEventSourceResponse() { delete _client; }
+
+size_t AsyncEventSourceResponse::simFill(uint8_t *buf, size_t maxLen) {
+  size_t n = 0;
+  auto &q = _client->_messages;
+  while (n < maxLen && !q.empty()) {
+    const std::string &m = q.front();
+    size_t take = std::min(maxLen - n, m.size() - _client->_sent);
+    memcpy(buf + n, m.data() + _client->_sent, take);
+    n += take;
+    _client->_sent += take;
+    if (_client->_sent == m.size()) {
+      q.pop_front();
+      _client->_sent = 0;
+    }
+  }
+  return n;
+}
+
+// ===== Server =====
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, ArRequestHandlerFunction onRequest) {
+  return on(uri, HTTP_ANY, onRequest);
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest) {
+  return on(uri, method, onRequest, nullptr, nullptr);
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload) {
+  return on(uri, method, onRequest, onUpload, nullptr);
+}
+
+AsyncCallbackWebHandler &AsyncWebServer::on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody) {
+  AsyncCallbackWebHandler *handler = new AsyncCallbackWebHandler();
+  handler->setUri(uri);
+  handler->setMethod(method);
+  handler->onRequest(onRequest);
+  handler->onUpload(onUpload);
+  handler->onBody(onBody);
+  _handlers.push_back(handler);
+  return *handler;
+}
+
+AsyncStaticWebHandler &AsyncWebServer::serveStatic(const char *uri, fs::FS &fs, const char *path, const char *cache_control) {
+  AsyncStaticWebHandler *handler = new AsyncStaticWebHandler(uri, fs, path, cache_control);
+  _handlers.push_back(handler);
+  return *handler;
+}
+
+AsyncWebHandler *AsyncWebServer::findHandler(AsyncWebServerRequest *request) {
+  for (auto &h : _handlers) {
+    if (h->canHandle(request)) return h;
+  }
+  return nullptr;
+}
+
+void AsyncWebServer::removeNotInterestingHeaders(AsyncWebServerRequest *request) {
+  auto interesting = [&](const String &name) {
+    for (const auto &i : request->_interestingHeaders) {
+      if (sameName(i, "ANY") || sameName(i, name.c_str())) return true;
+    }
+    return false;
+  };
+  auto &h = request->_headers;
+  h.erase(std::remove_if(h.begin(), h.end(), [&](const std::unique_ptr<AsyncWebHeader> &x) { return !interesting(x->name()); }), h.end());
+}
+
+std::unique_ptr<SimExchange> AsyncWebServer::simBegin(const SimHttpRequest &req) {
+  AsyncWebServerRequest *request = new AsyncWebServerRequest();
+  std::unique_ptr<SimExchange> exchange(new SimExchange(request));
+  request->_method = req.method;
+  int q = req.url.indexOf('?');
+  request->_url = q < 0 ? req.url : req.url.substring(0, q);
+  if (q >= 0) {
+    std::string query = req.url.substring(q + 1).std();
+    size_t start = 0;
+    while (start <= query.size()) {
+      size_t amp = query.find('&', start);
+      if (amp == std::string::npos) amp = query.size();
+      std::string pair = query.substr(start, amp - start);
+      if (!pair.empty()) {
+        size_t eq = pair.find('=');
+        String name = urlDecode(pair.substr(0, eq));
+        String value = eq == std::string::npos ? String() : urlDecode(pair.substr(eq + 1));
+        request->_params.emplace_back(new AsyncWebParameter(name, value));
+      }
+      start = amp + 1;
+    }
+  }
+  for (const auto &f : req.form) request->_params.emplace_back(new AsyncWebParameter(f.first, f.second, true));
+  for (const auto &h : req.headers) {
+    request->_headers.emplace_back(new AsyncWebHeader(h.first, h.second));
+    if (sameName(h.first, "Content-Type")) request->_contentType = h.second;
+  }
+  request->_contentLength = req.uploadName.length() ? req.uploadData.size() : req.body.size();
+
+  AsyncWebHandler *handler = findHandler(request);
+  removeNotInterestingHeaders(request);
+  std::vector<uint8_t> seg(req.chunk);
+  if (req.uploadName.length()) {
+    size_t index = 0;
+    do {
+      if (index >= req.uploadStall) return exchange;  // No response until the caller disconnects.
+      size_t n = std::min(req.chunk, req.uploadData.size() - index);
+      memcpy(seg.data(), req.uploadData.data() + index, n);
+      bool final = index + n == req.uploadData.size();
+      if (handler) handler->handleUpload(request, req.uploadName, index, seg.data(), n, final);
+      else if (_catchAllUpload) _catchAllUpload(request, req.uploadName, index, seg.data(), n, final);
+      index += n;
+    } while (index < req.uploadData.size());
+    request->_params.emplace_back(new AsyncWebParameter("file", req.uploadName, true, true, req.uploadData.size()));
+    if (req.holdEnd) {
+      exchange->_end = [this, request, handler]() { answer(request, handler); };
+      return exchange;
+    }
+  } else if (!req.body.empty()) {
+    for (size_t index = 0; index < req.body.size(); index += req.chunk) {
+      size_t n = std::min(req.chunk, req.body.size() - index);
+      memcpy(seg.data(), req.body.data() + index, n);
+      if (handler) handler->handleBody(request, seg.data(), n, index, req.body.size());
+      else if (_catchAllBody) _catchAllBody(request, seg.data(), n, index, req.body.size());
+    }
+  }
+  answer(request, handler);
+  return exchange;
+}
+
+// The whole request has arrived: call its handler, unless a response went already.
+void AsyncWebServer::answer(AsyncWebServerRequest *request, AsyncWebHandler *handler) {
+  if (request->simResponse()) return;
+  if (handler) handler->handleRequest(request);
+  else if (_notFound) _notFound(request);
+  else request->send(404);
+}
+
+SimHttpResult AsyncWebServer::simFetch(const SimHttpRequest &req, size_t window) {
+  std::unique_ptr<SimExchange> ex = simBegin(req);
+  SimHttpResult result;
+  AsyncWebServerResponse *response = ex->response();
+  if (!response) return result;
+  result.code = response->code();
+  result.contentType = response->contentType();
+  std::vector<uint8_t> buf(window);
+  size_t n;
+  while ((n = ex->pull(buf.data(), window)) > 0) result.body.append((const char *)buf.data(), n);
+  result.headers = response->headers();
+  return result;
+}
+
+const AsyncWebHeader *SimHttpResult::header(const char *name) const {
+  for (const auto &h : headers) {
+    if (sameName(h.name(), name)) return &h;
+  }
+  return nullptr;
+}
+
+size_t SimExchange::pull(uint8_t *buf, size_t maxLen) {
+  if (_done || !response()) return 0;
+  size_t n = response()->simFill(buf, maxLen);
+  if (n == 0 && !response()->simOpen()) _done = true;
+  return n;
+}
+
+void SimExchange::disconnect() {
+  _done = true;
+  _end = nullptr;
+  _request.reset();
+}
+
+void SimExchange::finish() {
+  if (!_end) return;
+  std::function<void()> end = std::move(_end);
+  _end = nullptr;
+  end();
+}
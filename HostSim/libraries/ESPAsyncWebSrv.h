@@ -0,0 +1,466 @@
+/**
+ * ESPAsyncWebServer stand-in for the host simulation.
+ *
+ * The sketch-facing API follows the library CBASS-32 builds against
+ * (handlers, parameters, PROGMEM templates, streams, chunked responses,
+ * serveStatic).  There is no socket.  A test or benchmark builds a
+ * SimHttpRequest and calls AsyncWebServer::simBegin(), which dispatches it
+ * on the calling thread just as AsyncTCP would.  The returned exchange is
+ * then drained with pull(), a buffer at a time, so several downloads can be
+ * interleaved to mimic concurrent clients.  simFetch() does both steps.
+ *
+ * AsyncEventSource streams stay open: pull() returns 0 while no event is
+ * waiting, and done() only once the client is closed.
+ *
+ * TEMPLATE_PLACEHOLDER is '~', matching the edit CBASS-32 requires in
+ * WebResponseImpl.h.
+ */
+#ifndef SIM_ESPASYNCWEBSRV_H
+#define SIM_ESPASYNCWEBSRV_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Arduino.h"
+#include "FS.h"
+#include "WiFi.h"
+
+#define TEMPLATE_PLACEHOLDER '~'
+#define TEMPLATE_PARAM_NAME_LENGTH 32
+
+typedef uint8_t WebRequestMethodComposite;
+enum {
+  HTTP_GET = 0b00000001,
+  HTTP_POST = 0b00000010,
+  HTTP_DELETE = 0b00000100,
+  HTTP_PUT = 0b00001000,
+  HTTP_PATCH = 0b00010000,
+  HTTP_HEAD = 0b00100000,
+  HTTP_OPTIONS = 0b01000000,
+  HTTP_ANY = 0b01111111,
+};
+
+class AsyncWebServerRequest;
+class AsyncWebServerResponse;
+
+typedef std::function<void(AsyncWebServerRequest *request)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final)> ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)> ArBodyHandlerFunction;
+typedef std::function<String(const String &)> AwsTemplateProcessor;
+typedef std::function<size_t(uint8_t *buffer, size_t maxLen, size_t index)> AwsResponseFiller;
+typedef std::function<void(void)> ArDisconnectHandler;
+
+class AsyncWebParameter {
+public:
+  AsyncWebParameter(const String &name, const String &value, bool form = false, bool file = false, size_t size = 0)
+      : _name(name), _value(value), _size(size), _isForm(form), _isFile(file) {}
+  const String &name() const { return _name; }
+  const String &value() const { return _value; }
+  size_t size() const { return _size; }
+  bool isPost() const { return _isForm; }
+  bool isFile() const { return _isFile; }
+
+private:
+  String _name, _value;
+  size_t _size;
+  bool _isForm, _isFile;
+};
+
+class AsyncWebHeader {
+public:
+  AsyncWebHeader(const String &name, const String &value) : _name(name), _value(value) {}
+  const String &name() const { return _name; }
+  const String &value() const { return _value; }
+
+private:
+  String _name, _value;
+};
+
+// ===== Responses =====
+
+class AsyncWebServerResponse {
+public:
+  AsyncWebServerResponse(int code, const String &contentType) : _code(code), _contentType(contentType) {}
+  virtual ~AsyncWebServerResponse() {}
+  void setCode(int code) { _code = code; }
+  void setContentType(const String &type) { _contentType = type; }
+  void setContentLength(size_t len) { _contentLength = len; }
+  void addHeader(const String &name, const String &value) { _headers.emplace_back(name, value); }
+
+  // Simulation side.
+  int code() const { return _code; }
+  size_t contentLength() const { return _contentLength; }  // 0 if unknown, as for chunked responses.
+  const String &contentType() const { return _contentType; }
+  const std::vector<AsyncWebHeader> &headers() const { return _headers; }
+  const AsyncWebHeader *header(const char *name) const;
+  // Copy up to maxLen more body bytes into buf; 0 means the body is complete,
+  // unless simOpen() says more may come.
+  virtual size_t simFill(uint8_t *buf, size_t maxLen) = 0;
+  virtual bool simOpen() const { return false; }
+
+protected:
+  int _code;
+  String _contentType;
+  size_t _contentLength = 0;
+  std::vector<AsyncWebHeader> _headers;
+};
+
+// Responses built from a fixed source, with optional ~KEY~ templating.
+class AsyncAbstractResponse : public AsyncWebServerResponse {
+public:
+  AsyncAbstractResponse(int code, const String &contentType, AwsTemplateProcessor callback)
+      : AsyncWebServerResponse(code, contentType), _callback(callback) {}
+  size_t simFill(uint8_t *buf, size_t maxLen) override;
+
+protected:
+  // Raw (pre-template) body bytes, as the library's _fillBuffer.
+  virtual size_t _fillBuffer(uint8_t *buf, size_t maxLen) = 0;
+
+private:
+  size_t fillTemplated(uint8_t *buf, size_t maxLen);
+  AwsTemplateProcessor _callback;
+  size_t _index = 0;
+  bool _sourceDone = false;
+  std::string _pending;  // Template output not yet delivered.
+  std::string _raw;      // Raw bytes not yet templated.
+};
+
+class AsyncBasicResponse : public AsyncAbstractResponse {
+public:
+  AsyncBasicResponse(int code, const String &contentType, const String &content)
+      : AsyncAbstractResponse(code, contentType, nullptr), _content(content.std()) {}
+
+protected:
+  size_t _fillBuffer(uint8_t *buf, size_t maxLen) override;
+
+private:
+  std::string _content;
+  size_t _pos = 0;
+};
+
+class AsyncProgmemResponse : public AsyncAbstractResponse {
+public:
+  AsyncProgmemResponse(int code, const String &contentType, const uint8_t *content, size_t len, AwsTemplateProcessor callback)
+      : AsyncAbstractResponse(code, contentType, callback), _content(content), _len(len) {}
+
+protected:
+  size_t _fillBuffer(uint8_t *buf, size_t maxLen) override;
+
+private:
+  const uint8_t *_content;
+  size_t _len;
+  size_t _pos = 0;
+};
+
+// A body from a filler function.  With a length it ends after that many bytes
+// and is sent with Content-Length; without, it is chunked and ends when the
+// filler returns 0.
+class AsyncCallbackResponse : public AsyncAbstractResponse {
+public:
+  AsyncCallbackResponse(int code, const String &contentType, size_t len, AwsResponseFiller filler, AwsTemplateProcessor callback)
+      : AsyncAbstractResponse(code, contentType, callback), _filler(filler) { _contentLength = len; }
+
+protected:
+  size_t _fillBuffer(uint8_t *buf, size_t maxLen) override;
+
+private:
+  AwsResponseFiller _filler;
+  size_t _filled = 0;
+};
+
+class AsyncFileResponse : public AsyncAbstractResponse {
+public:
+  AsyncFileResponse(fs::File file, const String &path, const String &contentType, bool download, AwsTemplateProcessor callback);
+
+protected:
+  size_t _fillBuffer(uint8_t *buf, size_t maxLen) override;
+
+private:
+  fs::File _file;
+};
+
+class AsyncResponseStream : public AsyncWebServerResponse, public Print {
+public:
+  AsyncResponseStream(const String &contentType, size_t bufferSize)
+      : AsyncWebServerResponse(200, contentType) { _content.reserve(bufferSize); }
+  size_t write(uint8_t c) override { _content += (char)c; return 1; }
+  size_t write(const uint8_t *data, size_t len) override { _content.append((const char *)data, len); return len; }
+  using Print::write;
+  size_t simFill(uint8_t *buf, size_t maxLen) override;
+
+private:
+  std::string _content;
+  size_t _pos = 0;
+};
+
+// ===== Requests =====
+
+class AsyncWebHandler;
+
+class AsyncWebServerRequest {
+  friend class AsyncWebServer;
+
+public:
+  ~AsyncWebServerRequest();
+
+  const String &url() const { return _url; }
+  WebRequestMethodComposite method() const { return _method; }
+  const char *methodToString() const;
+  const String &contentType() const { return _contentType; }
+  size_t contentLength() const { return _contentLength; }
+
+  size_t params() const { return _params.size(); }
+  bool hasParam(const String &name, bool post = false, bool file = false) const;
+  AsyncWebParameter *getParam(const String &name, bool post = false, bool file = false) const;
+  AsyncWebParameter *getParam(size_t num) const;
+  bool hasArg(const char *name) const;
+  const String &arg(const String &name) const;
+
+  size_t headers() const { return _headers.size(); }
+  bool hasHeader(const String &name) const;
+  AsyncWebHeader *getHeader(const String &name) const;
+  AsyncWebHeader *getHeader(size_t num) const;
+  String header(const char *name) const;
+  // Headers no handler names here, in canHandle(), are discarded before the
+  // handler runs, as in the library.  "ANY" keeps them all.
+  void addInterestingHeader(const String &name) { _interestingHeaders.push_back(name); }
+
+  void onDisconnect(ArDisconnectHandler fn) { _onDisconnect = fn; }
+
+  AsyncWebServerResponse *beginResponse(int code, const String &contentType = String(), const String &content = String());
+  AsyncWebServerResponse *beginResponse(fs::FS &fs, const String &path, const String &contentType = String(), bool download = false, AwsTemplateProcessor callback = nullptr);
+  AsyncWebServerResponse *beginResponse_P(int code, const String &contentType, const uint8_t *content, size_t len, AwsTemplateProcessor callback = nullptr);
+  AsyncWebServerResponse *beginResponse_P(int code, const String &contentType, PGM_P content, AwsTemplateProcessor callback = nullptr);
+  AsyncWebServerResponse *beginResponse(const String &contentType, size_t len, AwsResponseFiller callback, AwsTemplateProcessor templateCallback = nullptr);
+  AsyncWebServerResponse *beginChunkedResponse(const String &contentType, AwsResponseFiller callback, AwsTemplateProcessor templateCallback = nullptr);
+  AsyncResponseStream *beginResponseStream(const String &contentType, size_t bufferSize = 1460);
+
+  void send(AsyncWebServerResponse *response);
+  void send(int code, const String &contentType = String(), const String &content = String());
+  void send(fs::FS &fs, const String &path, const String &contentType = String(), bool download = false, AwsTemplateProcessor callback = nullptr);
+  void send_P(int code, const String &contentType, PGM_P content, AwsTemplateProcessor callback = nullptr);
+  void sendChunked(const String &contentType, AwsResponseFiller callback, AwsTemplateProcessor templateCallback = nullptr);
+  void redirect(const String &url);
+
+  // Per-request storage owned by the handler; released with free() when the
+  // request is destroyed, as in the library.
+  void *_tempObject = nullptr;
+
+  // Simulation side: the response chosen by the handler, or nullptr.
+  AsyncWebServerResponse *simResponse() const { return _response.get(); }
+
+private:
+  String _url;
+  WebRequestMethodComposite _method = HTTP_GET;
+  String _contentType;
+  size_t _contentLength = 0;
+  std::vector<std::unique_ptr<AsyncWebParameter>> _params;
+  std::vector<std::unique_ptr<AsyncWebHeader>> _headers;
+  std::vector<String> _interestingHeaders;
+  std::unique_ptr<AsyncWebServerResponse> _response;
+  ArDisconnectHandler _onDisconnect;
+};
+
+// ===== Handlers =====
+
+class AsyncWebHandler {
+public:
+  virtual ~AsyncWebHandler() {}
+  virtual bool canHandle(AsyncWebServerRequest *request) = 0;
+  virtual void handleRequest(AsyncWebServerRequest *request) = 0;
+  virtual void handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) {
+    (void)request; (void)filename; (void)index; (void)data; (void)len; (void)final;
+  }
+  virtual void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+    (void)request; (void)data; (void)len; (void)index; (void)total;
+  }
+  virtual bool isRequestHandlerTrivial() { return true; }
+};
+
+class AsyncCallbackWebHandler : public AsyncWebHandler {
+public:
+  void setUri(const String &uri) { _uri = uri; }
+  void setMethod(WebRequestMethodComposite method) { _method = method; }
+  void onRequest(ArRequestHandlerFunction fn) { _onRequest = fn; }
+  void onUpload(ArUploadHandlerFunction fn) { _onUpload = fn; }
+  void onBody(ArBodyHandlerFunction fn) { _onBody = fn; }
+
+  bool canHandle(AsyncWebServerRequest *request) override;
+  void handleRequest(AsyncWebServerRequest *request) override;
+  void handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final) override;
+  void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) override;
+  bool isRequestHandlerTrivial() override { return !_onRequest; }
+
+private:
+  String _uri;
+  WebRequestMethodComposite _method = HTTP_ANY;
+  ArRequestHandlerFunction _onRequest;
+  ArUploadHandlerFunction _onUpload;
+  ArBodyHandlerFunction _onBody;
+};
+
+class AsyncStaticWebHandler : public AsyncWebHandler {
+public:
+  AsyncStaticWebHandler(const char *uri, fs::FS &fs, const char *path, const char *cache_control);
+  AsyncStaticWebHandler &setCacheControl(const char *cache_control) { _cache_control = cache_control; return *this; }
+  AsyncStaticWebHandler &setDefaultFile(const char *filename) { _default_file = filename; return *this; }
+  AsyncStaticWebHandler &setTemplateProcessor(AwsTemplateProcessor newCallback) { _callback = newCallback; return *this; }
+
+  bool canHandle(AsyncWebServerRequest *request) override;
+  void handleRequest(AsyncWebServerRequest *request) override;
+
+private:
+  fs::FS &_fs;
+  String _uri, _path, _default_file = "index.htm", _cache_control;
+  AwsTemplateProcessor _callback;
+};
+
+// ===== Server-sent events =====
+
+class AsyncEventSource;
+class AsyncEventSourceResponse;
+
+#define SSE_MAX_QUEUED_MESSAGES 32
+
+class AsyncEventSourceClient {
+  friend class AsyncEventSource;
+  friend class AsyncEventSourceResponse;
+
+public:
+  AsyncEventSourceClient(AsyncWebServerRequest *request, AsyncEventSource *server);
+  ~AsyncEventSourceClient();
+  void close();
+  void write(const char *message, size_t len);
+  void send(const char *message, const char *event = NULL, uint32_t id = 0, uint32_t reconnect = 0);
+  bool connected() const { return _connected; }
+  uint32_t lastId() const { return _lastId; }
+  size_t packetsWaiting() const { return _messages.size(); }
+
+private:
+  AsyncEventSource *_server;
+  uint32_t _lastId = 0;
+  bool _connected = true;
+  std::deque<std::string> _messages;  // As the library queues them, up to SSE_MAX_QUEUED_MESSAGES.
+  size_t _sent = 0;                   // Bytes of the front message already pulled.
+};
+
+typedef std::function<void(AsyncEventSourceClient *client)> ArEventHandlerFunction;
+
+class AsyncEventSource : public AsyncWebHandler {
+  friend class AsyncEventSourceClient;
+
+public:
+  explicit AsyncEventSource(const String &url) : _url(url) {}
+  ~AsyncEventSource() { close(); }
+  const char *url() const { return _url.c_str(); }
+  void close();
+  void onConnect(ArEventHandlerFunction cb) { _connectcb = cb; }
+  void send(const char *message, const char *event = NULL, uint32_t id = 0, uint32_t reconnect = 0);
+  size_t count() const;
+  size_t avgPacketsWaiting() const;
+  bool canHandle(AsyncWebServerRequest *request) override;
+  void handleRequest(AsyncWebServerRequest *request) override;
+
+  // Simulation side: messages dropped because a client's queue was full.
+  size_t simDropped = 0;
+
+private:
+  String _url;
+  std::vector<AsyncEventSourceClient *> _clients;
+  ArEventHandlerFunction _connectcb;
+};
+
+// The open response of one event source client.
+class AsyncEventSourceResponse : public AsyncWebServerResponse {
+public:
+  AsyncEventSourceResponse(AsyncEventSource *server, AsyncWebServerRequest *request);
+  ~AsyncEventSourceResponse();
+  size_t simFill(uint8_t *buf, size_t maxLen) override;
+  bool simOpen() const override { return _client && _client->connected(); }
+
+private:
+  AsyncEventSourceClient *_client;
+};
+
+// ===== Simulated client side =====
+
+struct SimHttpRequest {
+  WebRequestMethodComposite method = HTTP_GET;
+  String url;  // Path with an optional ?query string.
+  std::vector<std::pair<String, String>> headers;
+  std::vector<std::pair<String, String>> form;  // POST form fields.
+  std::string body;                             // Raw body for onBody handlers.
+  String uploadName;                            // Multipart file name, if uploading.
+  std::string uploadData;
+  size_t chunk = 1460;                          // Body and upload segment size.
+  size_t uploadStall = SIZE_MAX;                // Upload bytes sent before the client stops, leaving the request open.
+  bool holdEnd = false;                         // Send every upload piece, but the end of the request only on finish().
+};
+
+struct SimHttpResult {
+  int code = 0;
+  String contentType;
+  std::vector<AsyncWebHeader> headers;
+  std::string body;
+  const AsyncWebHeader *header(const char *name) const;
+};
+
+class SimExchange {
+public:
+  explicit SimExchange(AsyncWebServerRequest *request) : _request(request) {}
+  AsyncWebServerResponse *response() const { return _request ? _request->simResponse() : nullptr; }
+  // Pull up to maxLen body bytes.  Returns 0 once the response is complete.
+  size_t pull(uint8_t *buf, size_t maxLen);
+  bool done() const { return _done; }
+  // Close the connection early, as a dropped client would.
+  void disconnect();
+  // Send the end of a request held by SimHttpRequest::holdEnd, so it is answered.
+  void finish();
+
+private:
+  friend class AsyncWebServer;
+  std::unique_ptr<AsyncWebServerRequest> _request;
+  std::function<void()> _end;
+  bool _done = false;
+};
+
+class AsyncWebServer {
+public:
+  explicit AsyncWebServer(uint16_t port) : _port(port) {}
+  void begin() {}
+  void end() {}
+
+  AsyncCallbackWebHandler &on(const char *uri, ArRequestHandlerFunction onRequest);
+  AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest);
+  AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload);
+  AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest, ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody);
+  AsyncStaticWebHandler &serveStatic(const char *uri, fs::FS &fs, const char *path, const char *cache_control = nullptr);
+  AsyncWebHandler &addHandler(AsyncWebHandler *handler) { _handlers.push_back(handler); return *handler; }
+  void onNotFound(ArRequestHandlerFunction fn) { _notFound = fn; }
+  void onFileUpload(ArUploadHandlerFunction fn) { _catchAllUpload = fn; }
+  void onRequestBody(ArBodyHandlerFunction fn) { _catchAllBody = fn; }
+
+  // Simulation side.
+  std::unique_ptr<SimExchange> simBegin(const SimHttpRequest &req);
+  SimHttpResult simFetch(const SimHttpRequest &req, size_t window = 1436);
+  SimHttpResult simGet(const String &url) { SimHttpRequest r; r.url = url; return simFetch(r); }
+
+private:
+  AsyncWebHandler *findHandler(AsyncWebServerRequest *request);
+  void answer(AsyncWebServerRequest *request, AsyncWebHandler *handler);
+  void removeNotInterestingHeaders(AsyncWebServerRequest *request);
+
+  uint16_t _port;
+  // Not deleted: the server lives as long as the program, and sketches
+  // pass addHandler() globals such as an AsyncEventSource.
+  std::vector<AsyncWebHandler *> _handlers;
+  ArRequestHandlerFunction _notFound;
+  ArUploadHandlerFunction _catchAllUpload;
+  ArBodyHandlerFunction _catchAllBody;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include "FS.h"
+#include "SPIFFS.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+fs::SPIFFSFS SPIFFS;
+
+namespace fs {
+
+File::File(const std::string &hostPath, const std::string &path, const char *mode) : _hostPath(hostPath), _path(path) {
+  struct stat st;
+  if (stat(hostPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    DIR *d = opendir(hostPath.c_str());
+    if (d) {
+      _dir = std::shared_ptr<void>(d, [](void *p) { closedir((DIR *)p); });
+      _isDir = true;
+    }
+    return;
+  }
+  FILE *f = fopen(hostPath.c_str(), mode);
+  if (f) _f = std::shared_ptr<FILE>(f, fclose);
+}
+
+const char *File::name() const {
+  size_t slash = _path.rfind('/');
+  return slash == std::string::npos ? _path.c_str() : _path.c_str() + slash + 1;
+}
+
+size_t File::size() const {
+  struct stat st;
+  if (!_f || fstat(fileno(_f.get()), &st) != 0) return 0;
+  return st.st_size;
+}
+
+bool File::seek(uint32_t pos) {
+  return _f && fseek(_f.get(), pos, SEEK_SET) == 0;
+}
+
+size_t File::position() const {
+  return _f ? ftell(_f.get()) : 0;
+}
+
+File File::openNextFile() {
+  if (!_isDir) return File();
+  struct dirent *e;
+  while ((e = readdir((DIR *)_dir.get())) != nullptr) {
+    if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+    std::string p = _path == "/" ? "/" + std::string(e->d_name) : _path + "/" + e->d_name;
+    return File(_hostPath + "/" + e->d_name, p, "r");
+  }
+  return File();
+}
+
+int File::available() {
+  if (!_f) return 0;
+  size_t s = size(), p = position();
+  return p < s ? (int)(s - p) : 0;
+}
+
+int File::read() {
+  return _f ? fgetc(_f.get()) : -1;
+}
+
+size_t File::read(uint8_t *buf, size_t size) {
+  return _f ? fread(buf, 1, size, _f.get()) : 0;
+}
+
+int File::peek() {
+  if (!_f) return -1;
+  int c = fgetc(_f.get());
+  if (c != EOF) ungetc(c, _f.get());
+  return c;
+}
+
+size_t File::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buf, size_t size) {
+  return _f ? fwrite(buf, 1, size, _f.get()) : 0;
+}
+
+void File::flush() {
+  if (_f) fflush(_f.get());
+}
+
+File FS::open(const char *path, const char *mode) {
+  File f(_map(path), path, mode);
+  return f;
+}
+
+bool FS::exists(const char *path) {
+  return access(_map(path).c_str(), F_OK) == 0;
+}
+
+bool FS::remove(const char *path) {
+  return unlink(_map(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *from, const char *to) {
+  return ::rename(_map(from).c_str(), _map(to).c_str()) == 0;
+}
+
+bool FS::mkdir(const char *path) {
+  return ::mkdir(_map(path).c_str(), 0755) == 0;
+}
+
+size_t SPIFFSFS::usedBytes() {
+  return 0;
+}
+
+}  // namespace fs
@@ -0,0 +1,70 @@
+/**
+ * Arduino-ESP32 FS stand-in, used for SPIFFS.  Files live under a host
+ * directory chosen by the FS object.
+ */
+#ifndef SIM_FS_H
+#define SIM_FS_H
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+class File : public Stream {
+public:
+  File() {}
+  File(const std::string &hostPath, const std::string &path, const char *mode);
+  explicit operator bool() const { return (bool)_f || _isDir; }
+  void close() { _f.reset(); _isDir = false; }
+  bool isDirectory() const { return _isDir; }
+  const char *path() const { return _path.c_str(); }
+  const char *name() const;
+  size_t size() const;
+  bool seek(uint32_t pos);
+  size_t position() const;
+  File openNextFile();
+
+  int available() override;
+  int read() override;
+  size_t read(uint8_t *buf, size_t size);
+  int peek() override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t size) override;
+  using Print::write;
+  void flush() override;
+
+private:
+  std::shared_ptr<FILE> _f;
+  std::string _hostPath, _path;
+  bool _isDir = false;
+  std::shared_ptr<void> _dir;
+};
+
+class FS {
+public:
+  explicit FS(std::string (*mapPath)(const char *)) : _map(mapPath) {}
+  File open(const char *path, const char *mode = FILE_READ);
+  File open(const String &path, const char *mode = FILE_READ) { return open(path.c_str(), mode); }
+  bool exists(const char *path);
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool remove(const char *path);
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *from, const char *to);
+  bool mkdir(const char *path);
+
+protected:
+  std::string (*_map)(const char *);
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+
+#endif
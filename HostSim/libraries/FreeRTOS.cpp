@@ -0,0 +1,290 @@
+#include "FreeRTOS.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Sim.h"
+
+struct SimQueue {
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  std::deque<std::vector<uint8_t>> items;
+};
+
+namespace {
+
+const uint64_t never = UINT64_MAX;
+
+struct Task {
+  std::string name;
+  UBaseType_t priority;
+  BaseType_t core;
+  std::condition_variable cv;
+  bool blocked = false;
+  bool deleted = false;
+  bool signalled = false;            // What it waits on has changed.
+  const void *waitingOn = nullptr;
+  uint64_t wakeUs = never;
+  uint64_t lastRun = 0;              // For taking turns among equal priorities.
+};
+
+// Everything below is guarded by lock.  None of it is ever destroyed, since
+// task threads are still parked on it when the process exits.
+struct Scheduler {
+  std::mutex lock;
+  std::vector<Task *> tasks;
+  Task *loopTask;
+  Task *current;
+  uint64_t runs = 0;
+  std::exception_ptr pending;  // Thrown in another task, for the loop task to rethrow.
+
+  Scheduler() {
+    loopTask = new Task{"loopTask", 1, 1};
+    tasks.push_back(loopTask);
+    current = loopTask;
+  }
+};
+
+Scheduler &sched() {
+  static Scheduler *s = new Scheduler;
+  return *s;
+}
+
+bool isReady(const Task *t) {
+  return !t->deleted && (!t->blocked || t->signalled || t->wakeUs <= sim::micros64());
+}
+
+// The highest priority ready task, moving the clock forward if none is ready yet.
+Task *pickNext(Scheduler &s) {
+  for (;;) {
+    Task *best = nullptr;
+    for (Task *t : s.tasks) {
+      if (!isReady(t)) continue;
+      if (!best || t->priority > best->priority || (t->priority == best->priority && t->lastRun < best->lastRun)) best = t;
+    }
+    if (best) return best;
+    uint64_t next = never;
+    for (Task *t : s.tasks) {
+      if (!t->deleted && t->wakeUs < next) next = t->wakeUs;
+    }
+    if (next == never) {
+      fprintf(stderr, "FreeRTOS stand-in: every task is blocked with no timeout.\n");
+      abort();
+    }
+    sim::advanceMicros(next - sim::micros64());
+  }
+}
+
+void resumed(Scheduler &s, Task *self) {
+  self->blocked = false;
+  self->signalled = false;
+  self->waitingOn = nullptr;
+  self->wakeUs = never;
+  self->lastRun = ++s.runs;
+}
+
+// The running task has set its own blocked state.  Hand the CPU to whoever
+// should run next and return once this task is picked again.
+void switchAway(Scheduler &s, std::unique_lock<std::mutex> &held) {
+  Task *self = s.current;
+  try {
+    Task *next = pickNext(s);
+    if (next != self) {
+      s.current = next;
+      next->cv.notify_one();
+      self->cv.wait(held, [&] { return s.current == self; });
+    }
+  } catch (...) {
+    resumed(s, self);
+    throw;
+  }
+  resumed(s, self);
+  if (self == s.loopTask && s.pending) {
+    std::exception_ptr e = s.pending;
+    s.pending = nullptr;
+    std::rethrow_exception(e);
+  }
+}
+
+// Block until woken by a change to obj, or until deadlineUs.  False if the
+// deadline has already passed.
+bool waitOn(Scheduler &s, std::unique_lock<std::mutex> &held, const void *obj, uint64_t deadlineUs) {
+  if (sim::micros64() >= deadlineUs) return false;
+  Task *self = s.current;
+  self->blocked = true;
+  self->waitingOn = obj;
+  self->wakeUs = deadlineUs;
+  switchAway(s, held);
+  return true;
+}
+
+void wake(Scheduler &s, const void *obj) {
+  for (Task *t : s.tasks) {
+    if (t->blocked && t->waitingOn == obj) t->signalled = true;
+  }
+}
+
+uint64_t deadline(TickType_t ticks) {
+  if (ticks == portMAX_DELAY) return never;
+  return sim::micros64() + (uint64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+void sleepUntil(uint64_t wakeUs) {
+  Scheduler &s = sched();
+  std::unique_lock<std::mutex> held(s.lock);
+  waitOn(s, held, nullptr, wakeUs);
+}
+
+void runTask(Task *self, TaskFunction_t code, void *param) {
+  Scheduler &s = sched();
+  {
+    std::unique_lock<std::mutex> held(s.lock);
+    self->cv.wait(held, [&] { return s.current == self; });
+    resumed(s, self);
+  }
+  try {
+    code(param);
+    vTaskDelete(nullptr);  // FreeRTOS tasks must not return, but treat it as deleting itself.
+  } catch (...) {
+    // A watchdog or restart.  The loop task passes it on to the driver.
+    std::unique_lock<std::mutex> held(s.lock);
+    self->deleted = true;
+    s.pending = std::current_exception();
+    s.current = s.loopTask;
+    s.loopTask->cv.notify_one();
+  }
+}
+
+}  // namespace
+
+namespace sim {
+
+void spend(uint64_t us) {
+  if (us == 0) return;
+  if (sched().tasks.size() == 1) {
+    advanceMicros(us);  // Only the loop task: nothing else could run meanwhile.
+    return;
+  }
+  sleepUntil(micros64() + us);
+}
+
+}  // namespace sim
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stackDepth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *created, BaseType_t core) {
+  (void)stackDepth;
+  Scheduler &s = sched();
+  std::unique_lock<std::mutex> held(s.lock);
+  Task *t = new Task{name ? name : "", priority, core};
+  t->lastRun = s.runs;
+  s.tasks.push_back(t);
+  std::thread(runTask, t, code, param).detach();
+  if (created) *created = t;
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  Scheduler &s = sched();
+  std::unique_lock<std::mutex> held(s.lock);
+  Task *t = task ? (Task *)task : s.current;
+  t->deleted = true;
+  if (t != s.current) return;
+  // Park this thread for good.
+  Task *next = pickNext(s);
+  s.current = next;
+  next->cv.notify_one();
+  t->cv.wait(held, [] { return false; });
+}
+
+void vTaskDelay(TickType_t ticks) {
+  sim::spend((uint64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+void vTaskDelayUntil(TickType_t *previousWakeTime, TickType_t increment) {
+  *previousWakeTime += increment;
+  uint64_t wakeUs = (uint64_t)*previousWakeTime * portTICK_PERIOD_MS * 1000;
+  if (wakeUs > sim::micros64()) sleepUntil(wakeUs);
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)(sim::micros64() / (portTICK_PERIOD_MS * 1000));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return sched().current;
+}
+
+BaseType_t xPortGetCoreID() {
+  return sched().current->core;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  (void)task;
+  return 8192;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  return new SimQueue{length, itemSize, {}};
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait) {
+  Scheduler &s = sched();
+  std::unique_lock<std::mutex> held(s.lock);
+  uint64_t until = deadline(ticksToWait);
+  while (queue->items.size() >= queue->length) {
+    if (!waitOn(s, held, queue, until)) return errQUEUE_FULL;
+  }
+  const uint8_t *p = (const uint8_t *)item;
+  queue->items.emplace_back(p, p + queue->itemSize);
+  wake(s, queue);
+  return pdPASS;
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+  Scheduler &s = sched();
+  std::unique_lock<std::mutex> held(s.lock);
+  queue->items.clear();
+  const uint8_t *p = (const uint8_t *)item;
+  queue->items.emplace_back(p, p + queue->itemSize);
+  wake(s, queue);
+  return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticksToWait) {
+  Scheduler &s = sched();
+  std::unique_lock<std::mutex> held(s.lock);
+  uint64_t until = deadline(ticksToWait);
+  while (queue->items.empty()) {
+    if (!waitOn(s, held, queue, until)) return errQUEUE_EMPTY;
+  }
+  if (queue->itemSize) memcpy(buffer, queue->items.front().data(), queue->itemSize);
+  queue->items.pop_front();
+  wake(s, queue);
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  std::unique_lock<std::mutex> held(sched().lock);
+  return queue->items.size();
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  SemaphoreHandle_t m = xQueueCreate(1, 0);
+  xSemaphoreGive(m);
+  return m;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticksToWait) {
+  return xQueueReceive(mutex, nullptr, ticksToWait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+  return xQueueSend(mutex, nullptr, 0);
+}
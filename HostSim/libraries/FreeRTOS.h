@@ -0,0 +1,68 @@
+/**
+ * FreeRTOS stand-in: tasks, queues and mutexes on the virtual clock.
+ *
+ * Each task created with xTaskCreatePinnedToCore() gets a host thread, but
+ * only one thread runs at a time.  A task runs until it blocks: in
+ * vTaskDelay(), vTaskDelayUntil(), a queue or mutex wait, delay(), or a
+ * stand-in library spending time on a bus.  The scheduler then runs the
+ * highest priority task that is ready, taking turns among equals.  When no
+ * task is ready the clock jumps to the next wake-up, so runs are repeatable.
+ *
+ * Time a task spends does not hold up other tasks, as if each had a core to
+ * itself.  The core a task is pinned to is only reported by xPortGetCoreID().
+ * Mutexes have no priority inheritance.
+ *
+ * The thread that calls setup() and loop() is Arduino's loopTask, priority 1
+ * on core 1.  It must not delete itself.
+ */
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+#include <cstdint>
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef struct SimQueue *QueueHandle_t;
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+#define errQUEUE_FULL 0
+#define errQUEUE_EMPTY 0
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1  // CONFIG_FREERTOS_HZ is 1000 on the ESP32 Arduino core.
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define configMAX_PRIORITIES 25
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+// ===== Tasks =====
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stackDepth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *created, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previousWakeTime, TickType_t increment);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xPortGetCoreID();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+// ===== Queues =====
+// Items are copied in and out, as in FreeRTOS.
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticksToWait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+// ===== Mutexes =====
+// A queue of one empty item, as FreeRTOS builds them.
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticksToWait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex);
+
+#endif
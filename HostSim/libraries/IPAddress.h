@@ -0,0 +1,23 @@
+#ifndef SIM_IPADDRESS_H
+#define SIM_IPADDRESS_H
+
+#include <cstdint>
+#include <cstdio>
+#include "WString.h"
+
+class IPAddress {
+public:
+  IPAddress() : a{0, 0, 0, 0} {}
+  IPAddress(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3) : a{b0, b1, b2, b3} {}
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", a[0], a[1], a[2], a[3]);
+    return String(buf);
+  }
+  uint8_t operator[](int i) const { return a[i]; }
+
+private:
+  uint8_t a[4];
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef SIM_ONEWIRE_H
+#define SIM_ONEWIRE_H
+
+#include <cstdint>
+
+// The simulated bus has no wire protocol.  DallasTemperature talks to the
+// sensors in Sim.h directly.
+class OneWire {
+public:
+  explicit OneWire(uint8_t pin) : _pin(pin) {}
+  uint8_t pin() const { return _pin; }
+
+private:
+  uint8_t _pin;
+};
+
+#endif
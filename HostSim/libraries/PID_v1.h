@@ -0,0 +1,50 @@
+/**
+ * Brett Beauregard's Arduino PID Library (v1.2.1) rewritten for the host
+ * simulation.  The arithmetic follows the original so simulated control
+ * matches what runs on the board.
+ */
+#ifndef SIM_PID_V1_H
+#define SIM_PID_V1_H
+
+class PID {
+public:
+#define AUTOMATIC 1
+#define MANUAL 0
+#define DIRECT 0
+#define REVERSE 1
+#define P_ON_M 0
+#define P_ON_E 1
+
+  PID(double *Input, double *Output, double *Setpoint, double Kp, double Ki, double Kd, int POn, int ControllerDirection);
+  PID(double *Input, double *Output, double *Setpoint, double Kp, double Ki, double Kd, int ControllerDirection);
+
+  void SetMode(int Mode);
+  bool Compute();
+  void SetOutputLimits(double Min, double Max);
+  void SetTunings(double Kp, double Ki, double Kd);
+  void SetTunings(double Kp, double Ki, double Kd, int POn);
+  void SetControllerDirection(int Direction);
+  void SetSampleTime(int NewSampleTime);
+
+  double GetKp() { return dispKp; }
+  double GetKi() { return dispKi; }
+  double GetKd() { return dispKd; }
+  int GetMode() { return inAuto ? AUTOMATIC : MANUAL; }
+  int GetDirection() { return controllerDirection; }
+
+private:
+  void Initialize();
+
+  double dispKp, dispKi, dispKd;
+  double kp, ki, kd;
+  int controllerDirection;
+  int pOn;
+  double *myInput, *myOutput, *mySetpoint;
+  unsigned long lastTime;
+  double outputSum, lastInput;
+  unsigned long SampleTime;
+  double outMin, outMax;
+  bool inAuto, pOnE;
+};
+
+#endif
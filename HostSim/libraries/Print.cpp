@@ -0,0 +1,134 @@
+#include "Print.h"
+
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::write(const char *str) {
+  if (!str) return 0;
+  return write((const uint8_t *)str, strlen(str));
+}
+
+size_t Print::printf(const char *format, ...) {
+  char loc[256];
+  va_list arg;
+  va_start(arg, format);
+  va_list copy;
+  va_copy(copy, arg);
+  int len = vsnprintf(loc, sizeof(loc), format, copy);
+  va_end(copy);
+  if (len < 0) {
+    va_end(arg);
+    return 0;
+  }
+  if ((size_t)len < sizeof(loc)) {
+    va_end(arg);
+    return write((const uint8_t *)loc, len);
+  }
+  std::vector<char> big(len + 1);
+  vsnprintf(big.data(), big.size(), format, arg);
+  va_end(arg);
+  return write((const uint8_t *)big.data(), len);
+}
+
+size_t Print::print(const __FlashStringHelper *f) {
+  return write(reinterpret_cast<const char *>(f));
+}
+size_t Print::print(const String &s) {
+  return write((const uint8_t *)s.c_str(), s.length());
+}
+size_t Print::print(const char *str) {
+  return write(str);
+}
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+size_t Print::print(unsigned char n, int base) {
+  return print((unsigned long long)n, base);
+}
+size_t Print::print(int n, int base) {
+  return print((long long)n, base);
+}
+size_t Print::print(unsigned int n, int base) {
+  return print((unsigned long long)n, base);
+}
+size_t Print::print(long n, int base) {
+  return print((long long)n, base);
+}
+size_t Print::print(unsigned long n, int base) {
+  return print((unsigned long long)n, base);
+}
+size_t Print::print(long long n, int base) {
+  if (base == DEC && n < 0) return printNumber((unsigned long long)(-n), base, true);
+  return printNumber((unsigned long long)n, base, false);
+}
+size_t Print::print(unsigned long long n, int base) {
+  return printNumber(n, base, false);
+}
+size_t Print::print(double n, int digits) {
+  char buf[64];
+  if (std::isnan(n)) return print("nan");
+  if (std::isinf(n)) return print("inf");
+  snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return print(buf);
+}
+
+size_t Print::printNumber(unsigned long long n, int base, bool negative) {
+  char buf[8 * sizeof(n) + 2];
+  char *str = &buf[sizeof(buf) - 1];
+  *str = '\0';
+  if (base < 2) base = 10;
+  do {
+    char c = n % base;
+    n /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+  if (negative) *--str = '-';
+  return write(str);
+}
+
+size_t Print::println(const __FlashStringHelper *f) { return print(f) + println(); }
+size_t Print::println(const String &s) { return print(s) + println(); }
+size_t Print::println(const char *str) { return print(str) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char n, int base) { return print(n, base) + println(); }
+size_t Print::println(int n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned int n, int base) { return print(n, base) + println(); }
+size_t Print::println(long n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned long n, int base) { return print(n, base) + println(); }
+size_t Print::println(long long n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned long long n, int base) { return print(n, base) + println(); }
+size_t Print::println(double n, int digits) { return print(n, digits) + println(); }
+size_t Print::println() {
+  return write("\r\n");
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = read();
+    if (c < 0) break;
+    *buffer++ = (char)c;
+    count++;
+  }
+  return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length) {
+  size_t index = 0;
+  while (index < length) {
+    int c = read();
+    if (c < 0 || c == terminator) break;
+    *buffer++ = (char)c;
+    index++;
+  }
+  return index;
+}
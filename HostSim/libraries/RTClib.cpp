@@ -0,0 +1,97 @@
+#include "RTClib.h"
+
+#include <cstdio>
+#include "../Sim.h"
+
+// Howard Hinnant's civil calendar algorithms, valid for any Gregorian date.
+static int64_t daysFromCivil(int y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = (unsigned)(y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int64_t)doe - 719468;
+}
+
+static void civilFromDays(int64_t z, int &y, unsigned &m, unsigned &d) {
+  z += 719468;
+  const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const unsigned doe = (unsigned)(z - era * 146097);
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  d = doy - (153 * mp + 2) / 5 + 1;
+  m = mp < 10 ? mp + 3 : mp - 9;
+  y = (int)(yoe + era * 400) + (m <= 2);
+}
+
+DateTime::DateTime(uint32_t t) {
+  int y;
+  unsigned mo, da;
+  civilFromDays(t / 86400, y, mo, da);
+  yOff = y - 2000;
+  m = mo;
+  d = da;
+  uint32_t sod = t % 86400;
+  hh = sod / 3600;
+  mm = sod / 60 % 60;
+  ss = sod % 60;
+}
+
+DateTime::DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t min, uint8_t sec) {
+  if (year >= 2000U) year -= 2000U;
+  yOff = year;
+  m = month;
+  d = day;
+  hh = hour;
+  mm = min;
+  ss = sec;
+}
+
+DateTime::DateTime(const char *iso8601dateTime) {
+  int y = 2000, mo = 1, da = 1, h = 0, mi = 0, s = 0;
+  sscanf(iso8601dateTime, "%d-%d-%dT%d:%d:%d", &y, &mo, &da, &h, &mi, &s);
+  yOff = y >= 2000 ? y - 2000 : y;
+  m = mo;
+  d = da;
+  hh = h;
+  mm = mi;
+  ss = s;
+}
+
+bool DateTime::isValid() const {
+  if (yOff >= 100 || m < 1 || m > 12 || d < 1 || hh > 23 || mm > 59 || ss > 59) return false;
+  DateTime other(unixtime());
+  return other.yOff == yOff && other.m == m && other.d == d;
+}
+
+uint8_t DateTime::dayOfTheWeek() const {
+  return (uint8_t)((daysFromCivil(year(), m, d) + 4) % 7);  // 1970-01-01 was a Thursday.
+}
+
+uint32_t DateTime::unixtime() const {
+  return (uint32_t)(daysFromCivil(year(), m, d) * 86400 + hh * 3600 + mm * 60 + ss);
+}
+
+String DateTime::timestamp(timestampOpt opt) const {
+  char buf[25];
+  switch (opt) {
+    case TIMESTAMP_TIME:
+      sprintf(buf, "%02d:%02d:%02d", hh, mm, ss);
+      break;
+    case TIMESTAMP_DATE:
+      sprintf(buf, "%u-%02d-%02d", 2000U + yOff, m, d);
+      break;
+    default:
+      sprintf(buf, "%u-%02d-%02dT%02d:%02d:%02d", 2000U + yOff, m, d, hh, mm, ss);
+  }
+  return String(buf);
+}
+
+DateTime RTC_DS3231::now() {
+  return DateTime((uint32_t)(sim::epochAtBoot + sim::micros64() / 1000000ULL));
+}
+
+void RTC_DS3231::adjust(const DateTime &dt) {
+  sim::epochAtBoot = dt.unixtime() - (uint32_t)(sim::micros64() / 1000000ULL);
+}
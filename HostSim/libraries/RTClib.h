@@ -0,0 +1,72 @@
+/**
+ * RTClib stand-in.  DateTime and TimeSpan follow Adafruit's classes; the
+ * DS3231 reads sim::epochAtBoot plus the virtual clock, and adjust() moves
+ * that base just as setting the real chip would.
+ */
+#ifndef SIM_RTCLIB_H
+#define SIM_RTCLIB_H
+
+#include <cstdint>
+#include "WString.h"
+
+#define SECONDS_FROM_1970_TO_2000 946684800
+
+class TimeSpan {
+public:
+  TimeSpan(int32_t seconds = 0) : _seconds(seconds) {}
+  TimeSpan(int16_t days, int8_t hours, int8_t minutes, int8_t seconds)
+      : _seconds((int32_t)days * 86400L + (int32_t)hours * 3600 + (int32_t)minutes * 60 + seconds) {}
+  int16_t days() const { return _seconds / 86400L; }
+  int8_t hours() const { return _seconds / 3600 % 24; }
+  int8_t minutes() const { return _seconds / 60 % 60; }
+  int8_t seconds() const { return _seconds % 60; }
+  int32_t totalseconds() const { return _seconds; }
+  TimeSpan operator+(const TimeSpan &right) const { return TimeSpan(_seconds + right._seconds); }
+  TimeSpan operator-(const TimeSpan &right) const { return TimeSpan(_seconds - right._seconds); }
+
+private:
+  int32_t _seconds;
+};
+
+class DateTime {
+public:
+  enum timestampOpt { TIMESTAMP_FULL, TIMESTAMP_TIME, TIMESTAMP_DATE };
+
+  DateTime(uint32_t t = SECONDS_FROM_1970_TO_2000);
+  DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour = 0, uint8_t min = 0, uint8_t sec = 0);
+  explicit DateTime(const char *iso8601dateTime);
+
+  bool isValid() const;
+  uint16_t year() const { return 2000U + yOff; }
+  uint8_t month() const { return m; }
+  uint8_t day() const { return d; }
+  uint8_t hour() const { return hh; }
+  uint8_t minute() const { return mm; }
+  uint8_t second() const { return ss; }
+  uint8_t dayOfTheWeek() const;
+  uint32_t secondstime() const { return unixtime() - SECONDS_FROM_1970_TO_2000; }
+  uint32_t unixtime() const;
+  String timestamp(timestampOpt opt = TIMESTAMP_FULL) const;
+
+  DateTime operator+(const TimeSpan &span) const { return DateTime(unixtime() + span.totalseconds()); }
+  DateTime operator-(const TimeSpan &span) const { return DateTime(unixtime() - span.totalseconds()); }
+  TimeSpan operator-(const DateTime &right) const { return TimeSpan((int32_t)(unixtime() - right.unixtime())); }
+  bool operator<(const DateTime &right) const { return unixtime() < right.unixtime(); }
+  bool operator==(const DateTime &right) const { return unixtime() == right.unixtime(); }
+  bool operator!=(const DateTime &right) const { return !(*this == right); }
+
+private:
+  uint8_t yOff, m, d, hh, mm, ss;
+};
+
+class TwoWire;
+
+class RTC_DS3231 {
+public:
+  bool begin(TwoWire *wireInstance = nullptr) { (void)wireInstance; return true; }
+  void adjust(const DateTime &dt);
+  bool lostPower() { return false; }
+  DateTime now();
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SIM_SPI_H
+#define SIM_SPI_H
+
+#include <cstdint>
+
+#define FSPI 0
+#define HSPI 1
+#define VSPI 2
+
+class SPIClass {
+public:
+  explicit SPIClass(uint8_t spi_bus = HSPI) : _bus(spi_bus) {}
+  void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) {
+    (void)sck; (void)miso; (void)mosi; (void)ss;
+  }
+  void end() {}
+
+private:
+  uint8_t _bus;
+};
+extern SPIClass SPI;
+
+#endif
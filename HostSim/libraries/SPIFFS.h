@@ -0,0 +1,24 @@
+#ifndef SIM_SPIFFS_H
+#define SIM_SPIFFS_H
+
+#include "FS.h"
+
+namespace fs {
+
+class SPIFFSFS : public FS {
+public:
+  SPIFFSFS() : FS(sim::spiffsPath) {}
+  bool begin(bool formatOnFail = false, const char *basePath = "/spiffs", uint8_t maxOpenFiles = 10) {
+    (void)formatOnFail; (void)basePath; (void)maxOpenFiles;
+    return true;
+  }
+  void end() {}
+  size_t totalBytes() { return 1441792; }  // Default 1.4 MB partition on the Nano ESP32.
+  size_t usedBytes();
+};
+
+}  // namespace fs
+
+extern fs::SPIFFSFS SPIFFS;
+
+#endif
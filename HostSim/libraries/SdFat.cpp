@@ -0,0 +1,290 @@
+#include "SdFat.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint32_t sectorSize = 512;
+
+static void sectorRead() {
+  sim::sdSectorReads++;
+  sim::spend(sim::sdReadUs);
+}
+
+static void sectorWrite() {
+  sim::sdSectorWrites++;
+  sim::spend(sim::sdWriteUs);
+}
+
+struct File32::Handle {
+  int fd = -1;
+  DIR *dir = nullptr;
+  std::string hostPath;
+  int64_t cacheSector = -1;
+  bool cacheDirty = false;
+  bool entryDirty = false;  // Size changed since the directory entry was written.
+  ~Handle() {
+    if (fd >= 0) ::close(fd);
+    if (dir) closedir(dir);
+  }
+
+  void flushCache() {
+    if (cacheDirty) sectorWrite();
+    cacheDirty = false;
+  }
+
+  // Count the transfers for reading or writing count bytes at pos.
+  void transfer(uint32_t pos, size_t count, bool writing, uint32_t fileSize) {
+    while (count > 0) {
+      int64_t sector = pos / sectorSize;
+      uint32_t offset = pos % sectorSize;
+      size_t n = std::min<size_t>(sectorSize - offset, count);
+      if (n == sectorSize) {
+        // Whole sectors bypass the cache.
+        if (sector == cacheSector) {
+          cacheSector = -1;
+          cacheDirty = false;
+        }
+        writing ? sectorWrite() : sectorRead();
+      } else if (sector != cacheSector) {
+        flushCache();
+        // A write starting a new sector at the end of the file needs no read.
+        if (!writing || offset != 0 || pos < fileSize) sectorRead();
+        cacheSector = sector;
+      }
+      if (writing && n != sectorSize) cacheDirty = true;
+      pos += n;
+      count -= n;
+    }
+    if (writing) entryDirty = true;
+  }
+
+  void sync() {
+    flushCache();
+    if (entryDirty) {
+      sectorRead();
+      sectorWrite();
+      entryDirty = false;
+    }
+  }
+};
+
+bool File32::open(const char *path, int oflag) {
+  close();
+  std::string host = sim::sdPath(path);
+  struct stat st;
+  auto h = std::make_shared<Handle>();
+  h->hostPath = host;
+  if (stat(host.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    h->dir = opendir(host.c_str());
+    if (!h->dir) return false;
+  } else {
+    h->fd = ::open(host.c_str(), oflag & ~O_AT_END, 0644);
+    if (h->fd < 0) return false;
+    if (oflag & O_AT_END) lseek(h->fd, 0, SEEK_END);
+    sectorRead();  // The directory sector.
+  }
+  _h = h;
+  return true;
+}
+
+bool File32::openNext(File32 *dir, int oflag) {
+  close();
+  if (!dir || !dir->_h || !dir->_h->dir) return false;
+  struct dirent *e;
+  while ((e = readdir(dir->_h->dir)) != nullptr) {
+    if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, "..")) continue;
+    std::string host = dir->_h->hostPath + "/" + e->d_name;
+    struct stat st;
+    if (stat(host.c_str(), &st) != 0) continue;
+    auto h = std::make_shared<Handle>();
+    h->hostPath = host;
+    if (S_ISDIR(st.st_mode)) {
+      h->dir = opendir(host.c_str());
+      if (!h->dir) continue;
+    } else {
+      h->fd = ::open(host.c_str(), oflag & ~O_AT_END, 0644);
+      if (h->fd < 0) continue;
+    }
+    _h = h;
+    return true;
+  }
+  return false;
+}
+
+bool File32::close() {
+  if (_h && _h.use_count() == 1) _h->sync();
+  _h.reset();
+  return true;
+}
+
+bool File32::isDirectory() const {
+  return _h && _h->dir;
+}
+
+size_t File32::getName(char *name, size_t size) {
+  if (!_h || size == 0) return 0;
+  size_t slash = _h->hostPath.rfind('/');
+  std::string base = slash == std::string::npos ? _h->hostPath : _h->hostPath.substr(slash + 1);
+  strncpy(name, base.c_str(), size - 1);
+  name[size - 1] = 0;
+  return strlen(name);
+}
+
+uint32_t File32::size() const {
+  if (!_h || _h->fd < 0) return 0;
+  struct stat st;
+  if (fstat(_h->fd, &st) != 0) return 0;
+  return (uint32_t)st.st_size;
+}
+
+uint32_t File32::curPosition() const {
+  if (!_h || _h->fd < 0) return 0;
+  return (uint32_t)lseek(_h->fd, 0, SEEK_CUR);
+}
+
+bool File32::seekSet(uint32_t pos) {
+  if (!_h || _h->fd < 0) return false;
+  return lseek(_h->fd, pos, SEEK_SET) >= 0;
+}
+
+bool File32::seekCur(int32_t offset) {
+  if (!_h || _h->fd < 0) return false;
+  return lseek(_h->fd, offset, SEEK_CUR) >= 0;
+}
+
+bool File32::seekEnd(int32_t offset) {
+  if (!_h || _h->fd < 0) return false;
+  return lseek(_h->fd, offset, SEEK_END) >= 0;
+}
+
+bool File32::truncate(uint32_t length) {
+  if (!_h || _h->fd < 0) return false;
+  return ftruncate(_h->fd, length) == 0 && seekSet(length);
+}
+
+// FAT preallocation reserves contiguous clusters without changing the file
+// size.  The host only needs the call to succeed.
+bool File32::preAllocate(uint32_t length) {
+  (void)length;
+  return _h && _h->fd >= 0 && size() == 0;
+}
+
+bool File32::sync() {
+  if (!_h || _h->fd < 0) return false;
+  _h->sync();
+  return true;
+}
+
+bool File32::rename(const char *newPath) {
+  if (!_h) return false;
+  std::string host = sim::sdPath(newPath);
+  if (access(host.c_str(), F_OK) == 0) return false;  // SdFat will not replace a file.
+  if (::rename(_h->hostPath.c_str(), host.c_str()) != 0) return false;
+  _h->hostPath = host;
+  return true;
+}
+
+bool File32::remove() {
+  if (!_h || _h->dir) return false;
+  bool ok = unlink(_h->hostPath.c_str()) == 0;
+  close();
+  return ok;
+}
+
+int File32::available() {
+  if (!_h || _h->fd < 0) return 0;
+  uint32_t s = size(), p = curPosition();
+  return p < s ? (int)std::min<uint32_t>(s - p, 0x7FFF) : 0;
+}
+
+int File32::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File32::read(void *buf, size_t count) {
+  if (!_h || _h->fd < 0) return -1;
+  sim::spend(sim::sdCallUs);
+  uint32_t pos = curPosition();
+  int n = (int)::read(_h->fd, buf, count);
+  if (n > 0) _h->transfer(pos, n, false, size());
+  return n;
+}
+
+int File32::peek() {
+  if (!_h || _h->fd < 0) return -1;
+  sim::spend(sim::sdCallUs);
+  uint8_t c;
+  if (::read(_h->fd, &c, 1) != 1) return -1;
+  lseek(_h->fd, -1, SEEK_CUR);
+  return c;
+}
+
+size_t File32::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t File32::write(const uint8_t *buf, size_t count) {
+  if (!_h || _h->fd < 0) return 0;
+  sim::spend(sim::sdCallUs);
+  uint32_t pos = curPosition(), fileSize = size();
+  ssize_t n = ::write(_h->fd, buf, count);
+  if (n > 0) _h->transfer(pos, n, true, fileSize);
+  return n < 0 ? 0 : (size_t)n;
+}
+
+bool SdFat32::begin(SdSpiConfig config) {
+  (void)config;
+  struct stat st;
+  if (stat(sim::sdRoot.c_str(), &st) == 0) return S_ISDIR(st.st_mode);
+  return ::mkdir(sim::sdRoot.c_str(), 0755) == 0;
+}
+
+void SdFat32::initErrorHalt(Print *pr) {
+  pr->println("SdError: no card (host directory missing)");
+}
+
+File32 SdFat32::open(const char *path, int oflag) {
+  File32 f;
+  f.open(path, oflag);
+  return f;
+}
+
+bool SdFat32::exists(const char *path) {
+  sectorRead();  // The directory is searched for the name.
+  return access(sim::sdPath(path).c_str(), F_OK) == 0;
+}
+
+bool SdFat32::mkdir(const char *path, bool pFlag) {
+  (void)pFlag;
+  return ::mkdir(sim::sdPath(path).c_str(), 0755) == 0;
+}
+
+bool SdFat32::remove(const char *path) {
+  if (unlink(sim::sdPath(path).c_str()) != 0) return false;
+  // The directory entry is marked free.  Freeing the clusters is not counted.
+  sectorRead();
+  sectorWrite();
+  return true;
+}
+
+bool SdFat32::rename(const char *oldPath, const char *newPath) {
+  if (sim::sdRenameFailures > 0) {
+    sim::sdRenameFailures--;
+    return false;
+  }
+  std::string to = sim::sdPath(newPath);
+  if (access(to.c_str(), F_OK) == 0) return false;  // SdFat will not replace a file.
+  if (::rename(sim::sdPath(oldPath).c_str(), to.c_str()) != 0) return false;
+  // A new directory entry is written and the old one marked free.  The data stays where it is.
+  sectorRead();
+  sectorWrite();
+  sectorRead();
+  sectorWrite();
+  return true;
+}
+
+bool SdFat32::rmdir(const char *path) {
+  return ::rmdir(sim::sdPath(path).c_str()) == 0;
+}
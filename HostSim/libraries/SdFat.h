@@ -0,0 +1,101 @@
+/**
+ * SdFat stand-in for the host simulation.  SdFat32 and File32 work on the
+ * host directory sim::sdRoot, so a run leaves behind a card image that can be
+ * inspected (LOG.txt, Settings.ini, backups).
+ *
+ * File32 objects are copied by value in CBASS code, as they are with the real
+ * library.  Copies share one host descriptor, which is closed when the last
+ * copy is closed or destroyed.
+ *
+ * Card traffic is modelled in sim::sdSectorReads and sdSectorWrites.  Each
+ * file has a one-sector cache, as SdFat does: partial sector writes go
+ * through it, whole aligned sectors go straight to the card, and sync() or
+ * close() writes a dirty cache sector and then the directory entry.  Opening
+ * a file reads its directory sector.  FAT traffic is not modelled.
+ */
+#ifndef SIM_SDFAT_H
+#define SIM_SDFAT_H
+
+#include <fcntl.h>
+#include <memory>
+#include <string>
+
+#include "Arduino.h"
+
+#ifndef O_AT_END
+#define O_AT_END 0x4000000
+#endif
+#define O_READ O_RDONLY
+#define O_WRITE O_WRONLY
+
+#define SHARED_SPI 0
+#define DEDICATED_SPI 1
+#define SD_SCK_MHZ(maxMhz) (1000000UL * (maxMhz))
+
+struct SdSpiConfig {
+  SdSpiConfig(uint8_t cs, uint8_t opt, uint32_t clock) : csPin(cs), options(opt), maxSck(clock) {}
+  uint8_t csPin;
+  uint8_t options;
+  uint32_t maxSck;
+};
+
+class File32 : public Stream {
+public:
+  File32() {}
+
+  bool open(const char *path, int oflag = O_RDONLY);
+  bool open(const String &path, int oflag = O_RDONLY) { return open(path.c_str(), oflag); }
+  bool openNext(File32 *dir, int oflag = O_RDONLY);
+  bool close();
+  bool isOpen() const { return (bool)_h; }
+  explicit operator bool() const { return isOpen(); }
+  bool isDirectory() const;
+  bool isFile() const { return isOpen() && !isDirectory(); }
+
+  size_t getName(char *name, size_t size);
+  uint32_t size() const;
+  uint32_t fileSize() const { return size(); }
+  uint32_t curPosition() const;
+  uint32_t position() const { return curPosition(); }
+  bool seekSet(uint32_t pos);
+  bool seekCur(int32_t offset);
+  bool seekEnd(int32_t offset = 0);
+  bool seek(uint32_t pos) { return seekSet(pos); }
+  bool truncate(uint32_t length);
+  bool truncate() { return truncate(curPosition()); }
+  bool preAllocate(uint32_t length);
+  bool sync();
+  bool rename(const char *newPath);
+  bool remove();
+
+  int available() override;
+  int read() override;
+  int read(void *buf, size_t count);
+  int peek() override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t count) override;
+  using Print::write;
+  void flush() override { sync(); }
+
+private:
+  struct Handle;
+  std::shared_ptr<Handle> _h;
+};
+
+class SdFat32 {
+public:
+  bool begin(SdSpiConfig config);
+  void initErrorHalt(Print *pr);
+  File32 open(const char *path, int oflag = O_RDONLY);
+  File32 open(const String &path, int oflag = O_RDONLY) { return open(path.c_str(), oflag); }
+  bool exists(const char *path);
+  bool exists(const String &path) { return exists(path.c_str()); }
+  bool mkdir(const char *path, bool pFlag = true);
+  bool mkdir(const String &path, bool pFlag = true) { return mkdir(path.c_str(), pFlag); }
+  bool remove(const char *path);
+  bool remove(const String &path) { return remove(path.c_str()); }
+  bool rename(const char *oldPath, const char *newPath);
+  bool rmdir(const char *path);
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "WString.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+static std::string inBase(unsigned long long value, unsigned char base, bool negative) {
+  if (base < 2 || base > 36) base = 10;
+  std::string out;
+  do {
+    int d = value % base;
+    out += (char)(d < 10 ? '0' + d : 'a' + d - 10);
+    value /= base;
+  } while (value);
+  if (negative) out += '-';
+  std::reverse(out.begin(), out.end());
+  return out;
+}
+
+String::String(unsigned char value, unsigned char base) : s(inBase(value, base, false)) {}
+String::String(unsigned int value, unsigned char base) : s(inBase(value, base, false)) {}
+String::String(unsigned long value, unsigned char base) : s(inBase(value, base, false)) {}
+String::String(int value, unsigned char base) : String((long)value, base) {}
+String::String(long value, unsigned char base) {
+  if (base == 10 && value < 0) s = inBase(-(long long)value, base, true);
+  else s = inBase((unsigned long)value, base, false);
+}
+String::String(float value, unsigned char decimalPlaces) : String((double)value, decimalPlaces) {}
+String::String(double value, unsigned char decimalPlaces) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+  s = buf;
+}
+
+bool String::equalsIgnoreCase(const String &rhs) const {
+  if (s.size() != rhs.s.size()) return false;
+  for (size_t i = 0; i < s.size(); i++) {
+    if (tolower((unsigned char)s[i]) != tolower((unsigned char)rhs.s[i])) return false;
+  }
+  return true;
+}
+
+String String::substring(unsigned int left, unsigned int right) const {
+  if (left > right) std::swap(left, right);
+  if (left >= s.size()) return String();
+  if (right > s.size()) right = s.size();
+  return String(s.substr(left, right - left));
+}
+
+void String::replace(const String &find, const String &with) {
+  if (find.s.empty()) return;
+  size_t pos = 0;
+  while ((pos = s.find(find.s, pos)) != std::string::npos) {
+    s.replace(pos, find.s.size(), with.s);
+    pos += with.s.size();
+  }
+}
+
+void String::trim() {
+  size_t b = 0, e = s.size();
+  while (b < e && isspace((unsigned char)s[b])) b++;
+  while (e > b && isspace((unsigned char)s[e - 1])) e--;
+  s = s.substr(b, e - b);
+}
+
+void String::toLowerCase() {
+  for (char &c : s) c = tolower((unsigned char)c);
+}
+
+void String::toUpperCase() {
+  for (char &c : s) c = toupper((unsigned char)c);
+}
+
+long String::toInt() const {
+  return atol(s.c_str());
+}
+
+float String::toFloat() const {
+  return (float)atof(s.c_str());
+}
+
+double String::toDouble() const {
+  return atof(s.c_str());
+}
+
+String operator+(const String &lhs, const String &rhs) {
+  String r(lhs);
+  r += rhs;
+  return r;
+}
+String operator+(const String &lhs, const char *rhs) {
+  String r(lhs);
+  r += rhs;
+  return r;
+}
+String operator+(const char *lhs, const String &rhs) {
+  String r(lhs);
+  r += rhs;
+  return r;
+}
+String operator+(const String &lhs, char rhs) {
+  String r(lhs);
+  r += rhs;
+  return r;
+}
+String operator+(const String &lhs, int rhs) { return lhs + String(rhs); }
+String operator+(const String &lhs, unsigned int rhs) { return lhs + String(rhs); }
+String operator+(const String &lhs, long rhs) { return lhs + String(rhs); }
+String operator+(const String &lhs, unsigned long rhs) { return lhs + String(rhs); }
+String operator+(const String &lhs, double rhs) { return lhs + String(rhs); }
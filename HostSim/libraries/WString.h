@@ -0,0 +1,97 @@
+/**
+ * Arduino String for the host simulation, built on std::string.  Only the
+ * members CBASS-32 uses are provided, with Arduino's semantics (indexOf
+ * returns -1, substring clamps, toInt/toFloat return 0 on junk, ...).
+ */
+#ifndef SIM_WSTRING_H
+#define SIM_WSTRING_H
+
+#include <cstddef>
+#include <string>
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+class String {
+public:
+  String() {}
+  String(const char *cstr) : s(cstr ? cstr : "") {}
+  String(const std::string &str) : s(str) {}
+  String(const __FlashStringHelper *f) : s(reinterpret_cast<const char *>(f)) {}
+  explicit String(char c) : s(1, c) {}
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(float value, unsigned char decimalPlaces = 2);
+  explicit String(double value, unsigned char decimalPlaces = 2);
+
+  const char *c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.length(); }
+  bool isEmpty() const { return s.empty(); }
+  bool reserve(unsigned int size) { s.reserve(size); return true; }
+  char charAt(unsigned int i) const { return i < s.size() ? s[i] : 0; }
+  char operator[](unsigned int i) const { return charAt(i); }
+
+  String &operator+=(const String &rhs) { s += rhs.s; return *this; }
+  String &operator+=(const char *rhs) { if (rhs) s += rhs; return *this; }
+  String &operator+=(char c) { s += c; return *this; }
+  String &operator+=(int n) { return *this += String(n); }
+  String &operator+=(unsigned int n) { return *this += String(n); }
+  String &operator+=(long n) { return *this += String(n); }
+  String &operator+=(unsigned long n) { return *this += String(n); }
+  String &operator+=(double d) { return *this += String(d); }
+  bool concat(const char *cstr, unsigned int len) { s.append(cstr, len); return true; }
+
+  bool equals(const String &rhs) const { return s == rhs.s; }
+  bool equals(const char *rhs) const { return s == (rhs ? rhs : ""); }
+  bool equalsIgnoreCase(const String &rhs) const;
+  bool operator==(const String &rhs) const { return s == rhs.s; }
+  bool operator==(const char *rhs) const { return equals(rhs); }
+  bool operator!=(const String &rhs) const { return s != rhs.s; }
+  bool operator!=(const char *rhs) const { return !equals(rhs); }
+  bool operator<(const String &rhs) const { return s < rhs.s; }
+  bool startsWith(const String &prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+  bool endsWith(const String &suffix) const {
+    return s.size() >= suffix.s.size() && s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+  }
+
+  int indexOf(char c, unsigned int from = 0) const { return npos(s.find(c, from)); }
+  int indexOf(const String &str, unsigned int from = 0) const { return npos(s.find(str.s, from)); }
+  int indexOf(const char *str, unsigned int from = 0) const { return npos(s.find(str, from)); }
+  int lastIndexOf(char c) const { return npos(s.rfind(c)); }
+  int lastIndexOf(const String &str) const { return npos(s.rfind(str.s)); }
+  int lastIndexOf(const char *str) const { return npos(s.rfind(str)); }
+  String substring(unsigned int left) const { return substring(left, s.size()); }
+  String substring(unsigned int left, unsigned int right) const;
+
+  void remove(unsigned int index) { if (index < s.size()) s.erase(index); }
+  void remove(unsigned int index, unsigned int count) { if (index < s.size()) s.erase(index, count); }
+  void replace(const String &find, const String &with);
+  void trim();
+  void toLowerCase();
+  void toUpperCase();
+
+  long toInt() const;
+  float toFloat() const;
+  double toDouble() const;
+
+  const std::string &std() const { return s; }
+
+private:
+  static int npos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+  std::string s;
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+String operator+(const String &lhs, char rhs);
+String operator+(const String &lhs, int rhs);
+String operator+(const String &lhs, unsigned int rhs);
+String operator+(const String &lhs, long rhs);
+String operator+(const String &lhs, unsigned long rhs);
+String operator+(const String &lhs, double rhs);
+
+#endif
@@ -0,0 +1,47 @@
+/**
+ * WiFi stand-in.  Station mode connects at once to 127.0.0.1; access point
+ * mode reports the configured address.  Requests reach the web server
+ * through AsyncWebServer::simRequest() instead of a socket.
+ */
+#ifndef SIM_WIFI_H
+#define SIM_WIFI_H
+
+#include "Arduino.h"
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+typedef enum { WL_IDLE_STATUS = 0, WL_CONNECTED = 3, WL_DISCONNECTED = 6 } wl_status_t;
+
+class WiFiClient {
+public:
+  IPAddress remoteIP() const { return IPAddress(127, 0, 0, 1); }
+};
+
+class WiFiClass {
+public:
+  bool mode(wifi_mode_t m) { _mode = m; return true; }
+  bool setHostname(const char *name) { (void)name; return true; }
+  wl_status_t begin(const char *ssid, const char *passphrase = nullptr) {
+    (void)ssid; (void)passphrase;
+    _status = WL_CONNECTED;
+    return _status;
+  }
+  wl_status_t status() { return _status; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  bool disconnect(bool wifioff = false) { (void)wifioff; _status = WL_DISCONNECTED; return true; }
+  bool softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet) {
+    (void)gateway; (void)subnet;
+    _apIP = local_ip;
+    return true;
+  }
+  bool softAP(const char *ssid, const char *passphrase = nullptr) { (void)ssid; (void)passphrase; return true; }
+  IPAddress softAPIP() { return _apIP; }
+  bool softAPdisconnect(bool wifioff = false) { (void)wifioff; return true; }
+
+private:
+  wifi_mode_t _mode = WIFI_OFF;
+  wl_status_t _status = WL_IDLE_STATUS;
+  IPAddress _apIP = IPAddress(192, 168, 4, 1);
+};
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,30 @@
+/**
+ * Task watchdog stand-in.  A reset stamps the virtual clock for the calling
+ * task; the clock throws sim::Watchdog if it moves past the timeout without
+ * one from every subscribed task.
+ */
+#ifndef SIM_ESP_TASK_WDT_H
+#define SIM_ESP_TASK_WDT_H
+
+#include <cstdint>
+#include "../Sim.h"
+#include "FreeRTOS.h"
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+inline esp_err_t esp_task_wdt_init(uint32_t timeout, bool panic) {
+  (void)panic;
+  sim::wdtTimeoutSeconds = timeout;
+  return ESP_OK;
+}
+inline esp_err_t esp_task_wdt_add(TaskHandle_t task) {
+  sim::wdtAdd(task ? task : xTaskGetCurrentTaskHandle());
+  return ESP_OK;
+}
+inline esp_err_t esp_task_wdt_reset() {
+  sim::wdtReset(xTaskGetCurrentTaskHandle());
+  return ESP_OK;
+}
+
+#endif
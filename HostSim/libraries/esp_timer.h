@@ -0,0 +1,17 @@
+/**
+ * esp_timer stand-in.  Unlike micros(), which follows the virtual clock,
+ * esp_timer_get_time() returns real host time so benchmarks written for the
+ * board measure the host when run here.
+ */
+#ifndef SIM_ESP_TIMER_H
+#define SIM_ESP_TIMER_H
+
+#include <chrono>
+#include <cstdint>
+
+inline int64_t esp_timer_get_time() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
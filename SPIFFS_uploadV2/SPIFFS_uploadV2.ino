@@ -11,6 +11,10 @@
  * 4) The Arduino NANO ESP32 now has those files permanently installed.
  * 5) Optionally, you may delete the files from the SD card, as they are no
  *    longer needed there.
+ * Files with a gzip-compressed copy (name.gz) in htdocs are stored only as the
+ * .gz, which the web server sends to any browser accepting gzip.  plotly.js.gz
+ * is a third the size of plotly.js, so it loads faster and fits more easily.
+ * To add one, run "gzip -9 -k -n name" in htdocs.
  * PROTIP: Initialize all of your Arduinos at once before assembling them into
  *    the enclosures.  You can do this by swapping them into a single CBASS-32 using
  *    a single microSD card if that is more convenient.  You just need to load and
@@ -74,6 +78,20 @@ void copyFile_toFS(fs::FS &fs2, const char *path) {
 }
 
 
+/**
+ * Copy path, or path.gz instead if the SD card has it.  An older copy in the
+ * other form is deleted so the server cannot send a stale version.
+ */
+void copyAsset_toFS(fs::FS &fs2, const char *path) {
+  String gz = String(path) + ".gz";
+  if (SD.exists(gz)) {
+    copyFile_toFS(fs2, gz.c_str());
+    if (fs2.exists(path)) deleteFile(fs2, path);
+  } else {
+    copyFile_toFS(fs2, path);
+    if (fs2.exists(gz)) deleteFile(fs2, gz.c_str());
+  }
+}
 
 /**
  * Not a function we need except for testing.
@@ -171,12 +189,12 @@ void setup() {
   //deleteFile(SPIFFS, "/fakesub/hello.txt");
 
   // Copy each file, deleting any prior version first.
-  copyFile_toFS(SPIFFS, "/htdocs/trash.png");
-  copyFile_toFS(SPIFFS, "/htdocs/plus_circle.png");
-  copyFile_toFS(SPIFFS, "/htdocs/favicon.ico");
-  copyFile_toFS(SPIFFS, "/htdocs/page.css");
-  //copyFile_toFS(SPIFFS, "/htdocs/plotly.js");
-  //copyFile_toFS(SPIFFS, "/htdocs/fullScreenIcon.svg");
+  copyAsset_toFS(SPIFFS, "/htdocs/trash.png");
+  copyAsset_toFS(SPIFFS, "/htdocs/plus_circle.png");
+  copyAsset_toFS(SPIFFS, "/htdocs/favicon.ico");
+  copyAsset_toFS(SPIFFS, "/htdocs/page.css");
+  copyAsset_toFS(SPIFFS, "/htdocs/plotly.js");
+  copyAsset_toFS(SPIFFS, "/htdocs/fullScreenIcon.svg");
   
 
   Serial.println("\nSPIFFS dir:");